@@ -0,0 +1,12 @@
+#pragma once
+
+// Shared by the microbenchmarks.
+
+// Stores a result of the timed loop through a volatile, a write the compiler
+// has to keep, so neither the result nor the loop computing it is optimised
+// away.
+template <typename T>
+inline void do_not_optimize(const T& value){
+    static volatile T sink;
+    sink = value;
+}
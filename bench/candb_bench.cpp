@@ -0,0 +1,151 @@
+// CanStore insert, store, lookup and walk rates at 5k and 10k ids, mixed
+// 11-bit and 29-bit, next to an unordered_map under a mutex as a reference.
+// CanStore's first frame of an id allocates its history ring and every
+// store also writes the ring and the traffic counters, the map does neither.
+//
+//   candb_bench [rounds]    (default 200 stores per id)
+
+#include "bench.hpp"
+#include "candb.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// roughly a shared bus: every 11-bit id first, then J1939 style 29-bit ones
+std::vector<uint32_t> make_ids(size_t n){
+    std::vector<uint32_t> ids;
+    for(uint32_t id = 0; id <= CAN_ID_STD_MASK && ids.size() < n; ++id)
+        ids.push_back(id);
+    std::mt19937 rng(7);
+    std::unordered_set<uint32_t> seen;
+    while(ids.size() < n){
+        const uint32_t id = CAN_ID_EXT_FLAG | 0x18000000u | (rng() & 0x00FFFFFFu);
+        if(seen.insert(id).second)
+            ids.push_back(id);
+    }
+    std::shuffle(ids.begin(), ids.end(), rng);
+    return ids;
+}
+
+// the obvious alternative: one map, one lock
+class MapStore {
+    public:
+        void store(uint32_t id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns){
+            std::lock_guard<std::mutex> lock(_mtx);
+            CanFrame &f = _frames[id];
+            f.len = len;
+            std::copy(payload, payload + len, f.data.begin());
+            f.timestamp_ns = timestamp_ns;
+        }
+        bool read(uint32_t id, CanFrame& out) const{
+            std::lock_guard<std::mutex> lock(_mtx);
+            auto it = _frames.find(id);
+            if(it == _frames.end())
+                return false;
+            out = it->second;
+            return true;
+        }
+    private:
+        mutable std::mutex _mtx;
+        std::unordered_map<uint32_t, CanFrame> _frames;
+};
+
+struct Rates {
+    double insert_mops = 0;     // first frame of each id
+    double store_mops = 0;      // ids already present
+    double read_mops = 0;
+    double walk_us = 0;         // read_at over every id, CanStore only
+};
+
+double mops(size_t ops, uint64_t start){
+    return ops / ((monotonic_ns() - start) * 1e-9) / 1e6;
+}
+
+template <typename Store>
+Rates measure(Store& store, const std::vector<uint32_t>& ids, size_t rounds){
+    const uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    Rates r;
+    uint64_t start = monotonic_ns();
+    for(uint32_t id : ids)
+        store.store(id, 8, payload, 1);
+    r.insert_mops = mops(ids.size(), start);
+
+    start = monotonic_ns();
+    for(size_t n = 0; n < rounds; ++n)
+        for(uint32_t id : ids)
+            store.store(id, 8, payload, n);
+    r.store_mops = mops(ids.size() * rounds, start);
+
+    CanFrame f;
+    uint64_t sum = 0;
+    start = monotonic_ns();
+    for(size_t n = 0; n < rounds; ++n)
+        for(uint32_t id : ids)
+            if(store.read(id, f))
+                sum += f.data[7];
+    r.read_mops = mops(ids.size() * rounds, start);
+    if(sum != ids.size() * rounds * 8)
+        std::cout << "[!] reads came back wrong" << std::endl;
+    return r;
+}
+
+double walk_us(const CanStore& store, size_t rounds){
+    CanFrame f;
+    uint64_t sum = 0;
+    const uint64_t start = monotonic_ns();
+    for(size_t n = 0; n < rounds; ++n)
+        for(size_t i = 0; i < store.size(); ++i)
+            if(store.read_at(i, f))
+                sum += f.len;
+    do_not_optimize(sum);
+    return (monotonic_ns() - start) / 1e3 / rounds;
+}
+
+void row(const std::string& name, size_t ids, const Rates& r){
+    std::cout << std::left << std::setw(22) << name << std::right << std::setw(8) << ids
+              << std::fixed << std::setprecision(1) << std::setw(12) << r.insert_mops
+              << std::setw(12) << r.store_mops << std::setw(12) << r.read_mops;
+    if(r.walk_us > 0)
+        std::cout << std::setw(10) << r.walk_us;
+    else
+        std::cout << std::setw(10) << "-";
+    std::cout << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    const size_t rounds = argc > 1 ? std::stoul(argv[1]) : 200;
+
+    std::cout << rounds << " stores and reads per id, M ops/s\n\n"
+              << std::left << std::setw(22) << "store" << std::right << std::setw(8) << "ids"
+              << std::setw(12) << "insert" << std::setw(12) << "store" << std::setw(12) << "read"
+              << std::setw(10) << "walk us" << "\n";
+
+    for(size_t n : {size_t(5000), size_t(10000)}){
+        const std::vector<uint32_t> ids = make_ids(n);
+        {
+            auto store = std::make_unique<CanStore>();
+            Rates r = measure(*store, ids, rounds);
+            r.walk_us = walk_us(*store, rounds);
+            if(store->size() != n)
+                std::cout << "[!] CanStore holds " << store->size() << " ids" << std::endl;
+            row("CanStore", n, r);
+        }
+        {
+            MapStore map;
+            row("unordered_map+mutex", n, measure(map, ids, rounds));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+// CanStore under contention: one writer at a CAN-like 20k frames/s over a
+// few thousand ids while GUI-style readers sweep every entry, against the
+// per-entry mutex store the seqlock replaced. Reports the writer's store
+// latency, the readers' throughput and any torn payloads they saw.
+//
+//   candb_contention_bench [seconds] [readers]    (default 3 s, 3 readers)
+
+#include "candb.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t IDS = 2000;
+constexpr uint64_t FRAME_PERIOD_NS = 50000;     // 20k frames/s
+
+// the store as it was: a mutex per entry, held by readers while they copy
+class LockedStore {
+    public:
+        LockedStore() : _entries(new Entry[IDS]) {}
+
+        void store(uint32_t id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns){
+            Entry &e = _entries[id];
+            std::lock_guard<std::mutex> lock(e.mtx);
+            e.len = len;
+            e.timestamp_ns = timestamp_ns;
+            std::copy(payload, payload + len, e.data.begin());
+            std::fill(e.data.begin() + len, e.data.end(), 0);
+            e.valid = true;
+        }
+
+        bool read(uint32_t id, CanFrame& out) const{
+            const Entry &e = _entries[id];
+            std::lock_guard<std::mutex> lock(e.mtx);
+            if(!e.valid)
+                return false;
+            out.len = e.len;
+            out.timestamp_ns = e.timestamp_ns;
+            std::copy(e.data.begin(), e.data.end(), out.data.begin());
+            return true;
+        }
+
+    private:
+        struct Entry {
+            mutable std::mutex mtx;
+            bool valid = false;
+            uint8_t len = 0;
+            uint64_t timestamp_ns = 0;
+            std::array<uint8_t, CAN_CLASSIC_MAX_LEN> data{};
+        };
+        std::unique_ptr<Entry[]> _entries;
+};
+
+struct Result {
+    double p50_us = 0, p99_us = 0, max_us = 0;     // per store() call
+    double writer_fps = 0;
+    double reads_m_s = 0;                           // entries, all readers
+    uint64_t torn = 0;
+};
+
+// every payload byte is the frame count's low byte, so a torn copy shows up
+// as bytes that disagree
+template <typename Store>
+Result contend(Store& store, double seconds, unsigned readers){
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> reads{0}, torn{0};
+    std::vector<std::thread> threads;
+    for(unsigned r = 0; r < readers; ++r){
+        threads.emplace_back([&]{
+            CanFrame f;
+            uint64_t n = 0, bad = 0;
+            while(running.load(std::memory_order_relaxed)){
+                for(uint32_t id = 0; id < IDS; ++id){
+                    if(!store.read(id, f))
+                        continue;
+                    ++n;
+                    if(std::any_of(f.data.begin() + 1, f.data.begin() + 8, [&](uint8_t b){ return b != f.data[0]; }))
+                        ++bad;
+                }
+            }
+            reads += n;
+            torn += bad;
+        });
+    }
+
+    std::vector<double> us;
+    const uint64_t start = monotonic_ns();
+    const uint64_t end = start + static_cast<uint64_t>(seconds * 1e9);
+    uint64_t next = start;
+    uint8_t payload[8];
+    for(uint64_t frame = 0; next < end; ++frame){
+        next += FRAME_PERIOD_NS;
+        while(monotonic_ns() < next)
+            std::this_thread::yield();
+        std::fill(payload, payload + 8, static_cast<uint8_t>(frame));
+        const uint64_t t0 = monotonic_ns();
+        store.store(static_cast<uint32_t>(frame % IDS), 8, payload, t0);
+        us.push_back((monotonic_ns() - t0) / 1000.0);
+    }
+    const double elapsed = (monotonic_ns() - start) * 1e-9;
+    running.store(false);
+    for(auto &t : threads)
+        t.join();
+
+    std::sort(us.begin(), us.end());
+    Result res;
+    res.p50_us = us[us.size() / 2];
+    res.p99_us = us[us.size() * 99 / 100];
+    res.max_us = us.back();
+    res.writer_fps = us.size() / elapsed;
+    res.reads_m_s = reads.load() / elapsed / 1e6;
+    res.torn = torn.load();
+    return res;
+}
+
+void row(const std::string& name, const Result& r){
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << r.p50_us << std::setw(10) << r.p99_us << std::setprecision(1)
+              << std::setw(10) << r.max_us << std::setprecision(0) << std::setw(10) << r.writer_fps
+              << std::setprecision(1) << std::setw(12) << r.reads_m_s << std::setw(8) << r.torn << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    const double seconds = argc > 1 ? std::stod(argv[1]) : 3.0;
+    const unsigned readers = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 3;
+
+    std::cout << "1 writer at " << 1000000000 / FRAME_PERIOD_NS << " frames/s over " << IDS << " ids, "
+              << readers << " readers, " << seconds << " s each, " << std::thread::hardware_concurrency()
+              << " cpus\n\n"
+              << std::left << std::setw(18) << "store" << std::right << std::setw(10) << "p50 us"
+              << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::setw(10) << "frames/s"
+              << std::setw(12) << "M reads/s" << std::setw(8) << "torn" << "\n";
+
+    {
+        LockedStore store;
+        row("mutex (old)", contend(store, seconds, readers));
+    }
+    {
+        auto store = std::make_unique<CanStore>();
+        row("seqlock", contend(*store, seconds, readers));
+    }
+    return 0;
+}
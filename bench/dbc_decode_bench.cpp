@@ -0,0 +1,205 @@
+// Signal decoding over the five builtin DBCs: the bit-at-a-time loop behind
+// an unordered_map lookup that decoding used to be, the plans DbcParser
+// compiles when it parses a DBC, and the code dbc_to_header generates
+// for the builtins. Every message is decoded from random payloads.
+//
+//   dbc_decode_bench [dbc dir] [rounds]    (default the repo's dbc/, 2000)
+
+#include "bench.hpp"
+#include "dbc.hpp"
+#include "dbc_compiled.hpp"
+#include "clock.hpp"
+#include "bps_dbc.hpp"
+#include "controls_dbc.hpp"
+#include "prohelion_wavesculptor22_dbc.hpp"
+#include "mppt_dbc.hpp"
+#include "daq_dbc.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef PHOTON_DBC_DIR
+#define PHOTON_DBC_DIR "dbc"
+#endif
+
+namespace {
+
+// the decode path as it was: find the message, then every signal bit by bit
+class LegacyDecoder {
+    public:
+        explicit LegacyDecoder(const DbcParser& dbc) : _messages(dbc.messages()) {}
+
+        bool decode_values(uint32_t id, const CanFrame& frame, std::vector<double>& out) const{
+            auto it = _messages.find(id);
+            if(it == _messages.end()) return false;
+            out.clear();
+            for(const auto& sig : it->second.signals){
+                if(!signal_fits(sig))
+                    continue;
+                uint64_t raw = extract_signal(frame.data.data(), sig.start_bit, sig.size, sig.little_endian);
+                int64_t s = sig.is_signed ? sign_extend(raw, sig.size) : (int64_t)raw;
+                out.push_back(s * sig.factor + sig.offset);
+            }
+            return true;
+        }
+
+    private:
+        static uint64_t extract_signal(const uint8_t* data, uint16_t start, uint8_t size, bool little){
+            uint64_t val = 0;
+            if(little){
+                for(unsigned i=0;i<size;++i){
+                    unsigned pos = start + i;
+                    uint8_t byte = pos / 8;
+                    uint8_t bit = pos % 8;
+                    val |= ((uint64_t)((data[byte] >> bit) & 1) << i);
+                }
+            } else {
+                for(unsigned i=0;i<size;++i){
+                    int pos = start - i;
+                    uint8_t byte = pos / 8;
+                    uint8_t bit = pos % 8;
+                    val = (val << 1) | ((data[byte] >> bit) & 1);
+                }
+            }
+            return val;
+        }
+
+        static bool signal_fits(const DbcSignal& sig){
+            const unsigned max_bits = CAN_FD_MAX_LEN * 8;
+            if(sig.size == 0 || sig.size > 64)
+                return false;
+            if(sig.little_endian)
+                return sig.start_bit + sig.size <= max_bits;
+            return sig.start_bit < max_bits && sig.start_bit + 1 >= sig.size;
+        }
+
+        static int64_t sign_extend(uint64_t val, unsigned bits){
+            if(bits == 0 || bits >= 64) return static_cast<int64_t>(val);
+            uint64_t mask = 1ull << (bits - 1);
+            return (val ^ mask) - mask;
+        }
+
+        std::unordered_map<uint32_t, DbcMessage> _messages;
+};
+
+struct Frame {
+    uint32_t id;
+    CanFrame frame;
+};
+
+template <typename Decoder>
+double mframes_s(const Decoder& dbc, const std::vector<Frame>& frames, size_t rounds, uint64_t& signals){
+    std::vector<double> values;
+    double sum = 0;
+    signals = 0;
+    const uint64_t start = monotonic_ns();
+    for(size_t r = 0; r < rounds; ++r)
+        for(const auto &f : frames)
+            if(dbc.decode_values(f.id, f.frame, values)){
+                signals += values.size();
+                if(!values.empty())
+                    sum += values[0];
+            }
+    const double s = (monotonic_ns() - start) * 1e-9;
+    do_not_optimize(sum);
+    return frames.size() * rounds / s / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    const std::string dir = argc > 1 ? argv[1] : PHOTON_DBC_DIR;
+    const size_t rounds = argc > 2 ? std::stoul(argv[2]) : 2000;
+    const std::pair<const char*, const DbcCompiledDbc*> builtins[] = {
+        {"bps.dbc", &bps_dbc_compiled},
+        {"controls.dbc", &controls_dbc_compiled},
+        {"prohelion_wavesculptor22.dbc", &prohelion_wavesculptor22_dbc_compiled},
+        {"mppt.dbc", &mppt_dbc_compiled},
+        {"daq.dbc", &daq_dbc_compiled},
+    };
+
+    DbcParser parsed, generated;
+    for(const auto &b : builtins){
+        if(!parsed.load(dir + "/" + b.first)){
+            std::cout << "[!] Unable to load " << dir << "/" << b.first << std::endl;
+            return 1;
+        }
+        generated.add_compiled(*b.second, b.first);
+    }
+    const LegacyDecoder legacy(parsed);
+
+    // every message, with a few payloads each
+    std::mt19937 rng(22);
+    std::vector<Frame> frames;
+    for(const auto &mp : parsed.messages()){
+        for(int k = 0; k < 4; ++k){
+            Frame f{mp.first, {}};
+            f.frame.len = mp.second.dlc ? can_dlc_to_len(can_len_to_dlc(mp.second.dlc)) : CAN_CLASSIC_MAX_LEN;
+            for(auto &b : f.frame.data)
+                b = static_cast<uint8_t>(rng());
+            frames.push_back(f);
+        }
+    }
+
+    // plans and the bit loop agree wherever the loop was right: it read
+    // float signals as integers and counted Motorola bits down linearly,
+    // so messages with either are left out of the check
+    std::vector<double> a, b, c;
+    size_t mismatched = 0, unchecked = 0;
+    auto differ = [](const std::vector<double>& x, const std::vector<double>& y){
+        if(x.size() != y.size())
+            return true;
+        for(size_t i = 0; i < x.size(); ++i)
+            if(std::fabs(x[i] - y[i]) > 1e-9 * std::max(1.0, std::fabs(x[i])))
+                return true;
+        return false;
+    };
+    for(const auto &f : frames){
+        legacy.decode_values(f.id, f.frame, a);
+        parsed.decode_values(f.id, f.frame, b);
+        // the generated code has to match the plans everywhere
+        generated.decode_values(f.id, f.frame, c);
+        if(differ(b, c)){
+            ++mismatched;
+            continue;
+        }
+        bool old_wrong = false;
+        for(const auto &sig : parsed.messages().at(f.id).signals)
+            old_wrong |= sig.value_type != DbcValueType::Integer
+                      || (!sig.little_endian && sig.size > sig.start_bit % 8 + 1);
+        if(old_wrong){
+            ++unchecked;
+            continue;
+        }
+        if(differ(a, b))
+            ++mismatched;
+    }
+
+    uint64_t signals = 0;
+    std::cout << parsed.messages().size() << " messages in " << sizeof(builtins) / sizeof(builtins[0])
+              << " builtin DBCs, " << frames.size() << " frames x " << rounds << ", "
+              << unchecked << " frames the old loop got wrong not compared\n\n"
+              << std::left << std::setw(22) << "decoder" << std::right << std::setw(12) << "Mframes/s"
+              << std::setw(14) << "Msignals/s" << std::setw(9) << "" << "\n";
+    const double old = mframes_s(legacy, frames, rounds, signals);
+    const double per_frame = static_cast<double>(signals) / (frames.size() * rounds);
+    auto print = [&](const char* name, double mfs){
+        std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << mfs << std::setw(14) << mfs * per_frame
+                  << std::setprecision(2) << std::setw(8) << mfs / old << "x\n";
+    };
+    print("bit loop (old)", old);
+    print("compiled plans", mframes_s(parsed, frames, rounds, signals));
+    print("generated code", mframes_s(generated, frames, rounds, signals));
+    if(mismatched){
+        std::cout << "[!] " << mismatched << " frames decode differently between the decoders" << std::endl;
+        return 1;
+    }
+    return 0;
+}
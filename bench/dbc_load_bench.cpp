@@ -0,0 +1,218 @@
+// DbcParser's string_view scanner against the line/istringstream parser it
+// replaced, on a generated DBC of a few thousand messages. Both parse the
+// same text from memory; the new one additionally compiles its decode plans.
+//
+//   dbc_load_bench [messages] [passes]    (default 4000 messages, best of 5)
+//
+// The generated file sticks to what the old parser could read: no
+// multiplexing and single-line comments.
+
+#include "dbc.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// the parser as it was, loadFromMemory() only
+class LegacyDbcParser {
+    public:
+        bool loadFromMemory(const char* data, size_t size, const std::string& name){
+            std::istringstream file(std::string(data, size));
+            if(!file)
+                return false;
+            std::string src = name;
+            std::string line;
+            DbcMessage* current = nullptr;
+            unsigned default_cycle_ms = 0;
+            std::unordered_map<uint32_t, unsigned> cycle_ms;
+            while(std::getline(file, line)){
+                line = trim(line);
+                if(line.empty()) continue;
+                std::istringstream iss(line);
+                std::string tok;
+                iss >> tok;
+                if(tok == "BO_"){
+                    uint32_t id; std::string name; char colon; unsigned dlc; std::string transmitter;
+                    iss >> id >> name >> colon >> dlc >> transmitter;
+                    DbcMessage msg; msg.id = id; msg.name = name; msg.dlc = static_cast<uint8_t>(dlc);
+                    msg.dbc_name = src;
+                    _messages[id] = msg;
+                    current = &_messages[id];
+                } else if(tok == "SG_" && current){
+                    std::string name; iss >> name;
+                    if(!iss) continue;
+                    std::string sep; iss >> sep;
+                    std::string rest; std::getline(iss, rest);
+                    rest = trim(rest);
+                    std::istringstream iss2(rest);
+                    std::string posToken; iss2 >> posToken;
+                    size_t pipe = posToken.find('|');
+                    size_t at = posToken.find('@', pipe+1);
+                    uint16_t start = static_cast<uint16_t>(std::stoi(posToken.substr(0, pipe)));
+                    uint8_t sizeb = static_cast<uint8_t>(std::stoi(posToken.substr(pipe+1, at-pipe-1)));
+                    bool little = posToken.at(at+1) == '1';
+                    bool sign = posToken.at(at+2) == '-';
+                    std::string factorToken; iss2 >> factorToken;
+                    double factor = 1.0, offset = 0.0;
+                    if(factorToken.size() > 2){
+                        factorToken = factorToken.substr(1, factorToken.size()-2);
+                        size_t comma = factorToken.find(',');
+                        factor = std::stod(factorToken.substr(0, comma));
+                        offset = std::stod(factorToken.substr(comma+1));
+                    }
+                    DbcSignal sig; sig.name = name; sig.start_bit = start; sig.size = sizeb;
+                    sig.little_endian = little; sig.is_signed = sign; sig.factor = factor; sig.offset = offset;
+                    current->signals.push_back(sig);
+                } else if(tok == "VAL_TABLE_"){
+                    std::string table; iss >> table;
+                    int64_t val; std::string desc;
+                    while(iss >> val){
+                        iss >> std::ws; char quote; iss >> quote; std::getline(iss, desc, '"');
+                        _value_tables[table][val] = desc;
+                        iss >> std::ws; char end; iss >> end;
+                    }
+                } else if(tok == "VAL_"){
+                    uint32_t id; std::string sig; iss >> id >> sig;
+                    int64_t val; std::string desc;
+                    while(iss >> val){
+                        iss >> std::ws; char quote; iss >> quote; std::getline(iss, desc, '"');
+                        _value_tables[sig][val] = desc;
+                        iss >> std::ws; char end; iss >> end;
+                    }
+                } else if(tok == "BA_DEF_DEF_"){
+                    std::string attr; unsigned ms;
+                    iss >> attr;
+                    if(attr == "\"GenMsgCycleTime\"" && (iss >> ms))
+                        default_cycle_ms = ms;
+                } else if(tok == "BA_"){
+                    std::string attr, kind; iss >> attr >> kind;
+                    uint32_t id; unsigned ms;
+                    if(attr == "\"GenMsgCycleTime\"" && kind == "BO_" && (iss >> id >> ms))
+                        cycle_ms[id] = ms;
+                }
+            }
+
+            for(auto &mp : _messages){
+                if(mp.second.dbc_name != src)
+                    continue;
+                auto it = cycle_ms.find(mp.first);
+                mp.second.cycle_time_ms = it != cycle_ms.end() ? it->second : default_cycle_ms;
+            }
+
+            for(auto &mp : _messages){
+                for(auto &sig : mp.second.signals){
+                    auto it = _value_tables.find(sig.name);
+                    if(it != _value_tables.end()) sig.value_map = it->second;
+                }
+            }
+            return true;
+        }
+
+        const std::unordered_map<uint32_t, DbcMessage>& messages() const { return _messages; }
+
+    private:
+        static std::string trim(const std::string& in){
+            auto start = in.find_first_not_of(" \t\r\n");
+            auto end = in.find_last_not_of(" \t\r\n");
+            if(start == std::string::npos) return "";
+            return in.substr(start, end - start + 1);
+        }
+
+        std::unordered_map<std::string, std::unordered_map<int64_t, std::string>> _value_tables;
+        std::unordered_map<uint32_t, DbcMessage> _messages;
+};
+
+// a vehicle-sized DBC: 8 byte messages with 8 to 16 signals of mixed byte
+// order, units, receivers, comments, cycle times and a few value tables
+std::string generate_dbc(size_t messages){
+    std::mt19937 rng(21);
+    std::ostringstream out;
+    out << "VERSION \"\"\n\nNS_ :\n\tCM_\n\tBA_DEF_\n\tBA_\n\tVAL_\n\nBS_:\n\nBU_: ECU1 ECU2 ECU3 ECU4\n\n";
+    out << "VAL_TABLE_ OnOff 1 \"On\" 0 \"Off\" ;\n\n";
+    for(size_t m = 0; m < messages; ++m){
+        const uint32_t id = m < 1500 ? static_cast<uint32_t>(m) : (0x80000000u | (0x18F00000u + static_cast<uint32_t>(m)));
+        out << "BO_ " << id << " Msg_" << m << ": 8 ECU" << (1 + m % 4) << "\n";
+        const unsigned signals = 8 + rng() % 9;
+        const unsigned bits = 64 / signals;
+        for(unsigned s = 0; s < signals; ++s){
+            const bool intel = rng() % 3 != 0;
+            const unsigned lsb = s * bits;
+            // Motorola start bits name the msb in the DBC sawtooth order
+            const unsigned start = intel ? lsb : (lsb / 8) * 8 + 7 - (lsb % 8);
+            out << " SG_ Sig_" << m << "_" << s << " : " << start << "|" << (intel ? bits : std::min(bits, 8 - lsb % 8))
+                << "@" << (intel ? 1 : 0) << (s % 4 == 0 ? "-" : "+") << " (" << (0.1 * (1 + rng() % 10)) << ","
+                << (static_cast<int>(rng() % 100) - 50) << ") [0|" << (1u << std::min(bits, 20u)) << "] \""
+                << (s % 2 ? "km/h" : "") << "\" ECU" << (1 + (m + 1) % 4) << ",ECU" << (1 + (m + 2) % 4) << "\n";
+        }
+        out << "\n";
+    }
+    out << "BA_DEF_ BO_ \"GenMsgCycleTime\" INT 0 10000;\n"
+        << "BA_DEF_DEF_ \"GenMsgCycleTime\" 100;\n";
+    for(size_t m = 0; m < messages; m += 3){
+        const uint32_t id = m < 1500 ? static_cast<uint32_t>(m) : (0x80000000u | (0x18F00000u + static_cast<uint32_t>(m)));
+        out << "CM_ BO_ " << id << " \"Message " << m << " as sent by its ECU\";\n";
+        out << "BA_ \"GenMsgCycleTime\" BO_ " << id << " " << (10 * (1 + m % 10)) << ";\n";
+        out << "VAL_ " << id << " Sig_" << m << "_1 3 \"Error\" 2 \"Not available\" 1 \"Active\" 0 \"Idle\" ;\n";
+    }
+    return out.str();
+}
+
+size_t signal_count(const std::unordered_map<uint32_t, DbcMessage>& messages){
+    size_t n = 0;
+    for(const auto &mp : messages)
+        n += mp.second.signals.size();
+    return n;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    const size_t messages = argc > 1 ? std::stoul(argv[1]) : 4000;
+    const int passes = argc > 2 ? std::stoi(argv[2]) : 5;
+    const std::string text = generate_dbc(messages);
+
+    double old_best = 1e30, new_best = 1e30;
+    size_t old_messages = 0, old_signals = 0, new_messages = 0, new_signals = 0;
+    for(int p = 0; p < passes; ++p){
+        {
+            LegacyDbcParser dbc;
+            const uint64_t start = monotonic_ns();
+            dbc.loadFromMemory(text.data(), text.size(), "bench.dbc");
+            old_best = std::min(old_best, (monotonic_ns() - start) * 1e-6);
+            old_messages = dbc.messages().size();
+            old_signals = signal_count(dbc.messages());
+        }
+        {
+            DbcParser dbc;
+            const uint64_t start = monotonic_ns();
+            dbc.loadFromMemory(text.data(), text.size(), "bench.dbc");
+            new_best = std::min(new_best, (monotonic_ns() - start) * 1e-6);
+            new_messages = dbc.messages().size();
+            new_signals = signal_count(dbc.messages());
+        }
+    }
+
+    std::cout << text.size() / 1000 << " kB DBC, best of " << passes << "\n\n"
+              << std::left << std::setw(22) << "parser" << std::right << std::setw(10) << "ms"
+              << std::setw(10) << "MB/s" << std::setw(10) << "messages" << std::setw(10) << "signals" << "\n"
+              << std::fixed << std::setprecision(1)
+              << std::left << std::setw(22) << "line/istream (old)" << std::right << std::setw(10) << old_best
+              << std::setw(10) << text.size() / 1e3 / old_best << std::setw(10) << old_messages
+              << std::setw(10) << old_signals << "\n"
+              << std::left << std::setw(22) << "string_view scanner" << std::right << std::setw(10) << new_best
+              << std::setw(10) << text.size() / 1e3 / new_best << std::setw(10) << new_messages
+              << std::setw(10) << new_signals << "\n\n"
+              << std::setprecision(2) << old_best / new_best << "x\n";
+    if(old_messages != new_messages || old_signals != new_signals){
+        std::cout << "[!] parsers disagree on the content" << std::endl;
+        return 1;
+    }
+    return 0;
+}
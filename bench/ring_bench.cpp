@@ -0,0 +1,195 @@
+// RingBuffer throughput and hand-off latency against the mutex/condvar ring
+// it replaced, for each wait strategy.
+//
+//   ring_bench [megabytes]    (default 256)
+
+#include "bench.hpp"
+#include "ringbuffer.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// the ring as it was: one lock and two condition variables, a notify per chunk
+class LegacyRingBuffer {
+    public:
+        void write(const uint8_t* data, size_t len){
+            size_t written = 0;
+            std::unique_lock<std::mutex> lock(mtx);
+            while(written < len){
+                not_full.wait(lock, [&]{ return count < BUFFERSIZE; });
+                size_t to_write = std::min(len - written, BUFFERSIZE - count);
+                size_t n1 = std::min(BUFFERSIZE - tail, to_write);
+                std::memcpy(buf + tail, data + written, n1);
+                tail = (tail + n1) % BUFFERSIZE;
+                if(n1 < to_write){
+                    std::memcpy(buf + tail, data + written + n1, to_write - n1);
+                    tail = (tail + to_write - n1) % BUFFERSIZE;
+                }
+                count += to_write;
+                written += to_write;
+                not_empty.notify_one();
+            }
+        }
+
+        size_t read(uint8_t* out, size_t maxlen){
+            std::unique_lock<std::mutex> lock(mtx);
+            not_empty.wait(lock, [&]{ return count > 0; });
+            size_t to_read = std::min(count, maxlen);
+            size_t n1 = std::min(BUFFERSIZE - head, to_read);
+            std::memcpy(out, buf + head, n1);
+            head = (head + n1) % BUFFERSIZE;
+            if(n1 < to_read){
+                std::memcpy(out + n1, buf + head, to_read - n1);
+                head = (head + to_read - n1) % BUFFERSIZE;
+            }
+            count -= to_read;
+            not_full.notify_one();
+            return to_read;
+        }
+
+    private:
+        uint8_t buf[BUFFERSIZE];
+        size_t head = 0, tail = 0, count = 0;
+        std::mutex mtx;
+        std::condition_variable not_empty, not_full;
+};
+
+// MB/s moving total bytes in READ_CHUNK writes and reads
+template <typename Ring>
+double copy_throughput(Ring& ring, size_t total){
+    std::vector<uint8_t> src(READ_CHUNK, 0x5a);
+    const uint64_t start = monotonic_ns();
+    std::thread producer([&]{
+        for(size_t sent = 0; sent < total; sent += READ_CHUNK)
+            ring.write(src.data(), READ_CHUNK);
+    });
+    std::vector<uint8_t> dst(READ_CHUNK);
+    for(size_t got = 0; got < total; )
+        got += ring.read(dst.data(), dst.size());
+    producer.join();
+    return total / 1e6 / ((monotonic_ns() - start) * 1e-9);
+}
+
+// the in-place path the sources use: reserve/commit, peek/consume
+double zero_copy_throughput(RingBuffer& ring, size_t total){
+    const uint64_t start = monotonic_ns();
+    std::thread producer([&]{
+        for(size_t sent = 0; sent < total; ){
+            size_t len = 0;
+            uint8_t* dst = ring.reserve(len);
+            len = std::min({len, READ_CHUNK, total - sent});
+            std::memset(dst, 0x5a, len);
+            ring.commit(len);
+            sent += len;
+        }
+    });
+    uint64_t sum = 0;
+    for(size_t got = 0; got < total; ){
+        size_t len = 0;
+        const uint8_t* src = ring.peek(len);
+        sum += src[len - 1];
+        ring.consume(len);
+        got += len;
+    }
+    producer.join();
+    do_not_optimize(sum);
+    return total / 1e6 / ((monotonic_ns() - start) * 1e-9);
+}
+
+struct Latency {
+    double p50_us = 0, p99_us = 0, max_us = 0;
+};
+
+// one-way delay of 16-byte records written every 50 us, a CAN capture rate
+template <typename Ring>
+Latency handoff_latency(Ring& ring, size_t records){
+    std::thread producer([&]{
+        uint8_t rec[16] = {};
+        uint64_t next = monotonic_ns();
+        for(size_t i = 0; i < records; ++i){
+            next += 50000;
+            while(monotonic_ns() < next)
+                std::this_thread::yield();
+            const uint64_t now = monotonic_ns();
+            std::memcpy(rec, &now, sizeof(now));
+            ring.write(rec, sizeof(rec));
+        }
+    });
+    std::vector<double> us;
+    us.reserve(records);
+    uint8_t buf[16];
+    size_t have = 0;
+    while(us.size() < records){
+        have += ring.read(buf + have, sizeof(buf) - have);
+        if(have < sizeof(buf))
+            continue;
+        uint64_t sent;
+        std::memcpy(&sent, buf, sizeof(sent));
+        us.push_back((monotonic_ns() - sent) / 1000.0);
+        have = 0;
+    }
+    producer.join();
+    std::sort(us.begin(), us.end());
+    return {us[us.size() / 2], us[us.size() * 99 / 100], us.back()};
+}
+
+void row(const std::string& name, double copy, double zero, const Latency& l){
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(10) << copy;
+    if(zero > 0)
+        std::cout << std::setw(12) << zero;
+    else
+        std::cout << std::setw(12) << "-";
+    std::cout << std::setprecision(1) << std::setw(10) << l.p50_us << std::setw(10) << l.p99_us
+              << std::setw(10) << l.max_us << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    const size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 256;
+    const size_t total = megabytes * 1000 * 1000 / READ_CHUNK * READ_CHUNK;
+    const size_t records = 20000;
+    const bool multicore = std::thread::hardware_concurrency() > 1;
+
+    std::cout << megabytes << " MB in " << READ_CHUNK << " byte chunks, " << records
+              << " records for latency, " << std::thread::hardware_concurrency() << " cpus\n\n"
+              << std::left << std::setw(22) << "ring" << std::right << std::setw(10) << "MB/s"
+              << std::setw(12) << "0-copy MB/s" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us"
+              << std::setw(10) << "max us" << "\n";
+
+    {
+        auto copy = std::make_unique<LegacyRingBuffer>();
+        double mbs = copy_throughput(*copy, total);
+        auto lat = std::make_unique<LegacyRingBuffer>();
+        row("mutex/condvar (old)", mbs, 0, handoff_latency(*lat, records));
+    }
+
+    const std::pair<WaitStrategy, const char*> strategies[] = {
+        {WaitStrategy::Blocking, "spsc blocking"},
+        {WaitStrategy::SpinFutex, "spsc spin+futex"},
+        {WaitStrategy::Spin, "spsc spin"},
+    };
+    for(const auto &s : strategies){
+        // a spinning side only gives the core up when preempted
+        if(s.first == WaitStrategy::Spin && !multicore){
+            std::cout << std::left << std::setw(22) << s.second << "skipped, needs two cpus\n";
+            continue;
+        }
+        RingBuffer copy(s.first), zero(s.first), lat(s.first);
+        double mbs = copy_throughput(copy, total);
+        double zmbs = zero_copy_throughput(zero, total);
+        row(s.second, mbs, zmbs, handoff_latency(lat, records));
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+// SlcanParser against the per-byte state machine it replaced, fed a
+// recorded SLCAN stream in serial read sized chunks.
+//
+//   slcan_bench [capture] [passes]
+//
+// Without a capture a stream of classic 't' frames is generated (the only
+// kind the old parser knew; a capture with T/r/d records or Z stamps only
+// counts for the new one).
+
+#include "bench.hpp"
+#include "slcan.hpp"
+#include "ringbuffer.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// the parser as it was: a state per character, 't' frames only
+class LegacySlcanParser {
+    public:
+        explicit LegacySlcanParser(FrameHandler handler) : _handler(std::move(handler)) {}
+
+        void parse(const uint8_t* data, size_t len){
+            for(size_t i = 0; i < len; ++i){
+                uint8_t c = data[i];
+                switch(_state){
+                    case ParseState::WaitStart:
+                        if(c == 't'){
+                            _id = 0;
+                            _id_digits = 0;
+                            _state = ParseState::Id;
+                        }
+                        break;
+                    case ParseState::Id: {
+                        uint8_t v = hex_value(c);
+                        if(v < 16){
+                            _id = (_id << 4) | v;
+                            if(++_id_digits == 3)
+                                _state = ParseState::Len;
+                        }else{
+                            _state = ParseState::WaitStart;
+                        }
+                        break;
+                    }
+                    case ParseState::Len: {
+                        uint8_t v = hex_value(c);
+                        if(v < 16 && v <= 8){
+                            _dlen = v;
+                            _index = 0;
+                            _state = _dlen ? ParseState::DataHigh : ParseState::End;
+                        }else{
+                            _state = ParseState::WaitStart;
+                        }
+                        break;
+                    }
+                    case ParseState::DataHigh: {
+                        uint8_t v = hex_value(c);
+                        if(v < 16){
+                            _payload[_index] = v << 4;
+                            _state = ParseState::DataLow;
+                        }else{
+                            _state = ParseState::WaitStart;
+                        }
+                        break;
+                    }
+                    case ParseState::DataLow: {
+                        uint8_t v = hex_value(c);
+                        if(v < 16){
+                            _payload[_index] |= v;
+                            if(++_index == _dlen)
+                                _state = ParseState::End;
+                            else
+                                _state = ParseState::DataHigh;
+                        }else{
+                            _state = ParseState::WaitStart;
+                        }
+                        break;
+                    }
+                    case ParseState::End:
+                        if(c == '\r' && _handler)
+                            _handler(_id, _dlen, _payload, 0);
+                        _state = ParseState::WaitStart;
+                        break;
+                }
+            }
+        }
+
+    private:
+        enum class ParseState : uint8_t { WaitStart, Id, Len, DataHigh, DataLow, End };
+
+        static uint8_t hex_value(uint8_t c){
+            static const std::array<int8_t, 256> table = []{
+                std::array<int8_t, 256> t{};
+                t.fill(-1);
+                for(uint8_t i = 0; i < 10; ++i)
+                    t['0' + i] = i;
+                for(uint8_t i = 0; i < 6; ++i){
+                    t['A' + i] = 10 + i;
+                    t['a' + i] = 10 + i;
+                }
+                return t;
+            }();
+            return table[c];
+        }
+
+        FrameHandler _handler;
+        ParseState _state = ParseState::WaitStart;
+        uint32_t _id = 0;
+        uint8_t _id_digits = 0;
+        uint8_t _dlen = 0;
+        uint8_t _payload[8] = {};
+        uint8_t _index = 0;
+};
+
+// what an adapter sends for a busy bus: 't' frames of every length, mostly 8
+std::vector<uint8_t> generate_stream(size_t frames){
+    static const char hex[] = "0123456789ABCDEF";
+    std::mt19937 rng(42);
+    std::vector<uint8_t> out;
+    out.reserve(frames * 22);
+    for(size_t i = 0; i < frames; ++i){
+        const uint32_t id = rng() & CAN_ID_STD_MASK;
+        const uint32_t dlc = (rng() % 4) ? 8 : rng() % 9;
+        out.push_back('t');
+        out.push_back(hex[(id >> 8) & 0xF]);
+        out.push_back(hex[(id >> 4) & 0xF]);
+        out.push_back(hex[id & 0xF]);
+        out.push_back(hex[dlc]);
+        for(uint32_t b = 0; b < dlc * 2; ++b)
+            out.push_back(hex[rng() & 0xF]);
+        out.push_back('\r');
+    }
+    return out;
+}
+
+struct Result {
+    double mframes_s = 0;
+    double mb_s = 0;
+    uint64_t frames = 0;
+};
+
+void feed(LegacySlcanParser& parser, const uint8_t* data, size_t len){
+    parser.parse(data, len);
+}
+
+void feed(SlcanParser& parser, const uint8_t* data, size_t len){
+    parser.parse(data, len, 0);
+}
+
+// best of passes, each over the whole stream in READ_CHUNK slices
+template <typename Parser>
+Result run(const std::vector<uint8_t>& stream, int passes){
+    uint64_t frames = 0, sum = 0;
+    Parser parser([&](uint32_t id, uint8_t len, const uint8_t* payload, uint64_t){
+        ++frames;
+        sum += id + (len ? payload[len - 1] : 0);
+    });
+    Result best;
+    for(int p = 0; p < passes; ++p){
+        frames = 0;
+        const uint64_t start = monotonic_ns();
+        for(size_t off = 0; off < stream.size(); off += READ_CHUNK)
+            feed(parser, stream.data() + off, std::min(READ_CHUNK, stream.size() - off));
+        const double s = (monotonic_ns() - start) * 1e-9;
+        if(frames / s / 1e6 > best.mframes_s)
+            best = {frames / s / 1e6, stream.size() / s / 1e6, frames};
+    }
+    do_not_optimize(sum);
+    return best;
+}
+
+void row(const std::string& name, const Result& r){
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << r.mframes_s << std::setw(10) << r.mb_s << std::setw(12) << r.frames << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    std::vector<uint8_t> stream;
+    if(argc > 1){
+        std::ifstream in(argv[1], std::ios::binary);
+        if(!in){
+            std::cout << "[!] Unable to open " << argv[1] << std::endl;
+            return 1;
+        }
+        stream.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    } else {
+        stream = generate_stream(2000000);
+    }
+    const int passes = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    std::cout << stream.size() / 1000 << " kB of SLCAN in " << READ_CHUNK << " byte reads, best of "
+              << passes << "\n\n"
+              << std::left << std::setw(22) << "parser" << std::right << std::setw(12) << "Mframes/s"
+              << std::setw(10) << "MB/s" << std::setw(12) << "frames" << "\n";
+
+    const Result old = run<LegacySlcanParser>(stream, passes);
+    const Result now = run<SlcanParser>(stream, passes);
+    row("state machine (old)", old);
+    row("record/simd", now);
+    std::cout << "\n" << std::setprecision(2) << now.mframes_s / old.mframes_s << "x\n";
+    if(argc <= 1 && old.frames != now.frames){
+        std::cout << "[!] parsers disagree on the frame count" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+# Compile the builtin dbcs to decoder headers (see core/dbc_compiled.hpp)
+# with dbc_to_header, a host tool around the DbcParser of core/dbc.cpp.
+# Included by the top level and by the standalone test / bench builds.
+if(TARGET GenerateDbcHeaders)
+    return()
+endif()
+
+get_filename_component(PHOTON_ROOT ${CMAKE_CURRENT_LIST_DIR}/.. ABSOLUTE)
+
+add_executable(dbc_to_header ${PHOTON_ROOT}/cmake/dbc_to_header.cpp ${PHOTON_ROOT}/core/dbc.cpp)
+target_include_directories(dbc_to_header PRIVATE ${PHOTON_ROOT}/core)
+target_compile_features(dbc_to_header PRIVATE cxx_std_17)
+
+set(DBC_FILES
+    dbc/bps.dbc
+    dbc/controls.dbc
+    dbc/prohelion_wavesculptor22.dbc
+    #dbc/tpee_mppt[B].dbc
+    #dbc/tpee_mppt[A].dbc
+    dbc/mppt.dbc
+    dbc/daq.dbc
+)
+file(MAKE_DIRECTORY ${CMAKE_BINARY_DIR}/generated)
+set(GENERATED_DBC_HEADERS)
+foreach(DBC ${DBC_FILES})
+    get_filename_component(DNAME ${DBC} NAME)
+    string(REGEX REPLACE "[^A-Za-z0-9_]" "_" DVAR ${DNAME})
+    set(DHEADER ${CMAKE_BINARY_DIR}/generated/${DVAR}.hpp)
+    add_custom_command(
+        OUTPUT ${DHEADER}
+        COMMAND dbc_to_header ${PHOTON_ROOT}/${DBC} ${DHEADER}
+        DEPENDS ${PHOTON_ROOT}/${DBC} dbc_to_header
+        COMMENT "Compiling ${DBC} to ${DHEADER}")
+    list(APPEND GENERATED_DBC_HEADERS ${DHEADER})
+endforeach()
+add_custom_target(GenerateDbcHeaders ALL DEPENDS ${GENERATED_DBC_HEADERS})
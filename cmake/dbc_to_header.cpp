@@ -0,0 +1,432 @@
+// Compiles a DBC into a C++ header of message structs with constant-shift
+// decode/encode functions, an id switch and the message tables, see
+// core/dbc_compiled.hpp. Built for the host from core/dbc.cpp: DbcParser
+// reads the DBC, and each signal's bits are taken from the plan
+// DbcParser::compile() makes for it, so the generated code reads exactly
+// what the parser's decoder does. A malformed statement fails the build.
+//
+//   dbc_to_header <input.dbc> <output.hpp>
+
+#include "dbc.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// a run of bits of one payload byte, and where it lands in the raw value
+struct Piece {
+    unsigned byte;
+    unsigned low;       // lowest bit of the run in the byte
+    unsigned width;
+    unsigned raw;       // its position in the raw value
+};
+
+// Where the plan reads the signal from: every payload bit is set on its own
+// and read back as a plain unsigned integer. Runs of bits are grouped per
+// byte; false if the bits don't form such runs covering the value once.
+bool pieces(const DbcSignal& sig, std::vector<Piece>& out){
+    DbcSignalPlan plan = DbcParser::compile(sig);
+    plan.value_type = DbcValueType::Integer;
+    plan.sign_shift = 0;
+    plan.factor = 1.0;
+    plan.offset = 0.0;
+    out.clear();
+    uint8_t data[CAN_FD_MAX_LEN] = {};
+    uint64_t covered = 0;
+    unsigned bits = 0;
+    for(unsigned k = 0; k < CAN_FD_MAX_LEN; ++k){
+        for(unsigned j = 0; j < 8; ++j){
+            data[k] = static_cast<uint8_t>(1u << j);
+            int64_t integer = 0;
+            DbcParser::plan_value(plan, data, integer);
+            data[k] = 0;
+            const uint64_t raw = static_cast<uint64_t>(integer);
+            if(!raw)
+                continue;
+            if(raw & (raw - 1))
+                return false;
+            unsigned r = 0;
+            while(!((raw >> r) & 1))
+                ++r;
+            if(!out.empty() && out.back().byte == k && out.back().low + out.back().width == j
+               && out.back().raw + out.back().width == r){
+                ++out.back().width;
+            } else {
+                out.push_back({k, j, 1, r});
+            }
+            covered |= raw;
+            ++bits;
+        }
+    }
+    return bits == sig.size && covered == plan.mask;
+}
+
+const std::set<std::string> RESERVED = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch",
+    "char", "char16_t", "char32_t", "class", "compl", "const", "constexpr", "const_cast", "continue",
+    "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export",
+    "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable",
+    "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
+    "protected", "public", "register", "reinterpret_cast", "return", "short", "signed", "sizeof", "static",
+    "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true",
+    "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+    "wchar_t", "while", "xor", "xor_eq",
+    // members of the generated structs
+    "id", "dlc", "value_count", "decode", "encode", "decode_values",
+};
+
+std::string ident(const std::string& name){
+    std::string s;
+    for(const char c : name){
+        const bool alnum = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        s += alnum || c == '_' ? c : '_';
+    }
+    if(s.empty() || (s[0] >= '0' && s[0] <= '9'))
+        s = "_" + s;
+    return RESERVED.count(s) ? s + "_" : s;
+}
+
+std::string cstr(const std::string& s){
+    std::string out = "\"";
+    for(const char ch : s){
+        const unsigned char c = static_cast<unsigned char>(ch);
+        if(c == '\\'){
+            out += "\\\\";
+        } else if(c == '"'){
+            out += "\\\"";
+        } else if(c == '\n'){
+            out += "\\n";
+        } else if(c >= 32 && c < 127 && c != '?'){
+            out += ch;
+        } else {
+            char oct[8];
+            std::snprintf(oct, sizeof(oct), "\\%03o", c);
+            out += oct;
+        }
+    }
+    return out + "\"";
+}
+
+// shortest digits that read back to x, as a double literal: plain for
+// exponents from -4 to 15 (0.0005, 4294967295.0), else scientific
+std::string num(double x){
+    if(std::isnan(x))
+        return "NAN";
+    if(std::isinf(x))
+        return x < 0 ? "-HUGE_VAL" : "HUGE_VAL";
+    char buf[40];
+    const auto r = std::to_chars(buf, buf + sizeof(buf), x, std::chars_format::scientific);
+    const std::string s(buf, r.ptr);
+    const size_t e = s.find('e');
+    const int exp = std::stoi(s.substr(e + 1));
+    if(exp < -4 || exp >= 16)
+        return s;
+    std::string out = s[0] == '-' ? "-" : "";
+    std::string digits;
+    for(size_t i = out.size(); i < e; ++i)
+        if(s[i] != '.')
+            digits += s[i];
+    if(exp < 0)
+        return out + "0." + std::string(-exp - 1, '0') + digits;
+    if(digits.size() <= static_cast<size_t>(exp) + 1)
+        return out + digits + std::string(exp + 1 - digits.size(), '0') + ".0";
+    return out + digits.substr(0, exp + 1) + "." + digits.substr(exp + 1);
+}
+
+std::string hex(uint64_t v){
+    char buf[24];
+    std::snprintf(buf, sizeof(buf), "0x%llxu", static_cast<unsigned long long>(v));
+    return buf;
+}
+
+std::string boolean(bool b){
+    return b ? "true" : "false";
+}
+
+struct Signal {
+    const DbcSignal* sig;
+    DbcSignalPlan plan;
+    std::vector<Piece> pieces;
+    std::string member;
+};
+
+std::string raw_expr(const Signal& s){
+    std::string out;
+    for(const Piece &p : s.pieces){
+        std::string t = "static_cast<uint64_t>(d[" + std::to_string(p.byte) + "])";
+        if(p.low)
+            t = "(" + t + " >> " + std::to_string(p.low) + ")";
+        if(p.low + p.width < 8)
+            t = "(" + t + " & " + hex((1u << p.width) - 1) + ")";
+        if(p.raw)
+            t = "(" + t + " << " + std::to_string(p.raw) + ")";
+        out += (out.empty() ? "" : " | ") + t;
+    }
+    return out;
+}
+
+std::string value_expr(const Signal& s){
+    const std::string raw = raw_expr(s);
+    const std::string f = num(s.sig->factor), o = num(s.sig->offset);
+    if(s.plan.value_type == DbcValueType::Float)
+        return "dbc_float(" + raw + ") * " + f + " + " + o;
+    if(s.plan.value_type == DbcValueType::Double)
+        return "dbc_double(" + raw + ") * " + f + " + " + o;
+    if(s.sig->is_signed)
+        return "dbc_scale(dbc_sign_extend(" + raw + ", " + std::to_string(s.sig->size) + "), " + f + ", " + o + ")";
+    return "dbc_scale(static_cast<int64_t>(" + raw + "), " + f + ", " + o + ")";
+}
+
+std::vector<std::string> encode_lines(const Signal& s){
+    const std::string f = num(s.sig->factor), o = num(s.sig->offset);
+    const std::string raw_name = "raw_" + s.member;
+    std::string raw;
+    if(s.plan.value_type == DbcValueType::Float)
+        raw = "dbc_float_bits((" + s.member + " - " + o + ") / " + f + ")";
+    else if(s.plan.value_type == DbcValueType::Double)
+        raw = "dbc_double_bits((" + s.member + " - " + o + ") / " + f + ")";
+    else
+        raw = "dbc_unscale(" + s.member + ", " + f + ", " + o + ")";
+    std::vector<std::string> lines{"const uint64_t " + raw_name + " = " + raw + ";"};
+    for(const Piece &p : s.pieces){
+        const unsigned mask = ((1u << p.width) - 1) << p.low;
+        std::string part = raw_name;
+        if(p.raw)
+            part = "(" + part + " >> " + std::to_string(p.raw) + ")";
+        part = "(" + part + " & " + hex((1u << p.width) - 1) + ")";
+        if(p.low)
+            part = "(" + part + " << " + std::to_string(p.low) + ")";
+        const std::string d = "d[" + std::to_string(p.byte) + "]";
+        if(mask == 0xff){
+            lines.push_back(d + " = static_cast<uint8_t>(" + part + ");");
+        } else {
+            char keep[8];
+            std::snprintf(keep, sizeof(keep), "0x%02xu", 0xffu & ~mask);
+            lines.push_back(d + " = static_cast<uint8_t>((" + d + " & " + keep + ") | " + part + ");");
+        }
+    }
+    return lines;
+}
+
+bool generate(const DbcParser& dbc, const std::string& input, const std::string& var, std::ostream& o){
+    std::vector<const DbcMessage*> messages;
+    for(const auto &mp : dbc.messages())
+        messages.push_back(&mp.second);
+    std::sort(messages.begin(), messages.end(),
+              [](const DbcMessage* a, const DbcMessage* b){ return a->id < b->id; });
+
+    o << "#pragma once\n"
+      << "// generated from " << input << " by cmake/dbc_to_header.cpp, do not edit\n"
+      << "#include <cmath>\n"
+      << "#include <cstddef>\n"
+      << "#include <cstdint>\n"
+      << "#include \"dbc_compiled.hpp\"\n"
+      << "\n"
+      << "namespace " << var << " {\n"
+      << "\n";
+
+    std::set<std::string> used;
+    std::vector<std::string> struct_names;
+    for(const DbcMessage* m : messages){
+        std::string sname = ident(m->name) + "_t";
+        while(used.count(sname))
+            sname += "_";
+        used.insert(sname);
+        struct_names.push_back(sname);
+
+        std::vector<Signal> sigs;
+        std::set<std::string> taken;
+        bool floating = false;
+        for(const auto &sig : m->signals){
+            Signal s{&sig, DbcParser::compile(sig), {}, {}};
+            if(!s.plan.fits)
+                continue;
+            if(!pieces(sig, s.pieces)){
+                std::cout << "[!] " << m->name << "." << sig.name << ": bits don't map onto a payload" << std::endl;
+                return false;
+            }
+            s.member = ident(sig.name);
+            while(taken.count(s.member))
+                s.member += "_";
+            taken.insert(s.member);
+            floating |= s.plan.value_type != DbcValueType::Integer;
+            sigs.push_back(std::move(s));
+        }
+        // float bits are read with memcpy, which isn't constexpr before C++20
+        const std::string spec = floating ? "inline" : "constexpr";
+
+        o << "// BO_ " << m->id << " " << m->name << ": " << unsigned(m->dlc) << "\n"
+          << "struct " << sname << " {\n"
+          << "    static constexpr uint32_t id = " << hex(m->id) << ";\n"
+          << "    static constexpr uint8_t dlc = " << unsigned(m->dlc) << ";\n"
+          << "    static constexpr size_t value_count = " << sigs.size() << ";\n";
+        for(const auto &s : sigs)
+            o << "    double " << s.member << " = 0.0;\n";
+        o << "\n"
+          << "    static " << spec << " " << sname << " decode(const uint8_t* d){\n"
+          << "        " << sname << " m{};\n";
+        for(const auto &s : sigs)
+            o << "        m." << s.member << " = " << value_expr(s) << ";\n";
+        if(sigs.empty())
+            o << "        (void)d;\n";
+        o << "        return m;\n"
+          << "    }\n"
+          << "    // signals not set here keep the bits already in d\n"
+          << "    " << spec << " void encode(uint8_t* d) const {\n";
+        for(const auto &s : sigs)
+            for(const auto &line : encode_lines(s))
+                o << "        " << line << "\n";
+        if(sigs.empty())
+            o << "        (void)d;\n";
+        o << "    }\n"
+          << "    static " << spec << " void decode_values(const uint8_t* d, double* out){\n";
+        if(sigs.empty()){
+            o << "        (void)d; (void)out;\n";
+        } else {
+            o << "        const " << sname << " m = decode(d);\n";
+            for(size_t i = 0; i < sigs.size(); ++i)
+                o << "        out[" << i << "] = m." << sigs[i].member << ";\n";
+        }
+        o << "    }\n"
+          << "};\n"
+          << "\n";
+    }
+
+    o << "// values of message id, DbcParser::decode_values() order\n"
+      << "inline bool decode(uint32_t id, const uint8_t* data, double* out){\n"
+      << "    switch(id){\n";
+    for(const auto &sname : struct_names)
+        o << "    case " << sname << "::id: " << sname << "::decode_values(data, out); return true;\n";
+    o << "    default: return false;\n"
+      << "    }\n"
+      << "}\n"
+      << "\n";
+
+    // tables, with maps in key order so the output only changes with the DBC
+    o << "namespace tables {\n";
+    auto strings = [&o](const std::string& name, const std::vector<std::string>& items){
+        if(items.empty())
+            return std::string("nullptr, 0");
+        o << "constexpr const char* " << name << "[] = {";
+        for(size_t i = 0; i < items.size(); ++i)
+            o << (i ? ", " : "") << cstr(items[i]);
+        o << "};\n";
+        return name + ", " + std::to_string(items.size());
+    };
+    auto attributes = [&o](const std::string& name, const DbcAttributes& attrs){
+        if(attrs.empty())
+            return std::string("nullptr, 0");
+        const std::map<std::string, std::string> sorted(attrs.begin(), attrs.end());
+        o << "constexpr DbcCompiledAttribute " << name << "[] = {\n";
+        for(const auto &a : sorted)
+            o << "    {" << cstr(a.first) << ", " << cstr(a.second) << "},\n";
+        o << "};\n";
+        return name + ", " + std::to_string(attrs.size());
+    };
+    static const char* const VALUE_TYPES[] = {"Integer", "Float", "Double"};
+    std::vector<std::string> entries;
+    for(size_t mi = 0; mi < messages.size(); ++mi){
+        const DbcMessage &m = *messages[mi];
+        std::vector<std::string> sig_entries;
+        for(size_t si = 0; si < m.signals.size(); ++si){
+            const DbcSignal &s = m.signals[si];
+            const std::string p = "m" + std::to_string(mi) + "_s" + std::to_string(si);
+            const std::string rx = strings(p + "_receivers", s.receivers);
+            const std::string at = attributes(p + "_attributes", s.attributes);
+            std::string vals = "nullptr, 0";
+            if(!s.value_map.empty()){
+                const std::map<int64_t, std::string> sorted(s.value_map.begin(), s.value_map.end());
+                o << "constexpr DbcCompiledValue " << p << "_values[] = {\n";
+                for(const auto &v : sorted)
+                    o << "    {" << v.first << ", " << cstr(v.second) << "},\n";
+                o << "};\n";
+                vals = p + "_values, " + std::to_string(sorted.size());
+            }
+            std::ostringstream e;
+            e << "    {" << cstr(s.name) << ", " << s.start_bit << ", " << unsigned(s.size) << ", "
+              << boolean(s.little_endian) << ", " << boolean(s.is_signed) << ", DbcValueType::"
+              << VALUE_TYPES[static_cast<unsigned>(s.value_type)] << ", " << num(s.factor) << ", "
+              << num(s.offset) << ", " << num(s.minimum) << ", " << num(s.maximum) << ", " << cstr(s.unit)
+              << ", " << cstr(s.comment) << ", " << boolean(s.multiplexor) << ", " << s.mux_value << ", "
+              << rx << ", " << at << ", " << vals << "},";
+            sig_entries.push_back(e.str());
+        }
+        std::string sigs = "nullptr, 0";
+        if(!sig_entries.empty()){
+            o << "constexpr DbcCompiledSignal m" << mi << "_signals[] = {\n";
+            for(const auto &e : sig_entries)
+                o << e << "\n";
+            o << "};\n";
+            sigs = "m" + std::to_string(mi) + "_signals, " + std::to_string(sig_entries.size());
+        }
+        const std::string tx = strings("m" + std::to_string(mi) + "_transmitters", m.extra_transmitters);
+        const std::string at = attributes("m" + std::to_string(mi) + "_attributes", m.attributes);
+        entries.push_back("    {" + hex(m.id) + ", " + cstr(m.name) + ", " + std::to_string(m.dlc) + ", "
+                          + std::to_string(m.cycle_time_ms) + ", " + cstr(m.transmitter) + ", " + tx + ", "
+                          + cstr(m.comment) + ", " + at + ", " + sigs + "},");
+    }
+    if(!entries.empty()){
+        o << "constexpr DbcCompiledMessage messages[] = {\n";
+        for(const auto &e : entries)
+            o << e << "\n";
+        o << "};\n";
+    }
+    o << "} // namespace tables\n"
+      << "\n"
+      << "} // namespace " << var << "\n"
+      << "\n";
+    if(entries.empty())
+        o << "constexpr DbcCompiledDbc " << var << "_compiled = {nullptr, 0, &" << var << "::decode};\n";
+    else
+        o << "constexpr DbcCompiledDbc " << var << "_compiled = {" << var << "::tables::messages, "
+          << entries.size() << ", &" << var << "::decode};\n";
+    return true;
+}
+
+std::string basename(const std::string& path){
+    const size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    if(argc != 3){
+        std::cout << "Usage: " << argv[0] << " <input.dbc> <output.hpp>" << std::endl;
+        return 1;
+    }
+    const std::string input = argv[1], output = argv[2];
+
+    DbcParser dbc;
+    if(!dbc.load(input))
+        return 1;
+    if(dbc.errors()){
+        std::cout << "[!] " << input << ": " << dbc.errors() << " malformed statements" << std::endl;
+        return 1;
+    }
+
+    // bps_dbc.hpp declares bps_dbc_compiled
+    std::string var = basename(output);
+    var = var.substr(0, var.find_last_of('.'));
+    std::replace(var.begin(), var.end(), '.', '_');
+
+    std::ostringstream text;
+    if(!generate(dbc, basename(input), var, text))
+        return 1;
+    std::ofstream out(output, std::ios::binary);
+    out << text.str();
+    if(!out.flush()){
+        std::cout << "[!] Unable to write " << output << std::endl;
+        return 1;
+    }
+    return 0;
+}
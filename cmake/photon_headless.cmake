@@ -0,0 +1,22 @@
+# core/ without the GUI (main.cpp, the ImPlot drawing in signal_routing.cpp)
+# as a static library, for the tests and benchmarks. Needs neither Vulkan
+# nor a window system, so tests/ and bench/ also configure on their own:
+# cmake -S tests -B build-tests && cmake --build build-tests && ctest --test-dir build-tests
+if(TARGET photon_headless)
+    return()
+endif()
+get_filename_component(PHOTON_ROOT ${CMAKE_CURRENT_LIST_DIR}/.. ABSOLUTE)
+
+include(${CMAKE_CURRENT_LIST_DIR}/dbc_headers.cmake)
+find_package(Threads REQUIRED)
+
+file(GLOB PHOTON_HEADLESS_SOURCES ${PHOTON_ROOT}/core/*.cpp)
+list(REMOVE_ITEM PHOTON_HEADLESS_SOURCES ${PHOTON_ROOT}/core/main.cpp ${PHOTON_ROOT}/core/signal_routing.cpp)
+
+add_library(photon_headless STATIC ${PHOTON_HEADLESS_SOURCES})
+target_include_directories(photon_headless PUBLIC ${PHOTON_ROOT}/core ${CMAKE_BINARY_DIR}/generated)
+target_link_libraries(photon_headless PUBLIC Threads::Threads)
+if(WIN32)
+    target_link_libraries(photon_headless PUBLIC Ws2_32)
+endif()
+add_dependencies(photon_headless GenerateDbcHeaders)
@@ -0,0 +1,437 @@
+#include "arrow_export.hpp"
+#include "framelog.hpp"
+#include "canlog_writer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+static constexpr uint64_t CHUNK_FRAMES = 1u << 20;
+static constexpr size_t BODY_ALIGN = 64;
+
+namespace {
+
+// -- flatbuffers --
+
+// Minimal flatbuffers builder: the buffer grows back to front like the
+// reference implementation, so children are finished before the tables
+// that point at them. Bytes are kept reversed and flipped in finish().
+// Assumes a little endian host, as flatbuffers and Arrow files are.
+class FlatBuilder {
+    public:
+        uint32_t size() const { return static_cast<uint32_t>(_buf.size()); }
+
+        // pads so that after `additional` more bytes the size is a multiple of align
+        void prep(size_t align, size_t additional){
+            _minalign = std::max(_minalign, align);
+            const size_t pad = (align - ((_buf.size() + additional) & (align - 1))) & (align - 1);
+            _buf.insert(_buf.end(), pad, 0);
+        }
+
+        template<typename T> void push(T v){
+            uint8_t b[sizeof(T)];
+            std::memcpy(b, &v, sizeof(T));
+            for(size_t i = sizeof(T); i-- > 0;)
+                _buf.push_back(b[i]);
+        }
+        void pad(size_t n){ _buf.insert(_buf.end(), n, 0); }
+
+        // -- tables --
+        void start_table(){
+            _fields.clear();
+            _table_start = size();
+        }
+        template<typename T> void field(int slot, T v){
+            prep(sizeof(T), 0);
+            push(v);
+            _fields.emplace_back(slot, size());
+        }
+        void field_offset(int slot, uint32_t target){
+            prep(4, 0);
+            push<uint32_t>(size() + 4 - target);
+            _fields.emplace_back(slot, size());
+        }
+        uint32_t end_table(){
+            prep(4, 0);
+            push<int32_t>(0); // soffset to the vtable, patched below
+            const uint32_t object = size();
+            int slots = 0;
+            for(const auto &f : _fields)
+                slots = std::max(slots, f.first + 1);
+            std::vector<uint16_t> vt(static_cast<size_t>(slots), 0);
+            for(const auto &f : _fields)
+                vt[static_cast<size_t>(f.first)] = static_cast<uint16_t>(object - f.second);
+            for(size_t i = vt.size(); i-- > 0;)
+                push<uint16_t>(vt[i]);
+            push<uint16_t>(static_cast<uint16_t>(object - _table_start));
+            push<uint16_t>(static_cast<uint16_t>((vt.size() + 2) * 2));
+            const int32_t soffset = static_cast<int32_t>(size() - object);
+            uint8_t b[4];
+            std::memcpy(b, &soffset, 4);
+            for(size_t k = 0; k < 4; ++k)
+                _buf[object - 1 - k] = b[k];
+            return object;
+        }
+
+        // -- vectors --
+        void start_vector(size_t count, size_t elem, size_t align){
+            prep(4, count * elem);
+            prep(align, count * elem);
+        }
+        uint32_t end_vector(size_t count){
+            push<uint32_t>(static_cast<uint32_t>(count));
+            return size();
+        }
+        uint32_t offsets(const std::vector<uint32_t>& targets){
+            start_vector(targets.size(), 4, 4);
+            for(size_t i = targets.size(); i-- > 0;)
+                push<uint32_t>(size() + 4 - targets[i]);
+            return end_vector(targets.size());
+        }
+        uint32_t string(const std::string& s){
+            prep(4, s.size() + 1);
+            push<uint8_t>(0);
+            for(size_t i = s.size(); i-- > 0;)
+                push<uint8_t>(static_cast<uint8_t>(s[i]));
+            return end_vector(s.size());
+        }
+
+        std::vector<uint8_t> finish(uint32_t root){
+            prep(_minalign, 4);
+            push<uint32_t>(size() + 4 - root);
+            std::vector<uint8_t> out(_buf.rbegin(), _buf.rend());
+            return out;
+        }
+
+    private:
+        std::vector<uint8_t> _buf;
+        size_t _minalign = 1;
+        uint32_t _table_start = 0;
+        std::vector<std::pair<int, uint32_t>> _fields; // slot, position
+};
+
+// Schema.fbs / Message.fbs / File.fbs ids
+enum : uint8_t  { TYPE_INT = 2, TYPE_FLOATING_POINT = 3 };
+enum : uint8_t  { HEADER_SCHEMA = 1, HEADER_RECORD_BATCH = 3 };
+enum : int16_t  { METADATA_V5 = 4, PRECISION_DOUBLE = 2 };
+
+// timestamp_ns int64, then float64 columns
+uint32_t build_schema(FlatBuilder& fb, const std::vector<std::string>& columns){
+    std::vector<uint32_t> fields;
+    for(size_t i = 0; i < columns.size(); ++i){
+        const uint32_t name = fb.string(columns[i]);
+        fb.start_table();
+        if(i == 0){
+            fb.field<int32_t>(0, 64);       // Int.bitWidth
+            fb.field<uint8_t>(1, 1);        // Int.is_signed
+        } else {
+            fb.field<int16_t>(0, PRECISION_DOUBLE);
+        }
+        const uint32_t type = fb.end_table();
+        fb.start_vector(0, 4, 4);
+        const uint32_t children = fb.end_vector(0);
+
+        fb.start_table();
+        fb.field_offset(0, name);
+        fb.field<uint8_t>(1, 0);            // nullable
+        fb.field<uint8_t>(2, i == 0 ? TYPE_INT : TYPE_FLOATING_POINT);
+        fb.field_offset(3, type);
+        fb.field_offset(5, children);
+        fields.push_back(fb.end_table());
+    }
+    const uint32_t vec = fb.offsets(fields);
+    fb.start_table();
+    fb.field<int16_t>(0, 0);                // little endian
+    fb.field_offset(1, vec);
+    return fb.end_table();
+}
+
+std::vector<uint8_t> message(uint8_t header_type, uint32_t header, FlatBuilder& fb, int64_t body_len){
+    fb.start_table();
+    fb.field<int16_t>(0, METADATA_V5);
+    fb.field<uint8_t>(1, header_type);
+    fb.field_offset(2, header);
+    fb.field<int64_t>(3, body_len);
+    return fb.finish(fb.end_table());
+}
+
+struct Block {
+    int64_t offset;
+    int32_t meta_len;
+    int64_t body_len;
+};
+
+// one .arrow file, columns fixed at construction
+class ArrowFileWriter {
+    public:
+        ArrowFileWriter(const std::string& path, std::vector<std::string> columns)
+            : _out(path, std::ios::binary | std::ios::trunc), _columns(std::move(columns)) {
+            if(!_out)
+                throw std::runtime_error("cannot create " + path);
+            write("ARROW1\0\0", 8);
+            FlatBuilder fb;
+            const uint32_t schema = build_schema(fb, _columns);
+            write_message(message(HEADER_SCHEMA, schema, fb, 0), nullptr, 0);
+        }
+
+        // rows of timestamps and one value column per signal
+        void batch(const std::vector<int64_t>& t, const std::vector<std::vector<double>>& values){
+            const int64_t rows = static_cast<int64_t>(t.size());
+            if(!rows)
+                return;
+            // body: per column an empty validity bitmap and the values
+            std::vector<std::pair<int64_t, int64_t>> buffers;
+            int64_t body = 0;
+            auto place = [&](int64_t len){
+                buffers.emplace_back(body, len);
+                body += (len + BODY_ALIGN - 1) & ~static_cast<int64_t>(BODY_ALIGN - 1);
+            };
+            place(0);
+            place(rows * 8);
+            for(size_t c = 0; c < values.size(); ++c){
+                place(0);
+                place(rows * 8);
+            }
+
+            FlatBuilder fb;
+            fb.start_vector(buffers.size(), 16, 8);
+            for(size_t i = buffers.size(); i-- > 0;){
+                fb.push<int64_t>(buffers[i].second);
+                fb.push<int64_t>(buffers[i].first);
+            }
+            const uint32_t buffer_vec = fb.end_vector(buffers.size());
+            const size_t columns = values.size() + 1;
+            fb.start_vector(columns, 16, 8);
+            for(size_t i = 0; i < columns; ++i){
+                fb.push<int64_t>(0);        // null_count
+                fb.push<int64_t>(rows);     // length
+            }
+            const uint32_t node_vec = fb.end_vector(columns);
+            fb.start_table();
+            fb.field<int64_t>(0, rows);
+            fb.field_offset(1, node_vec);
+            fb.field_offset(2, buffer_vec);
+            const uint32_t rb = fb.end_table();
+
+            std::vector<uint8_t> body_bytes(static_cast<size_t>(body), 0);
+            std::memcpy(body_bytes.data() + buffers[1].first, t.data(), static_cast<size_t>(rows) * 8);
+            for(size_t c = 0; c < values.size(); ++c)
+                std::memcpy(body_bytes.data() + buffers[3 + 2 * c].first, values[c].data(), static_cast<size_t>(rows) * 8);
+
+            _blocks.push_back(write_message(message(HEADER_RECORD_BATCH, rb, fb, body),
+                                            body_bytes.data(), body_bytes.size()));
+        }
+
+        // end of stream, footer, trailing magic
+        uint64_t finish(){
+            write_u32(0xFFFFFFFFu);
+            write_u32(0);
+
+            FlatBuilder fb;
+            fb.start_vector(_blocks.size(), 24, 8);
+            for(size_t i = _blocks.size(); i-- > 0;){
+                fb.push<int64_t>(_blocks[i].body_len);
+                fb.pad(4);
+                fb.push<int32_t>(_blocks[i].meta_len);
+                fb.push<int64_t>(_blocks[i].offset);
+            }
+            const uint32_t batches = fb.end_vector(_blocks.size());
+            fb.start_vector(0, 24, 8);
+            const uint32_t dictionaries = fb.end_vector(0);
+            const uint32_t schema = build_schema(fb, _columns);
+            fb.start_table();
+            fb.field<int16_t>(0, METADATA_V5);
+            fb.field_offset(1, schema);
+            fb.field_offset(2, dictionaries);
+            fb.field_offset(3, batches);
+            const std::vector<uint8_t> footer = fb.finish(fb.end_table());
+
+            write(footer.data(), footer.size());
+            write_u32(static_cast<uint32_t>(footer.size()));
+            write("ARROW1", 6);
+            _out.flush();
+            if(!_out)
+                throw std::runtime_error("write failed");
+            return _offset;
+        }
+
+    private:
+        void write(const void* data, size_t len){
+            _out.write(static_cast<const char*>(data), static_cast<std::streamsize>(len));
+            _offset += len;
+        }
+        void write_u32(uint32_t v){ write(&v, 4); }
+
+        // continuation marker, metadata length, metadata padded to 8, body
+        Block write_message(const std::vector<uint8_t>& meta, const uint8_t* body, size_t body_len){
+            Block b;
+            b.offset = static_cast<int64_t>(_offset);
+            const size_t padded = (meta.size() + 8 + 7) / 8 * 8 - 8;
+            write_u32(0xFFFFFFFFu);
+            write_u32(static_cast<uint32_t>(padded));
+            write(meta.data(), meta.size());
+            static const uint8_t zeros[8] = {};
+            write(zeros, padded - meta.size());
+            b.meta_len = static_cast<int32_t>(padded + 8);
+            if(body_len)
+                write(body, body_len);
+            b.body_len = static_cast<int64_t>(body_len);
+            return b;
+        }
+
+        std::ofstream _out;
+        std::vector<std::string> _columns;
+        uint64_t _offset = 0;
+        std::vector<Block> _blocks;
+};
+
+// -- decoding --
+
+struct Columns {
+    std::vector<int64_t> t;
+    std::vector<std::vector<double>> values; // per signal
+};
+
+struct Chunk {
+    FrameLog::Cursor begin, end;
+    std::vector<Columns> messages;
+    uint64_t frames = 0;
+};
+
+struct Plan {
+    std::vector<const DbcMessage*> messages;
+    std::vector<std::vector<DbcSignalPlan>> signals;   // compiled, per message
+    std::unordered_map<uint32_t, size_t> by_id;
+};
+
+void decode_chunk(const FrameLog& log, const Plan& plan, Chunk& chunk){
+    chunk.messages.assign(plan.messages.size(), Columns{});
+    for(size_t m = 0; m < plan.messages.size(); ++m)
+        chunk.messages[m].values.resize(plan.messages[m]->signals.size());
+
+    uint8_t data[CAN_FD_MAX_LEN];
+    CanLogRecord rec;
+    const uint8_t* payload;
+    for(FrameLog::Cursor c = chunk.begin; c < chunk.end && log.next(c, rec, payload);){
+        ++chunk.frames;
+        auto it = plan.by_id.find(rec.id);
+        if(it == plan.by_id.end())
+            continue;
+        // signals may reach past a short frame, read zeros there like the store does
+        std::memset(data, 0, sizeof(data));
+        std::memcpy(data, payload, std::min<size_t>(rec.len, sizeof(data)));
+        const std::vector<DbcSignalPlan> &signals = plan.signals[it->second];
+        Columns &cols = chunk.messages[it->second];
+        cols.t.push_back(static_cast<int64_t>(rec.timestamp_ns));
+        for(size_t s = 0; s < signals.size(); ++s){
+            int64_t raw;
+            cols.values[s].push_back(signals[s].fits ? DbcParser::plan_value(signals[s], data, raw)
+                                                     : std::numeric_limits<double>::quiet_NaN());
+        }
+    }
+}
+
+std::string file_name(const std::string& name){
+    std::string out = name;
+    for(char &ch : out)
+        if(ch == '/' || ch == '\\' || ch == ':' || ch == '*' || ch == '?' || ch == '"' || ch == '<' || ch == '>' || ch == '|')
+            ch = '_';
+    return out;
+}
+
+} // namespace
+
+ArrowExportStats export_arrow(const std::string& session_dir,
+                              const DbcMessageList& messages,
+                              const std::string& out_dir, unsigned threads,
+                              const std::function<bool()>& keep_going){
+    const auto started = std::chrono::steady_clock::now();
+    std::unique_ptr<FrameLog> opened = open_frame_log(session_dir);
+    const FrameLog &log = *opened;
+    canlog_make_dirs(out_dir);
+    if(!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    Plan plan;
+    for(const auto &mp : messages)
+        if(!mp.second->signals.empty())
+            plan.messages.push_back(mp.second);
+    std::sort(plan.messages.begin(), plan.messages.end(),
+              [](const DbcMessage* a, const DbcMessage* b){ return a->name < b->name || (a->name == b->name && a->id < b->id); });
+    plan.signals.resize(plan.messages.size());
+    for(size_t i = 0; i < plan.messages.size(); ++i){
+        plan.by_id[plan.messages[i]->id] = i;
+        for(const auto &sig : plan.messages[i]->signals)
+            plan.signals[i].push_back(DbcParser::compile(sig));
+    }
+
+    // chunk boundaries evenly spread over the session's time span
+    const uint64_t first = log.first_ns(), last = log.last_ns();
+    const uint64_t n = std::max<uint64_t>(threads, (log.records() + CHUNK_FRAMES - 1) / CHUNK_FRAMES);
+    std::vector<FrameLog::Cursor> cuts{log.begin()};
+    for(uint64_t i = 1; i < n && last > first; ++i)
+        cuts.push_back(log.seek(first + (last - first) / n * i));
+    cuts.push_back(log.end());
+    std::sort(cuts.begin(), cuts.end());
+    cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+    std::vector<std::unique_ptr<ArrowFileWriter>> files(plan.messages.size());
+    std::vector<std::string> used_names;
+    ArrowExportStats stats;
+
+    for(size_t wave = 0; wave + 1 < cuts.size(); wave += threads){
+        if(keep_going && !keep_going())
+            throw std::runtime_error("export cancelled");
+        std::vector<Chunk> chunks;
+        for(size_t i = wave; i < std::min<size_t>(wave + threads, cuts.size() - 1); ++i){
+            Chunk c;
+            c.begin = cuts[i];
+            c.end = cuts[i + 1];
+            chunks.push_back(std::move(c));
+        }
+        std::vector<std::thread> workers;
+        for(size_t i = 1; i < chunks.size(); ++i)
+            workers.emplace_back(decode_chunk, std::cref(log), std::cref(plan), std::ref(chunks[i]));
+        decode_chunk(log, plan, chunks[0]);
+        for(auto &w : workers)
+            w.join();
+
+        for(const auto &c : chunks){
+            stats.frames += c.frames;
+            for(size_t m = 0; m < plan.messages.size(); ++m){
+                const Columns &cols = c.messages[m];
+                if(cols.t.empty())
+                    continue;
+                if(!files[m]){
+                    const DbcMessage &msg = *plan.messages[m];
+                    std::string name = file_name(msg.name);
+                    if(std::find(used_names.begin(), used_names.end(), name) != used_names.end()){
+                        char id[16];
+                        std::snprintf(id, sizeof(id), "_%X", msg.id & CAN_ID_EXT_MASK);
+                        name += id;
+                    }
+                    used_names.push_back(name);
+                    std::vector<std::string> columns{"timestamp_ns"};
+                    for(const auto &sig : msg.signals)
+                        columns.push_back(sig.name);
+                    files[m].reset(new ArrowFileWriter(out_dir + "/" + name + ".arrow", std::move(columns)));
+                    ++stats.files;
+                }
+                files[m]->batch(cols.t, cols.values);
+                stats.rows += cols.t.size();
+            }
+        }
+    }
+
+    for(auto &f : files)
+        if(f)
+            stats.bytes += f->finish();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return stats;
+}
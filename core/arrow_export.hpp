@@ -0,0 +1,37 @@
+#pragma once
+
+#include "dbc.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+// Decoded signals of a session (or an .mf4 file, framelog.hpp), written for
+// pandas / polars as Arrow IPC files (Feather v2), one file per DBC message
+// in out_dir: <message>.arrow with a timestamp_ns int64 column (log time, as
+// the FrameLog gives it) and one float64 column per signal. A file per message keeps every column
+// dense; a single table over all messages would be mostly nulls.
+//
+// The session is cut into time chunks that are decoded in parallel, a wave
+// of one chunk per thread at a time, and every chunk becomes one record
+// batch per message, written in log order. Buffers are uncompressed and
+// 64-byte aligned, so pyarrow.memory_map / polars can map the columns
+// without copying. The IPC framing and its flatbuffers metadata are written
+// by hand, there is no Arrow dependency.
+
+struct ArrowExportStats {
+    uint64_t frames = 0;    // read from the session
+    uint64_t rows = 0;      // decoded into some file
+    size_t files = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+};
+
+// threads 0: one per core. keep_going is asked between waves of chunks, the
+// export stops with an exception once it says no. Throws std::runtime_error
+// / std::system_error.
+ArrowExportStats export_arrow(const std::string& session_dir,
+                              const DbcMessageList& messages,
+                              const std::string& out_dir, unsigned threads = 0,
+                              const std::function<bool()>& keep_going = {});
@@ -1,11 +1,17 @@
-#include "serial.hpp"
-#include "tcp.hpp"
-#include "ringbuffer.hpp"
+#include "reactor.hpp"
+#include "sources.hpp"
+#include "socketcan.hpp"
 #include "candb.hpp"
 #include "dbc.hpp"
+#include "dbc_compiled.hpp"
+#include "dbc_catalog.hpp"
 #include "config.hpp"
 #include "backend.hpp"
+#include "replay.hpp"
+#include "logimport.hpp"
+#include "arrow_export.hpp"
 #include <algorithm>
+#include <cctype>
 #include <cstdint>
 #include <iomanip>
 #include <ios>
@@ -15,9 +21,23 @@
 #include <array>
 #include <memory>
 #include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
 #include <utility>
 #include <string>
-
+#include <system_error>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+// builtin DBCs, compiled to decoders at build time (cmake/dbc_to_header.cpp)
 #include "bps_dbc.hpp"
 #include "controls_dbc.hpp"
 #include "prohelion_wavesculptor22_dbc.hpp"
@@ -27,89 +47,145 @@
 #include "daq_dbc.hpp"
 
 static CanStore can_store;
-static DbcParser dbc;
 
-static std::mutex dbc_mtx;
+// only ever accessed through std::atomic_load / std::atomic_store
+static DbcSnapshotPtr dbc_snapshot = std::make_shared<const DbcSnapshot>();
 struct BuiltinDbc {
     const char* name;
-    const unsigned char* data;
-    size_t size;
+    const DbcCompiledDbc* compiled;
     bool enabled;
 };
 
 static BuiltinDbc builtin_dbcs[] = {
-    {"BPS", bps_dbc, bps_dbc_size, true},
-    {"Wavesculptor22", prohelion_wavesculptor22_dbc, prohelion_wavesculptor22_dbc_size, true},
-    //{"MPPT A", tpee_mppt_A__dbc, tpee_mppt_A__dbc_size, true},
-    //{"MPPT B", tpee_mppt_B__dbc, tpee_mppt_B__dbc_size, true},
-    {"MPPT", mppt_dbc, mppt_dbc_size, true},
-    {"Controls", controls_dbc, controls_dbc_size, true},
-    {"DAQ", daq_dbc, daq_dbc_size, true}
+    {"BPS", &bps_dbc_compiled, true},
+    {"Wavesculptor22", &prohelion_wavesculptor22_dbc_compiled, true},
+    //{"MPPT A", &tpee_mppt_A__dbc_compiled, true},
+    //{"MPPT B", &tpee_mppt_B__dbc_compiled, true},
+    {"MPPT", &mppt_dbc_compiled, true},
+    {"Controls", &controls_dbc_compiled, true},
+    {"DAQ", &daq_dbc_compiled, true}
 
 };
 static std::mutex builtin_mtx;
 
 struct DbcOp{
-    enum Type { Load, Unload } type;
+    // Reload: a watched file changed. Watch / Unwatch: hot reload on, off
+    enum Type { Load, Unload, Reload, Watch, Unwatch } type;
     std::string name;
     bool builtin = false;
 };
 
+// control plane: the gui queues requests here and the backend thread sleeps
+// on control_cv until there is something to do
+static std::mutex control_mtx;
+static std::condition_variable control_cv;
 static std::vector<DbcOp> dbc_requests;
-static std::mutex dbc_request_mtx;
+static std::atomic<bool> shutdown_requested(false);
+
 static std::vector<std::string> loaded_dbcs;
 static std::mutex loaded_dbcs_mtx;
-std::atomic<bool> new_dbc_flag(false);
 
+// every DBC ever loaded, parsed once; only the backend thread touches it
+static DbcFragmentCache dbc_cache;
+
+static DbcFileWatcher dbc_watcher([]{
+    {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        dbc_requests.push_back({DbcOp::Reload, {}});
+    }
+    control_cv.notify_one();
+});
+
+// enough history per id to ride out a stalled GUI frame or two
+static constexpr unsigned HISTORY_WINDOW_MS = 500;
+
+// history depth from the cycle time, DLC checks from the message size
+static void apply_dbc_limits(const DbcCatalog &catalog){
+    for(std::size_t i = 0; i < can_store.size(); ++i)
+        can_store.set_expected_len(can_store.id_at(i), 0);
+    for(const auto &mp : catalog.messages()){
+        unsigned cycle = mp.second->cycle_time_ms;
+        if(cycle)
+            can_store.set_history_capacity(mp.first, (HISTORY_WINDOW_MS + cycle - 1) / cycle);
+        can_store.set_expected_len(mp.first, mp.second->dlc);
+    }
+}
+
+// Merges the enabled builtins and the loaded files, in that order, from
+// dbc_cache: only files edited since their last parse are parsed again.
+// Publishes nothing if every fragment is the one already in use.
 static void rebuild_dbc(){
-    DbcParser tmp;
+    std::vector<DbcFragmentPtr> fragments;
     {
         std::lock_guard<std::mutex> lock(builtin_mtx);
         for(const auto &b : builtin_dbcs)
             if(b.enabled)
-                tmp.loadFromMemory((const char*)b.data, b.size, b.name);
-    }
-    {
-        std::lock_guard<std::mutex> lock(loaded_dbcs_mtx);
-        for(const auto &p : loaded_dbcs)
-            tmp.load(p);
+                fragments.push_back(dbc_cache.compiled(*b.compiled, b.name));
     }
-    std::lock_guard<std::mutex> lock(dbc_mtx);
-    dbc = std::move(tmp);
+    std::vector<std::string> paths = get_loaded_dbcs();
+    for(const auto &p : paths)
+        if(DbcFragmentPtr f = dbc_cache.file(p))
+            fragments.push_back(std::move(f));
+    if(dbc_watcher.running())
+        dbc_watcher.watch(paths);
+
+    // rebuilds only run on the backend thread, nothing else publishes
+    const DbcSnapshotPtr current = std::atomic_load(&dbc_snapshot);
+    if(fragments == current->dbc.fragments())
+        return;
+    auto next = std::make_shared<DbcSnapshot>();
+    next->version = current->version + 1;
+    next->dbc = DbcCatalog(std::move(fragments));
+    if(next->dbc.conflicts() != current->dbc.conflicts())
+        for(const auto &c : next->dbc.conflicts())
+            std::cout << "[!] DBC id 0x" << std::hex << c.id << std::dec << " of " << c.replaced->name
+                      << " overridden by " << c.kept->name << std::endl;
+    apply_dbc_limits(next->dbc);
+    std::atomic_store(&dbc_snapshot, DbcSnapshotPtr(std::move(next)));
 }
 
-std::atomic<bool> data_source_terminate(false);
+DbcSnapshotPtr backend_dbc_snapshot(){
+    return std::atomic_load(&dbc_snapshot);
+}
 
 const CanStore& get_can_store() { return can_store; }
 
 void forward_dbc_load(const std::string& path){
     if(path.empty())
         return;
-    std::lock_guard<std::mutex> lock(dbc_request_mtx);
-    dbc_requests.push_back({DbcOp::Load, path});
-    new_dbc_flag.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        dbc_requests.push_back({DbcOp::Load, path});
+    }
+    control_cv.notify_one();
 }
 
 void forward_dbc_unload(const std::string& path){
     if(path.empty())
         return;
-    std::lock_guard<std::mutex> lock(dbc_request_mtx);
-    dbc_requests.push_back({DbcOp::Unload, path});
-    new_dbc_flag.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        dbc_requests.push_back({DbcOp::Unload, path});
+    }
+    control_cv.notify_one();
 }
 
 void forward_builtin_dbc_load(const std::string& name){
     if(name.empty()) return;
-    std::lock_guard<std::mutex> lock(dbc_request_mtx);
-    dbc_requests.push_back({DbcOp::Load, name, true});
-    new_dbc_flag.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        dbc_requests.push_back({DbcOp::Load, name, true});
+    }
+    control_cv.notify_one();
 }
 
 void forward_builtin_dbc_unload(const std::string& name){
     if(name.empty()) return;
-    std::lock_guard<std::mutex> lock(dbc_request_mtx);
-    dbc_requests.push_back({DbcOp::Unload, name, true});
-    new_dbc_flag.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        dbc_requests.push_back({DbcOp::Unload, name, true});
+    }
+    control_cv.notify_one();
 }
 
 std::vector<std::pair<std::string,bool>> list_builtin_dbcs(){
@@ -125,29 +201,25 @@ std::vector<std::string> get_loaded_dbcs(){
     return loaded_dbcs;
 }
 
-bool backend_decode(uint32_t id, const CanFrame &frame, std::string &out){
-    std::lock_guard<std::mutex> lock(dbc_mtx);
-    return dbc.decode(id, frame, out);
+void forward_dbc_hot_reload(bool enabled){
+    {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        dbc_requests.push_back({enabled ? DbcOp::Watch : DbcOp::Unwatch, {}});
+    }
+    control_cv.notify_one();
 }
 
-bool backend_decode_signals(uint32_t id, const CanFrame &frame, std::vector<std::pair<std::string,double>> &out){
-    std::lock_guard<std::mutex> lock(dbc_mtx);
-    return dbc.decode_signals(id, frame, out);
+bool backend_dbc_hot_reload(){
+    return dbc_watcher.running();
 }
 
-std::unordered_map<uint32_t, DbcMessage> backend_get_messages(){
-    std::lock_guard<std::mutex> lock(dbc_mtx);
-    return dbc.messages();
+bool backend_decode(uint32_t id, const CanFrame &frame, std::string &out){
+    return backend_dbc_snapshot()->dbc.decode(id, frame, out);
 }
 
-enum class ParseState : uint8_t {
-    WaitStart,
-    Id,
-    Len,
-    DataHigh,
-    DataLow,
-    End
-};
+bool backend_decode_signals(uint32_t id, const CanFrame &frame, std::vector<std::pair<std::string,double>> &out){
+    return backend_dbc_snapshot()->dbc.decode_signals(id, frame, out);
+}
 
 void user_prompt(){
     std::string input;
@@ -164,10 +236,13 @@ void user_prompt(){
             std::cout << "Invalid ID" << std::endl;
             continue;
         }
+        // anything past 11 bits can only be an extended id
+        if(id > CAN_ID_STD_MASK)
+            id = CAN_ID_EXT_FLAG | (id & CAN_ID_EXT_MASK);
         CanFrame frame;
-        if(can_store.read(static_cast<CanStore::IdType>(id), frame)){
+        if(can_store.read(id, frame)){
             std::string decoded;
-            if(dbc.decode(id,frame,decoded)){
+            if(backend_decode(id,frame,decoded)){
                 std::cout << decoded << std::endl;
             } else {
                 std::cout << "Len: " << std::dec << static_cast<int>(frame.len) << " Data: ";
@@ -182,290 +257,511 @@ void user_prompt(){
     }
 }
 
-static inline uint8_t hex_value(uint8_t c){
-    static const std::array<int8_t, 256> table = []{
-        std::array<int8_t, 256> t{};
-        t.fill(-1);
-        for(uint8_t i = 0; i < 10; ++i)
-            t['0' + i] = i;
-        for(uint8_t i = 0; i < 6; ++i){
-            t['A' + i] = 10 + i;
-            t['a' + i] = 10 + i;
-        }
-        return t;
-    }();
-    return table[c];
-}
-
-inline void dispatch(uint32_t id, uint8_t len, const uint8_t* payload){
-   can_store.store(static_cast<CanStore::IdType>(id), len, payload);
-}
-
-void parse(const uint8_t* data, size_t len){
-    static ParseState state = ParseState::WaitStart;
-    static uint32_t id = 0;
-    static uint8_t id_digits = 0;
-    static uint8_t dlen = 0;
-    static uint8_t payload[8];
-    static uint8_t index = 0;
-
-    for(size_t i = 0; i < len; ++i){
-        uint8_t c = data[i];
-        switch(state){
-            case ParseState::WaitStart:
-                if(c == 't'){
-                    id = 0;
-                    id_digits = 0;
-                    state = ParseState::Id;
-                }
-                break;
-            case ParseState::Id: {
-                uint8_t v = hex_value(c);
-                if(v < 16){
-                    id = (id << 4) | v;
-                    if(++id_digits == 3)
-                        state = ParseState::Len;
-                }else{
-                    state = ParseState::WaitStart;
-                }
-                break;
-            }
-            case ParseState::Len: {
-                uint8_t v = hex_value(c);
-                if(v < 16){
-                    dlen = v;
-                    index = 0;
-                    state = dlen ? ParseState::DataHigh : ParseState::End;
-                }else{
-                    state = ParseState::WaitStart;
-                }
-                break;
-            }
-            case ParseState::DataHigh: {
-                uint8_t v = hex_value(c);
-                if(v < 16){
-                    payload[index] = v << 4;
-                    state = ParseState::DataLow;
-                }else{
-                    state = ParseState::WaitStart;
-                }
-                break;
-            }
-            case ParseState::DataLow: {
-                uint8_t v = hex_value(c);
-                if(v < 16){
-                    payload[index] |= v;
-                    if(++index == dlen)
-                        state = ParseState::End;
-                    else
-                        state = ParseState::DataHigh;
-                }else{
-                    state = ParseState::WaitStart;
-                }
-                break;
-            }
-            case ParseState::End:
-                if(c == '\r')
-                    dispatch(id, dlen, payload);
-                state = ParseState::WaitStart;
-                break;
+inline void dispatch(uint32_t id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns){
+   // remote requests carry no payload worth keeping
+   if(id & CAN_ID_RTR_FLAG)
+       return;
+   can_store.store(id, len, payload, timestamp_ns);
+}
+
+static Reactor reactor;
+
+// one set of bus totals per source, kept by name so reopening a source
+// carries on counting where it left off
+static std::mutex bus_stats_mtx;
+static std::vector<std::shared_ptr<BusStats>> bus_stats;
+
+static SessionRecorder recorder;
+
+// a bus's position in the registry doubles as its number in session logs
+static std::shared_ptr<BusStats> bus_stats_for(const std::string &name, uint8_t &index){
+    std::lock_guard<std::mutex> lock(bus_stats_mtx);
+    for(size_t i = 0; i < bus_stats.size(); ++i)
+        if(bus_stats[i]->name() == name){
+            index = static_cast<uint8_t>(std::min<size_t>(i, 255));
+            return bus_stats[i];
         }
-    }
+    index = static_cast<uint8_t>(std::min<size_t>(bus_stats.size(), 255));
+    bus_stats.push_back(std::make_shared<BusStats>(name));
+    recorder.set_bus_name(index, name);
+    return bus_stats.back();
 }
 
-void serial_read(SerialPort &serial, RingBuffer &ringBuffer){
-    std::vector<uint8_t> temp(READ_CHUNK);
-    while(!data_source_terminate.load()){
-        size_t amount_read = serial.read(temp.data(), temp.size());
-        if (amount_read > 0) ringBuffer.write(temp.data(), amount_read);
-    }
-    //OutputDebugString("Closing Connection!\n");
+std::vector<std::shared_ptr<BusStats>> backend_bus_stats(){
+    std::lock_guard<std::mutex> lock(bus_stats_mtx);
+    return bus_stats;
 }
-void tcp_read(TcpSocket &socket, RingBuffer &ringBuffer){
-    std::vector<uint8_t> temp(READ_CHUNK);
-    while(!data_source_terminate.load()){
-        size_t amount_read = socket.read(temp.data(), temp.size());
-        if(amount_read > 0) ringBuffer.write(temp.data(), amount_read);
-    }
+
+static FrameHandler store_handler(const std::string &bus){
+    uint8_t index = 0;
+    std::shared_ptr<BusStats> stats = bus_stats_for(bus, index);
+    return [stats, index](uint32_t id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns){
+        // remote frames still take up the bus, just without a data field
+        stats->update(id, (id & CAN_ID_RTR_FLAG) ? 0 : len, timestamp_ns);
+        recorder.record(index, id, len, payload, timestamp_ns);
+        dispatch(id, len, payload, timestamp_ns);
+    };
 }
 
-void photon_proc(RingBuffer &ringBuffer){
-    std::vector<uint8_t> temp(READ_CHUNK);
-    while(true){
-        size_t amount_read = ringBuffer.read(temp.data(), temp.size());
-        parse((uint8_t*)temp.data(), amount_read);
+struct SourceOp {
+    enum Type { OpenSerial, OpenTcp, OpenSocketCan, OpenReplay, Close, CloseAll, StartRecording, StopRecording, ExportArrow } type;
+    std::string addr;
+    std::string cfg;
+    int id = -1;
+};
+
+static std::vector<SourceOp> source_requests;
+
+static void push_source_op(SourceOp op){
+    {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        source_requests.push_back(std::move(op));
     }
+    control_cv.notify_one();
 }
 
-struct SerialSource {
-    std::string fd;
-    std::string baud;
-    std::mutex mtx;
-}serialSourceBuffer;
+// lets a blocking connect/accept or a long job give up once we are
+// shutting down
+static bool keep_going(){
+    return !shutdown_requested.load();
+}
 
-struct TcpSource {
-    std::string fd;
-    std::string port;
-    std::mutex mtx;
-}tcpSourceBuffer;
+// Exports and log imports can run for minutes, so they get a thread of
+// their own and the control thread goes straight back to its queue. A job
+// reports its own outcome and stops early through keep_going(); only the
+// control thread starts and joins them.
+struct Job {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> done;
+};
+static std::vector<Job> jobs;
 
-std::atomic<bool> new_source_flag(false);
-std::atomic<int> sourceEnum(-1);
+static void start_job(std::function<void()> fn){
+    for(auto it = jobs.begin(); it != jobs.end();){
+        if(it->done->load()){
+            it->thread.join();
+            it = jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    jobs.push_back({std::thread([fn, done]{
+        fn();
+        done->store(true);
+    }), done});
+}
+
+static void join_jobs(){
+    for(auto &j : jobs)
+        j.thread.join();
+    jobs.clear();
+}
 
 void kill_data_source(){
-    sourceEnum.store(-1);
-    new_source_flag.store(true, std::memory_order_release);
+    push_source_op({SourceOp::CloseAll, {}, {}});
+}
+
+void kill_data_source(int id){
+    SourceOp op{SourceOp::Close, {}, {}};
+    op.id = id;
+    push_source_op(std::move(op));
+}
+
+std::vector<std::pair<int, std::string>> list_data_sources(){
+    return reactor.sources();
 }
 
 void forward_serial_source(std::string& fd, std::string& baud){
     if(fd.empty() || baud.empty())
         return;
-
-    std::unique_lock<std::mutex> lock(serialSourceBuffer.mtx);
-    serialSourceBuffer.fd = fd;
-    serialSourceBuffer.baud = baud;
-    sourceEnum.store(0);
-    new_source_flag.store(true, std::memory_order_release);
+    push_source_op({SourceOp::OpenSerial, fd, baud});
 }
 
 void forward_tcp_source(std::string& fd, std::string& port){
     if(fd.empty() || port.empty())
         return;
+    push_source_op({SourceOp::OpenTcp, fd, port});
+}
+
+void forward_socketcan_source(std::string& ifname){
+    if(ifname.empty())
+        return;
+    push_source_op({SourceOp::OpenSocketCan, ifname, {}});
+}
 
-    std::unique_lock<std::mutex> lock(tcpSourceBuffer.mtx);
-    tcpSourceBuffer.fd = fd;
-    tcpSourceBuffer.port = port;
-    sourceEnum.store(1);
-    new_source_flag.store(true, std::memory_order_release);
+void forward_record_start(const std::string& dir, bool mdf){
+    push_source_op({SourceOp::StartRecording, dir, mdf ? "mf4" : ""});
 }
 
-enum source_t {
-    local,
-    remote
-};
+void forward_record_stop(){
+    push_source_op({SourceOp::StopRecording, {}, {}});
+}
 
-int backend(int argc, char* argv[]){
-    (void)argc;(void)argv;
-    int res = 0;
-    if (argc != 0)
-        res = std::stoi(argv[1]);
-    source_t source = (source_t)res;
+const SessionRecorder& get_recorder(){
+    return recorder;
+}
 
-    for(int i = 2; i < argc; i++){ std::cout << "Decoding ";
-        std::cout << argv[i] << std::endl;
-        dbc.load(argv[i]);
+// The replay lives on the reactor thread like the sources and is driven by
+// one of its timers; the pointer is only guarded for status().
+static std::mutex replay_mtx;
+static std::shared_ptr<ReplayEngine> replay;
+static int replay_timer = -1;
+
+// reactor thread
+static void close_replay(){
+    if(replay_timer >= 0)
+        reactor.remove_timer(replay_timer);
+    replay_timer = -1;
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    replay.reset();
+}
+
+// reactor thread: the timer only runs while there is something to play,
+// a paused or finished replay costs no wakeups
+static void update_replay_timer(const ReplayEngine& r){
+    if(replay_timer >= 0)
+        reactor.set_timer_armed(replay_timer, !r.idle());
+}
+
+static void with_replay(std::function<void(ReplayEngine&)> fn){
+    reactor.post([fn]{
+        std::shared_ptr<ReplayEngine> r;
+        {
+            std::lock_guard<std::mutex> lock(replay_mtx);
+            r = replay;
+        }
+        if(r){
+            fn(*r);
+            update_replay_timer(*r);
+        }
+    });
+}
+
+static bool is_mdf_path(const std::string &path){
+    const size_t dot = path.rfind('.');
+    if(dot == std::string::npos)
+        return false;
+    std::string ext = path.substr(dot + 1);
+    for(char &ch : ext)
+        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    return ext == "mf4" || ext == "mdf";
+}
+
+static std::string absolute_path(const std::string &path){
+#ifdef _WIN32
+    char buf[_MAX_PATH];
+    return _fullpath(buf, path.c_str(), sizeof(buf)) ? std::string(buf) : path;
+#else
+    char* real = realpath(path.c_str(), nullptr);
+    if(!real)
+        return path;
+    std::string out = real;
+    std::free(real);
+    return out;
+#endif
+}
+
+// FNV-1a, only to tell logs apart in a directory name
+static uint64_t fnv1a(const std::string &s){
+    uint64_t h = 14695981039346656037ull;
+    for(unsigned char ch : s){
+        h ^= ch;
+        h *= 1099511628211ull;
     }
+    return h;
+}
 
-    rebuild_dbc();
-    //dbc.can_parse_debug();
-    
-    std::unique_ptr<SerialPort> serial;
-    std::unique_ptr<TcpSocket> tcp;
+// the segments an import writes, then the directory itself
+static void remove_import(const std::string &dir){
+    for(uint32_t seg = 0;; ++seg){
+        const bool log = std::remove(canlog_segment_path(dir, seg, "canlog").c_str()) == 0;
+        const bool idx = std::remove(canlog_segment_path(dir, seg, "canidx").c_str()) == 0;
+        if(!log && !idx)
+            break;
+    }
+#ifdef _WIN32
+    _rmdir(dir.c_str());
+#else
+    rmdir(dir.c_str());
+#endif
+}
+
+// one import at a time, so opening the same log twice imports it once
+static std::mutex import_mtx;
+
+// Text logs from other tools are imported once into
+// sessions/import-<name>-<key> and replayed from there, the key a hash of
+// the log's full path, size and mtime: another log of the same name, or
+// this one edited, gets an import of its own. The import is written to a
+// .partial directory and only renamed into place once complete, so a failed
+// or cancelled one is never replayed. MDF4 files are read in place.
+// Runs on a job thread.
+static std::string replay_directory(const std::string &path){
+    struct stat log_st;
+    if(stat(path.c_str(), &log_st) != 0 || (log_st.st_mode & S_IFMT) != S_IFREG || is_mdf_path(path))
+        return path;
+
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    name = name.substr(0, name.rfind('.'));
+    char key[24];
+    std::snprintf(key, sizeof(key), "-%016llx", static_cast<unsigned long long>(fnv1a(
+        absolute_path(path) + "\n" + std::to_string(log_st.st_size) + "\n" + std::to_string(log_st.st_mtime))));
+    const std::string dir = "sessions/import-" + name + key;
+
+    std::lock_guard<std::mutex> lock(import_mtx);
+    struct stat idx_st;
+    if(stat(canlog_segment_path(dir, 0, "canidx").c_str(), &idx_st) == 0)
+        return dir;
+
+    // whatever an earlier run left behind
+    const std::string partial = dir + ".partial";
+    remove_import(partial);
+    remove_import(dir);
+    ImportStats st;
+    try{
+        st = import_log(path, partial, 0, keep_going);
+    } catch (...){
+        remove_import(partial);
+        throw;
+    }
+    if(std::rename(partial.c_str(), dir.c_str()) != 0){
+        const int err = errno;
+        remove_import(partial);
+        throw std::system_error(err, std::system_category(), "cannot rename " + partial);
+    }
+
+    std::cout << "[+] Imported " << st.frames << " frames from " << path << " ("
+              << log_format_name(st.format) << ", " << st.skipped << " lines skipped) in "
+              << st.seconds << " s";
+    // a tiny log can import within the clock's resolution
+    if(st.seconds > 0)
+        std::cout << ", " << static_cast<uint64_t>(st.bytes / 1e6 / st.seconds) << " MB/s";
+    std::cout << std::endl;
+    return dir;
+}
 
-    RingBuffer ringBuffer;
+void forward_replay_source(const std::string& dir){
+    if(dir.empty())
+        return;
+    push_source_op({SourceOp::OpenReplay, dir, {}});
+}
 
-    std::thread prod_t;
+void forward_replay_close(){
+    reactor.post(close_replay);
+}
 
-    std::thread photon_t(photon_proc, std::ref(ringBuffer));
+void forward_replay_seek(uint64_t log_ns){
+    with_replay([log_ns](ReplayEngine &r){ r.seek(log_ns); });
+}
 
-    while(1){
-          if(new_dbc_flag.load()){ // -- handle dbc operations  --
-            new_dbc_flag.store(false, std::memory_order_release);
-            std::vector<DbcOp> ops;
-            {
-                std::lock_guard<std::mutex> lock(dbc_request_mtx);
-                ops.swap(dbc_requests);
-            }
-            bool rebuild = false;
-            for(auto &op : ops){
-                if(op.builtin){
-                    std::lock_guard<std::mutex> lock(builtin_mtx);
-                    for(auto &b : builtin_dbcs){
-                        if(b.name == op.name){
-                            b.enabled = (op.type == DbcOp::Load);
-                            rebuild = true;
-                            break;
-                        }
+void forward_replay_speed(double speed){
+    with_replay([speed](ReplayEngine &r){ r.set_speed(speed); });
+}
+
+void forward_replay_pause(bool paused){
+    with_replay([paused](ReplayEngine &r){ r.set_paused(paused); });
+}
+
+void forward_replay_step(){
+    with_replay([](ReplayEngine &r){ r.step(); });
+}
+
+void forward_export_arrow(const std::string& session_dir){
+    if(session_dir.empty())
+        return;
+    push_source_op({SourceOp::ExportArrow, session_dir, {}});
+}
+
+ReplayStatus backend_replay_status(){
+    std::shared_ptr<ReplayEngine> r;
+    {
+        std::lock_guard<std::mutex> lock(replay_mtx);
+        r = replay;
+    }
+    return r ? r->status() : ReplayStatus{};
+}
+
+// opening can block (tcp connect retries), so it happens here and only the
+// ready source is handed to the reactor thread
+static void handle_source_op(const SourceOp &op){
+    try{
+        switch(op.type){
+            case SourceOp::OpenSerial:
+                reactor.add_source(std::unique_ptr<IngestSource>(new SerialIngest(op.addr, std::stoi(op.cfg), store_handler("Serial " + op.addr))));
+                break;
+            case SourceOp::OpenTcp:
+                reactor.add_source(std::unique_ptr<IngestSource>(new TcpIngest(op.addr, std::stoi(op.cfg), store_handler("TCP " + op.addr + ":" + op.cfg), keep_going)));
+                break;
+            case SourceOp::OpenSocketCan:
+                reactor.add_source(std::unique_ptr<IngestSource>(new SocketCanIngest(op.addr, store_handler("SocketCAN " + op.addr))));
+                break;
+            case SourceOp::OpenReplay: {
+                // the log is imported, mapped and indexed on a job, the
+                // reactor only plays it
+                const std::string addr = op.addr;
+                start_job([addr]{
+                    try{
+                        auto r = std::make_shared<ReplayEngine>(replay_directory(addr), [](const std::string &bus){
+                            return store_handler("Replay " + bus);
+                        });
+                        if(!keep_going())
+                            return;
+                        reactor.post([r]{
+                            close_replay();
+                            {
+                                std::lock_guard<std::mutex> lock(replay_mtx);
+                                replay = r;
+                            }
+                            replay_timer = reactor.add_timer(ReplayEngine::TICK_NS, [r]{
+                                r->tick();
+                                if(r->idle())
+                                    update_replay_timer(*r);
+                            });
+                        });
+                        std::cout << "[+] Replaying " << addr << std::endl;
+                    } catch (const std::exception &e){
+                        std::cout << "[!] Unable to open source " << addr << ": " << e.what() << std::endl;
                     }
-                } else {
-                    if(op.type == DbcOp::Load){
-                        std::lock_guard<std::mutex> lock(loaded_dbcs_mtx);
-                        if(std::find(loaded_dbcs.begin(), loaded_dbcs.end(), op.name) == loaded_dbcs.end()){
-                            loaded_dbcs.push_back(op.name);
-                            rebuild = true;
-                        }
+                });
+                break;
+            }
+            case SourceOp::Close:
+                reactor.remove_source(op.id);
+                break;
+            case SourceOp::CloseAll:
+                reactor.remove_all_sources();
+                reactor.post(close_replay);
+                break;
+            case SourceOp::StartRecording:
+                try{
+                    if(op.cfg == "mf4"){
+                        const DbcSnapshotPtr snap = backend_dbc_snapshot();
+                        recorder.start(op.addr, &snap->dbc.messages());
                     } else {
-                        std::lock_guard<std::mutex> lock(loaded_dbcs_mtx);
-                        auto it = std::find(loaded_dbcs.begin(), loaded_dbcs.end(), op.name);
-                        if(it != loaded_dbcs.end()){
-                            loaded_dbcs.erase(it);
-                            rebuild = true;
-                        }
+                        recorder.start(op.addr);
                     }
+                } catch (const std::exception &e){
+                    std::cout << "[!] Unable to start recording: " << e.what() << std::endl;
                 }
+                break;
+            case SourceOp::StopRecording:
+                recorder.stop();
+                break;
+            case SourceOp::ExportArrow: {
+                // next to an .mf4, inside a session directory
+                const std::string dir = op.addr;
+                const std::string out = is_mdf_path(dir) ? dir.substr(0, dir.rfind('.')) + "-arrow" : dir + "/arrow";
+                // the job keeps the DBCs it started with, whatever is loaded meanwhile
+                const DbcSnapshotPtr snap = backend_dbc_snapshot();
+                start_job([dir, out, snap]{
+                    try{
+                        ArrowExportStats st = export_arrow(dir, snap->dbc.messages(), out, 0, keep_going);
+                        std::cout << "[+] Exported " << st.rows << " rows of " << st.frames << " frames to "
+                                  << st.files << " files in " << out << " (" << st.seconds << " s)" << std::endl;
+                    } catch (const std::exception &e){
+                        std::cout << "[!] Unable to export " << dir << ": " << e.what() << std::endl;
+                    }
+                });
+                break;
             }
-            if(rebuild)
-                rebuild_dbc();
         }
+    } catch (const std::exception &e){
+        std::cout << "[!] Unable to open source " << op.addr << ": " << e.what() << std::endl;
+    }
+}
 
-        if(new_source_flag.load()){ // -- new source --
-            new_source_flag.store(false, std::memory_order_release);
-            
-
-            // -- kill old thread --
-            if(prod_t.joinable()){
-               data_source_terminate.store(true, std::memory_order_release);
-               prod_t.join();
-               data_source_terminate.store(false, std::memory_order_release);
+static void handle_dbc_ops(const std::vector<DbcOp> &ops){
+    bool rebuild = false;
+    for(const auto &op : ops){
+        if(op.type == DbcOp::Reload){
+            rebuild = true;
+        } else if(op.type == DbcOp::Watch){
+            // the rebuild watches the loaded files, and picks up edits made
+            // while nothing was watching
+            if(dbc_watcher.start())
+                rebuild = true;
+        } else if(op.type == DbcOp::Unwatch){
+            dbc_watcher.stop();
+        } else if(op.builtin){
+            std::lock_guard<std::mutex> lock(builtin_mtx);
+            for(auto &b : builtin_dbcs){
+                if(b.name == op.name){
+                    b.enabled = (op.type == DbcOp::Load);
+                    rebuild = true;
+                    break;
+                }
+            }
+        } else {
+            if(op.type == DbcOp::Load){
+                std::lock_guard<std::mutex> lock(loaded_dbcs_mtx);
+                if(std::find(loaded_dbcs.begin(), loaded_dbcs.end(), op.name) == loaded_dbcs.end()){
+                    loaded_dbcs.push_back(op.name);
+                    rebuild = true;
+                }
+            } else {
+                std::lock_guard<std::mutex> lock(loaded_dbcs_mtx);
+                auto it = std::find(loaded_dbcs.begin(), loaded_dbcs.end(), op.name);
+                if(it != loaded_dbcs.end()){
+                    loaded_dbcs.erase(it);
+                    rebuild = true;
+                }
             }
+        }
+    }
+    if(rebuild)
+        rebuild_dbc();
+}
 
-            // -- grab protocol --
-            int prot = sourceEnum.load();
+void backend_shutdown(){
+    {
+        std::lock_guard<std::mutex> lock(control_mtx);
+        shutdown_requested.store(true);
+    }
+    control_cv.notify_one();
+}
 
-            // -- false alarm --
-            if(prot == -1){
-                // if we keep prot to -1, we just kill the thread
-                //OutputDebugString("[!] Kill Source\n");
-                continue;
-            }
+int backend(int argc, char* argv[]){
+    for(int i = 2; i < argc; i++){ std::cout << "Decoding ";
+        std::cout << argv[i] << std::endl;
+        std::lock_guard<std::mutex> lock(loaded_dbcs_mtx);
+        loaded_dbcs.push_back(argv[i]);
+    }
 
-            std::string fd;
-            unsigned cfg;
-
-            // -- grab params --
-            if((source_t)prot == local){
-                serial.reset();
-                std::lock_guard<std::mutex> lock(serialSourceBuffer.mtx);
-                fd = serialSourceBuffer.fd;
-                //OutputDebugString(fd.c_str());
-                //OutputDebugString("\n");
-                cfg = std::stoi(serialSourceBuffer.baud);
-            }
-            if((source_t)prot == remote){
-                tcp.reset();
-                std::lock_guard<std::mutex> lock(tcpSourceBuffer.mtx);
-                fd = tcpSourceBuffer.fd;
-                cfg = std::stoi(tcpSourceBuffer.port);
-            }
+    rebuild_dbc();
+    //dbc.can_parse_debug();
 
-            // -- create threads --
-            try{
-                if((source_t)prot == local){
-                    //OutputDebugString("[+] Attempting Serial\n");
-                    serial = std::make_unique<SerialPort>(fd, cfg);
-                    prod_t = std::thread(serial_read, std::ref(*serial), std::ref(ringBuffer));
-                }
-                if((source_t)prot == remote){
-                    //OutputDebugString("[!] Attempting TCP\n");
-                    tcp = std::make_unique<TcpSocket>(fd, cfg);
-                    prod_t = std::thread(tcp_read, std::ref(*tcp), std::ref(ringBuffer));
-                }
-            } catch (const std::exception &e){
-            }
+    std::thread reactor_t([]{ reactor.run(); });
 
+    while(true){
+        std::vector<DbcOp> dbc_ops;
+        std::vector<SourceOp> source_ops;
+        {
+            std::unique_lock<std::mutex> lock(control_mtx);
+            control_cv.wait(lock, []{
+                return shutdown_requested.load() || !dbc_requests.empty() || !source_requests.empty();
+            });
+            if(shutdown_requested.load())
+                break;
+            dbc_ops.swap(dbc_requests);
+            source_ops.swap(source_requests);
         }
+
+        if(!dbc_ops.empty()) // -- handle dbc operations --
+            handle_dbc_ops(dbc_ops);
+
+        for(const auto &op : source_ops) // -- source changes --
+            handle_source_op(op);
     }
 
-    photon_t.join();
+    // jobs see shutdown_requested and stop at their next chunk
+    join_jobs();
+    // sources are closed on the reactor thread before it leaves run()
+    reactor.remove_all_sources();
+    reactor.post(close_replay);
+    reactor.stop();
+    reactor_t.join();
+    recorder.stop();
+    dbc_watcher.stop();
     return 0;
 }
@@ -1,27 +1,73 @@
 #pragma once
 
 #include "candb.hpp"
+#include "canstats.hpp"
 #include "dbc.hpp"
+#include "dbc_catalog.hpp"
+#include "recorder.hpp"
+#include "replay.hpp"
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
 #include <unordered_map>
 
 int backend(int argc, char* argv[]);
+// wakes backend() so it closes every source and returns
+void backend_shutdown();
 
 const CanStore& get_can_store();
 
+// The loaded DBC set, never changed once published: every rebuild makes a
+// new one with the next version and swaps it in atomically. Readers take a
+// reference with backend_dbc_snapshot() and use it, without a lock or a
+// copy, for as long as they hold it (a GUI frame, an export); the last one
+// to let go frees it.
+struct DbcSnapshot {
+    uint64_t version = 0;
+    DbcCatalog dbc;
+};
+using DbcSnapshotPtr = std::shared_ptr<const DbcSnapshot>;
+DbcSnapshotPtr backend_dbc_snapshot();
+
+// one-off decodes against the current snapshot; loops should take the
+// snapshot once instead
 bool backend_decode(uint32_t id, const CanFrame& frame, std::string& out);
 bool backend_decode_signals(uint32_t id, const CanFrame& frame, std::vector<std::pair<std::string, double>> &out);
-std::unordered_map<uint32_t, DbcMessage> backend_get_messages();
 
 void forward_serial_source(std::string& fd, std::string& baud);
 void forward_tcp_source(std::string& fd, std::string& port);
+void forward_socketcan_source(std::string& ifname);
+// plays a recorded session directory back as a source, or a candump, ASC
+// or TRC log after importing it
+void forward_replay_source(const std::string& dir);
+void forward_replay_close();
+void forward_replay_seek(uint64_t log_ns);
+// 0 = as fast as possible
+void forward_replay_speed(double speed);
+void forward_replay_pause(bool paused);
+void forward_replay_step();
+ReplayStatus backend_replay_status();
+// decoded signals of a session with the loaded DBCs, to <dir>/arrow/*.arrow
+void forward_export_arrow(const std::string& session_dir);
 void kill_data_source();
+void kill_data_source(int id);
+std::vector<std::pair<int, std::string>> list_data_sources();
+// traffic totals, one per source ever opened
+std::vector<std::shared_ptr<BusStats>> backend_bus_stats();
+
+// raw frames of every source to a session log, empty dir for the default;
+// mdf also writes <dir>/session.mf4 with the loaded DBC messages decoded
+void forward_record_start(const std::string& dir, bool mdf = false);
+void forward_record_stop();
+const SessionRecorder& get_recorder();
 
 void forward_dbc_load(const std::string& path);
 void forward_dbc_unload(const std::string& path);
 std::vector<std::string> get_loaded_dbcs();
+// reload loaded DBC files as soon as they are saved (linux)
+void forward_dbc_hot_reload(bool enabled);
+bool backend_dbc_hot_reload();
 
 
 void forward_builtin_dbc_load(const std::string& name);
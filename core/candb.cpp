@@ -1,25 +1,329 @@
 #include "candb.hpp"
+#include <algorithm>
 #include <cstring>
 
-void CanStore::store(IdType id, uint8_t len, const uint8_t* payload){
-    if(id >= MAX_IDS || !payload || len > 8)
+CanStore::CanStore()
+    : _index(new Slot[INDEX_SLOTS]),
+      _entries(new Entry[MAX_IDS]) {}
+
+int CanStore::find(IdType id) const{
+    for(std::size_t s = slot_of(id);; s = (s + 1) & (INDEX_SLOTS - 1)){
+        uint32_t key = _index[s].key.load(std::memory_order_acquire);
+        if(key == id)
+            return static_cast<int>(_index[s].index);
+        if(key == EMPTY_KEY)
+            return -1;
+    }
+}
+
+int CanStore::insert(IdType id){
+    std::lock_guard<std::mutex> lock(_insert_mtx);
+    // another source may have raced us here
+    int found = find(id);
+    if(found >= 0)
+        return found;
+
+    std::size_t n = _count.load(std::memory_order_relaxed);
+    if(n >= MAX_IDS){
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    _entries[n].id = id;
+
+    std::size_t s = slot_of(id);
+    while(_index[s].key.load(std::memory_order_relaxed) != EMPTY_KEY)
+        s = (s + 1) & (INDEX_SLOTS - 1);
+    _index[s].index = static_cast<uint32_t>(n);
+    _index[s].key.store(id, std::memory_order_release);
+    _count.store(n + 1, std::memory_order_release);
+    return static_cast<int>(n);
+}
+
+CanStore::HistoryRing::HistoryRing(std::size_t capacity, std::size_t words, uint64_t base)
+    : capacity(capacity), words(words), base(base),
+      cells(new std::atomic<uint64_t>[capacity * (3 + words)]()) {}
+
+static std::size_t round_capacity(std::size_t frames){
+    std::size_t cap = CanStore::MIN_HISTORY;
+    while(cap < frames && cap < CanStore::MAX_HISTORY)
+        cap <<= 1;
+    return cap;
+}
+
+void CanStore::set_history_capacity(IdType id, std::size_t frames){
+    if(id == EMPTY_KEY)
+        return;
+    int index = find(id);
+    if(index < 0 && (index = insert(id)) < 0)
+        return;
+    _entries[index].history_capacity.store(static_cast<uint32_t>(round_capacity(frames)), std::memory_order_relaxed);
+}
+
+void CanStore::set_expected_len(IdType id, uint8_t len){
+    if(id == EMPTY_KEY)
+        return;
+    int index = find(id);
+    if(index < 0){
+        if(!len)
+            return;
+        if((index = insert(id)) < 0)
+            return;
+    }
+    _entries[index].counters.expected_len.store(len, std::memory_order_relaxed);
+}
+
+// writer side only, swaps in a new ring when the id needs wider slots or
+// its capacity was changed
+CanStore::HistoryRing* CanStore::ring_for(Entry& e, std::size_t words){
+    HistoryRing* ring = e.history.load(std::memory_order_relaxed);
+    std::size_t cap = e.history_capacity.load(std::memory_order_relaxed);
+    if(cap == 0)
+        cap = DEFAULT_HISTORY;
+    if(ring && ring->words >= words && ring->capacity == cap)
+        return ring;
+
+    if(ring)
+        words = std::max(words, ring->words);
+    std::size_t bytes = cap * (3 + words) * sizeof(uint64_t);
+    if(_history_bytes.load(std::memory_order_relaxed) + bytes > HISTORY_BUDGET && cap > MIN_HISTORY){
+        cap = MIN_HISTORY;
+        bytes = cap * (3 + words) * sizeof(uint64_t);
+    }
+    e.history_capacity.store(static_cast<uint32_t>(cap), std::memory_order_relaxed);
+    if(ring && ring->words >= words && ring->capacity == cap)
+        return ring;
+
+    HistoryRing* fresh = new HistoryRing(cap, words, e.frames.load(std::memory_order_relaxed));
+    _history_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    e.history.store(fresh, std::memory_order_release);
+    if(ring){
+        std::lock_guard<std::mutex> lock(_retired_mtx);
+        _retired.emplace_back(ring);
+        _have_retired.store(true, std::memory_order_relaxed);
+    }
+    return fresh;
+}
+
+// writer side: a reader that registers after the fence sees only the new
+// rings, so with none registered the replaced ones are unreachable
+void CanStore::reclaim_history(){
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(_history_readers.load(std::memory_order_acquire) != 0)
+        return;
+    std::lock_guard<std::mutex> lock(_retired_mtx);
+    for(const auto &ring : _retired)
+        _history_bytes.fetch_sub(ring->bytes(), std::memory_order_relaxed);
+    _retired.clear();
+    _have_retired.store(false, std::memory_order_relaxed);
+}
+
+static inline void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+void CanStore::store(IdType id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns){
+    if(id == EMPTY_KEY || !payload || len > CAN_FD_MAX_LEN)
         return;
-    Entry &e = _entries[id];
-    std::lock_guard<std::mutex> lock(e.mtx);
-    e.frame.len = len;
-    std::copy(payload, payload + len, e.frame.data.begin());
-    if (len < 8)
-        std::fill(e.frame.data.begin() + len, e.frame.data.end(), 0);
-    e.valid = true;
+    int index = find(id);
+    if(index < 0 && (index = insert(id)) < 0)
+        return;
+    Entry &e = _entries[index];
+
+    std::atomic<uint64_t>* fd = nullptr;
+    if(len > CAN_CLASSIC_MAX_LEN){
+        fd = e.fd_data.load(std::memory_order_acquire);
+        if(!fd){
+            // allocated once and kept, readers may still hold the pointer
+            std::atomic<uint64_t>* fresh = new std::atomic<uint64_t>[FD_WORDS]();
+            if(e.fd_data.compare_exchange_strong(fd, fresh, std::memory_order_acq_rel))
+                fd = fresh;
+            else
+                delete[] fresh;
+        }
+    }
+
+    // normally there is one writer (the reactor thread); the CAS only keeps
+    // two sources sharing an id from interleaving on the threaded fallback
+    uint32_t seq = e.seq.load(std::memory_order_relaxed);
+    while((seq & 1) || !e.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed)){
+        cpu_relax();
+        seq = e.seq.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint8_t buf[CAN_FD_MAX_LEN] = {};
+    std::memcpy(buf, payload, len);
+    e.len.store(len, std::memory_order_relaxed);
+    e.timestamp_ns.store(timestamp_ns, std::memory_order_relaxed);
+    uint64_t word;
+    if(fd){
+        for(std::size_t i = 0; i < FD_WORDS; ++i){
+            std::memcpy(&word, buf + 8 * i, 8);
+            fd[i].store(word, std::memory_order_relaxed);
+        }
+    } else {
+        std::memcpy(&word, buf, 8);
+        e.data.store(word, std::memory_order_relaxed);
+    }
+
+    // history slot for frame n, same odd/even dance per slot
+    const uint64_t n = e.frames.load(std::memory_order_relaxed);
+    HistoryRing* ring = ring_for(e, fd ? FD_WORDS : 1);
+    std::atomic<uint64_t>* slot = ring->slot(n);
+    slot[0].store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot[1].store(timestamp_ns, std::memory_order_relaxed);
+    slot[2].store(len, std::memory_order_relaxed);
+    for(std::size_t i = 0; i < ring->words; ++i){
+        std::memcpy(&word, buf + 8 * i, 8);
+        slot[3 + i].store(word, std::memory_order_relaxed);
+    }
+    slot[0].store(2 * n + 2, std::memory_order_release);
+    e.frames.store(n + 1, std::memory_order_release);
+    e.counters.update(len, timestamp_ns);
+
+    e.seq.store(seq + 2, std::memory_order_release);
+
+    if(_have_retired.load(std::memory_order_relaxed))
+        reclaim_history();
+}
+
+bool CanStore::read(IdType id, CanFrame& out, uint32_t* sequence) const{
+    int index = find(id);
+    if(index < 0)
+        return false;
+    return read_at(static_cast<std::size_t>(index), out, sequence);
+}
+
+uint32_t CanStore::sequence(IdType id) const{
+    int index = find(id);
+    if(index < 0)
+        return 0;
+    return sequence_at(static_cast<std::size_t>(index));
+}
+
+bool CanStore::read_at(std::size_t index, CanFrame& out, uint32_t* sequence) const{
+    if(index >= size())
+        return false;
+    const Entry &e = _entries[index];
+    uint32_t before;
+    for(;;){
+        before = e.seq.load(std::memory_order_acquire);
+        if(before == 0)
+            return false;
+        if(before & 1){
+            cpu_relax();
+            continue;
+        }
+        out.len = e.len.load(std::memory_order_relaxed);
+        out.timestamp_ns = e.timestamp_ns.load(std::memory_order_relaxed);
+        uint64_t word;
+        // a torn len can point at an fd block that isn't there yet, the
+        // sequence check below throws that copy away
+        const std::atomic<uint64_t>* fd = e.fd_data.load(std::memory_order_relaxed);
+        if(out.len > CAN_CLASSIC_MAX_LEN && fd){
+            for(std::size_t i = 0; i < FD_WORDS; ++i){
+                word = fd[i].load(std::memory_order_relaxed);
+                std::memcpy(out.data.data() + 8 * i, &word, 8);
+            }
+        } else {
+            word = e.data.load(std::memory_order_relaxed);
+            std::memcpy(out.data.data(), &word, 8);
+            std::fill(out.data.begin() + CAN_CLASSIC_MAX_LEN, out.data.end(), 0);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(e.seq.load(std::memory_order_relaxed) == before)
+            break;
+    }
+
+    if(sequence)
+        *sequence = before >> 1;
+    return true;
 }
 
-bool CanStore::read(IdType id, CanFrame& out) const{
-    if(id >= MAX_IDS)
+bool CanStore::stats(IdType id, IdStats& out) const{
+    int index = find(id);
+    if(index < 0)
         return false;
-    const Entry &e = _entries[id];
-    std::lock_guard<std::mutex> lock(e.mtx);
-    if(!e.valid)
+    return stats_at(static_cast<std::size_t>(index), out);
+}
+
+bool CanStore::stats_at(std::size_t index, IdStats& out) const{
+    if(index >= size())
         return false;
-    out = e.frame;
+    const Entry &e = _entries[index];
+    out.frames = e.frames.load(std::memory_order_acquire);
+    e.counters.copy_to(out);
     return true;
 }
+
+std::size_t CanStore::history(IdType id, uint64_t& cursor, std::vector<CanFrame>& out, uint64_t* lost) const{
+    int index = find(id);
+    if(index < 0)
+        return 0;
+    return history_at(static_cast<std::size_t>(index), cursor, out, lost);
+}
+
+std::size_t CanStore::history_at(std::size_t index, uint64_t& cursor, std::vector<CanFrame>& out, uint64_t* lost) const{
+    if(index >= size())
+        return 0;
+    const Entry &e = _entries[index];
+    // keeps the ring from being freed under us (reclaim_history)
+    struct ReaderGuard {
+        std::atomic<uint32_t>& readers;
+        explicit ReaderGuard(std::atomic<uint32_t>& r) : readers(r) {
+            readers.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        ~ReaderGuard(){ readers.fetch_sub(1, std::memory_order_release); }
+    } guard(_history_readers);
+    const HistoryRing* ring = e.history.load(std::memory_order_acquire);
+    if(!ring)
+        return 0;
+    const uint64_t head = e.frames.load(std::memory_order_acquire);
+    if(cursor > head)
+        cursor = head;
+
+    uint64_t oldest = head > ring->capacity ? head - ring->capacity : 0;
+    oldest = std::max(oldest, ring->base);
+    uint64_t missed = 0;
+    uint64_t n = cursor;
+    if(n < oldest){
+        missed += oldest - n;
+        n = oldest;
+    }
+
+    std::size_t appended = 0;
+    CanFrame f;
+    for(; n < head; ++n){
+        const std::atomic<uint64_t>* slot = ring->slot(n);
+        const uint64_t done = 2 * n + 2;
+        if(slot[0].load(std::memory_order_acquire) != done){
+            ++missed; // overwritten already, or in a ring that was replaced
+            continue;
+        }
+        f.timestamp_ns = slot[1].load(std::memory_order_relaxed);
+        f.len = static_cast<uint8_t>(slot[2].load(std::memory_order_relaxed));
+        for(std::size_t i = 0; i < ring->words; ++i){
+            uint64_t word = slot[3 + i].load(std::memory_order_relaxed);
+            std::memcpy(f.data.data() + 8 * i, &word, 8);
+        }
+        std::fill(f.data.begin() + 8 * ring->words, f.data.end(), 0);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot[0].load(std::memory_order_relaxed) != done){
+            ++missed;
+            continue;
+        }
+        out.push_back(f);
+        ++appended;
+    }
+
+    cursor = head;
+    if(lost)
+        *lost += missed;
+    return appended;
+}
@@ -1,30 +1,190 @@
 #pragma once
 
+#include "canstats.hpp"
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <vector>
 
+constexpr uint8_t CAN_CLASSIC_MAX_LEN = 8;
+constexpr uint8_t CAN_FD_MAX_LEN = 64;
+
+// 4-bit DLC code <-> payload bytes, codes 9..15 only mean more than 8 on FD
+inline uint8_t can_dlc_to_len(uint8_t dlc){
+    static constexpr uint8_t lens[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+    return lens[dlc & 0x0F];
+}
+
+inline uint8_t can_len_to_dlc(uint8_t len){
+    if(len <= 8)  return len;
+    if(len <= 12) return 9;
+    if(len <= 16) return 10;
+    if(len <= 20) return 11;
+    if(len <= 24) return 12;
+    if(len <= 32) return 13;
+    if(len <= 48) return 14;
+    return 15;
+}
+
+// classic or FD frame, bytes past len are zero
 struct CanFrame {
     uint8_t len = 0;
-    std::array<uint8_t, 8> data{};
+    std::array<uint8_t, CAN_FD_MAX_LEN> data{};
+    uint64_t timestamp_ns = 0; // host monotonic receive time, see clock.hpp
 };
 
+// flags carried in the upper bits of a frame id, same layout as linux can_id
+// (and as the DBC convention of setting bit 31 on extended message ids)
+constexpr uint32_t CAN_ID_EXT_FLAG = 0x80000000u;
+constexpr uint32_t CAN_ID_RTR_FLAG = 0x40000000u;
+constexpr uint32_t CAN_ID_STD_MASK = 0x000007FFu;
+constexpr uint32_t CAN_ID_EXT_MASK = 0x1FFFFFFFu;
+
+// what every source hands its decoded frames to, timestamp_ns is host
+// monotonic (clock.hpp)
+using FrameHandler = std::function<void(uint32_t id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns)>;
+
+// Latest frame per CAN id, 11-bit and 29-bit (CAN_ID_EXT_FLAG) alike.
+// Payloads up to 8 bytes sit inline; an id that ever carries a longer FD
+// payload gets a 64-byte side block, so classic traffic stays compact.
+// Entries are kept densely in arrival order and found through an
+// open-addressing index, so lookups stay O(1) and walking every id touches
+// only the slots that have been seen. An id once seen keeps its slot.
+// Lookups never lock the index; new ids are published with release stores
+// after their entry is ready.
+//
+// Each entry is a seqlock: the writer bumps the sequence to odd, stores,
+// and bumps it back to even, readers copy and retry if the sequence moved.
+// Readers never block the writer. sequence_at()/sequence() count updates,
+// so a consumer can skip an entry it has already seen at that count.
+//
+// Besides the latest frame every id keeps a short ring of past frames.
+// Frames are numbered per id from 0; a consumer keeps the number it wants
+// next as its cursor and history() hands back everything from there that
+// the ring still holds, counting the rest as lost. Rings are written by the
+// same writer under the entry's sequence and validated per slot on read.
+// Capacity is per id (DEFAULT_HISTORY unless set, e.g. from the DBC cycle
+// time) and the total is held under HISTORY_BUDGET bytes by falling back to
+// MIN_HISTORY for ids that come late.
+//
+// Traffic counters (canstats.hpp) ride along in the entry and are updated
+// by the same writer; set_expected_len() arms the DLC check from the DBC.
 class CanStore {
     public: 
-        static constexpr std::size_t MAX_IDS = 4096;
-        using IdType = std::uint16_t;
+        static constexpr std::size_t MAX_IDS = 16384;
+        static constexpr std::size_t DEFAULT_HISTORY = 64;
+        static constexpr std::size_t MIN_HISTORY = 8;
+        static constexpr std::size_t MAX_HISTORY = 4096;
+        static constexpr std::size_t HISTORY_BUDGET = 64u << 20;
+        using IdType = std::uint32_t;
+
+        CanStore();
 
-        CanStore() = default;
+        void store(IdType id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns);
+        bool read(IdType id, CanFrame& out, uint32_t* sequence = nullptr) const;
+        uint32_t sequence(IdType id) const;
 
-        void store(IdType id, uint8_t len, const uint8_t* payload);
-        bool read(IdType id, CanFrame& out) const;
+        // dense iteration, index in [0, size())
+        std::size_t size() const { return _count.load(std::memory_order_acquire); }
+        IdType id_at(std::size_t index) const { return _entries[index].id; }
+        bool read_at(std::size_t index, CanFrame& out, uint32_t* sequence = nullptr) const;
+        uint32_t sequence_at(std::size_t index) const {
+            return _entries[index].seq.load(std::memory_order_acquire) >> 1;
+        }
+
+        // frames [cursor, ...) still held for the id are appended to out and
+        // cursor moves past the newest; returns how many were appended
+        std::size_t history(IdType id, uint64_t& cursor, std::vector<CanFrame>& out, uint64_t* lost = nullptr) const;
+        std::size_t history_at(std::size_t index, uint64_t& cursor, std::vector<CanFrame>& out, uint64_t* lost = nullptr) const;
+        // total frames ever stored for the id, i.e. the next frame number
+        uint64_t frame_count_at(std::size_t index) const {
+            return _entries[index].frames.load(std::memory_order_acquire);
+        }
+
+        // rounded up to a power of two and clamped, applied on the id's next frame
+        void set_history_capacity(IdType id, std::size_t frames);
+
+        bool stats(IdType id, IdStats& out) const;
+        bool stats_at(std::size_t index, IdStats& out) const;
+        // frames of any other length count as DLC mismatches, 0 disables
+        void set_expected_len(IdType id, uint8_t len);
+
+        uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+        // held by history rings, replaced ones included until they are freed
+        std::size_t history_bytes() const { return _history_bytes.load(std::memory_order_relaxed); }
 
     private:
+        static constexpr std::size_t INDEX_SLOTS = MAX_IDS * 2;
+        static constexpr uint32_t EMPTY_KEY = 0xFFFFFFFFu;
+        static constexpr std::size_t FD_WORDS = CAN_FD_MAX_LEN / 8;
+        static_assert((INDEX_SLOTS & (INDEX_SLOTS - 1)) == 0, "index size must be a power of two");
+
+        // slots of 3 + words atomics: seq (2n+2 once frame n is complete),
+        // timestamp, len, payload words. Never resized, a wider or longer
+        // ring replaces it and starts at the frame number it took over at.
+        struct HistoryRing{
+            HistoryRing(std::size_t capacity, std::size_t words, uint64_t base);
+
+            std::size_t capacity;
+            std::size_t words;
+            uint64_t base;
+            std::unique_ptr<std::atomic<uint64_t>[]> cells;
+
+            std::atomic<uint64_t>* slot(uint64_t n) const {
+                return &cells[(n & (capacity - 1)) * (3 + words)];
+            }
+            std::size_t bytes() const { return capacity * (3 + words) * sizeof(uint64_t); }
+        };
+
+        // the payload is kept in atomic words so torn reads are only ever
+        // stale, never a data race
         struct Entry{
-            CanFrame frame;
-            bool valid = false;
-            mutable std::mutex mtx;
+            IdType id = 0;
+            std::atomic<uint32_t> seq{0};
+            std::atomic<uint64_t> timestamp_ns{0};
+            std::atomic<uint64_t> data{0};
+            std::atomic<std::atomic<uint64_t>*> fd_data{nullptr};
+            std::atomic<uint8_t> len{0};
+
+            std::atomic<uint64_t> frames{0};
+            std::atomic<HistoryRing*> history{nullptr};
+            std::atomic<uint32_t> history_capacity{0};
+
+            IdCounters counters;
+
+            ~Entry(){
+                delete[] fd_data.load();
+                delete history.load();
+            }
+        };
+
+        struct Slot{
+            std::atomic<uint32_t> key{EMPTY_KEY};
+            uint32_t index = 0;
         };
 
-        std::array<Entry, MAX_IDS> _entries{};
+        static std::size_t slot_of(IdType id){
+            return ((static_cast<uint32_t>(id) * 0x9E3779B1u) >> 17) & (INDEX_SLOTS - 1);
+        }
+        int find(IdType id) const;
+        int insert(IdType id);
+        HistoryRing* ring_for(Entry& e, std::size_t words);
+        void reclaim_history();
+
+        std::unique_ptr<Slot[]> _index;
+        std::unique_ptr<Entry[]> _entries;
+        std::atomic<std::size_t> _count{0};
+        std::atomic<uint64_t> _dropped{0};
+        std::mutex _insert_mtx;
+
+        // replaced rings stay alive for readers still walking them; the
+        // writer frees them once no history() call is in progress
+        std::atomic<std::size_t> _history_bytes{0};
+        mutable std::atomic<uint32_t> _history_readers{0};
+        std::atomic<bool> _have_retired{false};
+        std::mutex _retired_mtx;
+        std::vector<std::unique_ptr<HistoryRing>> _retired;
 };
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// On-disk session log, written by CanLogWriter (canlog_writer.hpp) for the
+// live SessionRecorder and the text log importers.
+//
+// A session is a directory of segments seg-NNNNN.canlog, each at most
+// CANLOG_SEGMENT_BYTES, and for every closed segment a seg-NNNNN.canidx.
+// Integers are little endian.
+//
+// Segment: a CANLOG_ALIGN byte header (CanLogHeader, zero filled), then
+// records, each starting on an 8-byte boundary:
+//
+//   0   u64  timestamp_ns   host monotonic (clock.hpp); 0 means padding,
+//                           skip to the next CANLOG_ALIGN boundary
+//   8   u32  id             CAN_ID_EXT_FLAG / CAN_ID_RTR_FLAG as in candb.hpp
+//   12  u8   bus            index into the bus table of the .canidx
+//   13  u8   len            payload bytes
+//   14  u8   flags          CANLOG_FLAG_*
+//   15  u8   reserved
+//   16  ...  payload, zero padded to a multiple of 8
+//
+// which is 24 bytes for a classic 8-byte frame. Everything after the header
+// is written in CANLOG_ALIGN multiples, so records never need to be found
+// by scanning from the start: any index offset is a record boundary.
+//
+// Index (.canidx): CanIndexHeader, then time_entries CanIndexTime, the first
+// record at or after every CANLOG_INDEX_STRIDE bytes of the segment, then
+// id_entries of CanIndexId each followed by its u32 stride numbers (the
+// strides the id appears in), then bus_count entries of u8 bus, u8 name
+// length, name. A segment without an index (the recorder died) is still
+// readable front to back.
+
+constexpr char CANLOG_MAGIC[8] = {'C', 'A', 'N', 'L', 'O', 'G', '1', '\0'};
+constexpr char CANIDX_MAGIC[8] = {'C', 'A', 'N', 'I', 'D', 'X', '1', '\0'};
+constexpr uint32_t CANLOG_VERSION = 1;
+
+constexpr size_t CANLOG_ALIGN = 4096;
+constexpr size_t CANLOG_SEGMENT_BYTES = 64u << 20;
+constexpr size_t CANLOG_INDEX_STRIDE = 64u << 10;
+constexpr size_t CANLOG_RECORD_HEADER = 16;
+
+constexpr uint8_t CANLOG_FLAG_FD  = 0x1;
+constexpr uint8_t CANLOG_FLAG_BRS = 0x2;
+
+struct CanLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t segment;
+    uint64_t realtime_ns;   // wall clock when the segment was opened
+    uint64_t monotonic_ns;  // host monotonic at the same instant
+};
+
+struct CanLogRecord {
+    uint64_t timestamp_ns;
+    uint32_t id;
+    uint8_t bus;
+    uint8_t len;
+    uint8_t flags;
+    uint8_t reserved;
+};
+
+struct CanIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t segment;
+    uint64_t data_end;      // segment bytes in use, header included
+    uint64_t first_ns;
+    uint64_t last_ns;
+    uint64_t records;
+    uint32_t time_entries;
+    uint32_t id_entries;
+    uint32_t bus_count;
+    uint32_t reserved;
+};
+
+struct CanIndexTime {
+    uint64_t timestamp_ns;
+    uint64_t offset;
+};
+
+struct CanIndexId {
+    uint32_t id;
+    uint32_t strides;
+};
+
+static_assert(sizeof(CanLogRecord) == CANLOG_RECORD_HEADER, "record header layout");
+static_assert(sizeof(CanLogHeader) <= CANLOG_ALIGN, "segment header must fit its block");
+
+// bytes a record with len payload bytes takes
+inline size_t canlog_record_size(uint8_t len){
+    return CANLOG_RECORD_HEADER + ((static_cast<size_t>(len) + 7) & ~static_cast<size_t>(7));
+}
+
+// n rounded up to a whole number of CANLOG_ALIGN blocks
+inline size_t canlog_align_up(size_t n){
+    return (n + CANLOG_ALIGN - 1) & ~(CANLOG_ALIGN - 1);
+}
+
+// lays out one record at dst, which has room for canlog_record_size(len);
+// returns that size. A zero stamp would read as padding and becomes 1.
+inline size_t canlog_put_record(uint8_t* dst, uint64_t timestamp_ns, uint32_t id, uint8_t bus,
+                                uint8_t len, uint8_t flags, const uint8_t* payload){
+    CanLogRecord rec{};
+    rec.timestamp_ns = timestamp_ns ? timestamp_ns : 1;
+    rec.id = id;
+    rec.bus = bus;
+    rec.len = len;
+    rec.flags = flags;
+    const size_t size = canlog_record_size(len);
+    std::memcpy(dst, &rec, sizeof(rec));
+    if(len && payload)
+        std::memcpy(dst + CANLOG_RECORD_HEADER, payload, len);
+    std::memset(dst + CANLOG_RECORD_HEADER + len, 0, size - CANLOG_RECORD_HEADER - len);
+    return size;
+}
+
+// dir/seg-NNNNN.canlog or .canidx
+inline std::string canlog_segment_path(const std::string& dir, uint32_t segment, const char* ext){
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg-%05u.%s", segment, ext);
+    return dir + "/" + name;
+}
@@ -0,0 +1,242 @@
+#include "canlog_reader.hpp"
+#include "candb.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CanLogReader::CanLogReader(const std::string& dir) : _dir(dir) {
+    for(uint32_t n = 0;; ++n){
+        const std::string path = canlog_segment_path(dir, n, "canlog");
+        std::ifstream probe(path, std::ios::binary);
+        if(!probe)
+            break;
+        probe.close();
+
+        _segments.emplace_back();
+        Segment &seg = _segments.back();
+        map_segment(seg, path);
+
+        CanLogHeader h{};
+        if(seg.size < CANLOG_ALIGN)
+            throw std::runtime_error(path + " is truncated");
+        std::memcpy(&h, seg.data, sizeof(h));
+        if(std::memcmp(h.magic, CANLOG_MAGIC, sizeof(h.magic)) != 0 || h.version != CANLOG_VERSION)
+            throw std::runtime_error(path + " is not a session log");
+
+        if(!load_index(seg, n))
+            scan_index(seg);
+    }
+    if(_segments.empty())
+        throw std::runtime_error("no session log in " + dir);
+}
+
+CanLogReader::~CanLogReader(){
+#ifndef _WIN32
+    for(auto &seg : _segments)
+        if(seg.data)
+            munmap(const_cast<uint8_t*>(seg.data), seg.size);
+#endif
+}
+
+void CanLogReader::map_segment(Segment& seg, const std::string& path){
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw std::system_error(errno, std::system_category(), "cannot open " + path);
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0){
+        ::close(fd);
+        throw std::runtime_error(path + " is empty");
+    }
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if(p == MAP_FAILED)
+        throw std::system_error(err, std::system_category(), "cannot map " + path);
+    madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    seg.data = static_cast<const uint8_t*>(p);
+    seg.size = static_cast<size_t>(st.st_size);
+#else
+    std::ifstream in(path, std::ios::binary);
+    seg.copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    seg.data = seg.copy.data();
+    seg.size = seg.copy.size();
+#endif
+    seg.data_end = seg.size;
+}
+
+bool CanLogReader::load_index(Segment& seg, uint32_t number){
+    std::ifstream in(canlog_segment_path(_dir, number, "canidx"), std::ios::binary);
+    if(!in)
+        return false;
+    CanIndexHeader h{};
+    in.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if(!in || std::memcmp(h.magic, CANIDX_MAGIC, sizeof(h.magic)) != 0 ||
+       h.version != CANLOG_VERSION || h.data_end > seg.size)
+        return false;
+
+    std::vector<CanIndexTime> times(h.time_entries);
+    in.read(reinterpret_cast<char*>(times.data()), times.size() * sizeof(CanIndexTime));
+    if(!in)
+        return false;
+    // id lists are for filtering tools, replay has no use for them
+    for(uint32_t i = 0; i < h.id_entries; ++i){
+        CanIndexId id{};
+        in.read(reinterpret_cast<char*>(&id), sizeof(id));
+        in.seekg(static_cast<std::streamoff>(id.strides) * sizeof(uint32_t), std::ios::cur);
+    }
+    std::vector<std::string> buses;
+    for(uint32_t i = 0; i < h.bus_count && in; ++i){
+        uint8_t bus = 0, n = 0;
+        in.read(reinterpret_cast<char*>(&bus), 1);
+        in.read(reinterpret_cast<char*>(&n), 1);
+        std::string name(n, '\0');
+        in.read(&name[0], n);
+        if(buses.size() <= bus)
+            buses.resize(bus + 1u);
+        buses[bus] = name;
+    }
+    if(!in)
+        return false;
+
+    seg.times.swap(times);
+    seg.data_end = h.data_end;
+    seg.first_ns = h.first_ns;
+    seg.last_ns = h.last_ns;
+    seg.records = h.records;
+    // buses only ever get added, the latest table is the fullest
+    if(buses.size() >= _bus_names.size())
+        _bus_names.swap(buses);
+    return true;
+}
+
+void CanLogReader::scan_index(Segment& seg){
+    seg.times.clear();
+    seg.first_ns = seg.last_ns = 0;
+    seg.records = 0;
+    uint64_t next_stride = 0;
+    uint64_t off = CANLOG_ALIGN;
+    while(off + CANLOG_RECORD_HEADER <= seg.data_end){
+        CanLogRecord rec;
+        std::memcpy(&rec, seg.data + off, sizeof(rec));
+        if(rec.timestamp_ns == 0){
+            off = (off / CANLOG_ALIGN + 1) * CANLOG_ALIGN;
+            continue;
+        }
+        if(rec.len > CAN_FD_MAX_LEN || off + canlog_record_size(rec.len) > seg.data_end)
+            break; // torn write at the end
+        if(off >= next_stride){
+            seg.times.push_back(CanIndexTime{rec.timestamp_ns, off});
+            next_stride = (off / CANLOG_INDEX_STRIDE + 1) * CANLOG_INDEX_STRIDE;
+        }
+        if(!seg.first_ns)
+            seg.first_ns = rec.timestamp_ns;
+        seg.last_ns = std::max(seg.last_ns, rec.timestamp_ns);
+        ++seg.records;
+        off += canlog_record_size(rec.len);
+    }
+    seg.data_end = off;
+}
+
+uint64_t CanLogReader::first_ns() const{
+    for(const auto &seg : _segments)
+        if(seg.records)
+            return seg.first_ns;
+    return 0;
+}
+
+uint64_t CanLogReader::last_ns() const{
+    uint64_t last = 0;
+    for(const auto &seg : _segments)
+        last = std::max(last, seg.last_ns);
+    return last;
+}
+
+uint64_t CanLogReader::records() const{
+    uint64_t n = 0;
+    for(const auto &seg : _segments)
+        n += seg.records;
+    return n;
+}
+
+CanLogReader::Cursor CanLogReader::end() const{
+    return Cursor{static_cast<uint32_t>(_segments.size()), CANLOG_ALIGN};
+}
+
+bool CanLogReader::at_end(const Cursor& c) const{
+    Cursor probe = c;
+    return !settle(probe);
+}
+
+bool CanLogReader::settle(Cursor& c) const{
+    if(c.offset < CANLOG_ALIGN)
+        c.offset = CANLOG_ALIGN;
+    while(c.segment < _segments.size()){
+        const Segment &seg = _segments[c.segment];
+        while(c.offset + CANLOG_RECORD_HEADER <= seg.data_end){
+            uint64_t ts;
+            std::memcpy(&ts, seg.data + c.offset, sizeof(ts));
+            if(ts)
+                return true;
+            c.offset = (c.offset / CANLOG_ALIGN + 1) * CANLOG_ALIGN;
+        }
+        ++c.segment;
+        c.offset = CANLOG_ALIGN;
+    }
+    return false;
+}
+
+bool CanLogReader::next(Cursor& c, CanLogRecord& rec, const uint8_t*& payload) const{
+    if(!settle(c))
+        return false;
+    const Segment &seg = _segments[c.segment];
+    std::memcpy(&rec, seg.data + c.offset, sizeof(rec));
+    const uint64_t size = canlog_record_size(rec.len);
+    if(rec.len > CAN_FD_MAX_LEN || c.offset + size > seg.data_end){
+        // torn or foreign record, nothing valid follows it in this segment
+        ++c.segment;
+        c.offset = CANLOG_ALIGN;
+        return next(c, rec, payload);
+    }
+    payload = seg.data + c.offset + CANLOG_RECORD_HEADER;
+    c.offset += size;
+    return true;
+}
+
+CanLogReader::Cursor CanLogReader::seek(uint64_t timestamp_ns) const{
+    // last segment starting at or before the target
+    size_t s = 0;
+    for(size_t lo = 0, hi = _segments.size(); lo < hi;){
+        size_t mid = (lo + hi) / 2;
+        if(_segments[mid].records && _segments[mid].first_ns <= timestamp_ns){
+            s = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    Cursor c{static_cast<uint32_t>(s), CANLOG_ALIGN};
+    const auto &times = _segments[s].times;
+    auto it = std::upper_bound(times.begin(), times.end(), timestamp_ns,
+                               [](uint64_t t, const CanIndexTime& e){ return t < e.timestamp_ns; });
+    if(it != times.begin())
+        c.offset = std::prev(it)->offset;
+
+    CanLogRecord rec;
+    const uint8_t* payload;
+    for(Cursor probe = c; next(probe, rec, payload); c = probe)
+        if(rec.timestamp_ns >= timestamp_ns)
+            return c;
+    return end();
+}
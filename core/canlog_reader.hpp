@@ -0,0 +1,63 @@
+#pragma once
+
+#include "framelog.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read side of a session log (canlog.hpp). Segments are mapped read only and
+// the .canidx time entries are kept in memory, so seek() is a binary search
+// over segments, another over the segment's time entries and a scan of at
+// most one CANLOG_INDEX_STRIDE. A segment without its index (the recorder
+// never closed it) is scanned once on open to build the same entries.
+//
+// Cursors are a segment number and a byte offset into it; an offset inside
+// the segment header means its first record.
+class CanLogReader : public FrameLog {
+    public:
+        // throws std::runtime_error / std::system_error
+        explicit CanLogReader(const std::string& dir);
+        ~CanLogReader();
+
+        CanLogReader(const CanLogReader&) = delete;
+        CanLogReader& operator=(const CanLogReader&) = delete;
+
+        const std::string& path() const override { return _dir; }
+        size_t segments() const { return _segments.size(); }
+        uint64_t first_ns() const override;
+        uint64_t last_ns() const override;
+        uint64_t records() const override;
+        const std::vector<std::string>& bus_names() const override { return _bus_names; }
+
+        Cursor begin() const override { return Cursor{0, CANLOG_ALIGN}; }
+        Cursor seek(uint64_t timestamp_ns) const override;
+        Cursor end() const override;
+        bool at_end(const Cursor& c) const;
+
+        bool next(Cursor& c, CanLogRecord& rec, const uint8_t*& payload) const override;
+
+    private:
+        struct Segment {
+            const uint8_t* data = nullptr;
+            size_t size = 0;           // mapped bytes
+            uint64_t data_end = 0;     // last byte worth reading
+            uint64_t first_ns = 0;
+            uint64_t last_ns = 0;
+            uint64_t records = 0;
+            std::vector<CanIndexTime> times;
+#ifdef _WIN32
+            std::vector<uint8_t> copy;
+#endif
+        };
+
+        void map_segment(Segment& seg, const std::string& path);
+        bool load_index(Segment& seg, uint32_t number);
+        void scan_index(Segment& seg);
+        // skips padding; false once c is past the segment's data
+        bool settle(Cursor& c) const;
+
+        std::string _dir;
+        std::vector<Segment> _segments;
+        std::vector<std::string> _bus_names;
+};
@@ -0,0 +1,257 @@
+#include "canlog_writer.hpp"
+#include "candb.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <system_error>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void CanLogWriter::AlignedFree::operator()(uint8_t* p) const{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+CanLogWriter::Block CanLogWriter::aligned_block(size_t bytes){
+    void* p = nullptr;
+#ifdef _WIN32
+    p = _aligned_malloc(bytes, CANLOG_ALIGN);
+#else
+    if(posix_memalign(&p, CANLOG_ALIGN, bytes) != 0)
+        p = nullptr;
+#endif
+    if(!p)
+        throw std::bad_alloc();
+    return Block(static_cast<uint8_t*>(p));
+}
+
+void canlog_make_dirs(const std::string& path){
+    for(size_t pos = 0; pos != std::string::npos;){
+        pos = path.find('/', pos + 1);
+        std::string part = path.substr(0, pos);
+        if(part.empty())
+            continue;
+#ifdef _WIN32
+        int rc = _mkdir(part.c_str());
+#else
+        int rc = mkdir(part.c_str(), 0755);
+#endif
+        if(rc != 0 && errno != EEXIST)
+            throw std::system_error(errno, std::system_category(), "cannot create " + part);
+    }
+}
+
+CanLogWriter::CanLogWriter(const std::string& dir) : _dir(dir) {
+    canlog_make_dirs(dir);
+}
+
+CanLogWriter::~CanLogWriter(){
+    try{
+        close();
+    } catch(const std::exception& e){
+        std::cout << "[!] Session log " << _dir << " not closed cleanly: " << e.what() << std::endl;
+    }
+}
+
+void CanLogWriter::set_bus_name(uint8_t bus, const std::string& name){
+    std::lock_guard<std::mutex> lock(_bus_mtx);
+    if(_bus_names.size() <= bus)
+        _bus_names.resize(bus + 1u);
+    _bus_names[bus] = name;
+}
+
+void CanLogWriter::append(uint8_t bus, uint32_t id, uint8_t len, const uint8_t* payload,
+                          uint64_t timestamp_ns, uint8_t flags){
+    if(len > CAN_FD_MAX_LEN)
+        len = CAN_FD_MAX_LEN;
+    if(!_append)
+        _append = aligned_block(APPEND_BYTES);
+    if(_append_fill + canlog_record_size(len) > APPEND_BYTES)
+        flush_append();
+    _append_fill += canlog_put_record(_append.get() + _append_fill, timestamp_ns, id, bus, len, flags, payload);
+}
+
+void CanLogWriter::flush_append(){
+    if(!_append_fill)
+        return;
+    const size_t len = canlog_align_up(_append_fill);
+    std::memset(_append.get() + _append_fill, 0, len - _append_fill);
+    _append_fill = 0;
+    write_block(_append.get(), len);
+}
+
+void CanLogWriter::close(){
+    flush_append();
+    close_segment();
+}
+
+void CanLogWriter::open_segment(){
+    const std::string path = canlog_segment_path(_dir, _segment, "canlog");
+
+    Block header = aligned_block(CANLOG_ALIGN);
+    std::memset(header.get(), 0, CANLOG_ALIGN);
+    CanLogHeader h{};
+    std::memcpy(h.magic, CANLOG_MAGIC, sizeof(h.magic));
+    h.version = CANLOG_VERSION;
+    h.segment = _segment;
+    h.monotonic_ns = monotonic_ns();
+    h.realtime_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    std::memcpy(header.get(), &h, sizeof(h));
+
+#ifdef _WIN32
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if(!f)
+        throw std::system_error(errno, std::system_category(), "cannot open " + path);
+    _file = f;
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+    // straight from our buffers to the disk, the page cache gains nothing
+    // from data we never read back
+    _fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    if(_fd < 0 && errno == EINVAL)
+#endif
+        _fd = ::open(path.c_str(), flags, 0644);
+    if(_fd < 0)
+        throw std::system_error(errno, std::system_category(), "cannot open " + path);
+#endif
+
+    _offset = 0;
+    _first_ns = _last_ns = 0;
+    _records = 0;
+    _next_stride = 0;
+    _time_index.clear();
+    _id_index.clear();
+    write_all(header.get(), CANLOG_ALIGN);
+}
+
+void CanLogWriter::write_block(const uint8_t* data, size_t len){
+    if(_fd < 0 && !_file)
+        open_segment();
+    else if(_offset + len > CANLOG_SEGMENT_BYTES){
+        close_segment();
+        open_segment();
+    }
+    index_records(data, len, _offset);
+    write_all(data, len);
+}
+
+void CanLogWriter::write_all(const uint8_t* data, size_t len){
+#ifdef _WIN32
+    FILE* f = static_cast<FILE*>(_file);
+    if(std::fwrite(data, 1, len, f) != len)
+        throw std::system_error(errno, std::system_category(), "write failed");
+#else
+    size_t done = 0;
+    while(done < len){
+        ssize_t n = ::write(_fd, data + done, len - done);
+        if(n < 0){
+            if(errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::system_category(), "write failed");
+        }
+        done += static_cast<size_t>(n);
+    }
+#endif
+    _offset += len;
+    _bytes_written += len;
+}
+
+// walks the records of a block about to land at base, which is always on
+// a record boundary
+void CanLogWriter::index_records(const uint8_t* data, size_t len, uint64_t base){
+    size_t off = 0;
+    while(off + CANLOG_RECORD_HEADER <= len){
+        CanLogRecord rec;
+        std::memcpy(&rec, data + off, sizeof(rec));
+        if(rec.timestamp_ns == 0){
+            off = (off / CANLOG_ALIGN + 1) * CANLOG_ALIGN;
+            continue;
+        }
+        const uint64_t at = base + off;
+        if(at >= _next_stride){
+            _time_index.push_back(CanIndexTime{rec.timestamp_ns, at});
+            _next_stride = (at / CANLOG_INDEX_STRIDE + 1) * CANLOG_INDEX_STRIDE;
+        }
+        const uint32_t stride = static_cast<uint32_t>(at / CANLOG_INDEX_STRIDE);
+        auto &strides = _id_index[rec.id];
+        if(strides.empty() || strides.back() != stride)
+            strides.push_back(stride);
+        if(!_first_ns)
+            _first_ns = rec.timestamp_ns;
+        _last_ns = std::max(_last_ns, rec.timestamp_ns);
+        ++_records;
+        off += canlog_record_size(rec.len);
+    }
+}
+
+void CanLogWriter::close_segment(){
+#ifdef _WIN32
+    if(!_file)
+        return;
+    std::fclose(static_cast<FILE*>(_file));
+    _file = nullptr;
+#else
+    if(_fd < 0)
+        return;
+    fdatasync(_fd);
+    ::close(_fd);
+    _fd = -1;
+#endif
+
+    const std::string path = canlog_segment_path(_dir, _segment, "canidx");
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if(out){
+        std::vector<std::string> buses;
+        {
+            std::lock_guard<std::mutex> lock(_bus_mtx);
+            buses = _bus_names;
+        }
+        CanIndexHeader h{};
+        std::memcpy(h.magic, CANIDX_MAGIC, sizeof(h.magic));
+        h.version = CANLOG_VERSION;
+        h.segment = _segment;
+        h.data_end = _offset;
+        h.first_ns = _first_ns;
+        h.last_ns = _last_ns;
+        h.records = _records;
+        h.time_entries = static_cast<uint32_t>(_time_index.size());
+        h.id_entries = static_cast<uint32_t>(_id_index.size());
+        h.bus_count = static_cast<uint32_t>(buses.size());
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(_time_index.data()), _time_index.size() * sizeof(CanIndexTime));
+        for(const auto &e : _id_index){
+            CanIndexId id{e.first, static_cast<uint32_t>(e.second.size())};
+            out.write(reinterpret_cast<const char*>(&id), sizeof(id));
+            out.write(reinterpret_cast<const char*>(e.second.data()), e.second.size() * sizeof(uint32_t));
+        }
+        for(size_t i = 0; i < buses.size(); ++i){
+            uint8_t bus = static_cast<uint8_t>(i);
+            uint8_t n = static_cast<uint8_t>(std::min<size_t>(buses[i].size(), 255));
+            out.write(reinterpret_cast<const char*>(&bus), 1);
+            out.write(reinterpret_cast<const char*>(&n), 1);
+            out.write(buses[i].data(), n);
+        }
+    }
+    if(!out)
+        std::cout << "[!] Could not write index " << path << std::endl;
+    ++_segment;
+}
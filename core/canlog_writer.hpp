@@ -0,0 +1,80 @@
+#pragma once
+
+#include "canlog.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// mkdir -p, throws std::system_error
+void canlog_make_dirs(const std::string& path);
+
+// Writes one session directory (canlog.hpp): rolls segments at
+// CANLOG_SEGMENT_BYTES and writes each closed segment's index. Segment
+// files are opened with O_DIRECT where the filesystem allows it, so blocks
+// must come from aligned_block() or be CANLOG_ALIGN aligned otherwise.
+//
+// Owned by one thread; only set_bus_name may be called from others.
+class CanLogWriter {
+    public:
+        static constexpr size_t APPEND_BYTES = 1u << 20;
+
+        struct AlignedFree {
+            void operator()(uint8_t* p) const;
+        };
+        using Block = std::unique_ptr<uint8_t[], AlignedFree>;
+        // CANLOG_ALIGN aligned, throws std::bad_alloc
+        static Block aligned_block(size_t bytes);
+
+        // creates dir and its parents, throws std::system_error
+        explicit CanLogWriter(const std::string& dir);
+        ~CanLogWriter();
+
+        CanLogWriter(const CanLogWriter&) = delete;
+        CanLogWriter& operator=(const CanLogWriter&) = delete;
+
+        const std::string& directory() const { return _dir; }
+        void set_bus_name(uint8_t bus, const std::string& name);
+
+        // records laid out as in canlog.hpp, a multiple of CANLOG_ALIGN
+        // long; zeros after the last record are padding
+        void write_block(const uint8_t* data, size_t len);
+        // one record into an internal block, written out as it fills
+        void append(uint8_t bus, uint32_t id, uint8_t len, const uint8_t* payload,
+                    uint64_t timestamp_ns, uint8_t flags = 0);
+        // writes what append() holds and closes the segment with its index;
+        // throws std::system_error like the writes
+        void close();
+
+        uint64_t bytes_written() const { return _bytes_written; }
+
+    private:
+        void open_segment();
+        void close_segment();
+        void write_all(const uint8_t* data, size_t len);
+        void index_records(const uint8_t* data, size_t len, uint64_t base);
+        void flush_append();
+
+        std::string _dir;
+        int _fd = -1;
+        void* _file = nullptr; // FILE* where there is no POSIX I/O
+        uint32_t _segment = 0;
+        uint64_t _offset = 0;
+        uint64_t _bytes_written = 0;
+
+        // index of the open segment
+        uint64_t _first_ns = 0;
+        uint64_t _last_ns = 0;
+        uint64_t _records = 0;
+        uint64_t _next_stride = 0;
+        std::vector<CanIndexTime> _time_index;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> _id_index;
+
+        Block _append;
+        size_t _append_fill = 0;
+
+        std::mutex _bus_mtx;
+        std::vector<std::string> _bus_names;
+};
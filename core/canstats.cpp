@@ -0,0 +1,97 @@
+#include "canstats.hpp"
+#include "candb.hpp"
+
+uint32_t can_frame_bits(uint32_t id, uint8_t len){
+    const bool ext = (id & CAN_ID_EXT_FLAG) != 0;
+    const uint32_t data = 8u * len;
+    if(len <= CAN_CLASSIC_MAX_LEN){
+        // SOF .. CRC is the stuffed region, then CRC delimiter, ACK, EOF, IFS
+        const uint32_t g = ext ? 54 : 34;
+        return g + data + 13 + (g + data - 1) / 4;
+    }
+    // FD: stuffed header and data, then the CRC with its stuff count and
+    // fixed stuff bits, then the same trailer
+    const uint32_t header = ext ? 41 : 22;
+    const uint32_t crc = len <= 16 ? 17 : 21;
+    return header + data + (header + data - 1) / 4 + 4 + crc + (crc + 4) / 4 + 1 + 13;
+}
+
+void IdCounters::update(uint8_t len, uint64_t timestamp_ns){
+    const uint8_t expected = expected_len.load(std::memory_order_relaxed);
+    if(expected && len != expected)
+        dlc_mismatches.store(dlc_mismatches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    const uint64_t last = last_ns.load(std::memory_order_relaxed);
+    last_ns.store(timestamp_ns, std::memory_order_relaxed);
+    // first frame, or two sources disagreeing on order
+    if(!last || timestamp_ns <= last)
+        return;
+    const int64_t dt = static_cast<int64_t>(timestamp_ns - last);
+    interval_ns.store(static_cast<uint64_t>(dt), std::memory_order_relaxed);
+
+    int64_t mean = static_cast<int64_t>(mean_interval_ns.load(std::memory_order_relaxed));
+    if(!mean){
+        mean_interval_ns.store(static_cast<uint64_t>(dt), std::memory_order_relaxed);
+        return;
+    }
+    const int64_t dev = dt > mean ? dt - mean : mean - dt;
+    mean += (dt - mean) / 16;
+    mean_interval_ns.store(static_cast<uint64_t>(mean), std::memory_order_relaxed);
+    int64_t jitter = static_cast<int64_t>(jitter_ns.load(std::memory_order_relaxed));
+    jitter += (dev - jitter) / 16;
+    jitter_ns.store(static_cast<uint64_t>(jitter), std::memory_order_relaxed);
+}
+
+void IdCounters::copy_to(IdStats& out) const{
+    out.last_ns = last_ns.load(std::memory_order_relaxed);
+    out.interval_ns = interval_ns.load(std::memory_order_relaxed);
+    out.mean_interval_ns = mean_interval_ns.load(std::memory_order_relaxed);
+    out.jitter_ns = jitter_ns.load(std::memory_order_relaxed);
+    out.dlc_mismatches = dlc_mismatches.load(std::memory_order_relaxed);
+    out.expected_len = expected_len.load(std::memory_order_relaxed);
+}
+
+void BusStats::update(uint32_t id, uint8_t len, uint64_t timestamp_ns){
+    const uint32_t bits = can_frame_bits(id, len);
+    _frames.store(_frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    _bits.store(_bits.load(std::memory_order_relaxed) + bits, std::memory_order_relaxed);
+    _last_ns.store(timestamp_ns, std::memory_order_relaxed);
+
+    if(!_window_start)
+        _window_start = timestamp_ns;
+    if(timestamp_ns >= _window_start + LOAD_WINDOW_NS){
+        _done_len_ns.store(timestamp_ns - _window_start, std::memory_order_relaxed);
+        _done_bits.store(_window_bits, std::memory_order_relaxed);
+        _done_frames.store(_window_frames, std::memory_order_relaxed);
+        _done_end_ns.store(timestamp_ns, std::memory_order_relaxed);
+        _window_start = timestamp_ns;
+        _window_bits = 0;
+        _window_frames = 0;
+    }
+    _window_bits += bits;
+    ++_window_frames;
+}
+
+// a window only tells the truth until the next one should have completed
+bool BusStats::window_current(uint64_t now_ns) const{
+    const uint64_t end = _done_end_ns.load(std::memory_order_relaxed);
+    return end && now_ns < end + 2 * LOAD_WINDOW_NS;
+}
+
+double BusStats::rate_hz(uint64_t now_ns) const{
+    if(!window_current(now_ns))
+        return 0.0;
+    const uint64_t len = _done_len_ns.load(std::memory_order_relaxed);
+    return len ? static_cast<double>(_done_frames.load(std::memory_order_relaxed)) * 1e9 / static_cast<double>(len) : 0.0;
+}
+
+double BusStats::load(uint64_t now_ns) const{
+    const uint32_t rate = bitrate();
+    if(!rate || !window_current(now_ns))
+        return 0.0;
+    const uint64_t len = _done_len_ns.load(std::memory_order_relaxed);
+    if(!len)
+        return 0.0;
+    const double seconds = static_cast<double>(len) * 1e-9;
+    return static_cast<double>(_done_bits.load(std::memory_order_relaxed)) / (seconds * rate);
+}
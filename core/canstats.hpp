@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Traffic health counters, updated at ingest and read by the GUI.
+//
+// Every counter has a single writer (the store for per-id stats, the owning
+// source's thread for a bus), so updates are plain relaxed loads and stores,
+// no read-modify-write and no fences on the parse path. Readers may see a
+// mix of two updates, which is fine for display.
+
+// nominal bit rate assumed for a bus until it is told otherwise
+constexpr uint32_t CAN_DEFAULT_BITRATE = 500000;
+
+// Bits on the wire for one frame, including the worst case number of stuff
+// bits (Davis et al., every 4 bits of the stuffed region can add one). FD
+// frames are counted at the nominal rate, without bit rate switching, so the
+// load estimate errs on the high side.
+uint32_t can_frame_bits(uint32_t id, uint8_t len);
+
+// plain copy of an id's counters
+struct IdStats {
+    uint64_t frames = 0;
+    uint64_t last_ns = 0;           // monotonic time of the newest frame
+    uint64_t interval_ns = 0;       // between the last two frames
+    uint64_t mean_interval_ns = 0;  // EWMA, 1/16 weight
+    uint64_t jitter_ns = 0;         // EWMA of |interval - mean|
+    uint32_t dlc_mismatches = 0;
+    uint8_t expected_len = 0;       // from the DBC, 0 if unknown
+
+    double rate_hz() const { return interval_ns ? 1e9 / static_cast<double>(interval_ns) : 0.0; }
+    double mean_rate_hz() const { return mean_interval_ns ? 1e9 / static_cast<double>(mean_interval_ns) : 0.0; }
+};
+
+// per-id counters, kept inside each CanStore entry so the store touches no
+// cache line it wasn't already writing
+struct IdCounters {
+    std::atomic<uint64_t> last_ns{0};
+    std::atomic<uint64_t> interval_ns{0};
+    std::atomic<uint64_t> mean_interval_ns{0};
+    std::atomic<uint64_t> jitter_ns{0};
+    std::atomic<uint32_t> dlc_mismatches{0};
+    std::atomic<uint8_t> expected_len{0};
+
+    // writer only, called for every stored frame
+    void update(uint8_t len, uint64_t timestamp_ns);
+    void copy_to(IdStats& out) const;
+};
+
+// Totals for one bus, i.e. one source. Load is the share of the bit rate
+// used over the last complete LOAD_WINDOW.
+class BusStats {
+    public:
+        static constexpr uint64_t LOAD_WINDOW_NS = 1000000000ull;
+
+        explicit BusStats(std::string name, uint32_t bitrate = CAN_DEFAULT_BITRATE)
+            : _name(std::move(name)), _bitrate(bitrate) {}
+
+        // writer only, from the source's frame handler
+        void update(uint32_t id, uint8_t len, uint64_t timestamp_ns);
+
+        const std::string& name() const { return _name; }
+        uint32_t bitrate() const { return _bitrate.load(std::memory_order_relaxed); }
+        void set_bitrate(uint32_t bitrate) { _bitrate.store(bitrate, std::memory_order_relaxed); }
+
+        uint64_t frames() const { return _frames.load(std::memory_order_relaxed); }
+        uint64_t bits() const { return _bits.load(std::memory_order_relaxed); }
+        uint64_t last_ns() const { return _last_ns.load(std::memory_order_relaxed); }
+        // frames per second over the last window
+        double rate_hz(uint64_t now_ns) const;
+        // 0..1 (more if the bit rate is set too low), 0 once the bus went quiet
+        double load(uint64_t now_ns) const;
+
+    private:
+        bool window_current(uint64_t now_ns) const;
+
+        std::string _name;
+        std::atomic<uint32_t> _bitrate;
+
+        std::atomic<uint64_t> _frames{0};
+        std::atomic<uint64_t> _bits{0};
+        std::atomic<uint64_t> _last_ns{0};
+
+        // running window, and the last one that completed
+        uint64_t _window_start = 0;
+        uint64_t _window_bits = 0;
+        uint64_t _window_frames = 0;
+        std::atomic<uint64_t> _done_end_ns{0};
+        std::atomic<uint64_t> _done_len_ns{0};
+        std::atomic<uint64_t> _done_bits{0};
+        std::atomic<uint64_t> _done_frames{0};
+};
@@ -0,0 +1,67 @@
+#include "clock.hpp"
+#include <chrono>
+
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+uint64_t monotonic_ns(){
+#if defined(_WIN32)
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+#endif
+}
+
+uint64_t process_start_ns(){
+    static const uint64_t start = monotonic_ns();
+    return start;
+}
+
+// touch it during static init so "start" really is process start
+[[maybe_unused]] static const uint64_t start_anchor = process_start_ns();
+
+double seconds_since_start(uint64_t timestamp_ns){
+    return static_cast<double>(static_cast<int64_t>(timestamp_ns - process_start_ns())) * 1e-9;
+}
+
+uint64_t realtime_to_monotonic(uint64_t realtime_ns){
+#if defined(_WIN32)
+    uint64_t now_real = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t now_real = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+#endif
+    uint64_t now_mono = monotonic_ns();
+    return now_mono - (now_real - realtime_ns);
+}
+
+uint64_t ClockAnchor::map(uint64_t sender_ns, uint64_t host_ns){
+    int64_t diff = static_cast<int64_t>(host_ns - sender_ns);
+    if(!_have || diff < _offset){
+        _offset = diff;
+        _creep_rem = 0;
+        _have = true;
+    } else {
+        // frames come far less than 1 ms apart, so the sub-ns part of each
+        // step is carried over instead of truncated
+        uint64_t elapsed = host_ns > _last_host ? host_ns - _last_host : 0;
+        uint64_t scaled = elapsed * DRIFT_PPM + _creep_rem;
+        int64_t creep = static_cast<int64_t>(scaled / 1000000);
+        _creep_rem = scaled % 1000000;
+        if(diff - _offset < creep){
+            creep = diff - _offset;
+            _creep_rem = 0;
+        }
+        _offset += creep;
+    }
+    _last_host = host_ns;
+    uint64_t mapped = sender_ns + static_cast<uint64_t>(_offset);
+    // never later than the moment we actually had the bytes
+    return mapped > host_ns ? host_ns : mapped;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// Every frame timestamp in the pipeline is host monotonic nanoseconds
+// (CLOCK_MONOTONIC / steady_clock), taken as close to the wire as the source
+// allows. Nothing downstream has to care where a stamp came from.
+uint64_t monotonic_ns();
+
+// monotonic time the process started, plots count seconds from here
+uint64_t process_start_ns();
+double seconds_since_start(uint64_t timestamp_ns);
+
+// a CLOCK_REALTIME stamp (kernel socket timestamps) on the monotonic clock
+uint64_t realtime_to_monotonic(uint64_t realtime_ns);
+
+// Puts a sender's clock (SLCAN Z stamps, telemetry base times) on the host
+// monotonic clock. The smallest host-minus-sender difference seen so far is
+// the best guess of the fixed offset plus minimum link latency; it may creep
+// up by a few hundred ppm of elapsed time so drift between the two clocks
+// doesn't leave it stuck on a stale minimum. Sender spacing between frames
+// is kept, which read times alone lose when frames arrive in bursts.
+class ClockAnchor {
+    public:
+        static constexpr uint64_t DRIFT_PPM = 500;
+
+        uint64_t map(uint64_t sender_ns, uint64_t host_ns);
+        void reset() { _have = false; }
+
+    private:
+        bool _have = false;
+        int64_t _offset = 0;
+        uint64_t _last_host = 0;
+        uint64_t _creep_rem = 0;    // creep owed, in ns * 1e-6
+};
@@ -1,171 +1,615 @@
 #include "dbc.hpp"
+#include "dbc_compiled.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iterator>
 
-static std::string trim(const std::string& in){
-    auto start = in.find_first_not_of(" \t\r\n");
-    auto end = in.find_last_not_of(" \t\r\n");
-    if(start == std::string::npos) return "";
-    return in.substr(start, end - start + 1);
+#ifdef _WIN32
+#include <stdlib.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// blanks and the punctuation that ends a word
+struct Delimiters {
+    bool table[256] = {};
+    constexpr Delimiters(){
+        for(const char* c = " \t\r\n:;,|@()[]\""; *c; ++c)
+            table[static_cast<uint8_t>(*c)] = true;
+    }
+    constexpr bool operator[](uint8_t c) const { return table[c]; }
+};
+constexpr Delimiters DELIMITER{};
+
+// Statement level scanner over a whole DBC. SG_ / BO_ / BU_ end at the end
+// of their line, everything else at its ';', and strings (comments) may
+// span lines, so the text is never split into lines up front.
+class DbcScanner {
+    public:
+        explicit DbcScanner(std::string_view src) : _src(src) {}
+
+        bool done(){
+            skip_space();
+            return _pos >= _src.size();
+        }
+
+        size_t position() const { return _pos; }
+
+        // 1-based line of a position, for messages
+        size_t line(size_t pos) const {
+            return 1 + static_cast<size_t>(std::count(_src.begin(), _src.begin() + pos, '\n'));
+        }
+
+        void skip_space(){
+            while(_pos < _src.size() && is_space(_src[_pos]))
+                ++_pos;
+        }
+
+        // only blanks left on this line
+        bool at_line_end(){
+            while(_pos < _src.size() && (_src[_pos] == ' ' || _src[_pos] == '\t' || _src[_pos] == '\r'))
+                ++_pos;
+            return _pos >= _src.size() || _src[_pos] == '\n';
+        }
+
+        bool eat(char c){
+            skip_space();
+            if(_pos < _src.size() && _src[_pos] == c){
+                ++_pos;
+                return true;
+            }
+            return false;
+        }
+
+        char peek(){
+            skip_space();
+            return _pos < _src.size() ? _src[_pos] : '\0';
+        }
+
+        // identifier or number, up to a blank or punctuation
+        std::string_view word(){
+            skip_space();
+            const size_t start = _pos;
+            while(_pos < _src.size() && !DELIMITER[static_cast<uint8_t>(_src[_pos])])
+                ++_pos;
+            return _src.substr(start, _pos - start);
+        }
+
+        // a single character, blanks not skipped (the @1+ of SG_)
+        char get(){
+            return _pos < _src.size() ? _src[_pos++] : '\0';
+        }
+
+        bool string(std::string& out){
+            if(!eat('"'))
+                return false;
+            out.clear();
+            while(_pos < _src.size()){
+                const size_t end = _src.find_first_of("\"\\", _pos);
+                if(end == std::string_view::npos)
+                    break;
+                out.append(_src.data() + _pos, end - _pos);
+                _pos = end + 1;
+                if(_src[end] == '"')
+                    return true;
+                if(_pos < _src.size())
+                    out += _src[_pos++];
+            }
+            return false; // unterminated
+        }
+
+        template<class T>
+        bool integer(T& out){
+            std::string_view w = word();
+            if(!w.empty() && w[0] == '+')
+                w.remove_prefix(1);
+            const auto r = std::from_chars(w.data(), w.data() + w.size(), out);
+            if(r.ec == std::errc() && r.ptr == w.data() + w.size())
+                return true;
+            // some tools write integers as 1.0
+            double d;
+            const auto rd = std::from_chars(w.data(), w.data() + w.size(), d);
+            if(rd.ec != std::errc() || rd.ptr != w.data() + w.size())
+                return false;
+            out = static_cast<T>(d);
+            return true;
+        }
+
+        bool real(double& out){
+            std::string_view w = word();
+            if(!w.empty() && w[0] == '+')
+                w.remove_prefix(1);
+            const auto r = std::from_chars(w.data(), w.data() + w.size(), out);
+            return r.ec == std::errc() && r.ptr == w.data() + w.size();
+        }
+
+        // attribute value: a string or a number, kept as text
+        bool value(std::string& out){
+            if(peek() == '"')
+                return string(out);
+            std::string_view w = word();
+            out.assign(w.data(), w.size());
+            return !w.empty();
+        }
+
+        // past the next ';' outside a string
+        void skip_statement(){
+            while(_pos < _src.size()){
+                const char c = _src[_pos++];
+                if(c == ';')
+                    return;
+                if(c == '"'){
+                    --_pos;
+                    std::string ignored;
+                    if(!string(ignored))
+                        return;
+                }
+            }
+        }
+
+        void skip_line(){
+            const size_t nl = _src.find('\n', _pos);
+            _pos = nl == std::string_view::npos ? _src.size() : nl + 1;
+        }
+
+        // NS_ : and its indented list of keywords
+        void skip_symbols(){
+            skip_line();
+            while(_pos < _src.size() && (_src[_pos] == ' ' || _src[_pos] == '\t'))
+                skip_line();
+        }
+
+    private:
+        static bool is_space(char c){ return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+        std::string_view _src;
+        size_t _pos = 0;
+};
+
+// statements that are read past to their ';'
+constexpr std::string_view SKIPPED[] = {
+    "EV_", "ENVVAR_DATA_", "SGTYPE_", "SGTYPE_VAL_", "SIG_GROUP_", "SIG_TYPE_REF_", "SIGTYPE_VALTYPE_",
+    "BA_DEF_REL_", "BA_REL_", "BA_DEF_DEF_REL_", "BA_DEF_SGTYPE_", "BA_SGTYPE_", "CAT_DEF_", "CAT_",
+    "FILTER", "EV_DATA_", "BU_SG_REL_", "BU_EV_REL_", "BU_BO_REL_",
+};
+
+std::string to_string(std::string_view v){
+    return std::string(v.data(), v.size());
 }
 
+} // namespace
+
 bool DbcParser::load(const std::string& path){
-    std::ifstream file(path);
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0){
+        if(fd >= 0)
+            ::close(fd);
+        std::cout << "[!] Unable to open DBC " << path << std::endl;
+        return false;
+    }
+    if(st.st_size == 0){
+        ::close(fd);
+        return parse(std::string_view(), path);
+    }
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED){
+        std::cout << "[!] Unable to map DBC " << path << std::endl;
+        return false;
+    }
+    const bool ok = parse(std::string_view(static_cast<const char*>(p), static_cast<size_t>(st.st_size)), path);
+    munmap(p, static_cast<size_t>(st.st_size));
+    return ok;
+#else
+    std::ifstream file(path, std::ios::binary);
     if(!file){
-        std::cout << "invalid file" << std::endl;
+        std::cout << "[!] Unable to open DBC " << path << std::endl;
         return false;
     }
-    std::string src = path;
-    std::string line;
-    DbcMessage* current = nullptr;
-    while(std::getline(file, line)){
-        line = trim(line);
-        if(line.empty()) continue;
-        std::istringstream iss(line);
-        std::string tok;
-        iss >> tok;
-        if(tok == "BO_"){
-            uint32_t id; std::string name; char colon; unsigned dlc; std::string transmitter;
-            iss >> id >> name >> colon >> dlc >> transmitter;
-            DbcMessage msg; msg.id = id; msg.name = name; msg.dlc = static_cast<uint8_t>(dlc);
-            msg.dbc_name = src;
-            _messages[id] = msg;
-            current = &_messages[id];
-        } else 
-        if(tok == "SG_" && current){
-            std::string name; iss >> name; // may include ":" after name
-            if(!iss) continue;
-            std::string sep; iss >> sep; // should be ':'
-            std::string rest; std::getline(iss, rest);
-            rest = trim(rest);
-            // parse start|size@endian+sign
-            std::istringstream iss2(rest);
-            std::string posToken; iss2 >> posToken;
-            size_t pipe = posToken.find('|');
-            size_t at = posToken.find('@', pipe+1);
-            uint16_t start = static_cast<uint16_t>(std::stoi(posToken.substr(0, pipe)));
-            uint8_t size = static_cast<uint8_t>(std::stoi(posToken.substr(pipe+1, at-pipe-1)));
-            bool little = posToken.at(at+1) == '1';
-            bool sign = posToken.at(at+2) == '-';
-            std::string factorToken; iss2 >> factorToken; // (factor,offset)
-            double factor = 1.0, offset = 0.0;
-            if(factorToken.size() > 2){
-                factorToken = factorToken.substr(1, factorToken.size()-2); // remove ()
-                size_t comma = factorToken.find(',');
-                factor = std::stod(factorToken.substr(0, comma));
-                offset = std::stod(factorToken.substr(comma+1));
-            }
-            DbcSignal sig; sig.name = name; sig.start_bit = start; sig.size = size;
-            sig.little_endian = little; sig.is_signed = sign; sig.factor = factor; sig.offset = offset;
-            current->signals.push_back(sig);
-        } else 
-        if(tok == "VAL_TABLE_"){
-            std::string table; iss >> table;
-            int64_t val; std::string desc;
-            while(iss >> val){
-                iss >> std::ws; char quote; iss >> quote; std::getline(iss, desc, '"');
-                _value_tables[table][val] = desc;
-                iss >> std::ws; char end; iss >> end; // consume closing quote char or semicolon
-            }
-        } else 
-        if(tok == "VAL_"){
-            uint32_t id; std::string sig; iss >> id >> sig;
-            int64_t val; std::string desc;
-            while(iss >> val){
-                iss >> std::ws; char quote; iss >> quote; std::getline(iss, desc, '"');
-                _value_tables[sig][val] = desc;
-                iss >> std::ws; char end; iss >> end;
-            }
-        }
-    }
-
-    // attach value tables to signals
-    for(auto &mp : _messages){
-        for(auto &sig : mp.second.signals){
-            auto it = _value_tables.find(sig.name);
-            if(it != _value_tables.end()) sig.value_map = it->second;
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return parse(text, path);
+#endif
+}
+
+bool DbcParser::loadFromMemory(const char* data, size_t size, const std::string& name){
+    return parse(std::string_view(data, size), name);
+}
+
+void DbcParser::add_compiled(const DbcCompiledDbc& compiled, const std::string& name){
+    auto attributes = [](const DbcCompiledAttribute* a, size_t n){
+        DbcAttributes out;
+        for(size_t i = 0; i < n; ++i)
+            out[a[i].name] = a[i].value;
+        return out;
+    };
+    for(size_t i = 0; i < compiled.message_count; ++i){
+        const DbcCompiledMessage &cm = compiled.messages[i];
+        DbcMessage msg;
+        msg.id = cm.id;
+        msg.name = cm.name;
+        msg.dlc = cm.dlc;
+        msg.cycle_time_ms = cm.cycle_time_ms;
+        msg.transmitter = cm.transmitter;
+        msg.extra_transmitters.assign(cm.extra_transmitters, cm.extra_transmitters + cm.extra_transmitter_count);
+        msg.comment = cm.comment;
+        msg.attributes = attributes(cm.attributes, cm.attribute_count);
+        msg.dbc_name = name;
+        for(size_t s = 0; s < cm.signal_count; ++s){
+            const DbcCompiledSignal &cs = cm.signals[s];
+            DbcSignal sig;
+            sig.name = cs.name;
+            sig.start_bit = cs.start_bit;
+            sig.size = cs.size;
+            sig.little_endian = cs.little_endian;
+            sig.is_signed = cs.is_signed;
+            sig.value_type = cs.value_type;
+            sig.factor = cs.factor;
+            sig.offset = cs.offset;
+            sig.minimum = cs.minimum;
+            sig.maximum = cs.maximum;
+            sig.unit = cs.unit;
+            sig.comment = cs.comment;
+            sig.multiplexor = cs.multiplexor;
+            sig.mux_value = cs.mux_value;
+            sig.receivers.assign(cs.receivers, cs.receivers + cs.receiver_count);
+            sig.attributes = attributes(cs.attributes, cs.attribute_count);
+            for(size_t v = 0; v < cs.value_count; ++v)
+                sig.value_map[cs.values[v].value] = cs.values[v].description;
+            msg.signals.push_back(std::move(sig));
         }
+        _messages[cm.id] = std::move(msg);
+        _compiled[cm.id] = compiled.decode;
     }
-
-    return true;
+    build_plans();
 }
 
-bool DbcParser::loadFromMemory(const char* data, size_t size, const std::string& name){
-    std::istringstream file(std::string(data, size));
-    if(!file)
-        return false;
-    std::string src = name;
-    std::string line;
+bool DbcParser::parse(std::string_view text, const std::string& src){
+    DbcScanner in(text);
     DbcMessage* current = nullptr;
-    while(std::getline(file, line)){
-        line = trim(line);
-        if(line.empty()) continue;
-        std::istringstream iss(line);
-        std::string tok;
-        iss >> tok;
-        if(tok == "BO_"){
-            uint32_t id; std::string name; char colon; unsigned dlc; std::string transmitter;
-            iss >> id >> name >> colon >> dlc >> transmitter;
-            DbcMessage msg; msg.id = id; msg.name = name; msg.dlc = static_cast<uint8_t>(dlc);
-            msg.dbc_name = src;
-            _messages[id] = msg;
-            current = &_messages[id];
-        } else if(tok == "SG_" && current){
-            std::string name; iss >> name;
-            if(!iss) continue;
-            std::string sep; iss >> sep;
-            std::string rest; std::getline(iss, rest);
-            rest = trim(rest);
-            std::istringstream iss2(rest);
-            std::string posToken; iss2 >> posToken;
-            size_t pipe = posToken.find('|');
-            size_t at = posToken.find('@', pipe+1);
-            uint16_t start = static_cast<uint16_t>(std::stoi(posToken.substr(0, pipe)));
-            uint8_t sizeb = static_cast<uint8_t>(std::stoi(posToken.substr(pipe+1, at-pipe-1)));
-            bool little = posToken.at(at+1) == '1';
-            bool sign = posToken.at(at+2) == '-';
-            std::string factorToken; iss2 >> factorToken;
-            double factor = 1.0, offset = 0.0;
-            if(factorToken.size() > 2){
-                factorToken = factorToken.substr(1, factorToken.size()-2);
-                size_t comma = factorToken.find(',');
-                factor = std::stod(factorToken.substr(0, comma));
-                offset = std::stod(factorToken.substr(comma+1));
-            }
-            DbcSignal sig; sig.name = name; sig.start_bit = start; sig.size = sizeb;
-            sig.little_endian = little; sig.is_signed = sign; sig.factor = factor; sig.offset = offset;
-            current->signals.push_back(sig);
-        } else if(tok == "VAL_TABLE_"){
-            std::string table; iss >> table;
-            int64_t val; std::string desc;
-            while(iss >> val){
-                iss >> std::ws; char quote; iss >> quote; std::getline(iss, desc, '"');
-                _value_tables[table][val] = desc;
-                iss >> std::ws; char end; iss >> end;
-            }
-        } else if(tok == "VAL_"){
-            uint32_t id; std::string sig; iss >> id >> sig;
-            int64_t val; std::string desc;
-            while(iss >> val){
-                iss >> std::ws; char quote; iss >> quote; std::getline(iss, desc, '"');
-                _value_tables[sig][val] = desc;
-                iss >> std::ws; char end; iss >> end;
-            }
-        }
-    }
-
-    for(auto &mp : _messages){
-        for(auto &sig : mp.second.signals){
-            auto it = _value_tables.find(sig.name);
-            if(it != _value_tables.end()) sig.value_map = it->second;
+    std::vector<uint32_t> ids;   // messages of this file
+    // VAL_ lines are applied once the whole file is read
+    struct SignalValues {
+        uint32_t id;
+        std::string signal;
+        std::unordered_map<int64_t, std::string> values;
+    };
+    std::vector<SignalValues> signal_values;
+    std::unordered_map<std::string, std::string> file_defaults;
+    // VAL_TABLE_s of this file, by name
+    std::unordered_map<std::string, std::unordered_map<int64_t, std::string>> value_tables;
+    unsigned errors = 0;
+
+    auto find_signal = [this](uint32_t id, std::string_view name) -> DbcSignal* {
+        auto it = _messages.find(id);
+        if(it == _messages.end())
+            return nullptr;
+        for(auto &sig : it->second.signals)
+            if(sig.name == name)
+                return &sig;
+        return nullptr;
+    };
+    auto value_descriptions = [&in](std::unordered_map<int64_t, std::string>& out){
+        while(!in.eat(';')){
+            int64_t v;
+            std::string desc;
+            if(!in.integer(v) || !in.string(desc))
+                return false;
+            out[v] = std::move(desc);
+        }
+        return true;
+    };
+
+    while(!in.done()){
+        const size_t statement = in.position();
+        const std::string_view kw = in.word();
+        bool ok = true;
+        bool line_based = false;
+
+        if(kw == "BO_"){
+            line_based = true;
+            DbcMessage msg;
+            unsigned dlc = 0;
+            ok = in.integer(msg.id);
+            msg.name = to_string(in.word());
+            ok = ok && !msg.name.empty() && in.eat(':') && in.integer(dlc);
+            if(ok){
+                msg.dlc = static_cast<uint8_t>(dlc);
+                if(!in.at_line_end())
+                    msg.transmitter = to_string(in.word());
+                msg.dbc_name = src;
+                const uint32_t id = msg.id;
+                current = &(_messages[id] = std::move(msg));
+                _compiled.erase(id);
+                ids.push_back(id);
+            } else {
+                current = nullptr;
+            }
+        } else if(kw == "SG_"){
+            line_based = true;
+            DbcSignal sig;
+            sig.name = to_string(in.word());
+            ok = current && !sig.name.empty();
+            if(ok && !in.eat(':')){
+                // multiplexing: M, m<n> or m<n>M
+                std::string_view mux = in.word();
+                if(!mux.empty() && mux.back() == 'M'){
+                    sig.multiplexor = true;
+                    mux.remove_suffix(1);
+                }
+                if(!mux.empty() && mux.front() == 'm'){
+                    const auto r = std::from_chars(mux.data() + 1, mux.data() + mux.size(), sig.mux_value);
+                    ok = r.ec == std::errc();
+                }
+                ok = ok && in.eat(':');
+            }
+            unsigned start = 0, size = 0;
+            ok = ok && in.integer(start) && in.eat('|') && in.integer(size) && in.eat('@');
+            if(ok){
+                const char order = in.get();
+                const char sign = in.get();
+                ok = (order == '0' || order == '1') && (sign == '+' || sign == '-');
+                sig.little_endian = order == '1';
+                sig.is_signed = sign == '-';
+                sig.start_bit = static_cast<uint16_t>(start);
+                sig.size = static_cast<uint8_t>(size);
+            }
+            ok = ok && in.eat('(') && in.real(sig.factor) && in.eat(',') && in.real(sig.offset) && in.eat(')');
+            // range, unit and receivers are optional in hand written files
+            if(ok && !in.at_line_end() && in.peek() == '[')
+                ok = in.eat('[') && in.real(sig.minimum) && in.eat('|') && in.real(sig.maximum) && in.eat(']');
+            if(ok && !in.at_line_end() && in.peek() == '"')
+                ok = in.string(sig.unit);
+            while(ok && !in.at_line_end()){
+                const std::string_view r = in.word();
+                if(r.empty() && !in.eat(','))
+                    break;
+                if(!r.empty() && r != "Vector__XXX")
+                    sig.receivers.push_back(to_string(r));
+            }
+            if(ok)
+                current->signals.push_back(std::move(sig));
+        } else if(kw == "BU_"){
+            line_based = true;
+            in.eat(':');
+            while(!in.at_line_end()){
+                const std::string_view n = in.word();
+                if(n.empty())
+                    break;
+                _nodes.push_back(to_string(n));
+            }
+        } else if(kw == "NS_"){
+            in.skip_symbols();
+            continue;
+        } else if(kw == "VERSION" || kw == "BS_"){
+            line_based = true;
+        } else if(kw == "CM_"){
+            std::string comment;
+            if(in.peek() == '"'){
+                ok = in.string(comment);
+            } else {
+                const std::string_view object = in.word();
+                if(object == "BO_"){
+                    uint32_t id = 0;
+                    ok = in.integer(id) && in.string(comment);
+                    auto it = _messages.find(id);
+                    if(ok && it != _messages.end())
+                        it->second.comment = std::move(comment);
+                } else if(object == "SG_"){
+                    uint32_t id = 0;
+                    ok = in.integer(id);
+                    const std::string_view name = in.word();
+                    ok = ok && in.string(comment);
+                    if(DbcSignal* sig = ok ? find_signal(id, name) : nullptr)
+                        sig->comment = std::move(comment);
+                } else {
+                    // BU_ / EV_ comments name a node or variable
+                    in.word();
+                    ok = in.string(comment);
+                }
+            }
+            ok = ok && in.eat(';');
+        } else if(kw == "BA_DEF_"){
+            DbcAttributeDef def;
+            if(in.peek() != '"')
+                def.object = to_string(in.word());
+            std::string name;
+            ok = in.string(name);
+            if(ok){
+                def.type = to_string(in.word());
+                std::string v;
+                while(def.type == "ENUM" && in.peek() == '"' && in.string(v)){
+                    def.enum_values.push_back(v);
+                    in.eat(',');
+                }
+                // INT / HEX / FLOAT ranges are not kept
+                in.skip_statement();
+                auto &slot = _attribute_defs[name];
+                def.default_value = slot.default_value;
+                slot = std::move(def);
+                continue;
+            }
+        } else if(kw == "BA_DEF_DEF_"){
+            std::string name, value;
+            ok = in.string(name) && in.value(value) && in.eat(';');
+            if(ok){
+                _attribute_defs[name].default_value = value;
+                file_defaults[name] = value;
+            }
+        } else if(kw == "BA_"){
+            std::string name, value;
+            ok = in.string(name);
+            DbcAttributes* target = nullptr;
+            if(ok && in.peek() != '"'){
+                const char c = in.peek();
+                if(c == 'B' || c == 'S' || c == 'E'){
+                    const std::string_view object = in.word();
+                    uint32_t id = 0;
+                    if(object == "BO_"){
+                        ok = in.integer(id);
+                        auto it = _messages.find(id);
+                        if(ok && it != _messages.end())
+                            target = &it->second.attributes;
+                    } else if(object == "SG_"){
+                        ok = in.integer(id);
+                        DbcSignal* sig = ok ? find_signal(id, in.word()) : nullptr;
+                        if(sig)
+                            target = &sig->attributes;
+                    } else {
+                        in.word(); // BU_ node / EV_ variable
+                    }
+                }
+            }
+            ok = ok && in.value(value) && in.eat(';');
+            if(ok && target)
+                (*target)[name] = value;
+        } else if(kw == "VAL_TABLE_"){
+            const std::string table = to_string(in.word());
+            ok = value_descriptions(value_tables[table]);
+        } else if(kw == "VAL_"){
+            SignalValues sv;
+            if(in.integer(sv.id)){
+                sv.signal = to_string(in.word());
+                ok = value_descriptions(sv.values);
+                if(ok)
+                    signal_values.push_back(std::move(sv));
+            } else {
+                in.skip_statement(); // environment variable
+            }
+        } else if(kw == "SIG_VALTYPE_"){
+            uint32_t id = 0;
+            unsigned type = 0;
+            ok = in.integer(id);
+            const std::string_view name = in.word();
+            ok = ok && in.eat(':') && in.integer(type) && type <= 2 && in.eat(';');
+            if(DbcSignal* sig = ok ? find_signal(id, name) : nullptr)
+                sig->value_type = static_cast<DbcValueType>(type);
+        } else if(kw == "SG_MUL_VAL_"){
+            uint32_t id = 0;
+            ok = in.integer(id);
+            DbcSignal* sig = ok ? find_signal(id, in.word()) : nullptr;
+            const std::string sw = to_string(in.word());
+            std::vector<std::pair<uint64_t, uint64_t>> ranges;
+            while(ok && !in.eat(';')){
+                const std::string_view r = in.word();
+                const size_t dash = r.find('-');
+                uint64_t lo = 0, hi = 0;
+                ok = dash != std::string_view::npos &&
+                     std::from_chars(r.data(), r.data() + dash, lo).ec == std::errc() &&
+                     std::from_chars(r.data() + dash + 1, r.data() + r.size(), hi).ec == std::errc();
+                ranges.emplace_back(lo, hi);
+                in.eat(',');
+            }
+            if(ok && sig){
+                sig->mux_switch = sw;
+                sig->mux_ranges = std::move(ranges);
+            }
+        } else if(kw == "BO_TX_BU_"){
+            uint32_t id = 0;
+            ok = in.integer(id) && in.eat(':');
+            auto it = _messages.find(id);
+            while(ok && !in.eat(';')){
+                const std::string_view n = in.word();
+                if(n.empty()){
+                    ok = false;
+                    break;
+                }
+                if(it != _messages.end())
+                    it->second.extra_transmitters.push_back(to_string(n));
+                in.eat(',');
+            }
+        } else if(std::find(std::begin(SKIPPED), std::end(SKIPPED), kw) != std::end(SKIPPED)){
+            in.skip_statement();
+            continue;
+        } else {
+            // ENDNS_ and anything unknown: a line of its own
+            in.skip_line();
+            continue;
+        }
+
+        if(!ok){
+            if(++errors <= 10)
+                std::cout << "[!] " << src << ":" << in.line(statement) << ": malformed " << to_string(kw) << std::endl;
+            if(line_based)
+                in.skip_line();
+            else
+                in.skip_statement();
+        } else if(line_based){
+            in.skip_line();
         }
     }
 
+    for(auto &sv : signal_values)
+        if(DbcSignal* sig = find_signal(sv.id, sv.signal))
+            sig->value_map = std::move(sv.values);
+
+    // cycle times, BA_ lines may come before or after their BO_
+    unsigned default_cycle_ms = 0;
+    auto def = file_defaults.find("GenMsgCycleTime");
+    if(def != file_defaults.end())
+        std::from_chars(def->second.data(), def->second.data() + def->second.size(), default_cycle_ms);
+    for(uint32_t id : ids){
+        DbcMessage &m = _messages[id];
+        if(m.dbc_name != src)
+            continue;
+        m.cycle_time_ms = default_cycle_ms;
+        auto it = m.attributes.find("GenMsgCycleTime");
+        if(it != m.attributes.end())
+            std::from_chars(it->second.data(), it->second.data() + it->second.size(), m.cycle_time_ms);
+        // a named value table shared by signals of the same name, within
+        // the file that defines it
+        for(auto &sig : m.signals){
+            if(!sig.value_map.empty())
+                continue;
+            auto vt = value_tables.find(sig.name);
+            if(vt != value_tables.end())
+                sig.value_map = vt->second;
+        }
+    }
+
+    _errors += errors;
+    build_plans();
     return true;
 }
 
-uint64_t DbcParser::extract_signal(const uint8_t* data, uint16_t start, uint8_t size, bool little) const{
+DbcParser::DbcParser(const DbcParser& other)
+    : _messages(other._messages), _nodes(other._nodes), _attribute_defs(other._attribute_defs),
+      _errors(other._errors), _compiled(other._compiled) {
+    build_plans();
+}
+
+DbcParser& DbcParser::operator=(const DbcParser& other){
+    if(this != &other){
+        _messages = other._messages;
+        _nodes = other._nodes;
+        _attribute_defs = other._attribute_defs;
+        _errors = other._errors;
+        _compiled = other._compiled;
+        build_plans();
+    }
+    return *this;
+}
+
+namespace {
+
+// Motorola bits counted msb first through the payload: bit 7 of byte 0 is
+// 0, bit 0 of byte 0 is 7, bit 7 of byte 1 is 8
+unsigned motorola_position(unsigned start_bit){
+    return (start_bit / 8) * 8 + (7 - start_bit % 8);
+}
+
+// bit by bit, for signals wider than one load
+uint64_t extract_signal(const uint8_t* data, unsigned start, unsigned size, bool little){
     uint64_t val = 0;
     if(little){
         for(unsigned i=0;i<size;++i){
@@ -175,37 +619,247 @@ uint64_t DbcParser::extract_signal(const uint8_t* data, uint16_t start, uint8_t
             val |= ((uint64_t)((data[byte] >> bit) & 1) << i);
         }
     } else {
+        // msb first, down to bit 0 of a byte then on from bit 7 of the next
+        unsigned pos = start;
         for(unsigned i=0;i<size;++i){
-            int pos = start - i;
-            uint8_t byte = pos / 8;
-            uint8_t bit = pos % 8;
-            val = (val << 1) | ((data[byte] >> bit) & 1);
+            val = (val << 1) | ((data[pos / 8] >> (pos % 8)) & 1);
+            pos = pos % 8 == 0 ? pos + 15 : pos - 1;
         }
     }
     return val;
 }
 
-int64_t DbcParser::sign_extend(uint64_t val, unsigned bits) const{
-    if(bits == 0 || bits >= 64) return static_cast<int64_t>(val);
-    uint64_t mask = 1ull << (bits - 1);
-    return (val ^ mask) - mask;
+uint64_t swap_bytes(uint64_t v){
+#ifdef _WIN32
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+// Assumes a little endian host, as the recorder and Arrow export do.
+inline double plan_read(const DbcSignalPlan& p, const uint8_t* data, int64_t& integer){
+    uint64_t raw;
+    if(p.wide){
+        raw = extract_signal(data, p.start_bit, p.size, !p.motorola);
+    } else {
+        uint64_t word;
+        std::memcpy(&word, data + p.byte, sizeof(word));
+        if(p.motorola)
+            word = swap_bytes(word);
+        raw = (word >> p.shift) & p.mask;
+    }
+    integer = static_cast<int64_t>(raw << p.sign_shift) >> p.sign_shift;
+    if(p.value_type == DbcValueType::Float){
+        float f;
+        const uint32_t bits = static_cast<uint32_t>(raw);
+        std::memcpy(&f, &bits, sizeof(f));
+        return f * p.factor + p.offset;
+    }
+    if(p.value_type == DbcValueType::Double){
+        double d;
+        std::memcpy(&d, &raw, sizeof(d));
+        return d * p.factor + p.offset;
+    }
+    return static_cast<double>(integer) * p.factor + p.offset;
+}
+
+} // namespace
+
+// the signal's bits have to land inside a 64-byte FD payload
+bool DbcParser::signal_fits(const DbcSignal& sig){
+    const unsigned max_bits = CAN_FD_MAX_LEN * 8;
+    if(sig.size == 0 || sig.size > 64)
+        return false;
+    if(sig.little_endian)
+        return sig.start_bit + sig.size <= max_bits;
+    return sig.start_bit < max_bits && motorola_position(sig.start_bit) + sig.size <= max_bits;
+}
+
+DbcSignalPlan DbcParser::compile(const DbcSignal& sig){
+    DbcSignalPlan p;
+    p.fits = signal_fits(sig);
+    p.motorola = !sig.little_endian;
+    p.size = sig.size;
+    p.start_bit = sig.start_bit;
+    p.factor = sig.factor;
+    p.offset = sig.offset;
+    if(!p.fits)
+        return p;
+    if((sig.value_type == DbcValueType::Float && sig.size == 32) ||
+       (sig.value_type == DbcValueType::Double && sig.size == 64))
+        p.value_type = sig.value_type;
+    p.mask = sig.size == 64 ? ~0ull : (1ull << sig.size) - 1;
+    p.sign_shift = sig.is_signed && sig.size < 64 ? static_cast<uint8_t>(64 - sig.size) : 0;
+    // the load stays inside the payload, a signal in its last bytes is
+    // reached with a larger shift instead
+    const unsigned max_byte = CAN_FD_MAX_LEN - 8;
+    if(sig.little_endian){
+        p.byte = static_cast<uint8_t>(std::min(sig.start_bit / 8u, max_byte));
+        const unsigned shift = sig.start_bit - p.byte * 8u;
+        p.wide = shift + sig.size > 64;
+        p.shift = static_cast<uint8_t>(shift);
+    } else {
+        // swapped, the loaded word holds the payload's bits msb first
+        const unsigned msb = motorola_position(sig.start_bit);
+        p.byte = static_cast<uint8_t>(std::min(msb / 8u, max_byte));
+        const unsigned lsb = msb + sig.size - 1 - p.byte * 8u;
+        p.wide = lsb > 63;
+        p.shift = p.wide ? 0 : static_cast<uint8_t>(63 - lsb);
+    }
+    return p;
+}
+
+double DbcParser::plan_value(const DbcSignalPlan& p, const uint8_t* data, int64_t& integer){
+    return plan_read(p, data, integer);
+}
+
+bool DbcParser::signal_value(const DbcSignal& sig, const uint8_t* data, double& value){
+    const DbcSignalPlan p = compile(sig);
+    if(!p.fits)
+        return false;
+    int64_t s;
+    value = plan_value(p, data, s);
+    return true;
+}
+
+namespace {
+
+uint32_t mix(uint32_t h){
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// slot of an id within a bucket displaced by seed
+uint32_t slot_of(uint32_t id, uint32_t seed, size_t slots){
+    return mix(id ^ (seed * 0x9e3779b9u)) & static_cast<uint32_t>(slots - 1);
+}
+
+size_t pow2_at_least(size_t n){
+    size_t p = 1;
+    while(p < n)
+        p <<= 1;
+    return p;
+}
+
+} // namespace
+
+void DbcParser::build_plans(){
+    _plans.clear();
+    _message_plans.clear();
+    _std_index.assign(CAN_ID_STD_MASK + 1, 0);
+    _ext_seeds.clear();
+    _ext_slots.clear();
+
+    std::vector<uint32_t> ext;   // _message_plans indices of other ids
+    for(const auto &mp : _messages){
+        MessagePlan m;
+        m.id = mp.first;
+        m.message = &mp.second;
+        m.begin = static_cast<uint32_t>(_plans.size());
+        for(const auto &sig : mp.second.signals){
+            DbcSignalPlan p = compile(sig);
+            if(!p.fits)
+                continue;
+            p.signal = &sig;
+            _plans.push_back(p);
+        }
+        m.end = static_cast<uint32_t>(_plans.size());
+        auto c = _compiled.find(m.id);
+        if(c != _compiled.end())
+            m.compiled = c->second;
+        const uint32_t index = static_cast<uint32_t>(_message_plans.size());
+        _message_plans.push_back(m);
+        if(m.id <= CAN_ID_STD_MASK)
+            _std_index[m.id] = index + 1;
+        else
+            ext.push_back(index);
+    }
+    if(ext.empty())
+        return;
+
+    // hash and displace: ids go to buckets by hash, then each bucket, the
+    // fullest first, gets the first seed that puts all its ids in empty
+    // slots. With twice as many slots as ids that is found in a few tries.
+    for(size_t slots = pow2_at_least(ext.size() * 2);; slots *= 2){
+        const size_t buckets = pow2_at_least((ext.size() + 3) / 4);
+        std::vector<std::vector<uint32_t>> members(buckets);
+        for(uint32_t index : ext)
+            members[mix(_message_plans[index].id) & (buckets - 1)].push_back(index);
+        std::vector<uint32_t> order(buckets);
+        for(uint32_t b = 0; b < buckets; ++b)
+            order[b] = b;
+        std::sort(order.begin(), order.end(), [&members](uint32_t a, uint32_t b){
+            return members[a].size() > members[b].size();
+        });
+        _ext_seeds.assign(buckets, 0);
+        _ext_slots.assign(slots, 0);
+        bool placed = true;
+        std::vector<uint32_t> taken;
+        for(uint32_t b : order){
+            if(members[b].empty())
+                break;
+            uint32_t seed = 0;
+            for(; seed < 4096; ++seed){
+                taken.clear();
+                for(uint32_t index : members[b]){
+                    const uint32_t s = slot_of(_message_plans[index].id, seed, slots);
+                    if(_ext_slots[s] || std::find(taken.begin(), taken.end(), s) != taken.end())
+                        break;
+                    taken.push_back(s);
+                }
+                if(taken.size() == members[b].size())
+                    break;
+            }
+            if(seed == 4096){
+                placed = false;
+                break;
+            }
+            _ext_seeds[b] = seed;
+            for(size_t i = 0; i < taken.size(); ++i)
+                _ext_slots[taken[i]] = members[b][i] + 1;
+        }
+        if(placed)
+            return;
+    }
+}
+
+const DbcParser::MessagePlan* DbcParser::find_plan(uint32_t id) const{
+    uint32_t index;
+    if(id <= CAN_ID_STD_MASK){
+        if(_std_index.empty())
+            return nullptr;
+        index = _std_index[id];
+    } else {
+        if(_ext_slots.empty())
+            return nullptr;
+        const uint32_t seed = _ext_seeds[mix(id) & (_ext_seeds.size() - 1)];
+        index = _ext_slots[slot_of(id, seed, _ext_slots.size())];
+    }
+    if(!index)
+        return nullptr;
+    const MessagePlan &m = _message_plans[index - 1];
+    return m.id == id ? &m : nullptr;
 }
 
 bool DbcParser::decode(uint32_t id, const CanFrame& frame, std::string& out) const{
-    auto it = _messages.find(id);
-    if(it == _messages.end()) return false;
+    const MessagePlan* m = find_plan(id);
+    if(!m) return false;
     std::ostringstream oss;
-    const auto& msg = it->second;
     bool first = true;
-    for(const auto& sig : msg.signals){
-        uint64_t raw = extract_signal(frame.data.data(), sig.start_bit, sig.size, sig.little_endian);
-        int64_t s = sig.is_signed ? sign_extend(raw, sig.size) : (int64_t)raw;
-        double value = s * sig.factor + sig.offset;
+    for(uint32_t i = m->begin; i < m->end; ++i){
+        const DbcSignalPlan &p = _plans[i];
+        int64_t s;
+        double value = plan_read(p, frame.data.data(), s);
         if(!first) oss << " ";
         first = false;
-        oss << sig.name << ": ";
-        auto v = sig.value_map.find(s);
-        if(v != sig.value_map.end()) oss << v->second;
+        oss << p.signal->name << ": ";
+        auto v = p.signal->value_map.find(s);
+        if(v != p.signal->value_map.end()) oss << v->second;
         else oss << value;
     }
     out = oss.str();
@@ -213,15 +867,33 @@ bool DbcParser::decode(uint32_t id, const CanFrame& frame, std::string& out) con
 }
 
 bool DbcParser::decode_signals(uint32_t id, const CanFrame& frame, std::vector<std::pair<std::string,double>>& out) const{
-    auto it = _messages.find(id);
-    if(it == _messages.end()) return false;
+    const MessagePlan* m = find_plan(id);
+    if(!m) return false;
     out.clear();
-    const auto& msg = it->second;
-    for(const auto& sig : msg.signals){
-        uint64_t raw = extract_signal(frame.data.data(), sig.start_bit, sig.size, sig.little_endian);
-        int64_t s = sig.is_signed ? sign_extend(raw, sig.size) : (int64_t)raw;
-        double value = s * sig.factor + sig.offset;
-        out.emplace_back(sig.name, value);
+    if(m->compiled){
+        std::vector<double> values(m->end - m->begin);
+        m->compiled(id, frame.data.data(), values.data());
+        for(uint32_t i = m->begin; i < m->end; ++i)
+            out.emplace_back(_plans[i].signal->name, values[i - m->begin]);
+        return true;
+    }
+    for(uint32_t i = m->begin; i < m->end; ++i){
+        int64_t s;
+        out.emplace_back(_plans[i].signal->name, plan_read(_plans[i], frame.data.data(), s));
+    }
+    return true;
+}
+
+bool DbcParser::decode_values(uint32_t id, const CanFrame& frame, std::vector<double>& out) const{
+    const MessagePlan* m = find_plan(id);
+    if(!m) return false;
+    out.resize(m->end - m->begin);
+    if(m->compiled)
+        return m->compiled(id, frame.data.data(), out.data());
+    double* v = out.data();
+    for(uint32_t i = m->begin; i < m->end; ++i){
+        int64_t s;
+        *v++ = plan_read(_plans[i], frame.data.data(), s);
     }
     return true;
 }
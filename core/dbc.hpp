@@ -2,19 +2,43 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "candb.hpp"
 
+struct DbcCompiledDbc;
+
+// SIG_VALTYPE_: how the raw bits read
+enum class DbcValueType : uint8_t { Integer = 0, Float = 1, Double = 2 };
+
+// attribute values are kept as written (strings unquoted, enums as index)
+using DbcAttributes = std::unordered_map<std::string, std::string>;
+
 struct DbcSignal {
     std::string name;
     uint16_t start_bit = 0;
     uint8_t size = 0;
     bool little_endian = true;
     bool is_signed = false;
+    DbcValueType value_type = DbcValueType::Integer;
     double factor = 1.0;
     double offset = 0.0;
+    double minimum = 0.0;
+    double maximum = 0.0;
+    std::string unit;
+    std::vector<std::string> receivers;
+    std::string comment;
+    DbcAttributes attributes;
+    // SG_ "M": this signal is the message's multiplexer switch
+    bool multiplexor = false;
+    // SG_ "m<n>": only present while the switch reads n, -1 if always
+    int64_t mux_value = -1;
+    // SG_MUL_VAL_ (extended multiplexing): switch and value ranges
+    std::string mux_switch;
+    std::vector<std::pair<uint64_t, uint64_t>> mux_ranges;
     std::unordered_map<int64_t, std::string> value_map;
 };
 
@@ -22,28 +46,124 @@ struct DbcMessage {
     uint32_t id = 0;
     std::string name;
     uint8_t dlc = 0;
+    uint32_t cycle_time_ms = 0; // GenMsgCycleTime, 0 if the DBC doesn't say
+    std::string transmitter;
+    std::vector<std::string> extra_transmitters; // BO_TX_BU_
+    std::string comment;
+    DbcAttributes attributes;
     std::vector<DbcSignal> signals;
     std::string dbc_name;
 };
 
+// messages and their ids, one entry per id, pointing into the parsers that
+// hold them (DbcCatalog)
+using DbcMessageList = std::vector<std::pair<uint32_t, const DbcMessage*>>;
+
+// BA_DEF_ / BA_DEF_DEF_
+struct DbcAttributeDef {
+    std::string object;                 // "", "BU_", "BO_", "SG_" or "EV_"
+    std::string type;                   // INT, HEX, FLOAT, STRING or ENUM
+    std::vector<std::string> enum_values;
+    std::string default_value;
+};
+
+// A signal compiled for decoding (DbcParser::compile): one unaligned 64-bit
+// load, a byte swap for Motorola, a shift and a mask, sign extension as a
+// pair of shifts and the scaling as one multiply-add. Bit positions follow
+// the DBC convention: Intel signals start at their lsb, Motorola ones at
+// their msb and run on from bit 7 of the next byte.
+struct DbcSignalPlan {
+    bool fits = false;          // lies inside a CAN_FD_MAX_LEN byte payload
+    bool motorola = false;
+    bool wide = false;          // spans 9 bytes, read bit by bit instead
+    DbcValueType value_type = DbcValueType::Integer;
+    uint8_t byte = 0;           // first of the 8 bytes loaded, at most 56
+    uint8_t shift = 0;          // right shift of the loaded (swapped) word
+    uint8_t sign_shift = 0;     // 64 - size for signed integers, else 0
+    uint8_t size = 0;
+    uint16_t start_bit = 0;
+    uint64_t mask = 0;
+    double factor = 1.0;
+    double offset = 0.0;
+    const DbcSignal* signal = nullptr;  // set for the parser's own plans
+};
+
+// Parses DBC text in one pass over the source (mapped for files): words,
+// numbers and strings are views into it until they are stored, numbers go
+// through from_chars. Covers the statements a DBC carries, from BO_ / SG_
+// with multiplexing, ranges, units and receivers to CM_, BA_DEF_ / BA_,
+// VAL_ / VAL_TABLE_, SIG_VALTYPE_, SG_MUL_VAL_ and BO_TX_BU_; the rest
+// (EV_, SIG_GROUP_, ...) is skipped. Malformed statements are reported with
+// their line and skipped. Loading several DBCs into one parser merges them,
+// a later message with the same id replaces the earlier one.
+//
+// Every load compiles the signals into DbcSignalPlans and indexes the
+// messages: a direct table for 11-bit ids and a perfect hash (hash and
+// displace) for the rest, so a decode is one or two probes and a few loads
+// and ALU ops per signal. DBCs compiled at build time (dbc_compiled.hpp)
+// are added without parsing and decode_values() runs their generated code.
 class DbcParser {
 public:
+    DbcParser() = default;
+    // plans point into _messages, a copy rebuilds them; moving keeps the
+    // map's nodes and so the plans
+    DbcParser(const DbcParser& other);
+    DbcParser& operator=(const DbcParser& other);
+    DbcParser(DbcParser&&) = default;
+    DbcParser& operator=(DbcParser&&) = default;
+
     bool load(const std::string& path);
     bool loadFromMemory(const char* data, size_t size, const std::string& name);
+    bool parse(std::string_view text, const std::string& name);
+    // messages of a DBC compiled by cmake/dbc_to_header.cpp, dbc_name name
+    void add_compiled(const DbcCompiledDbc& compiled, const std::string& name);
     bool decode(uint32_t id, const CanFrame& frame, std::string& out) const;
     void can_parse_debug();
     bool decode_signals(uint32_t id, const CanFrame& frame, std::vector<std::pair<std::string, double>> &out) const;
+    // physical values only, in the order decode_signals() names them
+    bool decode_values(uint32_t id, const CanFrame& frame, std::vector<double>& out) const;
     const std::unordered_map<uint32_t, DbcMessage>& messages() const { return _messages; }
+    const std::vector<std::string>& nodes() const { return _nodes; }
+    const std::unordered_map<std::string, DbcAttributeDef>& attribute_defs() const { return _attribute_defs; }
+    // malformed statements skipped by the loads so far
+    unsigned errors() const { return _errors; }
+    // physical value of sig in a CAN_FD_MAX_LEN byte payload, false if the
+    // signal can't lie inside one
+    static bool signal_value(const DbcSignal& sig, const uint8_t* data, double& value);
+    // for callers that decode the same signals over and over
+    static DbcSignalPlan compile(const DbcSignal& sig);
+    // physical value of a plan that fits, from a CAN_FD_MAX_LEN byte
+    // payload; integer gets the raw bits as the signed / float integer
+    // they encode, for value_map lookups
+    static double plan_value(const DbcSignalPlan& plan, const uint8_t* data, int64_t& integer);
 
 private:
-    uint64_t extract_signal(const uint8_t* data, uint16_t start, uint8_t size, bool little_endian) const;
-    int64_t sign_extend(uint64_t val, unsigned bits) const;
+    struct MessagePlan {
+        uint32_t id = 0;
+        const DbcMessage* message = nullptr;
+        uint32_t begin = 0, end = 0;        // its fitting signals in _plans
+        // generated decoder of a builtin DBC (DbcCompiledDecode)
+        bool (*compiled)(uint32_t id, const uint8_t* data, double* out) = nullptr;
+    };
+
+    static bool signal_fits(const DbcSignal& sig);
+    void build_plans();
+    const MessagePlan* find_plan(uint32_t id) const;
 
-    std::unordered_map<std::string, std::unordered_map<int64_t, std::string>> _value_tables;
     std::unordered_map<uint32_t, DbcMessage> _messages;
+    std::vector<std::string> _nodes;
+    std::unordered_map<std::string, DbcAttributeDef> _attribute_defs;
+    unsigned _errors = 0;
+    // ids whose message came from a compiled DBC, and its decoder
+    std::unordered_map<uint32_t, bool (*)(uint32_t, const uint8_t*, double*)> _compiled;
+
+    std::vector<DbcSignalPlan> _plans;
+    std::vector<MessagePlan> _message_plans;
+    std::vector<uint32_t> _std_index;       // 11-bit id -> _message_plans index + 1, 0 if none
+    std::vector<uint32_t> _ext_seeds;       // per bucket displacement of the perfect hash
+    std::vector<uint32_t> _ext_slots;       // slot -> _message_plans index + 1, 0 if empty
 };
 
-// we currently have 3 unordered maps
+// we currently have 2 unordered maps
 // value_map
-// _value_tables
 // _messages
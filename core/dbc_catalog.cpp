@@ -0,0 +1,236 @@
+#include "dbc_catalog.hpp"
+#include "dbc_compiled.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+DbcFragmentPtr DbcFragmentCache::file(const std::string& path){
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0){
+        std::cout << "[!] Unable to open DBC " << path << std::endl;
+        return nullptr;
+    }
+#if defined(__linux__)
+    const int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    const int64_t mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#endif
+    const int64_t size = static_cast<int64_t>(st.st_size);
+    auto it = _files.find(path);
+    if(it != _files.end() && it->second.mtime_ns == mtime_ns && it->second.size == size)
+        return it->second.fragment;
+
+    auto fragment = std::make_shared<DbcFragment>();
+    fragment->name = path;
+    if(!fragment->dbc.load(path))
+        return nullptr;
+    for(const auto &mp : fragment->dbc.messages())
+        fragment->messages.emplace_back(mp.first, &mp.second);
+    FileEntry &entry = _files[path];
+    entry.mtime_ns = mtime_ns;
+    entry.size = size;
+    entry.fragment = std::move(fragment);
+    return entry.fragment;
+}
+
+DbcFragmentPtr DbcFragmentCache::compiled(const DbcCompiledDbc& compiled, const std::string& name){
+    DbcFragmentPtr &slot = _compiled[name];
+    if(!slot){
+        auto fragment = std::make_shared<DbcFragment>();
+        fragment->name = name;
+        fragment->dbc.add_compiled(compiled, name);
+        for(const auto &mp : fragment->dbc.messages())
+            fragment->messages.emplace_back(mp.first, &mp.second);
+        slot = std::move(fragment);
+    }
+    return slot;
+}
+
+namespace {
+
+uint32_t ext_hash(uint32_t id, size_t slots){
+    return static_cast<uint32_t>((id * 0x9E3779B97F4A7C15ull) >> 32) & static_cast<uint32_t>(slots - 1);
+}
+
+} // namespace
+
+DbcCatalog::DbcCatalog(std::vector<DbcFragmentPtr> fragments)
+    : _fragments(std::move(fragments)), _std_index(CAN_ID_STD_MASK + 1, 0) {
+    size_t total = 0;
+    for(const auto &f : _fragments)
+        total += f->messages.size();
+    _messages.reserve(total);
+    _owner.reserve(total);
+    size_t slots = 16;
+    while(slots < total * 2)
+        slots <<= 1;
+    _ext_index.assign(slots, {0, 0});
+
+    for(const auto &f : _fragments){
+        for(const auto &mp : f->messages){
+            uint32_t &s = slot(mp.first);
+            if(s){
+                _conflicts.push_back({mp.first, f.get(), _owner[s - 1]});
+                _messages[s - 1].second = mp.second;
+                _owner[s - 1] = f.get();
+                continue;
+            }
+            _messages.push_back(mp);
+            _owner.push_back(f.get());
+            s = static_cast<uint32_t>(_messages.size());
+        }
+    }
+}
+
+uint32_t& DbcCatalog::slot(uint32_t id){
+    if(id <= CAN_ID_STD_MASK)
+        return _std_index[id];
+    const size_t mask = _ext_index.size() - 1;
+    for(size_t i = ext_hash(id, _ext_index.size());; i = (i + 1) & mask){
+        auto &e = _ext_index[i];
+        if(!e.second)
+            e.first = id;
+        if(e.first == id)
+            return e.second;
+    }
+}
+
+const DbcParser* DbcCatalog::owner(uint32_t id) const{
+    uint32_t s = 0;
+    if(id <= CAN_ID_STD_MASK){
+        if(!_std_index.empty())
+            s = _std_index[id];
+    } else if(!_ext_index.empty()){
+        const size_t mask = _ext_index.size() - 1;
+        for(size_t i = ext_hash(id, _ext_index.size()); _ext_index[i].second; i = (i + 1) & mask)
+            if(_ext_index[i].first == id){
+                s = _ext_index[i].second;
+                break;
+            }
+    }
+    return s ? &_owner[s - 1]->dbc : nullptr;
+}
+
+bool DbcCatalog::decode(uint32_t id, const CanFrame& frame, std::string& out) const{
+    const DbcParser* dbc = owner(id);
+    return dbc && dbc->decode(id, frame, out);
+}
+
+bool DbcCatalog::decode_signals(uint32_t id, const CanFrame& frame, std::vector<std::pair<std::string, double>>& out) const{
+    const DbcParser* dbc = owner(id);
+    return dbc && dbc->decode_signals(id, frame, out);
+}
+
+bool DbcCatalog::decode_values(uint32_t id, const CanFrame& frame, std::vector<double>& out) const{
+    const DbcParser* dbc = owner(id);
+    return dbc && dbc->decode_values(id, frame, out);
+}
+
+DbcFileWatcher::DbcFileWatcher(std::function<void()> on_change)
+    : _on_change(std::move(on_change)) {}
+
+DbcFileWatcher::~DbcFileWatcher(){
+    stop();
+}
+
+bool DbcFileWatcher::start(){
+    if(_running.load())
+        return true;
+#if defined(__linux__)
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    _wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_fd < 0 || _wake < 0){
+        std::cout << "[!] Unable to watch DBC files: " << std::strerror(errno) << std::endl;
+        if(_fd >= 0) ::close(_fd);
+        if(_wake >= 0) ::close(_wake);
+        _fd = _wake = -1;
+        return false;
+    }
+    _running.store(true);
+    _thread = std::thread([this]{ run(); });
+    return true;
+#else
+    std::cout << "[!] DBC hot reload needs inotify" << std::endl;
+    return false;
+#endif
+}
+
+void DbcFileWatcher::stop(){
+    if(!_running.exchange(false))
+        return;
+#if defined(__linux__)
+    const uint64_t one = 1;
+    if(::write(_wake, &one, sizeof(one)) < 0){}
+    _thread.join();
+    ::close(_fd);
+    ::close(_wake);
+    _fd = _wake = -1;
+    std::lock_guard<std::mutex> lock(_mtx);
+    _names.clear();
+#endif
+}
+
+void DbcFileWatcher::watch(const std::vector<std::string>& paths){
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(_mtx);
+    if(_fd < 0)
+        return;
+    for(const auto &n : _names)
+        inotify_rm_watch(_fd, n.first);
+    _names.clear();
+    for(const auto &path : paths){
+        const size_t slash = path.rfind('/');
+        const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        const std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        const int wd = inotify_add_watch(_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if(wd < 0){
+            std::cout << "[!] Unable to watch " << dir << ": " << std::strerror(errno) << std::endl;
+            continue;
+        }
+        _names[wd].push_back(name);
+    }
+#else
+    (void)paths;
+#endif
+}
+
+void DbcFileWatcher::run(){
+#if defined(__linux__)
+    alignas(inotify_event) char buf[4096];
+    pollfd fds[2] = {{_fd, POLLIN, 0}, {_wake, POLLIN, 0}};
+    while(_running.load()){
+        if(::poll(fds, 2, -1) < 0){
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(fds[1].revents)
+            break;
+        bool changed = false;
+        ssize_t n;
+        while((n = ::read(_fd, buf, sizeof(buf))) > 0){
+            std::lock_guard<std::mutex> lock(_mtx);
+            for(char* p = buf; p < buf + n; ){
+                const inotify_event* ev = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                auto it = _names.find(ev->wd);
+                if(ev->len && it != _names.end()
+                   && std::find(it->second.begin(), it->second.end(), ev->name) != it->second.end())
+                    changed = true;
+            }
+        }
+        // an editor's save is a burst of events, one callback covers it
+        if(changed)
+            _on_change();
+    }
+#endif
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dbc.hpp"
+
+struct DbcCompiledDbc;
+
+// One DBC file or builtin, parsed once and never changed after. Catalogs
+// share fragments, so loading, unloading or toggling a DBC reuses every
+// other one as it is.
+struct DbcFragment {
+    std::string name;       // path, or the builtin's name
+    DbcParser dbc;
+    DbcMessageList messages;    // of dbc, flat for merging
+};
+using DbcFragmentPtr = std::shared_ptr<const DbcFragment>;
+
+// Parsed DBCs by source. A file is parsed again only once its mtime or size
+// changed, so a rebuild after an edit costs one parse and the others a stat.
+// Not thread safe, the backend thread owns it.
+class DbcFragmentCache {
+public:
+    // nullptr if the file can't be read
+    DbcFragmentPtr file(const std::string& path);
+    DbcFragmentPtr compiled(const DbcCompiledDbc& compiled, const std::string& name);
+
+private:
+    struct FileEntry {
+        int64_t mtime_ns = 0;
+        int64_t size = 0;
+        DbcFragmentPtr fragment;
+    };
+    std::unordered_map<std::string, FileEntry> _files;
+    std::unordered_map<std::string, DbcFragmentPtr> _compiled;
+};
+
+// The merged view of a set of fragments: every message once, and decodes
+// handed to the fragment that owns the id. Building one fills a flat list
+// and two flat indexes, nothing is parsed, copied or allocated per message.
+// A later fragment wins an id it shares with an earlier one, each such
+// clash is kept in conflicts().
+class DbcCatalog {
+public:
+    struct Conflict {
+        uint32_t id = 0;
+        const DbcFragment* kept = nullptr;      // its message is used
+        const DbcFragment* replaced = nullptr;  // its message is hidden
+        bool operator==(const Conflict& o) const { return id == o.id && kept == o.kept && replaced == o.replaced; }
+        bool operator!=(const Conflict& o) const { return !(*this == o); }
+    };
+
+    DbcCatalog() = default;
+    explicit DbcCatalog(std::vector<DbcFragmentPtr> fragments);
+
+    bool decode(uint32_t id, const CanFrame& frame, std::string& out) const;
+    bool decode_signals(uint32_t id, const CanFrame& frame, std::vector<std::pair<std::string, double>>& out) const;
+    bool decode_values(uint32_t id, const CanFrame& frame, std::vector<double>& out) const;
+    const DbcMessageList& messages() const { return _messages; }
+    const std::vector<DbcFragmentPtr>& fragments() const { return _fragments; }
+    const std::vector<Conflict>& conflicts() const { return _conflicts; }
+
+private:
+    // _messages index + 1 slot of id, the empty one it would take if absent
+    uint32_t& slot(uint32_t id);
+    const DbcParser* owner(uint32_t id) const;
+
+    std::vector<DbcFragmentPtr> _fragments;
+    DbcMessageList _messages;
+    std::vector<const DbcFragment*> _owner; // per _messages entry
+    std::vector<Conflict> _conflicts;
+    std::vector<uint32_t> _std_index;       // 11-bit id -> _messages index + 1, 0 if none
+    // other ids, open addressing with linear probing: id and _messages
+    // index + 1, 0 if the slot is empty
+    std::vector<std::pair<uint32_t, uint32_t>> _ext_index;
+};
+
+// Calls on_change from its own thread whenever one of the watched files is
+// written or renamed into place (how most editors save). Watches the
+// directories, not the files, so replaced files stay watched. inotify only,
+// start() fails elsewhere.
+class DbcFileWatcher {
+public:
+    explicit DbcFileWatcher(std::function<void()> on_change);
+    ~DbcFileWatcher();
+
+    DbcFileWatcher(const DbcFileWatcher&) = delete;
+    DbcFileWatcher& operator=(const DbcFileWatcher&) = delete;
+
+    bool start();
+    void stop();
+    bool running() const { return _running.load(); }
+    // replaces the watched set
+    void watch(const std::vector<std::string>& paths);
+
+private:
+    void run();
+
+    std::function<void()> _on_change;
+    std::atomic<bool> _running{false};
+    std::mutex _mtx;
+    // watch descriptor -> names in that directory
+    std::unordered_map<int, std::vector<std::string>> _names;
+    int _fd = -1;
+    int _wake = -1;
+    std::thread _thread;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "dbc.hpp"
+
+// What cmake/dbc_to_header.cpp turns a builtin DBC into at build time, so it
+// is never parsed at run time. Per message the generated header has a
+// <Message>_t struct with a member per signal, constexpr decode() / encode()
+// with every byte index, shift and mask a constant, and decode_values(),
+// which writes the physical values in the order DbcParser::decode_values()
+// does. decode(id, data, out) switches over the ids to those, and the
+// tables below carry everything else a DbcMessage holds. DbcParser::
+// add_compiled() registers the result.
+//
+// Messages with IEEE float signals (SIG_VALTYPE_) are only inline: reading
+// float bits needs memcpy before C++20.
+
+struct DbcCompiledValue {
+    int64_t value;
+    const char* description;
+};
+
+struct DbcCompiledAttribute {
+    const char* name;
+    const char* value;
+};
+
+struct DbcCompiledSignal {
+    const char* name;
+    uint16_t start_bit;
+    uint8_t size;
+    bool little_endian;
+    bool is_signed;
+    DbcValueType value_type;
+    double factor;
+    double offset;
+    double minimum;
+    double maximum;
+    const char* unit;
+    const char* comment;
+    bool multiplexor;
+    int64_t mux_value;
+    const char* const* receivers;
+    size_t receiver_count;
+    const DbcCompiledAttribute* attributes;
+    size_t attribute_count;
+    const DbcCompiledValue* values;
+    size_t value_count;
+};
+
+struct DbcCompiledMessage {
+    uint32_t id;
+    const char* name;
+    uint8_t dlc;
+    uint32_t cycle_time_ms;
+    const char* transmitter;
+    const char* const* extra_transmitters;
+    size_t extra_transmitter_count;
+    const char* comment;
+    const DbcCompiledAttribute* attributes;
+    size_t attribute_count;
+    const DbcCompiledSignal* signals;
+    size_t signal_count;
+};
+
+// values of message id from a CAN_FD_MAX_LEN byte payload, false if the
+// DBC has no such message
+using DbcCompiledDecode = bool (*)(uint32_t id, const uint8_t* data, double* out);
+
+struct DbcCompiledDbc {
+    const DbcCompiledMessage* messages;
+    size_t message_count;
+    DbcCompiledDecode decode;
+};
+
+// -- helpers for the generated code --
+
+constexpr double dbc_scale(int64_t raw, double factor, double offset){
+    return static_cast<double>(raw) * factor + offset;
+}
+
+constexpr int64_t dbc_sign_extend(uint64_t raw, unsigned size){
+    return size >= 64 ? static_cast<int64_t>(raw)
+                      : static_cast<int64_t>(raw << (64 - size)) >> (64 - size);
+}
+
+// physical value back to raw bits, rounded to nearest
+constexpr uint64_t dbc_unscale(double value, double factor, double offset){
+    const double x = (value - offset) / factor;
+    return static_cast<uint64_t>(static_cast<int64_t>(x < 0.0 ? x - 0.5 : x + 0.5));
+}
+
+inline double dbc_float(uint64_t raw){
+    const uint32_t bits = static_cast<uint32_t>(raw);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline double dbc_double(uint64_t raw){
+    double d;
+    std::memcpy(&d, &raw, sizeof(d));
+    return d;
+}
+
+inline uint64_t dbc_float_bits(double value){
+    const float f = static_cast<float>(value);
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+inline uint64_t dbc_double_bits(double value){
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
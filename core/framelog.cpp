@@ -0,0 +1,14 @@
+#include "framelog.hpp"
+#include "canlog_reader.hpp"
+#include "mdf4.hpp"
+#include <algorithm>
+#include <cctype>
+
+std::unique_ptr<FrameLog> open_frame_log(const std::string& path){
+    std::string ext = path.size() > 4 ? path.substr(path.size() - 4) : std::string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char ch){ return static_cast<char>(std::tolower(ch)); });
+    if(ext == ".mf4" || ext == ".mdf")
+        return std::unique_ptr<FrameLog>(new Mdf4Reader(path));
+    return std::unique_ptr<FrameLog>(new CanLogReader(path));
+}
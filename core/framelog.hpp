@@ -0,0 +1,49 @@
+#pragma once
+
+#include "canlog.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A recorded, time ordered run of raw frames as replay and the exporters
+// walk it: a session directory (CanLogReader) or an MDF4 file (Mdf4Reader).
+// Records come out as canlog records whatever the storage, and every call is
+// const and safe from several threads at once.
+class FrameLog {
+    public:
+        // a record position; what the two numbers mean is up to the reader
+        // (segment / byte offset, data block / byte offset)
+        struct Cursor {
+            uint32_t segment = 0;
+            uint64_t offset = 0;
+
+            // log order
+            bool operator<(const Cursor& o) const {
+                return segment != o.segment ? segment < o.segment : offset < o.offset;
+            }
+            bool operator==(const Cursor& o) const { return segment == o.segment && offset == o.offset; }
+        };
+
+        virtual ~FrameLog() = default;
+
+        // what was opened, for messages
+        virtual const std::string& path() const = 0;
+        virtual uint64_t first_ns() const = 0;
+        virtual uint64_t last_ns() const = 0;
+        virtual uint64_t records() const = 0;
+        // bus number -> source name at recording time, may be empty
+        virtual const std::vector<std::string>& bus_names() const = 0;
+
+        virtual Cursor begin() const = 0;
+        // first record stamped at or after timestamp_ns, end() if none
+        virtual Cursor seek(uint64_t timestamp_ns) const = 0;
+        virtual Cursor end() const = 0;
+
+        // the record at c, then c moves past it; false at the end. payload
+        // stays valid as long as the log is open.
+        virtual bool next(Cursor& c, CanLogRecord& rec, const uint8_t*& payload) const = 0;
+};
+
+// a session directory or an .mf4 file; throws what the reader throws
+std::unique_ptr<FrameLog> open_frame_log(const std::string& path);
@@ -15,7 +15,9 @@
 #include <unordered_map>
 #include <utility>
 #include <vector>
+#include <algorithm>
 #include "backend.hpp"
+#include "clock.hpp"
 #include <thread>
 #include <cstdio>
 #include <deque>
@@ -69,11 +71,9 @@ static const ImU32 palette[] = {
 };
 
 // store history of decoded signal values for plotting
-static std::unordered_map<std::string, std::vector<double>> signal_times;
-static std::unordered_map<std::string, std::vector<double>> signal_values;
-static constexpr size_t MAX_SIGNAL_HISTORY = 500;
+static SignalHistory signal_history;
 
-static void render_plot_dock(const char* dock_id_str, std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>>& plots){
+static void render_plot_dock(const char* dock_id_str, std::unordered_map<std::string, std::vector<PlotSignal>>& plots){
     ImGuiID dock_id = ImGui::GetID(dock_id_str);
     ImGui::DockSpace(dock_id);
 
@@ -96,7 +96,7 @@ static void render_plot_dock(const char* dock_id_str, std::unordered_map<std::st
         ImGui::SetNextWindowSize(get_plot_size(size), ImGuiCond_FirstUseEver);
         ImGui::Begin(pl.first.c_str());
         auto drawer = g_plot_drawers.get_drawer(pl.first);
-        drawer(pl.first, pl.second, signal_times, signal_values);
+        drawer(pl.first, pl.second, signal_history);
         ImGui::End();
     }
 }
@@ -208,6 +208,7 @@ public:
     vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout,
                                  nullptr);
 
+    backend_shutdown();
     if (backend_thread.joinable())
         backend_thread.join();
   }
@@ -875,35 +876,46 @@ public:
     ImGui::End();
   }
 
+// every frame since the last visit is drained from the store's per-id
+// history and stamped with its receive time, not the render time. Signal
+// handles are looked up once per message and DBC snapshot version, the
+// per-sample path is a values-only decode and two appends.
 void update_signal_data(){
-    static double last_time = -1.0;
-    double now = ImGui::GetTime();
-    if (now == last_time)
-        return;
-    last_time = now;
+    static std::unordered_map<uint32_t, uint64_t> cursors;
+    static std::unordered_map<uint32_t, std::vector<SignalHandle>> handles;
+    static uint64_t version = 0;
+    static std::vector<CanFrame> frames;
 
-    auto messages = backend_get_messages();
+    const DbcSnapshotPtr snap = backend_dbc_snapshot();
+    const DbcCatalog &dbc = snap->dbc;
     const CanStore &store = get_can_store();
+    if(snap->version != version){
+        handles.clear();
+        version = snap->version;
+    }
 
-    for(const auto &mp : messages){
+    std::vector<double> vals;
+    std::vector<std::pair<std::string,double>> named;
+    for(const auto &mp : dbc.messages()){
         uint32_t id = mp.first;
-        const auto &msg = mp.second;
-        CanFrame frame;
-        if(store.read(id, frame)){
-            std::vector<std::pair<std::string,double>> vals;
-            if(backend_decode_signals(id, frame, vals)){
-                for(const auto &p : vals){
-                    std::string key = msg.dbc_name + ":" + std::to_string(id) + ":" + p.first;
-                    auto &xt = signal_times[key];
-                    auto &yv = signal_values[key];
-                    xt.push_back(now);
-                    yv.push_back(p.second);
-                    if(xt.size() > MAX_SIGNAL_HISTORY){
-                        xt.erase(xt.begin());
-                        yv.erase(yv.begin());
-                    }
-                }
+        const auto &msg = *mp.second;
+        frames.clear();
+        if(!store.history(id, cursors[id], frames))
+            continue;
+        auto &hs = handles[id];
+        for(const auto &frame : frames){
+            if(!dbc.decode_values(id, frame, vals))
+                break;
+            if(hs.size() != vals.size()){
+                hs.clear();
+                if(!dbc.decode_signals(id, frame, named))
+                    break;
+                for(const auto &p : named)
+                    hs.push_back(signal_history.handle(signal_key(msg.dbc_name, id, p.first)));
             }
+            double t = seconds_since_start(frame.timestamp_ns);
+            for(size_t i = 0; i < vals.size() && i < hs.size(); ++i)
+                signal_history.append(hs[i], t, vals[i]);
         }
     }
 }
@@ -916,130 +928,87 @@ std::unordered_map<std::string, int> dbc_idx = {
     {"DAQ", 4}
 };
 
+// A DBC tab's signals with their history handles and plots, resolved once
+// per DBC snapshot version like update_signal_data's handles. What goes to
+// the dock only changes when a signal gets its first samples, so a frame
+// checks each handle for data and rebuilds the plot lists just then.
+struct DbcPlots {
+    struct Entry {
+        SignalHandle handle;
+        std::string name;
+        std::string plot;
+        bool live;
+    };
+    bool built = false;
+    uint64_t version = 0;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, std::vector<PlotSignal>> plots;
+};
+
+void update_dbc_plots(DbcPlots& w, const std::string& dbc_name){
+    const DbcSnapshotPtr snap = backend_dbc_snapshot();
+    bool changed = false;
+    if(!w.built || w.version != snap->version){
+        w.entries.clear();
+        for(const auto &mp : snap->dbc.messages()){
+            const auto &msg = *mp.second;
+            if(msg.dbc_name != dbc_name)
+                continue;
+            for(const auto &sig : msg.signals){
+                std::string plot = g_plot_registry.get_plot(dbc_name, mp.first, sig.name);
+                if(plot.empty())
+                    plot = sig.name;
+                w.entries.push_back({signal_history.handle(signal_key(msg.dbc_name, mp.first, sig.name)),
+                                     sig.name, std::move(plot), false});
+            }
+        }
+        w.built = true;
+        w.version = snap->version;
+        changed = true;
+    }
+    for(auto &e : w.entries){
+        const bool live = !signal_history.view(e.handle).empty();
+        if(live != e.live){
+            e.live = live;
+            changed = true;
+        }
+    }
+    if(changed){
+        w.plots.clear();
+        for(const auto &e : w.entries)
+            if(e.live)
+                w.plots[e.plot].push_back({e.handle, e.name});
+    }
+}
+
 void bps_window(){
-      auto messages = backend_get_messages();
-      std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> plots;
-
-      for(const auto &mp : messages){
-          const auto &msg = mp.second;
-          if(msg.dbc_name != "BPS")
-              continue;
-          for(const auto &sig : mp.second.signals){
-              std::string key = msg.dbc_name + ":" + std::to_string(mp.first) + ":" + sig.name;
-              auto itx = signal_times.find(key);
-              auto ity = signal_values.find(key);
-              if(itx == signal_times.end() || ity == signal_values.end())
-                  continue;
-              if(itx->second.empty())
-                  continue;
-              std::string plot = g_plot_registry.get_plot("BPS", mp.first, sig.name);
-              if(plot.empty())
-                  plot = sig.name;
-              plots[plot].push_back({key, sig.name});
-          }
-      }
-     render_plot_dock("BPSDock", plots);
+      static DbcPlots plots;
+      update_dbc_plots(plots, "BPS");
+      render_plot_dock("BPSDock", plots.plots);
 }
 
 void controls_window(){
-      auto messages = backend_get_messages();
-      std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> plots;
-
-      for(const auto &mp : messages){
-          const auto &msg = mp.second;
-          if(msg.dbc_name != "Controls")
-              continue;
-          for(const auto &sig : mp.second.signals){
-              std::string key = msg.dbc_name + ":" + std::to_string(mp.first) +":" + sig.name;
-              auto itx = signal_times.find(key);
-              auto ity = signal_values.find(key);
-              if(itx == signal_times.end() || ity == signal_values.end())
-                  continue;
-              if(itx->second.empty())
-                  continue;
-              std::string plot = g_plot_registry.get_plot("Controls", mp.first, sig.name);
-              if(plot.empty())
-                  plot = sig.name;
-              plots[plot].push_back({key, sig.name});
-          }
-      }
-     render_plot_dock("MPPTDock", plots);
+      static DbcPlots plots;
+      update_dbc_plots(plots, "Controls");
+      render_plot_dock("MPPTDock", plots.plots);
 }
 
 void prohelion_window(){
-      auto messages = backend_get_messages();
-      std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> plots;
-
-      for(const auto &mp : messages){
-          const auto &msg = mp.second;
-          if(msg.dbc_name != "Wavesculptor22")
-              continue;
-          for(const auto &sig : mp.second.signals){
-              std::string key = msg.dbc_name + ":" + std::to_string(mp.first) + ":" + sig.name;
-              auto itx = signal_times.find(key);
-              auto ity = signal_values.find(key);
-              if(itx == signal_times.end() || ity == signal_values.end())
-                  continue;
-              if(itx->second.empty())
-                  continue;
-              std::string plot = g_plot_registry.get_plot("Wavesculptor22", mp.first, sig.name);
-              if(plot.empty())
-                  plot = sig.name;
-              plots[plot].push_back({key, sig.name});
-          }
-      }
-      render_plot_dock("ProhelionDock", plots);
+      static DbcPlots plots;
+      update_dbc_plots(plots, "Wavesculptor22");
+      render_plot_dock("ProhelionDock", plots.plots);
 }
 
 void mppt_window(){
-      auto messages = backend_get_messages();
-      std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> plots;
-
-      for(const auto &mp : messages){
-          const auto &msg = mp.second;
-          if(msg.dbc_name != "MPPT")
-              continue;
-          for(const auto &sig : mp.second.signals){
-              std::string key = msg.dbc_name + ":" + std::to_string(mp.first) + ":" + sig.name;
-              auto itx = signal_times.find(key);
-              auto ity = signal_values.find(key);
-              if(itx == signal_times.end() || ity == signal_values.end())
-                  continue;
-              if(itx->second.empty())
-                  continue;
-              std::string plot = g_plot_registry.get_plot("MPPT", mp.first, sig.name);
-              if(plot.empty())
-                  plot = sig.name;
-              plots[plot].push_back({key, sig.name});
-          }
-      }
-      render_plot_dock("MPPTDock", plots);
+      static DbcPlots plots;
+      update_dbc_plots(plots, "MPPT");
+      render_plot_dock("MPPTDock", plots.plots);
 }
 
 void daq_window(){
-      auto messages = backend_get_messages();
-      std::unordered_map<std::string, std::vector<std::pair<std::string,std::string>>> plots;
-
-      for(const auto &mp : messages){
-          const auto &msg = mp.second;
-          if(msg.dbc_name != "DAQ")
-              continue;
-          for(const auto &sig : mp.second.signals){
-              std::string key = msg.dbc_name + ":" + std::to_string(mp.first) + ":" + sig.name;
-              auto itx = signal_times.find(key);
-              auto ity = signal_values.find(key);
-              if(itx == signal_times.end() || ity == signal_values.end())
-                  continue;
-              if(itx->second.empty())
-                  continue;
-              std::string plot = g_plot_registry.get_plot("DAQ", mp.first, sig.name);
-              if(plot.empty())
-                  plot = sig.name;
-              plots[plot].push_back({key, sig.name});
-          }
-      }
-
-      render_plot_dock("DAQDock", plots);
+      static DbcPlots plots;
+      update_dbc_plots(plots, "DAQ");
+      render_plot_dock("DAQDock", plots.plots);
 }
 
 void embededPlotContents(const char * dbc_name){
@@ -1059,30 +1028,12 @@ void embededPlotContents(const char * dbc_name){
 }
 
 void sigPlotContents(const char* dbc_name){
-      auto messages = backend_get_messages();
-      for(const auto &mp : messages){
-          const auto &msg = mp.second;
-          if(msg.dbc_name != dbc_name)
-              continue;
-          for(const auto &sig : mp.second.signals){
-              std::string key = msg.dbc_name + ":" + std::to_string(mp.first) + ":" + sig.name;
-              auto itx = signal_times.find(key);
-              auto ity = signal_values.find(key);
-              if(itx == signal_times.end() || ity == signal_values.end())
-                  continue;
-              const auto &xs = itx->second;
-              const auto &ys = ity->second;
-              if(xs.empty())
-                  continue;
-              if(ImPlot::BeginPlot(sig.name.c_str())){
-                  std::cout << dbc_name << std::endl;
-                  ImPlot::SetupAxes("Time", "Value", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
-                  ImPlot::SetupAxisLimits(ImAxis_X1, xs.front(), xs.back(), ImGuiCond_Always);
-                  ImPlot::PlotLine(sig.name.c_str(), xs.data(), ys.data(), ys.size());
-                  ImPlot::EndPlot();
-              }
-          }
-      }
+      static std::unordered_map<std::string, DbcPlots> tabs;
+      DbcPlots &plots = tabs[dbc_name];
+      update_dbc_plots(plots, dbc_name);
+      for(const auto &e : plots.entries)
+          if(e.live)
+              plot_time_series(e.name, "Value", {{e.handle, e.name}}, signal_history);
   }
 
   void sourceConfigContents(){
@@ -1095,17 +1046,23 @@ void sigPlotContents(const char* dbc_name){
       static char baudBuf[16]   = "";
       static char ipBuf[64]     = "";
       static char portBuf[8]    = "";
+      static char canBuf[16]    = "";
+      static char replayBuf[128] = "";
 
       // -- hints --
       static std::string serialHint = "e.g. /dev/ttyUSB0";
       static std::string baudHint   = "e.g. 115200";
       static std::string ipHint     = "e.g. 192.168.1.2";
       static std::string portHint   = "e.g. 8080";
+      static std::string canHint    = "e.g. can0";
+      static std::string replayHint = "session dir, .mf4 or .log/.asc/.trc file";
 
-      const char* protocol_list[] = { "Data Acq. Server", "Serial", "TCP" };
+      const char* protocol_list[] = { "Data Acq. Server", "Serial", "TCP", "SocketCAN", "Replay" };
       static int protocol_idx = 0;
 
-      static int connected = 0;
+      auto active = list_data_sources();
+      ReplayStatus replay = backend_replay_status();
+      bool connected = !active.empty() || replay.open;
 
       ImGui::Combo("##01", &protocol_idx, protocol_list, ((int)sizeof(protocol_list) / sizeof(*(protocol_list))));
       ImGui::SameLine();
@@ -1113,7 +1070,7 @@ void sigPlotContents(const char* dbc_name){
         input_flag = 1;
 
       ImGui::SameLine();
-      if(ImGui::Button("Close Connection"))
+      if(ImGui::Button("Close All"))
           close_flag = 1;
 
       if(protocol_idx == 0){
@@ -1129,6 +1086,16 @@ void sigPlotContents(const char* dbc_name){
         ImGui::InputTextWithHint("##04", ipHint.c_str(), ipBuf, sizeof(ipBuf), ImGuiInputTextFlags_CharsDecimal | ImGuiInputTextFlags_CharsNoBlank);
         ImGui::InputTextWithHint("##05", portHint.c_str(), portBuf, sizeof(portBuf), ImGuiInputTextFlags_CharsDecimal);
       }
+      if(protocol_idx == 3){
+        ImGui::InputTextWithHint("##06", canHint.c_str(), canBuf, sizeof(canBuf), ImGuiInputTextFlags_CharsNoBlank);
+        ImVec2 slot_size(ImGui::CalcItemWidth(), ImGui::GetFrameHeight());
+        ImGui::Dummy(slot_size);
+      }
+      if(protocol_idx == 4){
+        ImGui::InputTextWithHint("##08", replayHint.c_str(), replayBuf, sizeof(replayBuf));
+        ImVec2 slot_size(ImGui::CalcItemWidth(), ImGui::GetFrameHeight());
+        ImGui::Dummy(slot_size);
+      }
       
       ImDrawList* draw_list = ImGui::GetWindowDrawList();
       ImVec2 gradient_size = ImVec2(ImGui::GetContentRegionAvail().x, ImGui::GetFrameHeight());
@@ -1147,11 +1114,76 @@ void sigPlotContents(const char* dbc_name){
       draw_list->AddRectFilledMultiColor(p0, p1, col_a, col_b, col_b, col_a);
       ImGui::InvisibleButton("##gradient2", gradient_size);
 
+      // -- active sources, each one can be closed on its own --
+      for(const auto &src : active){
+          ImGui::TextUnformatted(src.second.c_str());
+          ImGui::SameLine();
+          std::string btn = "Close##src" + std::to_string(src.first);
+          if(ImGui::Button(btn.c_str()))
+              kill_data_source(src.first);
+      }
+
+      // -- replay, positions are seconds into the log --
+      if(replay.open){
+          static const double speeds[] = { 0.25, 0.5, 1.0, 2.0, 5.0, 10.0, 100.0, 0.0 };
+          static const char* speed_names[] = { "0.25x", "0.5x", "1x", "2x", "5x", "10x", "100x", "Max" };
+          static int speed_idx = 2;
+
+          ImGui::TextUnformatted(("Replay " + replay.directory).c_str());
+          ImGui::SameLine();
+          if(ImGui::Button("Close##replay"))
+              forward_replay_close();
+          ImGui::SameLine();
+          if(ImGui::Button("Export Arrow"))
+              forward_export_arrow(replay.directory);
+
+          if(ImGui::Button(replay.paused ? "Play" : "Pause"))
+              forward_replay_pause(!replay.paused);
+          ImGui::SameLine();
+          if(ImGui::Button("Step"))
+              forward_replay_step();
+          ImGui::SameLine();
+          ImGui::SetNextItemWidth(80);
+          if(ImGui::Combo("##replay_speed", &speed_idx, speed_names, IM_ARRAYSIZE(speed_names)))
+              forward_replay_speed(speeds[speed_idx]);
+          ImGui::SameLine();
+          ImGui::Text("%llu frames  %.0f/s%s", (unsigned long long)replay.frames, replay.rate_hz,
+                      replay.finished ? "  (end)" : "");
+
+          // position is 0 before the first frame goes out and a seek can
+          // land it anywhere, so clamp into the log before subtracting
+          const uint64_t last_ns = std::max(replay.last_ns, replay.first_ns);
+          const uint64_t position_ns = std::min(std::max(replay.position_ns, replay.first_ns), last_ns);
+          const float length = static_cast<float>((last_ns - replay.first_ns) * 1e-9);
+          float position = static_cast<float>((position_ns - replay.first_ns) * 1e-9);
+          if(ImGui::SliderFloat("##replay_pos", &position, 0.0f, length, "%.1f s"))
+              forward_replay_seek(replay.first_ns + static_cast<uint64_t>(std::max(position, 0.0f) * 1e9));
+      }
+
+      // -- session recording --
+      static char recordBuf[128] = "";
+      static bool recordMdf = false;
+      const SessionRecorder &rec = get_recorder();
+      if(!rec.active()){
+          ImGui::InputTextWithHint("##07", "session dir (default sessions/<time>)", recordBuf, sizeof(recordBuf));
+          ImGui::SameLine();
+          ImGui::Checkbox("+MF4", &recordMdf);
+          ImGui::SameLine();
+          if(ImGui::Button("Record"))
+              forward_record_start(recordBuf, recordMdf);
+      } else {
+          if(ImGui::Button("Stop Recording"))
+              forward_record_stop();
+          ImGui::SameLine();
+          ImGui::Text("%s  %llu frames  %.1f MB  %llu dropped", rec.directory().c_str(),
+                      (unsigned long long)rec.frames(), rec.bytes_written() / 1e6,
+                      (unsigned long long)rec.dropped());
+      }
+
       if(close_flag == 1){
-          connected = 0;
           kill_data_source();
           close_flag = 0;
-          serialBuf[0] = baudBuf[0] = ipBuf[0] = portBuf[0] = '\0';
+          serialBuf[0] = baudBuf[0] = ipBuf[0] = portBuf[0] = canBuf[0] = replayBuf[0] = '\0';
       }
 
       if(input_flag == 1){
@@ -1175,9 +1207,18 @@ void sigPlotContents(const char* dbc_name){
             ipHint   = (!ipStr.empty())  ? ipStr  : "e.g. 192.168.1.2";
             portHint = (!prtStr.empty()) ? prtStr : "e.g. 8080";
           }
+          if(protocol_idx == 3){
+            std::string ifStr(canBuf);
+            forward_socketcan_source(ifStr);
+            canHint = (!ifStr.empty()) ? ifStr : "e.g. can0";
+          }
+          if(protocol_idx == 4){
+            std::string dirStr(replayBuf);
+            forward_replay_source(dirStr);
+            replayHint = (!dirStr.empty()) ? dirStr : "session dir, .mf4 or .log/.asc/.trc file";
+          }
 
-          serialBuf[0] = baudBuf[0] = ipBuf[0] = portBuf[0] = '\0';
-          connected = 1;
+          serialBuf[0] = baudBuf[0] = ipBuf[0] = portBuf[0] = canBuf[0] = replayBuf[0] = '\0';
       }
 
   }
@@ -1273,6 +1314,28 @@ void sigPlotContents(const char* dbc_name){
     ImGui::End();
   }
 
+  // one line per bus: frames, frame rate, estimated load against its bit rate
+  void busStatsContents(){
+      auto buses = backend_bus_stats();
+      if (buses.empty())
+        return;
+      const uint64_t now = monotonic_ns();
+      for (const auto &bus : buses) {
+        double load = bus->load(now);
+        ImGui::Text("%s  %llu frames  %.0f fps  load %.1f%%", bus->name().c_str(),
+                    static_cast<unsigned long long>(bus->frames()), bus->rate_hz(now), load * 100.0);
+        ImGui::SameLine();
+        int kbit = static_cast<int>(bus->bitrate() / 1000);
+        ImGui::SetNextItemWidth(80.0f);
+        std::string label = "kbit/s##" + bus->name();
+        if (ImGui::InputInt(label.c_str(), &kbit, 0, 0, ImGuiInputTextFlags_EnterReturnsTrue) && kbit > 0)
+          bus->set_bitrate(static_cast<uint32_t>(kbit) * 1000u);
+      }
+      ImGui::Separator();
+  }
+
+  enum CanTableColumn { ColId, ColLen, ColFrames, ColRate, ColMeanRate, ColJitter, ColAge, ColDlc, ColDecoded, ColCount_ };
+
   void canTableContents(){
       //const char * path = "log.txt";
       //std::ofstream file(path, std::ios::out | std::ios::app);
@@ -1280,34 +1343,143 @@ void sigPlotContents(const char* dbc_name){
                                    ImGuiTableFlags_BordersV |
                                    ImGuiTableFlags_RowBg |
                                    ImGuiTableFlags_Resizable |
+                                   ImGuiTableFlags_Sortable |
                                    ImGuiTableFlags_ScrollY;
-      if (ImGui::BeginTable("cantable", 3, flags)) {
-        ImGui::TableSetupColumn("ID", ImGuiTableColumnFlags_WidthFixed, 48.0f);
-        ImGui::TableSetupColumn("Len", ImGuiTableColumnFlags_WidthFixed, 24.0f);
-        ImGui::TableSetupColumn("Decoded");
+      busStatsContents();
+      const DbcSnapshotPtr snap = backend_dbc_snapshot();
+      if (ImGui::BeginTable("cantable", ColCount_, flags)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("ID", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort, 80.0f, ColId);
+        ImGui::TableSetupColumn("Len", ImGuiTableColumnFlags_WidthFixed, 24.0f, ColLen);
+        ImGui::TableSetupColumn("Count", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 64.0f, ColFrames);
+        ImGui::TableSetupColumn("Hz", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 48.0f, ColRate);
+        ImGui::TableSetupColumn("Avg Hz", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 48.0f, ColMeanRate);
+        ImGui::TableSetupColumn("Jitter ms", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 56.0f, ColJitter);
+        ImGui::TableSetupColumn("Age s", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 48.0f, ColAge);
+        ImGui::TableSetupColumn("DLC err", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 48.0f, ColDlc);
+        ImGui::TableSetupColumn("Decoded", ImGuiTableColumnFlags_NoSort, 0.0f, ColDecoded);
         ImGui::TableHeadersRow();
 
+        // the store is dense in arrival order, keep a sorted view of it
+        // ids can be known (e.g. sized from a DBC) before any frame arrives,
+        // those wait in pending until they have data
         const CanStore &store = get_can_store();
-        for (uint32_t id = 0; id < CanStore::MAX_IDS; ++id) {
-          CanFrame frame;
-          if (store.read(id, frame)) {
-            ImGui::TableNextRow();
-            ImGui::TableSetColumnIndex(0);
-            ImGui::Text("0x%03X", id);
-            ImGui::TableSetColumnIndex(1);
-            ImGui::Text("%d", frame.len);
-
-            ImGui::TableSetColumnIndex(2);
-            std::string decoded;
-            if (backend_decode(id, frame, decoded)){
-              ImGui::TextUnformatted(decoded.c_str());
-              //file << decoded.c_str() << std::endl;
+        static std::vector<uint32_t> order;
+        static std::vector<uint32_t> pending;
+        static size_t scanned = 0;
+        bool grew = false;
+        for (; scanned < store.size(); ++scanned)
+          pending.push_back(static_cast<uint32_t>(scanned));
+        auto ready = std::stable_partition(pending.begin(), pending.end(), [&store](uint32_t i) {
+          return store.sequence_at(i) == 0;
+        });
+        if (ready != pending.end()) {
+          order.insert(order.end(), ready, pending.end());
+          pending.erase(ready, pending.end());
+          grew = true;
+        }
+
+        // counters are snapshotted once per frame for sorting and drawing
+        static std::vector<IdStats> stats;
+        stats.resize(store.size());
+        for (uint32_t i : order)
+          store.stats_at(i, stats[i]);
+        const uint64_t now = monotonic_ns();
+
+        // the id order only changes with new ids, everything else is live
+        static int sort_column = ColId;
+        static bool descending = false;
+        ImGuiTableSortSpecs *specs = ImGui::TableGetSortSpecs();
+        bool resort = grew;
+        if (specs && specs->SpecsDirty) {
+          if (specs->SpecsCount > 0) {
+            sort_column = specs->Specs[0].ColumnUserID;
+            descending = specs->Specs[0].SortDirection == ImGuiSortDirection_Descending;
+          }
+          specs->SpecsDirty = false;
+          resort = true;
+        }
+        if (resort || sort_column != ColId) {
+          // one key per id and frame, the comparator only looks them up
+          static std::vector<double> keys;
+          keys.resize(store.size());
+          for (uint32_t i : order) {
+            const IdStats &st = stats[i];
+            switch (sort_column) {
+              case ColLen: {
+                CanFrame f;
+                keys[i] = store.read_at(i, f) ? f.len : 0;
+                break;
+              }
+              case ColFrames: keys[i] = static_cast<double>(st.frames); break;
+              case ColRate: keys[i] = st.rate_hz(); break;
+              case ColMeanRate: keys[i] = st.mean_rate_hz(); break;
+              case ColJitter: keys[i] = static_cast<double>(st.jitter_ns); break;
+              case ColAge: keys[i] = static_cast<double>(now - std::min(now, st.last_ns)); break;
+              case ColDlc: keys[i] = st.dlc_mismatches; break;
+              default: keys[i] = static_cast<double>(store.id_at(i)); break;
             }
-            else {
-              char buf[3 * 8 + 1] = {0};
-              for (uint8_t i = 0; i < frame.len; ++i)
-                sprintf(buf + i * 3, "%02X ", frame.data[i]);
-              ImGui::TextUnformatted(buf);
+          }
+          std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            if (keys[a] != keys[b])
+              return descending ? keys[a] > keys[b] : keys[a] < keys[b];
+            return store.id_at(a) < store.id_at(b);
+          });
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(order.size()));
+        while (clipper.Step()) {
+          for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            uint32_t id = store.id_at(order[row]);
+            const IdStats &st = stats[order[row]];
+            CanFrame frame;
+            ImGui::TableNextRow();
+            if (store.read_at(order[row], frame)) {
+              ImGui::TableSetColumnIndex(ColId);
+              if (id & CAN_ID_EXT_FLAG)
+                ImGui::Text("0x%08X", id & CAN_ID_EXT_MASK);
+              else
+                ImGui::Text("0x%03X", id);
+              ImGui::TableSetColumnIndex(ColLen);
+              ImGui::Text("%d", frame.len);
+
+              ImGui::TableSetColumnIndex(ColFrames);
+              ImGui::Text("%llu", static_cast<unsigned long long>(st.frames));
+              ImGui::TableSetColumnIndex(ColRate);
+              ImGui::Text("%.1f", st.rate_hz());
+              ImGui::TableSetColumnIndex(ColMeanRate);
+              ImGui::Text("%.1f", st.mean_rate_hz());
+              ImGui::TableSetColumnIndex(ColJitter);
+              ImGui::Text("%.2f", st.jitter_ns * 1e-6);
+
+              // stale once it missed a few of its usual periods
+              ImGui::TableSetColumnIndex(ColAge);
+              uint64_t age = now - std::min(now, st.last_ns);
+              bool stale = st.mean_interval_ns && age > 3 * st.mean_interval_ns;
+              if (stale)
+                ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "%.2f", age * 1e-9);
+              else
+                ImGui::Text("%.2f", age * 1e-9);
+
+              ImGui::TableSetColumnIndex(ColDlc);
+              if (st.dlc_mismatches)
+                ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%u", st.dlc_mismatches);
+              else
+                ImGui::TextUnformatted("0");
+
+              ImGui::TableSetColumnIndex(ColDecoded);
+              std::string decoded;
+              if (snap->dbc.decode(id, frame, decoded)){
+                ImGui::TextUnformatted(decoded.c_str());
+                //file << decoded.c_str() << std::endl;
+              }
+              else {
+                char buf[3 * CAN_FD_MAX_LEN + 1] = {0};
+                for (uint8_t i = 0; i < frame.len; ++i)
+                  sprintf(buf + i * 3, "%02X ", frame.data[i]);
+                ImGui::TextUnformatted(buf);
+              }
             }
           }
         }
@@ -1405,6 +1577,17 @@ void dbcConfigContents(){
               forward_dbc_unload(files[i]);
           }
       }
+      bool hot_reload = backend_dbc_hot_reload();
+      if(ImGui::Checkbox("Reload on save", &hot_reload))
+          forward_dbc_hot_reload(hot_reload);
+
+      const DbcSnapshotPtr snap = backend_dbc_snapshot();
+      if(!snap->dbc.conflicts().empty()){
+          ImGui::Separator();
+          ImGui::Text("ID conflicts:");
+          for(const auto &c : snap->dbc.conflicts())
+              ImGui::Text("0x%X %s over %s", c.id, c.kept->name.c_str(), c.replaced->name.c_str());
+      }
   }
 
 void dbcConfigWindow(){
@@ -1416,8 +1599,8 @@ void dbcConfigWindow(){
 
 void configTabContents(){
     // -- Top source config --
-    ImGui::BeginChild("src_cfg", ImVec2(0, 120), true,
-                      ImGuiWindowFlags_NoMove|ImGuiWindowFlags_NoResize|ImGuiWindowFlags_NoScrollbar|ImGuiWindowFlags_NoScrollWithMouse);
+    ImGui::BeginChild("src_cfg", ImVec2(0, 160), true,
+                      ImGuiWindowFlags_NoMove|ImGuiWindowFlags_NoResize);
     sourceConfigContents();
     ImGui::EndChild();
 
@@ -0,0 +1,757 @@
+#include "logimport.hpp"
+#include "canlog_writer.hpp"
+#include "candb.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr size_t CHUNK_BYTES = 16u << 20;
+static constexpr size_t HEADER_SCAN_BYTES = 64u << 10;
+
+namespace {
+
+// a parsed frame, payload in the chunk's byte pool
+struct Frame {
+    uint64_t timestamp_ns;
+    uint32_t id;
+    uint32_t data;
+    uint8_t bus;
+    uint8_t len;
+    uint8_t flags;
+};
+
+struct Options {
+    LogFormat format = LogFormat::Unknown;
+    bool hex = true;              // ASC "base hex"
+    bool relative = false;        // ASC "timestamps relative"
+    int trc_version = 10;         // TRC $FILEVERSION x10
+    std::string columns;          // TRC 2.x $COLUMNS, one letter each
+    uint64_t base_ns = 0;         // TRC $STARTTIME
+};
+
+struct Chunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    std::vector<Frame> frames;
+    std::vector<uint8_t> data;
+    std::vector<std::string> buses; // chunk local bus numbering
+    uint64_t skipped = 0;
+    uint64_t elapsed_ns = 0;        // ASC relative: every stamp in the chunk added up
+
+    uint8_t bus(const char* b, const char* e){
+        const size_t n = static_cast<size_t>(e - b);
+        for(size_t i = 0; i < buses.size(); ++i)
+            if(buses[i].size() == n && std::memcmp(buses[i].data(), b, n) == 0)
+                return static_cast<uint8_t>(i);
+        buses.emplace_back(b, n);
+        return static_cast<uint8_t>(std::min<size_t>(buses.size() - 1, 255));
+    }
+
+    uint8_t* add(uint64_t ts, uint32_t id, uint8_t bus, uint8_t len, uint8_t flags){
+        frames.push_back(Frame{ts, id, static_cast<uint32_t>(data.size()), bus, len, flags});
+        data.resize(data.size() + len);
+        return data.data() + data.size() - len;
+    }
+};
+
+// -- tokens and numbers --
+
+inline bool is_blank(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline int hex_digit(char c){
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+inline bool next_token(const char*& p, const char* end, const char*& b, const char*& e){
+    while(p < end && is_blank(*p))
+        ++p;
+    if(p == end)
+        return false;
+    b = p;
+    while(p < end && !is_blank(*p))
+        ++p;
+    e = p;
+    return true;
+}
+
+inline bool token_is(const char* b, const char* e, const char* word){
+    const size_t n = std::strlen(word);
+    return static_cast<size_t>(e - b) == n && std::memcmp(b, word, n) == 0;
+}
+
+inline bool parse_hex(const char* b, const char* e, uint32_t& v){
+    if(b == e || e - b > 8)
+        return false;
+    v = 0;
+    for(; b < e; ++b){
+        int d = hex_digit(*b);
+        if(d < 0)
+            return false;
+        v = (v << 4) | static_cast<uint32_t>(d);
+    }
+    return true;
+}
+
+inline bool parse_dec(const char* b, const char* e, uint32_t& v){
+    if(b == e || e - b > 10)
+        return false;
+    uint64_t acc = 0;
+    for(; b < e; ++b){
+        if(*b < '0' || *b > '9')
+            return false;
+        acc = acc * 10 + static_cast<uint64_t>(*b - '0');
+    }
+    if(acc > 0xFFFFFFFFull)
+        return false;
+    v = static_cast<uint32_t>(acc);
+    return true;
+}
+
+// "123.456" in units of unit_ns, exact to the nanosecond
+inline bool parse_fixed(const char* b, const char* e, uint64_t unit_ns, uint64_t& ns){
+    uint64_t whole = 0;
+    const char* p = b;
+    while(p < e && *p >= '0' && *p <= '9')
+        whole = whole * 10 + static_cast<uint64_t>(*p++ - '0');
+    if(p == b)
+        return false;
+    uint64_t frac = 0;
+    int digits = 0;
+    if(p < e && *p == '.'){
+        for(++p; p < e && *p >= '0' && *p <= '9'; ++p)
+            if(digits < 9){
+                frac = frac * 10 + static_cast<uint64_t>(*p - '0');
+                ++digits;
+            }
+    }
+    if(p != e)
+        return false;
+    for(; digits < 9; ++digits)
+        frac *= 10;
+    ns = whole * unit_ns + frac * unit_ns / 1000000000ull;
+    return true;
+}
+
+inline bool parse_byte(const char* b, const char* e, bool hex, uint8_t& out){
+    uint32_t v;
+    if(!(hex ? parse_hex(b, e, v) : parse_dec(b, e, v)) || v > 0xFF)
+        return false;
+    out = static_cast<uint8_t>(v);
+    return true;
+}
+
+// count bytes from the rest of the line into dst
+inline bool parse_bytes(const char*& p, const char* end, bool hex, uint8_t count, uint8_t* dst){
+    const char *b, *e;
+    for(uint8_t i = 0; i < count; ++i)
+        if(!next_token(p, end, b, e) || !parse_byte(b, e, hex, dst[i]))
+            return false;
+    return true;
+}
+
+inline uint8_t dlc_to_len(uint32_t dlc){
+    return can_dlc_to_len(static_cast<uint8_t>(std::min<uint32_t>(dlc, 15)));
+}
+
+// -- candump -l --
+//   (1436509052.249713) can0 123#DEADBEEF
+//   (1436509052.249713) can0 12345678#R / 123#R3 / 123##1<fd data>
+
+bool parse_candump(Chunk& c, const char* p, const char* end){
+    if(p == end || *p != '(')
+        return false;
+    const char* close = static_cast<const char*>(std::memchr(p, ')', static_cast<size_t>(end - p)));
+    uint64_t ts;
+    if(!close || !parse_fixed(p + 1, close, 1000000000ull, ts))
+        return false;
+    p = close + 1;
+
+    const char *ib, *ie, *fb, *fe;
+    if(!next_token(p, end, ib, ie) || !next_token(p, end, fb, fe))
+        return false;
+    const char* hash = static_cast<const char*>(std::memchr(fb, '#', static_cast<size_t>(fe - fb)));
+    uint32_t raw;
+    if(!hash || !parse_hex(fb, hash, raw)){
+        ++c.skipped;
+        return false;
+    }
+    uint32_t id;
+    if(hash - fb == 8){
+        if(raw & 0x20000000u){ // error frame
+            ++c.skipped;
+            return false;
+        }
+        id = CAN_ID_EXT_FLAG | (raw & CAN_ID_EXT_MASK);
+    } else {
+        id = raw & CAN_ID_STD_MASK;
+    }
+
+    const char* d = hash + 1;
+    uint8_t flags = 0;
+    size_t max_len = CAN_CLASSIC_MAX_LEN;
+    if(d < fe && *d == '#'){
+        if(d + 1 >= fe || hex_digit(d[1]) < 0){
+            ++c.skipped;
+            return false;
+        }
+        flags = CANLOG_FLAG_FD | ((hex_digit(d[1]) & 1) ? CANLOG_FLAG_BRS : 0);
+        max_len = CAN_FD_MAX_LEN;
+        d += 2;
+    } else if(d < fe && (*d == 'R' || *d == 'r')){
+        // remote frames carry no data, stored without their DLC like live ones
+        c.add(ts, id | CAN_ID_RTR_FLAG, c.bus(ib, ie), 0, 0);
+        return true;
+    }
+
+    const size_t digits = static_cast<size_t>(fe - d);
+    if(digits % 2 || digits / 2 > max_len){
+        ++c.skipped;
+        return false;
+    }
+    const uint8_t len = static_cast<uint8_t>(digits / 2);
+    uint8_t* dst = c.add(ts, id, c.bus(ib, ie), len, flags);
+    for(uint8_t i = 0; i < len; ++i){
+        int hi = hex_digit(d[2 * i]), lo = hex_digit(d[2 * i + 1]);
+        if(hi < 0 || lo < 0){
+            c.frames.pop_back();
+            c.data.resize(c.data.size() - len);
+            ++c.skipped;
+            return false;
+        }
+        dst[i] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    return true;
+}
+
+// -- Vector ASC --
+//   0.010000 1  123x            Rx   d 8 01 02 03 04 05 06 07 08  Length = ...
+//   0.010000 1  123             Rx   r
+//   0.010000 CANFD   1 Rx        123  [name]  1 0 d 12 01 02 ...
+
+bool parse_asc_id(const char* b, const char* e, bool hex, uint32_t& id){
+    bool ext = false;
+    if(e > b && (e[-1] == 'x' || e[-1] == 'X')){
+        ext = true;
+        --e;
+    }
+    uint32_t raw;
+    if(!(hex ? parse_hex(b, e, raw) : parse_dec(b, e, raw)))
+        return false;
+    id = ext ? (CAN_ID_EXT_FLAG | (raw & CAN_ID_EXT_MASK)) : (raw & CAN_ID_STD_MASK);
+    return true;
+}
+
+uint8_t asc_bus(Chunk& c, uint32_t channel){
+    char name[16];
+    int n = std::snprintf(name, sizeof(name), "CAN %u", channel);
+    return c.bus(name, name + n);
+}
+
+bool parse_asc(Chunk& c, const Options& opt, const char* p, const char* end){
+    const char *b, *e;
+    uint64_t ts;
+    if(!next_token(p, end, b, e) || !parse_fixed(b, e, 1000000000ull, ts))
+        return false; // header, comment or trigger block line
+    if(opt.relative){
+        c.elapsed_ns += ts;
+        ts = c.elapsed_ns;
+    }
+    if(!next_token(p, end, b, e))
+        return false;
+
+    uint32_t channel, id;
+    uint8_t data[CAN_FD_MAX_LEN];
+    if(token_is(b, e, "CANFD")){
+        const char *cb, *ce, *db, *de, *ib, *ie;
+        if(!next_token(p, end, cb, ce) || !parse_dec(cb, ce, channel) ||
+           !next_token(p, end, db, de) || !(token_is(db, de, "Rx") || token_is(db, de, "Tx")) ||
+           !next_token(p, end, ib, ie) || !parse_asc_id(ib, ie, opt.hex, id)){
+            ++c.skipped;
+            return false;
+        }
+        // an optional symbolic name sits between the id and the BRS flag
+        const char *sb, *se;
+        if(!next_token(p, end, sb, se)){
+            ++c.skipped;
+            return false;
+        }
+        if(se - sb != 1 && !next_token(p, end, sb, se)){
+            ++c.skipped;
+            return false;
+        }
+        uint32_t brs, esi, dlc, len;
+        const char *xb, *xe, *lb, *le, *kb, *ke;
+        if(!parse_dec(sb, se, brs) || !next_token(p, end, xb, xe) || !parse_dec(xb, xe, esi) ||
+           !next_token(p, end, kb, ke) || !parse_hex(kb, ke, dlc) ||
+           !next_token(p, end, lb, le) || !parse_dec(lb, le, len) || len > CAN_FD_MAX_LEN ||
+           !parse_bytes(p, end, opt.hex, static_cast<uint8_t>(len), data)){
+            ++c.skipped;
+            return false;
+        }
+        (void)esi;
+        (void)dlc;
+        uint8_t* dst = c.add(ts, id, asc_bus(c, channel), static_cast<uint8_t>(len),
+                             CANLOG_FLAG_FD | (brs ? CANLOG_FLAG_BRS : 0));
+        std::memcpy(dst, data, len);
+        return true;
+    }
+
+    // classic; anything else after the channel (ErrorFrame, Statistic:, ...)
+    // is not a frame
+    const char *ib, *ie, *db, *de, *tb, *te;
+    if(!parse_dec(b, e, channel) || !next_token(p, end, ib, ie) || !parse_asc_id(ib, ie, opt.hex, id) ||
+       !next_token(p, end, db, de) || !(token_is(db, de, "Rx") || token_is(db, de, "Tx")) ||
+       !next_token(p, end, tb, te)){
+        ++c.skipped;
+        return false;
+    }
+    if(token_is(tb, te, "r")){
+        c.add(ts, id | CAN_ID_RTR_FLAG, asc_bus(c, channel), 0, 0);
+        return true;
+    }
+    const char *kb, *ke;
+    uint32_t dlc;
+    if(!token_is(tb, te, "d") || !next_token(p, end, kb, ke) || !parse_hex(kb, ke, dlc) ||
+       !parse_bytes(p, end, opt.hex, std::min(dlc_to_len(dlc), CAN_CLASSIC_MAX_LEN), data)){
+        ++c.skipped;
+        return false;
+    }
+    const uint8_t len = std::min(dlc_to_len(dlc), CAN_CLASSIC_MAX_LEN);
+    std::memcpy(c.add(ts, id, asc_bus(c, channel), len, 0), data, len);
+    return true;
+}
+
+// -- PEAK TRC --
+//   1.0      1)      1841 0001 8 00 00 00 00 00 00 00 00
+//   1.1      1)      1841.0  Rx         0001  8  00 00 ...
+//   1.2/1.3  1)      1841.0 1  Rx       0001 [-] 8  00 00 ...
+//   2.x      per $COLUMNS, e.g. N,O,T,B,I,d,R,L,D
+//            1      1059.900 DT 1     0300 Rx - 7  00 00 ...
+
+uint32_t trc_id(const char* b, const char* e, uint32_t raw){
+    return (e - b > 4) ? (CAN_ID_EXT_FLAG | (raw & CAN_ID_EXT_MASK)) : (raw & CAN_ID_STD_MASK);
+}
+
+bool parse_trc_v1(Chunk& c, const Options& opt, const char* p, const char* end){
+    const char *b, *e;
+    uint64_t offset;
+    if(!next_token(p, end, b, e) || e[-1] != ')')
+        return false;
+    if(!next_token(p, end, b, e) || !parse_fixed(b, e, 1000000ull, offset))
+        return false;
+    uint32_t bus = 1;
+    if(opt.trc_version >= 12 && (!next_token(p, end, b, e) || !parse_dec(b, e, bus))){
+        ++c.skipped;
+        return false;
+    }
+    if(opt.trc_version >= 11 && (!next_token(p, end, b, e) || !(token_is(b, e, "Rx") || token_is(b, e, "Tx")))){
+        ++c.skipped;
+        return false;
+    }
+    const char *ib, *ie;
+    uint32_t raw, len;
+    if(!next_token(p, end, ib, ie) || !parse_hex(ib, ie, raw)){
+        ++c.skipped;
+        return false;
+    }
+    if(opt.trc_version >= 13 && !next_token(p, end, b, e)){
+        ++c.skipped;
+        return false;
+    }
+    if(!next_token(p, end, b, e) || !parse_dec(b, e, len) || len > CAN_CLASSIC_MAX_LEN){
+        ++c.skipped;
+        return false;
+    }
+    const uint64_t ts = opt.base_ns + offset;
+    const uint8_t bus_index = asc_bus(c, bus);
+    const char* rest = p;
+    if(next_token(rest, end, b, e) && token_is(b, e, "RTR")){
+        c.add(ts, trc_id(ib, ie, raw) | CAN_ID_RTR_FLAG, bus_index, 0, 0);
+        return true;
+    }
+    uint8_t data[CAN_CLASSIC_MAX_LEN];
+    if(!parse_bytes(p, end, true, static_cast<uint8_t>(len), data)){
+        ++c.skipped;
+        return false;
+    }
+    std::memcpy(c.add(ts, trc_id(ib, ie, raw), bus_index, static_cast<uint8_t>(len), 0), data, len);
+    return true;
+}
+
+bool parse_trc_v2(Chunk& c, const Options& opt, const char* p, const char* end){
+    uint64_t offset = 0;
+    uint32_t bus = 1, raw = 0, len = 0;
+    const char *ib = nullptr, *ie = nullptr;
+    bool have_offset = false, have_id = false, rtr = false;
+    uint8_t flags = 0;
+    for(char col : opt.columns){
+        const char *b, *e;
+        if(col == 'D')
+            break; // data is the rest of the line
+        if(!next_token(p, end, b, e))
+            return false;
+        switch(col){
+            case 'O':
+                if(!parse_fixed(b, e, 1000000ull, offset))
+                    return false;
+                have_offset = true;
+                break;
+            case 'T':
+                if(token_is(b, e, "DT")) flags = 0;
+                else if(token_is(b, e, "FD") || token_is(b, e, "FE")) flags = CANLOG_FLAG_FD;
+                else if(token_is(b, e, "FB") || token_is(b, e, "BI")) flags = CANLOG_FLAG_FD | CANLOG_FLAG_BRS;
+                else if(token_is(b, e, "RR")) rtr = true;
+                else { ++c.skipped; return false; } // status, error and event records
+                break;
+            case 'B':
+                if(!parse_dec(b, e, bus)){ ++c.skipped; return false; }
+                break;
+            case 'I':
+                if(!parse_hex(b, e, raw)){ ++c.skipped; return false; }
+                ib = b;
+                ie = e;
+                have_id = true;
+                break;
+            case 'L':
+                if(!parse_dec(b, e, len)){ ++c.skipped; return false; }
+                break;
+            case 'l':
+                if(!parse_dec(b, e, len)){ ++c.skipped; return false; }
+                len = (flags & CANLOG_FLAG_FD) ? dlc_to_len(len) : std::min<uint32_t>(len, CAN_CLASSIC_MAX_LEN);
+                break;
+            default: // N, d, R
+                break;
+        }
+    }
+    if(!have_offset || !have_id){
+        if(have_offset)
+            ++c.skipped;
+        return false;
+    }
+    const uint64_t ts = opt.base_ns + offset;
+    const uint32_t id = trc_id(ib, ie, raw);
+    if(rtr){
+        c.add(ts, id | CAN_ID_RTR_FLAG, asc_bus(c, bus), 0, 0);
+        return true;
+    }
+    const uint32_t max_len = (flags & CANLOG_FLAG_FD) ? CAN_FD_MAX_LEN : CAN_CLASSIC_MAX_LEN;
+    uint8_t data[CAN_FD_MAX_LEN];
+    if(len > max_len || !parse_bytes(p, end, true, static_cast<uint8_t>(len), data)){
+        ++c.skipped;
+        return false;
+    }
+    std::memcpy(c.add(ts, id, asc_bus(c, bus), static_cast<uint8_t>(len), flags), data, len);
+    return true;
+}
+
+void parse_chunk(Chunk& c, const Options& opt){
+    c.frames.reserve(static_cast<size_t>(c.end - c.begin) / 40);
+    c.data.reserve(static_cast<size_t>(c.end - c.begin) / 5);
+    for(const char* p = c.begin; p < c.end;){
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(c.end - p)));
+        const char* eol = nl ? nl : c.end;
+        switch(opt.format){
+            case LogFormat::Candump: parse_candump(c, p, eol); break;
+            case LogFormat::Asc:     parse_asc(c, opt, p, eol); break;
+            case LogFormat::Trc:
+                if(*p != ';'){
+                    if(opt.trc_version >= 20) parse_trc_v2(c, opt, p, eol);
+                    else parse_trc_v1(c, opt, p, eol);
+                }
+                break;
+            default: break;
+        }
+        p = eol + 1;
+    }
+    if(!std::is_sorted(c.frames.begin(), c.frames.end(),
+                       [](const Frame& a, const Frame& b){ return a.timestamp_ns < b.timestamp_ns; }))
+        std::stable_sort(c.frames.begin(), c.frames.end(),
+                         [](const Frame& a, const Frame& b){ return a.timestamp_ns < b.timestamp_ns; });
+}
+
+// -- header --
+
+std::string lower(std::string s){
+    for(char &ch : s)
+        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    return s;
+}
+
+void read_header(Options& opt, const char* data, size_t size){
+    size = std::min(size, HEADER_SCAN_BYTES);
+    const char* end = data + size;
+    for(const char* p = data; p < end;){
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        const char* eol = nl ? nl : end;
+        std::string line(p, eol);
+        p = eol + 1;
+
+        if(opt.format == LogFormat::Asc){
+            std::string l = lower(line);
+            size_t at;
+            if((at = l.find("base ")) != std::string::npos)
+                opt.hex = l.compare(at + 5, 3, "dec") != 0;
+            if((at = l.find("timestamps ")) != std::string::npos)
+                opt.relative = l.compare(at + 11, 8, "relative") == 0;
+        } else if(opt.format == LogFormat::Trc){
+            if(line.compare(0, 14, ";$FILEVERSION=") == 0){
+                double v = std::atof(line.c_str() + 14);
+                opt.trc_version = static_cast<int>(v * 10 + 0.5);
+            } else if(line.compare(0, 12, ";$STARTTIME=") == 0){
+                // days since 1899-12-30, as OLE automation dates count
+                double days = std::atof(line.c_str() + 12);
+                if(days > 25569.0)
+                    opt.base_ns = static_cast<uint64_t>((days - 25569.0) * 86400.0 * 1e9);
+            } else if(line.compare(0, 10, ";$COLUMNS=") == 0){
+                opt.columns.clear();
+                for(size_t i = 10; i < line.size(); ++i)
+                    if(std::isalpha(static_cast<unsigned char>(line[i])))
+                        opt.columns += line[i];
+            }
+        }
+    }
+    if(opt.format == LogFormat::Trc && opt.trc_version >= 20 && opt.columns.empty())
+        opt.columns = opt.trc_version >= 21 ? "NOTBIdRLD" : "NOTIdlD";
+}
+
+// read only view of the whole file
+class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path){
+#ifndef _WIN32
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+                throw std::system_error(errno, std::system_category(), "cannot open " + path);
+            struct stat st;
+            if(fstat(fd, &st) != 0){
+                int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::system_category(), "cannot stat " + path);
+            }
+            _size = static_cast<size_t>(st.st_size);
+            if(_size){
+                void* p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+                int err = errno;
+                ::close(fd);
+                if(p == MAP_FAILED)
+                    throw std::system_error(err, std::system_category(), "cannot map " + path);
+                madvise(p, _size, MADV_SEQUENTIAL);
+                _data = static_cast<const char*>(p);
+            } else {
+                ::close(fd);
+            }
+#else
+            std::ifstream in(path, std::ios::binary);
+            if(!in)
+                throw std::runtime_error("cannot open " + path);
+            _copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            _data = _copy.data();
+            _size = _copy.size();
+#endif
+        }
+
+        ~MappedFile(){
+#ifndef _WIN32
+            if(_data)
+                munmap(const_cast<char*>(_data), _size);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return _data; }
+        size_t size() const { return _size; }
+
+    private:
+        const char* _data = nullptr;
+        size_t _size = 0;
+#ifdef _WIN32
+        std::vector<char> _copy;
+#endif
+};
+
+std::string extension(const std::string& path){
+    size_t dot = path.rfind('.');
+    size_t slash = path.find_last_of("/\\");
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return {};
+    return lower(path.substr(dot + 1));
+}
+
+} // namespace
+
+LogFormat detect_log_format(const std::string& path){
+    const std::string ext = extension(path);
+    if(ext == "log") return LogFormat::Candump;
+    if(ext == "asc") return LogFormat::Asc;
+    if(ext == "trc") return LogFormat::Trc;
+
+    std::ifstream in(path);
+    std::string line;
+    for(int i = 0; i < 16 && std::getline(in, line); ++i){
+        size_t at = line.find_first_not_of(" \t\r");
+        if(at == std::string::npos)
+            continue;
+        if(line[at] == '(')
+            return LogFormat::Candump;
+        if(line[at] == ';')
+            return LogFormat::Trc;
+        std::string l = lower(line);
+        if(l.compare(at, 5, "date ") == 0 || l.compare(at, 5, "base ") == 0)
+            return LogFormat::Asc;
+    }
+    return LogFormat::Unknown;
+}
+
+const char* log_format_name(LogFormat format){
+    switch(format){
+        case LogFormat::Candump: return "candump";
+        case LogFormat::Asc:     return "Vector ASC";
+        case LogFormat::Trc:     return "PEAK TRC";
+        default:                 return "unknown";
+    }
+}
+
+ImportStats import_log(const std::string& path, const std::string& out_dir, unsigned threads,
+                       const std::function<bool()>& keep_going){
+    const auto started = std::chrono::steady_clock::now();
+    Options opt;
+    opt.format = detect_log_format(path);
+    if(opt.format == LogFormat::Unknown)
+        throw std::runtime_error("unrecognised log format: " + path);
+
+    MappedFile file(path);
+    read_header(opt, file.data(), file.size());
+
+    if(!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    CanLogWriter writer(out_dir);
+    std::unordered_map<std::string, uint8_t> bus_numbers;
+    ImportStats stats;
+    stats.format = opt.format;
+    stats.bytes = file.size();
+    uint64_t relative_base = 0;
+
+    const char* const end = file.data() + file.size();
+    for(const char* window = file.data(); window < end;){
+        if(keep_going && !keep_going())
+            throw std::runtime_error("import cancelled");
+        // cut the window into chunks that end on line boundaries
+        std::vector<Chunk> chunks(threads);
+        const char* p = window;
+        for(unsigned i = 0; i < threads && p < end; ++i){
+            const char* stop = p + std::min<size_t>(CHUNK_BYTES, static_cast<size_t>(end - p));
+            if(stop < end){
+                const char* nl = static_cast<const char*>(std::memchr(stop, '\n', static_cast<size_t>(end - stop)));
+                stop = nl ? nl + 1 : end;
+            }
+            chunks[i].begin = p;
+            chunks[i].end = stop;
+            p = stop;
+        }
+        window = p;
+
+        std::vector<std::thread> workers;
+        for(size_t i = 1; i < chunks.size(); ++i)
+            if(chunks[i].begin)
+                workers.emplace_back(parse_chunk, std::ref(chunks[i]), std::cref(opt));
+        parse_chunk(chunks[0], opt);
+        for(auto &w : workers)
+            w.join();
+
+        // relative ASC stamps only add up once the chunks before are known
+        if(opt.relative)
+            for(auto &c : chunks){
+                for(auto &f : c.frames)
+                    f.timestamp_ns += relative_base;
+                relative_base += c.elapsed_ns;
+            }
+
+        // chunk bus numbers to session bus numbers
+        std::vector<std::vector<uint8_t>> bus_map(chunks.size());
+        for(size_t i = 0; i < chunks.size(); ++i)
+            for(const auto &name : chunks[i].buses){
+                auto it = bus_numbers.find(name);
+                if(it == bus_numbers.end()){
+                    uint8_t n = static_cast<uint8_t>(std::min<size_t>(bus_numbers.size(), 255));
+                    it = bus_numbers.emplace(name, n).first;
+                    writer.set_bus_name(n, name);
+                }
+                bus_map[i].push_back(it->second);
+            }
+
+        auto emit = [&](size_t ci, const Frame& f){
+            const Chunk &c = chunks[ci];
+            writer.append(bus_map[ci][f.bus], f.id, f.len, c.data.data() + f.data, f.timestamp_ns, f.flags);
+        };
+
+        // chunks of a time ordered log follow each other, which needs no heap
+        bool ordered = true;
+        uint64_t last = 0;
+        for(const auto &c : chunks){
+            if(c.frames.empty())
+                continue;
+            if(c.frames.front().timestamp_ns < last){
+                ordered = false;
+                break;
+            }
+            last = c.frames.back().timestamp_ns;
+        }
+        if(ordered){
+            for(size_t ci = 0; ci < chunks.size(); ++ci)
+                for(const auto &f : chunks[ci].frames)
+                    emit(ci, f);
+        } else {
+            using Head = std::pair<uint64_t, size_t>; // stamp, chunk
+            std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+            std::vector<size_t> pos(chunks.size(), 0);
+            for(size_t ci = 0; ci < chunks.size(); ++ci)
+                if(!chunks[ci].frames.empty())
+                    heads.emplace(chunks[ci].frames[0].timestamp_ns, ci);
+            while(!heads.empty()){
+                const size_t ci = heads.top().second;
+                heads.pop();
+                emit(ci, chunks[ci].frames[pos[ci]]);
+                if(++pos[ci] < chunks[ci].frames.size())
+                    heads.emplace(chunks[ci].frames[pos[ci]].timestamp_ns, ci);
+            }
+        }
+
+        for(const auto &c : chunks){
+            stats.frames += c.frames.size();
+            stats.skipped += c.skipped;
+        }
+    }
+
+    writer.close();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return stats;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Importers for text CAN logs from other tools, written out as a native
+// session (canlog.hpp) that replay and export can open like a recording.
+//
+//   candump -l    (1436509052.249713) can0 123#DEADBEEF, 123##1<fd data>, 123#R
+//   Vector ASC    base hex/dec, absolute or relative timestamps, CAN and CANFD lines
+//   PEAK TRC      versions 1.0 to 1.3 and 2.0/2.1 (with $COLUMNS)
+//
+// The file is mapped and read in windows of THREADS x CHUNK_BYTES. Each
+// window is cut into chunks on line boundaries, the chunks are parsed in
+// parallel, each is put in time order and the chunks are merged by
+// timestamp into the writer. Header lines (ASC base/timestamps, TRC version,
+// columns and start time) are read once up front. Lines that are not frames
+// (comments, error frames, status events) are skipped.
+//
+// Stamps are the log's own time: epoch for candump and for TRC files with a
+// $STARTTIME, seconds from the start of the measurement for ASC.
+
+enum class LogFormat { Unknown, Candump, Asc, Trc };
+
+// by extension (.log, .asc, .trc), otherwise from the first lines
+LogFormat detect_log_format(const std::string& path);
+const char* log_format_name(LogFormat format);
+
+struct ImportStats {
+    LogFormat format = LogFormat::Unknown;
+    uint64_t frames = 0;
+    uint64_t skipped = 0;   // stamped lines that were not frames
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+};
+
+// threads 0: one per core. keep_going is asked before every window, the
+// import stops with an exception once it says no. Throws std::runtime_error
+// / std::system_error.
+ImportStats import_log(const std::string& path, const std::string& out_dir, unsigned threads = 0,
+                       const std::function<bool()>& keep_going = {});
@@ -0,0 +1,745 @@
+#include "mdf4.hpp"
+#include "candb.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t ID_BYTES = 64;
+constexpr size_t BLOCK_HEADER = 24;
+constexpr uint64_t HD_OFFSET = ID_BYTES;
+constexpr size_t HD_LINKS = 6;
+constexpr size_t HD_DATA = 32;
+constexpr size_t CN_DATA = 72;
+
+constexpr size_t RAW_RECORD = 80;
+constexpr uint32_t RAW_FRAME_OFFSET = 8;
+constexpr uint32_t RAW_DATA_OFFSET = 16;
+
+// cn_type, cn_sync_type, cn_data_type values
+constexpr uint8_t CN_FIXED = 0;
+constexpr uint8_t CN_VLSD = 1;
+constexpr uint8_t CN_MASTER = 2;
+constexpr uint8_t SYNC_NONE = 0;
+constexpr uint8_t SYNC_TIME = 1;
+constexpr uint8_t DT_UINT_LE = 0;
+constexpr uint8_t DT_FLOAT_LE = 4;
+constexpr uint8_t DT_BYTES = 10;
+
+// cg_flags: bus event, plain bus event
+constexpr uint16_t CG_BUS_EVENT = 0x6;
+
+// id_custom_unfin_flags: our own bit, the metadata blocks were never written
+constexpr uint16_t UNFIN_NO_METADATA = 0x1;
+
+struct RawField {
+    const char* name;
+    uint32_t byte_offset;
+    uint8_t bit_offset;
+    uint32_t bits;
+    uint8_t data_type;
+};
+
+// CAN_DataFrame members in record order, see mdf4.hpp
+const RawField RAW_FIELDS[] = {
+    {"ID", 8, 0, 29, DT_UINT_LE},
+    {"IDE", 11, 7, 1, DT_UINT_LE},
+    {"BusChannel", 12, 0, 8, DT_UINT_LE},
+    {"DLC", 13, 0, 4, DT_UINT_LE},
+    {"DataLength", 14, 0, 8, DT_UINT_LE},
+    {"BRS", 15, 0, 1, DT_UINT_LE},
+    {"EDL", 15, 1, 1, DT_UINT_LE},
+    {"DataBytes", RAW_DATA_OFFSET, 0, CAN_FD_MAX_LEN * 8u, DT_BYTES},
+};
+
+template<class T>
+void put(std::vector<uint8_t>& v, size_t at, T value){
+    std::memcpy(v.data() + at, &value, sizeof(value));
+}
+
+template<class T>
+T get(const uint8_t* p){
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+std::string xml_escape(const std::string& s){
+    std::string out;
+    for(char ch : s){
+        switch(ch){
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            default: out += ch;
+        }
+    }
+    return out;
+}
+
+std::string xml_unescape(const std::string& s){
+    static const std::pair<const char*, char> entities[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+    std::string out;
+    for(size_t i = 0; i < s.size();){
+        bool matched = false;
+        if(s[i] == '&'){
+            for(const auto &e : entities){
+                const size_t n = std::strlen(e.first);
+                if(s.compare(i, n, e.first) == 0){
+                    out += e.second;
+                    i += n;
+                    matched = true;
+                    break;
+                }
+            }
+        }
+        if(!matched)
+            out += s[i++];
+    }
+    return out;
+}
+
+uint64_t wall_clock_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+// -- writer --
+
+Mdf4Writer::Mdf4Writer(const std::string& path, const DbcMessageList& messages,
+                       int64_t realtime_offset_ns)
+    : _path(path), _realtime_offset_ns(realtime_offset_ns) {
+    _out.open(path, std::ios::binary | std::ios::trunc);
+    if(!_out)
+        throw std::runtime_error("cannot create " + path);
+
+    for(const auto &mp : messages)
+        if(!mp.second->signals.empty())
+            _messages.push_back(*mp.second);
+    std::sort(_messages.begin(), _messages.end(),
+              [](const DbcMessage& a, const DbcMessage& b){ return a.name < b.name || (a.name == b.name && a.id < b.id); });
+
+    _groups.resize(_messages.size() + 1);
+    _groups[0].name = "CAN_DataFrame";
+    _groups[0].record_bytes = RAW_RECORD;
+    _groups[0].capacity = RAW_BLOCK_BYTES / RAW_RECORD;
+    for(size_t i = 0; i < _messages.size(); ++i){
+        Group &g = _groups[i + 1];
+        g.name = _messages[i].name;
+        g.message = &_messages[i];
+        for(const auto &sig : _messages[i].signals)
+            g.plans.push_back(DbcParser::compile(sig));
+        g.record_bytes = 8 * (1 + _messages[i].signals.size());
+        g.capacity = std::max<size_t>(1, DECODED_BLOCK_BYTES / g.record_bytes);
+        _by_id[_messages[i].id] = i + 1;
+    }
+
+    // the header block is rewritten in place by close()
+    write_id(false);
+    _end = ID_BYTES;
+    std::vector<uint8_t> hd(HD_DATA, 0);
+    put_block("##HD", std::vector<uint64_t>(HD_LINKS, 0), hd.data(), hd.size());
+}
+
+Mdf4Writer::~Mdf4Writer(){
+    try{
+        close();
+    } catch(const std::exception& e){
+        std::cout << "[!] " << e.what() << std::endl;
+    }
+}
+
+void Mdf4Writer::set_bus_name(uint8_t bus, const std::string& name){
+    if(_bus_names.size() <= bus)
+        _bus_names.resize(bus + 1u);
+    _bus_names[bus] = name;
+}
+
+void Mdf4Writer::append(uint8_t bus, uint32_t id, uint8_t len, const uint8_t* payload,
+                        uint64_t timestamp_ns, uint8_t flags){
+    if(_closed)
+        return;
+    if(!_started){
+        _started = true;
+        _start_ns = timestamp_ns;
+    }
+    if(len > CAN_FD_MAX_LEN)
+        len = CAN_FD_MAX_LEN;
+    const double t = timestamp_ns >= _start_ns
+                   ? static_cast<double>(timestamp_ns - _start_ns) * 1e-9
+                   : -static_cast<double>(_start_ns - timestamp_ns) * 1e-9;
+    ++_frames;
+
+    Group &raw = _groups[0];
+    if(raw.buffer.empty())
+        raw.buffer.resize(raw.capacity * raw.record_bytes);
+    uint8_t* r = raw.buffer.data() + raw.fill * raw.record_bytes;
+    std::memcpy(r, &t, sizeof(t));
+    // the id word is candb.hpp's layout: 29 bits, RTR bit 30, IDE bit 31
+    std::memcpy(r + RAW_FRAME_OFFSET, &id, sizeof(id));
+    r[12] = static_cast<uint8_t>(bus + 1u);
+    r[13] = can_len_to_dlc(len);
+    r[14] = len;
+    r[15] = static_cast<uint8_t>(((flags & CANLOG_FLAG_BRS) ? 0x1 : 0) |
+                                 (((flags & CANLOG_FLAG_FD) || len > CAN_CLASSIC_MAX_LEN) ? 0x2 : 0));
+    std::memset(r + RAW_DATA_OFFSET, 0, CAN_FD_MAX_LEN);
+    if(len && payload)
+        std::memcpy(r + RAW_DATA_OFFSET, payload, len);
+    ++raw.cycles;
+    if(++raw.fill == raw.capacity)
+        flush(raw);
+
+    auto it = _by_id.find(id);
+    if(it == _by_id.end())
+        return;
+    Group &g = _groups[it->second];
+    if(g.buffer.empty())
+        g.buffer.resize(g.capacity * g.record_bytes);
+    uint8_t* d = g.buffer.data() + g.fill * g.record_bytes;
+    std::memcpy(d, &t, sizeof(t));
+    // signals may reach past a short frame, read zeros there like the store does
+    const uint8_t* data = r + RAW_DATA_OFFSET;
+    for(size_t s = 0; s < g.plans.size(); ++s){
+        int64_t raw;
+        const double v = g.plans[s].fits ? DbcParser::plan_value(g.plans[s], data, raw)
+                                         : std::numeric_limits<double>::quiet_NaN();
+        std::memcpy(d + 8 * (s + 1), &v, sizeof(v));
+    }
+    ++g.cycles;
+    if(++g.fill == g.capacity)
+        flush(g);
+}
+
+void Mdf4Writer::flush(Group& g){
+    if(!g.fill)
+        return;
+    const size_t bytes = g.fill * g.record_bytes;
+    g.blocks.push_back(put_block("##DT", {}, g.buffer.data(), bytes));
+    g.block_bytes.push_back(bytes);
+    g.fill = 0;
+}
+
+// appends a block on the next 8-byte boundary, returns its offset
+uint64_t Mdf4Writer::put_block(const char* id, const std::vector<uint64_t>& links,
+                               const void* data, size_t len){
+    const uint64_t at = _end;
+    uint8_t header[BLOCK_HEADER] = {};
+    std::memcpy(header, id, 4);
+    const uint64_t length = BLOCK_HEADER + 8 * links.size() + len;
+    const uint64_t count = links.size();
+    std::memcpy(header + 8, &length, sizeof(length));
+    std::memcpy(header + 16, &count, sizeof(count));
+    _out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if(!links.empty())
+        _out.write(reinterpret_cast<const char*>(links.data()), static_cast<std::streamsize>(8 * links.size()));
+    if(len)
+        _out.write(static_cast<const char*>(data), static_cast<std::streamsize>(len));
+    static const char zeros[8] = {};
+    const size_t pad = (8 - length % 8) % 8;
+    _out.write(zeros, static_cast<std::streamsize>(pad));
+    if(!_out)
+        throw std::runtime_error("write to " + _path + " failed");
+    _end += length + pad;
+    return at;
+}
+
+// TX / MD block: the string zero terminated, padded to 8 inside the block
+uint64_t Mdf4Writer::put_text(const char* id, const std::string& text){
+    std::vector<uint8_t> data(text.begin(), text.end());
+    data.resize((text.size() + 8) & ~static_cast<size_t>(7), 0);
+    return put_block(id, {}, data.data(), data.size());
+}
+
+// a single DT, or a DL listing every DT with its offset into the data
+uint64_t Mdf4Writer::put_data_link(const Group& g){
+    if(g.blocks.empty())
+        return 0;
+    if(g.blocks.size() == 1)
+        return g.blocks[0];
+    std::vector<uint64_t> links{0};
+    links.insert(links.end(), g.blocks.begin(), g.blocks.end());
+    std::vector<uint8_t> data(8 + 8 * g.blocks.size(), 0);
+    put<uint32_t>(data, 4, static_cast<uint32_t>(g.blocks.size()));
+    uint64_t offset = 0;
+    for(size_t i = 0; i < g.blocks.size(); ++i){
+        put<uint64_t>(data, 8 + 8 * i, offset);
+        offset += g.block_bytes[i];
+    }
+    return put_block("##DL", links, data.data(), data.size());
+}
+
+uint64_t Mdf4Writer::put_channel(const std::string& name, uint8_t type, uint8_t sync, uint8_t data_type,
+                                 uint32_t byte_offset, uint8_t bit_offset, uint32_t bits,
+                                 uint64_t next, uint64_t composition, uint64_t unit){
+    const uint64_t tx = put_text("##TX", name);
+    std::vector<uint8_t> data(CN_DATA, 0);
+    data[0] = type;
+    data[1] = sync;
+    data[2] = data_type;
+    data[3] = bit_offset;
+    put<uint32_t>(data, 4, byte_offset);
+    put<uint32_t>(data, 8, bits);
+    return put_block("##CN", {next, composition, tx, 0, 0, 0, unit, 0}, data.data(), data.size());
+}
+
+uint64_t Mdf4Writer::put_group(const Group& g, uint64_t next_dg){
+    const uint64_t data_link = put_data_link(g);
+    const uint64_t seconds = put_text("##TX", "s");
+    uint64_t channels = 0;
+    uint64_t source = 0;
+    uint64_t comment = 0;
+    uint16_t flags = 0;
+    uint16_t separator = 0;
+
+    if(!g.message){
+        uint64_t members = 0;
+        for(size_t i = sizeof(RAW_FIELDS) / sizeof(RAW_FIELDS[0]); i-- > 0;){
+            const RawField &f = RAW_FIELDS[i];
+            members = put_channel(std::string("CAN_DataFrame.") + f.name, CN_FIXED, SYNC_NONE, f.data_type,
+                                  f.byte_offset, f.bit_offset, f.bits, members, 0, 0);
+        }
+        channels = put_channel("CAN_DataFrame", CN_FIXED, SYNC_NONE, DT_BYTES, RAW_FRAME_OFFSET, 0,
+                               (RAW_RECORD - RAW_FRAME_OFFSET) * 8, 0, members, 0);
+
+        std::vector<uint8_t> si(8, 0);
+        si[0] = 2;  // bus
+        si[1] = 2;  // CAN
+        source = put_block("##SI", {put_text("##TX", "CAN"), 0, 0}, si.data(), si.size());
+
+        std::string xml = "<CGcomment><TX>raw CAN frames</TX><common_properties>";
+        for(size_t b = 0; b < _bus_names.size(); ++b)
+            if(!_bus_names[b].empty())
+                xml += "<e name=\"BusChannel " + std::to_string(b + 1) + "\">" + xml_escape(_bus_names[b]) + "</e>";
+        xml += "</common_properties></CGcomment>";
+        comment = put_text("##MD", xml);
+        flags = CG_BUS_EVENT;
+        separator = '.';
+    } else {
+        const auto &signals = g.message->signals;
+        for(size_t s = signals.size(); s-- > 0;)
+            channels = put_channel(signals[s].name, CN_FIXED, SYNC_NONE, DT_FLOAT_LE,
+                                   static_cast<uint32_t>(8 * (s + 1)), 0, 64, channels, 0, 0);
+        char text[64];
+        std::snprintf(text, sizeof(text), "CAN id 0x%X%s", g.message->id & CAN_ID_EXT_MASK,
+                      (g.message->id & CAN_ID_EXT_FLAG) ? " extended" : "");
+        std::string tx = text;
+        if(!g.message->dbc_name.empty())
+            tx += ", " + g.message->dbc_name;
+        comment = put_text("##TX", tx);
+    }
+    channels = put_channel("Timestamp", CN_MASTER, SYNC_TIME, DT_FLOAT_LE, 0, 0, 64, channels, 0, seconds);
+
+    std::vector<uint8_t> cg(32, 0);
+    put<uint64_t>(cg, 8, g.cycles);
+    put<uint16_t>(cg, 16, flags);
+    put<uint16_t>(cg, 18, separator);
+    put<uint32_t>(cg, 24, static_cast<uint32_t>(g.record_bytes));
+    const uint64_t cg_at = put_block("##CG", {0, channels, put_text("##TX", g.name), source, 0, comment},
+                                     cg.data(), cg.size());
+
+    std::vector<uint8_t> dg(8, 0);
+    return put_block("##DG", {next_dg, cg_at, data_link, 0}, dg.data(), dg.size());
+}
+
+void Mdf4Writer::write_id(bool finished){
+    uint8_t id[ID_BYTES] = {};
+    std::memcpy(id, finished ? "MDF     " : "UnFinMF ", 8);
+    std::memcpy(id + 8, "4.10    ", 8);
+    std::memcpy(id + 16, "photon  ", 8);
+    const uint16_t version = 410;
+    std::memcpy(id + 28, &version, sizeof(version));
+    const uint16_t custom = finished ? 0 : UNFIN_NO_METADATA;
+    std::memcpy(id + 62, &custom, sizeof(custom));
+    write_at(0, id, sizeof(id));
+}
+
+void Mdf4Writer::write_at(uint64_t offset, const void* data, size_t len){
+    _out.seekp(static_cast<std::streamoff>(offset));
+    _out.write(static_cast<const char*>(data), static_cast<std::streamsize>(len));
+    _out.seekp(0, std::ios::end);
+    if(!_out)
+        throw std::runtime_error("write to " + _path + " failed");
+}
+
+void Mdf4Writer::close(){
+    if(_closed)
+        return;
+    _closed = true;
+
+    for(auto &g : _groups)
+        flush(g);
+    _groups[0].buffer = std::vector<uint8_t>();
+
+    // groups chain front to back, so they are written back to front; a
+    // message that never showed up gets no group
+    uint64_t first_dg = 0;
+    for(size_t i = _groups.size(); i-- > 0;)
+        if(!_groups[i].message || _groups[i].cycles)
+            first_dg = put_group(_groups[i], first_dg);
+
+    const uint64_t now = wall_clock_ns();
+    const uint64_t history = put_text("##MD",
+        "<FHcomment><TX>recorded</TX><tool_id>photon</tool_id><tool_vendor>photon</tool_vendor>"
+        "<tool_version>1</tool_version></FHcomment>");
+    std::vector<uint8_t> fh(16, 0);
+    put<uint64_t>(fh, 0, now);
+    const uint64_t fh_at = put_block("##FH", {0, history}, fh.data(), fh.size());
+
+    // the header goes back over its placeholder, same size
+    std::vector<uint8_t> hd(BLOCK_HEADER + 8 * HD_LINKS + HD_DATA, 0);
+    std::memcpy(hd.data(), "##HD", 4);
+    put<uint64_t>(hd, 8, hd.size());
+    put<uint64_t>(hd, 16, HD_LINKS);
+    put<uint64_t>(hd, BLOCK_HEADER, first_dg);
+    put<uint64_t>(hd, BLOCK_HEADER + 8, fh_at);
+    const uint64_t start = _started
+        ? static_cast<uint64_t>(static_cast<int64_t>(_start_ns) + _realtime_offset_ns) : now;
+    put<uint64_t>(hd, BLOCK_HEADER + 8 * HD_LINKS, start);
+    write_at(HD_OFFSET, hd.data(), hd.size());
+    write_id(true);
+
+    _out.close();
+    if(!_out)
+        throw std::runtime_error("closing " + _path + " failed");
+    for(auto &g : _groups)
+        g.buffer = std::vector<uint8_t>();
+}
+
+// -- reader --
+
+Mdf4Reader::Mdf4Reader(const std::string& path) : _path(path) {
+    map();
+    if(_size < HD_OFFSET + BLOCK_HEADER)
+        throw std::runtime_error(path + " is not an MDF file");
+    if(std::memcmp(_data, "UnFinMF ", 8) == 0)
+        throw std::runtime_error(path + " was never finalized (recording interrupted?)");
+    if(std::memcmp(_data, "MDF     ", 8) != 0)
+        throw std::runtime_error(path + " is not an MDF file");
+    if(get<uint16_t>(_data + 28) < 400)
+        throw std::runtime_error(path + " is MDF 3, only MDF 4 is read");
+
+    const uint8_t* hd = block_at(HD_OFFSET, "##HD");
+    const uint64_t hd_links = get<uint64_t>(hd + 16);
+    _start_ns = get<uint64_t>(hd + BLOCK_HEADER + 8 * hd_links);
+
+    // the first sorted data group whose only channel group carries frames
+    for(uint64_t dg = get<uint64_t>(hd + BLOCK_HEADER); dg;){
+        const uint8_t* b = block_at(dg, "##DG");
+        const uint8_t rec_id_size = b[BLOCK_HEADER + 32];
+        const uint64_t cg = get<uint64_t>(b + BLOCK_HEADER + 8);
+        if(!rec_id_size && cg && get<uint64_t>(block_at(cg, "##CG") + BLOCK_HEADER) == 0 &&
+           load_group(cg, get<uint64_t>(b + BLOCK_HEADER + 16)))
+            break;
+        dg = get<uint64_t>(b + BLOCK_HEADER);
+    }
+    if(!_record_bytes)
+        throw std::runtime_error(path + " has no CAN_DataFrame channel group");
+}
+
+Mdf4Reader::~Mdf4Reader(){
+#ifndef _WIN32
+    if(_data)
+        munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+}
+
+void Mdf4Reader::map(){
+#ifndef _WIN32
+    int fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw std::system_error(errno, std::system_category(), "cannot open " + _path);
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0){
+        ::close(fd);
+        throw std::runtime_error(_path + " is empty");
+    }
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if(p == MAP_FAILED)
+        throw std::system_error(err, std::system_category(), "cannot map " + _path);
+    // replay walks it front to back, but open touches one page per block
+    madvise(p, static_cast<size_t>(st.st_size), MADV_RANDOM);
+    _data = static_cast<const uint8_t*>(p);
+    _size = static_cast<size_t>(st.st_size);
+#else
+    std::ifstream in(_path, std::ios::binary);
+    if(!in)
+        throw std::runtime_error("cannot open " + _path);
+    _copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    _data = _copy.data();
+    _size = _copy.size();
+#endif
+}
+
+// the block at offset, checked to be id and to fit the file
+const uint8_t* Mdf4Reader::block_at(uint64_t offset, const char* id) const{
+    if(offset > _size || _size - offset < BLOCK_HEADER)
+        throw std::runtime_error(_path + ": block offset past the end of the file");
+    const uint8_t* b = _data + offset;
+    const uint64_t length = get<uint64_t>(b + 8);
+    const uint64_t links = get<uint64_t>(b + 16);
+    if(length > _size - offset || length < BLOCK_HEADER || (length - BLOCK_HEADER) / 8 < links)
+        throw std::runtime_error(_path + ": damaged block");
+    if(id && std::memcmp(b, id, 4) != 0)
+        throw std::runtime_error(_path + ": expected a " + std::string(id + 2, 2) + " block");
+    return b;
+}
+
+bool Mdf4Reader::load_group(uint64_t cg, uint64_t data_link){
+    auto text = [this](uint64_t link){
+        if(!link)
+            return std::string();
+        const uint8_t* b = block_at(link, nullptr);
+        if(std::memcmp(b, "##TX", 4) != 0 && std::memcmp(b, "##MD", 4) != 0)
+            return std::string();
+        const uint64_t len = get<uint64_t>(b + 8) - BLOCK_HEADER - 8 * get<uint64_t>(b + 16);
+        const char* s = reinterpret_cast<const char*>(b + BLOCK_HEADER + 8 * get<uint64_t>(b + 16));
+        return std::string(s, strnlen(s, static_cast<size_t>(len)));
+    };
+    auto field = [](const uint8_t* cn){
+        const uint8_t* d = cn + BLOCK_HEADER + 8 * get<uint64_t>(cn + 16);
+        Field f;
+        f.present = true;
+        f.bit_offset = d[3];
+        f.byte_offset = get<uint32_t>(d + 4);
+        f.bits = get<uint32_t>(d + 8);
+        return f;
+    };
+
+    const uint8_t* g = block_at(cg, "##CG");
+    const uint8_t* gd = g + BLOCK_HEADER + 8 * get<uint64_t>(g + 16);
+    bool have_time = false, have_frame = false;
+
+    for(uint64_t cn = get<uint64_t>(g + BLOCK_HEADER + 8); cn;){
+        const uint8_t* c = block_at(cn, "##CN");
+        const uint8_t* d = c + BLOCK_HEADER + 8 * get<uint64_t>(c + 16);
+        const std::string name = text(get<uint64_t>(c + BLOCK_HEADER + 16));
+
+        if(d[0] == CN_MASTER && d[1] == SYNC_TIME){
+            _time = field(c);
+            _time_float = d[2] == DT_FLOAT_LE;
+            if((_time_float && _time.bits != 64 && _time.bits != 32) || (!_time_float && d[2] != DT_UINT_LE))
+                throw std::runtime_error(_path + ": unsupported time channel type");
+            if(const uint64_t cc = get<uint64_t>(c + BLOCK_HEADER + 32)){
+                const uint8_t* cb = block_at(cc, "##CC");
+                const uint8_t* cd = cb + BLOCK_HEADER + 8 * get<uint64_t>(cb + 16);
+                if(cd[0] == 1 && get<uint16_t>(cd + 6) >= 2){
+                    _time_a0 = get<double>(cd + 24);
+                    _time_a1 = get<double>(cd + 32);
+                } else if(cd[0] != 0){
+                    throw std::runtime_error(_path + ": time channel conversion is not linear");
+                }
+            }
+            have_time = true;
+        } else if(name == "CAN_DataFrame"){
+            have_frame = true;
+            for(uint64_t m = get<uint64_t>(c + BLOCK_HEADER + 8); m;){
+                const uint8_t* mc = block_at(m, nullptr);
+                if(std::memcmp(mc, "##CN", 4) != 0)
+                    break; // a channel array, not members
+                const uint8_t* md = mc + BLOCK_HEADER + 8 * get<uint64_t>(mc + 16);
+                std::string member = text(get<uint64_t>(mc + BLOCK_HEADER + 16));
+                const size_t dot = member.rfind('.');
+                if(dot != std::string::npos)
+                    member.erase(0, dot + 1);
+                if(member == "DataBytes" && md[0] == CN_VLSD)
+                    throw std::runtime_error(_path + ": variable length DataBytes are not supported");
+                Field *f = member == "ID" ? &_id : member == "IDE" ? &_ide : member == "BusChannel" ? &_bus
+                         : member == "DLC" ? &_dlc : member == "DataLength" ? &_length
+                         : member == "DataBytes" ? &_bytes : member == "BRS" ? &_brs
+                         : member == "EDL" ? &_edl : nullptr;
+                if(f)
+                    *f = field(mc);
+                m = get<uint64_t>(mc + BLOCK_HEADER);
+            }
+        }
+        cn = get<uint64_t>(c + BLOCK_HEADER);
+    }
+    if(!have_time || !have_frame || !_id.present || !_bytes.present){
+        _id = _ide = _bus = _dlc = _length = _bytes = _brs = _edl = Field{};
+        return false;
+    }
+
+    _record_bytes = get<uint32_t>(gd + 24) + get<uint32_t>(gd + 28);
+    const uint64_t need = std::max<uint64_t>(_time.byte_offset + _time.bits / 8,
+                                             _bytes.byte_offset + _bytes.bits / 8);
+    if(!_record_bytes || need > _record_bytes)
+        throw std::runtime_error(_path + ": channels reach past the record");
+
+    // bus names the writer kept: <e name="BusChannel N">name</e>
+    const std::string xml = text(get<uint64_t>(g + BLOCK_HEADER + 40));
+    const std::string key = "<e name=\"BusChannel ";
+    for(size_t at = xml.find(key); at != std::string::npos; at = xml.find(key, at + 1)){
+        const size_t num = at + key.size();
+        const size_t open_end = xml.find("\">", num);
+        const size_t close = xml.find("</e>", num);
+        if(open_end == std::string::npos || close == std::string::npos || close < open_end)
+            break;
+        const unsigned long channel = std::strtoul(xml.c_str() + num, nullptr, 10);
+        if(channel < 1 || channel > 256)
+            continue;
+        if(_bus_names.size() < channel)
+            _bus_names.resize(channel);
+        _bus_names[channel - 1] = xml_unescape(xml.substr(open_end + 2, close - open_end - 2));
+    }
+
+    load_data(data_link);
+    return true;
+}
+
+// collects the DT blocks behind a DT or a chain of DL blocks
+void Mdf4Reader::load_data(uint64_t link){
+    std::vector<std::pair<const uint8_t*, uint64_t>> raw; // data, bytes
+    auto add_dt = [&](uint64_t at){
+        const uint8_t* b = block_at(at, nullptr);
+        if(std::memcmp(b, "##DZ", 4) == 0)
+            throw std::runtime_error(_path + ": compressed data blocks are not supported");
+        if(std::memcmp(b, "##DT", 4) != 0)
+            throw std::runtime_error(_path + ": unexpected block in the data list");
+        raw.emplace_back(b + BLOCK_HEADER, get<uint64_t>(b + 8) - BLOCK_HEADER);
+    };
+
+    while(link){
+        const uint8_t* b = block_at(link, nullptr);
+        if(std::memcmp(b, "##DL", 4) != 0){
+            if(std::memcmp(b, "##HL", 4) == 0)
+                throw std::runtime_error(_path + ": compressed data blocks are not supported");
+            add_dt(link);
+            break;
+        }
+        const uint64_t links = get<uint64_t>(b + 16);
+        const uint32_t count = get<uint32_t>(b + BLOCK_HEADER + 8 * links + 4);
+        for(uint32_t i = 0; i < count && i + 1 < links; ++i)
+            if(const uint64_t dt = get<uint64_t>(b + BLOCK_HEADER + 8 * (i + 1)))
+                add_dt(dt);
+        link = get<uint64_t>(b + BLOCK_HEADER);
+    }
+
+    for(size_t i = 0; i < raw.size(); ++i){
+        if(raw[i].second % _record_bytes && i + 1 < raw.size())
+            throw std::runtime_error(_path + ": records split across data blocks are not supported");
+        Block blk;
+        blk.data = raw[i].first;
+        blk.records = raw[i].second / _record_bytes;
+        if(!blk.records)
+            continue;
+        blk.first_ns = stamp(blk.data);
+        _records += blk.records;
+        _blocks.push_back(blk);
+    }
+}
+
+uint64_t Mdf4Reader::bits_at(const uint8_t* record, const Field& f){
+    if(!f.bits)
+        return 0;
+    uint64_t v = 0;
+    const size_t bytes = std::min<size_t>(8, (f.bit_offset + f.bits + 7) / 8);
+    std::memcpy(&v, record + f.byte_offset, bytes);
+    v >>= f.bit_offset;
+    if(f.bits < 64)
+        v &= (uint64_t(1) << f.bits) - 1;
+    return v;
+}
+
+uint64_t Mdf4Reader::stamp(const uint8_t* record) const{
+    double raw;
+    if(_time_float && _time.bits == 32)
+        raw = get<float>(record + _time.byte_offset);
+    else if(_time_float)
+        raw = get<double>(record + _time.byte_offset);
+    else
+        raw = static_cast<double>(bits_at(record, _time));
+    const double seconds = _time_a0 + _time_a1 * raw;
+    const int64_t ns = static_cast<int64_t>(_start_ns) + std::llround(seconds * 1e9);
+    return ns > 0 ? static_cast<uint64_t>(ns) : 1;
+}
+
+uint64_t Mdf4Reader::first_ns() const{
+    return _blocks.empty() ? 0 : _blocks.front().first_ns;
+}
+
+uint64_t Mdf4Reader::last_ns() const{
+    if(_blocks.empty())
+        return 0;
+    const Block &b = _blocks.back();
+    return stamp(b.data + (b.records - 1) * _record_bytes);
+}
+
+bool Mdf4Reader::next(Cursor& c, CanLogRecord& rec, const uint8_t*& payload) const{
+    while(c.segment < _blocks.size() && c.offset >= _blocks[c.segment].records * _record_bytes){
+        ++c.segment;
+        c.offset = 0;
+    }
+    if(c.segment >= _blocks.size())
+        return false;
+
+    const uint8_t* r = _blocks[c.segment].data + c.offset;
+    rec = CanLogRecord{};
+    rec.timestamp_ns = stamp(r);
+    uint32_t id = static_cast<uint32_t>(bits_at(r, _id)) & CAN_ID_EXT_MASK;
+    const bool ide = _ide.present ? bits_at(r, _ide) != 0 : id > CAN_ID_STD_MASK;
+    if(ide)
+        id |= CAN_ID_EXT_FLAG;
+    rec.id = id;
+    if(_bus.present){
+        const uint64_t channel = bits_at(r, _bus);
+        rec.bus = static_cast<uint8_t>(channel ? std::min<uint64_t>(channel - 1, 255) : 0);
+    }
+    const uint32_t room = std::min<uint32_t>(_bytes.bits / 8, CAN_FD_MAX_LEN);
+    uint32_t len = _length.present ? static_cast<uint32_t>(bits_at(r, _length))
+                 : _dlc.present ? can_dlc_to_len(static_cast<uint8_t>(bits_at(r, _dlc)))
+                 : room;
+    rec.len = static_cast<uint8_t>(std::min(len, room));
+    if(_brs.present && bits_at(r, _brs))
+        rec.flags |= CANLOG_FLAG_BRS;
+    if((_edl.present && bits_at(r, _edl)) || rec.len > CAN_CLASSIC_MAX_LEN)
+        rec.flags |= CANLOG_FLAG_FD;
+    payload = r + _bytes.byte_offset;
+    c.offset += _record_bytes;
+    return true;
+}
+
+FrameLog::Cursor Mdf4Reader::seek(uint64_t timestamp_ns) const{
+    // last block starting at or before the target
+    auto it = std::upper_bound(_blocks.begin(), _blocks.end(), timestamp_ns,
+                               [](uint64_t t, const Block& b){ return t < b.first_ns; });
+    size_t b = it == _blocks.begin() ? 0 : static_cast<size_t>(std::distance(_blocks.begin(), it)) - 1;
+    if(_blocks.empty())
+        return end();
+
+    // then the first of its fixed size records at or after it
+    const Block &blk = _blocks[b];
+    uint64_t lo = 0, hi = blk.records;
+    while(lo < hi){
+        const uint64_t mid = (lo + hi) / 2;
+        if(stamp(blk.data + mid * _record_bytes) < timestamp_ns)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo == blk.records)
+        return b + 1 < _blocks.size() ? Cursor{static_cast<uint32_t>(b + 1), 0} : end();
+    return Cursor{static_cast<uint32_t>(b), lo * _record_bytes};
+}
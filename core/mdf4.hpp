@@ -0,0 +1,176 @@
+#pragma once
+
+#include "dbc.hpp"
+#include "framelog.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ASAM MDF 4.10 measurement files, for tools that take .mf4 (CANape,
+// asammdf, ...).
+//
+// Mdf4Writer lays a file out as sorted data groups, one channel group each:
+// raw frames in a CAN_DataFrame group following the ASAM bus logging
+// convention, and per DBC message with signals a group of its physical
+// values as float64, both against a float64 "Timestamp" master in seconds
+// from the header start time. Records are 80 bytes for every raw frame:
+//
+//   0   f64  Timestamp
+//   8   u32  CAN_DataFrame.ID (29 bits), .IDE bit 31; bit 30 keeps the RTR
+//            flag (candb.hpp id layout), which has no channel of its own
+//   12  u8   .BusChannel (bus number + 1)
+//   13  u8   .DLC
+//   14  u8   .DataLength
+//   15  u8   .BRS bit 0, .EDL bit 1
+//   16  64B  .DataBytes, zero padded
+//
+// Every group fills its own buffer and writes it out as a DT block when
+// full, so memory stays at one buffer per group whatever the length of the
+// capture. The group, channel and data list (DL) blocks that tie the DT
+// blocks together are written by close(); until then the file says
+// "UnFinMF " and is not readable.
+class Mdf4Writer {
+    public:
+        static constexpr size_t RAW_BLOCK_BYTES = 1u << 20;
+        static constexpr size_t DECODED_BLOCK_BYTES = 64u << 10;
+
+        // One decoded group per message of messages with signals. Timestamps
+        // passed to append() plus realtime_offset_ns are wall clock; the
+        // first one is the file's start time. Throws std::runtime_error.
+        Mdf4Writer(const std::string& path, const DbcMessageList& messages,
+                   int64_t realtime_offset_ns = 0);
+        ~Mdf4Writer();
+
+        Mdf4Writer(const Mdf4Writer&) = delete;
+        Mdf4Writer& operator=(const Mdf4Writer&) = delete;
+
+        // kept in the raw group's comment, read back by Mdf4Reader
+        void set_bus_name(uint8_t bus, const std::string& name);
+
+        // flags: CANLOG_FLAG_*
+        void append(uint8_t bus, uint32_t id, uint8_t len, const uint8_t* payload,
+                    uint64_t timestamp_ns, uint8_t flags = 0);
+
+        // writes what is buffered and the metadata; throws like append()
+        void close();
+
+        const std::string& path() const { return _path; }
+        uint64_t frames() const { return _frames; }
+        uint64_t bytes_written() const { return _end; }
+
+    private:
+        struct Group {
+            std::string name;
+            const DbcMessage* message = nullptr;   // null: raw frames
+            std::vector<DbcSignalPlan> plans;      // its signals, compiled
+            size_t record_bytes = 0;
+            size_t capacity = 0;                   // whole records per DT block
+            std::vector<uint8_t> buffer;
+            size_t fill = 0;
+            uint64_t cycles = 0;
+            std::vector<uint64_t> blocks;          // DT block offsets
+            std::vector<uint64_t> block_bytes;
+        };
+
+        void flush(Group& g);
+        uint64_t put_block(const char* id, const std::vector<uint64_t>& links,
+                           const void* data, size_t len);
+        uint64_t put_text(const char* id, const std::string& text);
+        uint64_t put_data_link(const Group& g);
+        uint64_t put_channel(const std::string& name, uint8_t type, uint8_t sync, uint8_t data_type,
+                             uint32_t byte_offset, uint8_t bit_offset, uint32_t bits,
+                             uint64_t next, uint64_t composition, uint64_t unit);
+        uint64_t put_group(const Group& g, uint64_t next_dg);
+        void write_id(bool finished);
+        void write_at(uint64_t offset, const void* data, size_t len);
+
+        std::string _path;
+        std::ofstream _out;
+        uint64_t _end = 0;
+        bool _closed = false;
+
+        int64_t _realtime_offset_ns;
+        bool _started = false;
+        uint64_t _start_ns = 0;   // log time of Timestamp 0
+        uint64_t _frames = 0;
+
+        std::vector<DbcMessage> _messages;
+        std::vector<Group> _groups;                  // [0] raw frames
+        std::unordered_map<uint32_t, size_t> _by_id; // decoded group by message id
+        std::vector<std::string> _bus_names;
+};
+
+// Raw frames of an MDF4 file for replay and export. Finds the first
+// CAN_DataFrame channel group of a sorted data group, reads the member
+// channels it has (ID, IDE, BusChannel, DLC, DataLength, DataBytes, BRS,
+// EDL) wherever they sit in the record, and maps the file read only.
+//
+// Only the data list is walked on open: one timestamp per DT block, so
+// seek() is a binary search over blocks, then over the fixed size records
+// of one block. Cursors are a block number and a byte offset into its data.
+// Compressed (DZ) data, variable length DataBytes and records split across
+// two blocks are refused.
+class Mdf4Reader : public FrameLog {
+    public:
+        // throws std::runtime_error / std::system_error
+        explicit Mdf4Reader(const std::string& path);
+        ~Mdf4Reader();
+
+        Mdf4Reader(const Mdf4Reader&) = delete;
+        Mdf4Reader& operator=(const Mdf4Reader&) = delete;
+
+        const std::string& path() const override { return _path; }
+        uint64_t first_ns() const override;
+        uint64_t last_ns() const override;
+        uint64_t records() const override { return _records; }
+        const std::vector<std::string>& bus_names() const override { return _bus_names; }
+
+        Cursor begin() const override { return Cursor{}; }
+        Cursor seek(uint64_t timestamp_ns) const override;
+        Cursor end() const override { return Cursor{static_cast<uint32_t>(_blocks.size()), 0}; }
+
+        bool next(Cursor& c, CanLogRecord& rec, const uint8_t*& payload) const override;
+
+    private:
+        // a channel inside the record
+        struct Field {
+            bool present = false;
+            uint32_t byte_offset = 0;
+            uint8_t bit_offset = 0;
+            uint32_t bits = 0;
+        };
+
+        struct Block {
+            const uint8_t* data = nullptr;
+            uint64_t records = 0;
+            uint64_t first_ns = 0;
+        };
+
+        void map();
+        const uint8_t* block_at(uint64_t offset, const char* id) const;
+        bool load_group(uint64_t cg, uint64_t data_link);
+        void load_data(uint64_t link);
+        uint64_t stamp(const uint8_t* record) const;
+        static uint64_t bits_at(const uint8_t* record, const Field& f);
+
+        std::string _path;
+        const uint8_t* _data = nullptr;
+        size_t _size = 0;
+#ifdef _WIN32
+        std::vector<uint8_t> _copy;
+#endif
+
+        uint64_t _start_ns = 0;       // header start time
+        size_t _record_bytes = 0;
+        Field _time;
+        bool _time_float = true;
+        double _time_a0 = 0.0, _time_a1 = 1.0;   // linear conversion to seconds
+        Field _id, _ide, _bus, _dlc, _length, _bytes, _brs, _edl;
+
+        std::vector<Block> _blocks;
+        uint64_t _records = 0;
+        std::vector<std::string> _bus_names;
+};
@@ -0,0 +1,366 @@
+#include "reactor.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <cerrno>
+#include <poll.h>
+#endif
+
+#if defined(__linux__)
+enum : uint64_t {
+    TAG_CONTROL = 0,
+    TAG_SOURCE  = 1,
+    TAG_TIMER   = 2
+};
+
+static inline uint64_t make_tag(uint64_t kind, int id){
+    return (kind << 32) | static_cast<uint32_t>(id);
+}
+#else
+static uint64_t now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+Reactor::Reactor(){
+#if defined(__linux__)
+    _epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(_epfd < 0)
+        throw std::system_error(errno, std::system_category(), "epoll_create1 failed");
+    _evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_evfd < 0){
+        ::close(_epfd);
+        throw std::system_error(errno, std::system_category(), "eventfd failed");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = make_tag(TAG_CONTROL, 0);
+    epoll_ctl(_epfd, EPOLL_CTL_ADD, _evfd, &ev);
+#endif
+}
+
+Reactor::~Reactor(){
+    stop();
+    std::vector<int> ids;
+    for(const auto &s : _sources)
+        ids.push_back(s.first);
+    for(int id : ids)
+        detach_source(id);
+    ids.clear();
+    for(const auto &t : _timers)
+        ids.push_back(t.first);
+    for(int id : ids)
+        detach_timer(id);
+#if defined(__linux__)
+    ::close(_evfd);
+    ::close(_epfd);
+#endif
+}
+
+int Reactor::add_source(std::unique_ptr<IngestSource> source){
+    int id = _next_id.fetch_add(1);
+    // std::function needs a copyable capture
+    auto box = std::make_shared<std::unique_ptr<IngestSource>>(std::move(source));
+    post([this, id, box]{ attach_source(id, std::move(*box)); });
+    return id;
+}
+
+void Reactor::remove_source(int id){
+    post([this, id]{ detach_source(id); });
+}
+
+void Reactor::remove_all_sources(){
+    post([this]{
+        std::vector<int> ids;
+        for(const auto &s : _sources)
+            ids.push_back(s.first);
+        for(int id : ids)
+            detach_source(id);
+    });
+}
+
+std::vector<std::pair<int, std::string>> Reactor::sources() const{
+    std::lock_guard<std::mutex> lock(_listing_mtx);
+    return _listing;
+}
+
+int Reactor::add_timer(uint64_t period_ns, Task fn){
+    int id = _next_id.fetch_add(1);
+    auto box = std::make_shared<Task>(std::move(fn));
+    post([this, id, period_ns, box]{ attach_timer(id, period_ns, std::move(*box)); });
+    return id;
+}
+
+void Reactor::remove_timer(int id){
+    post([this, id]{ detach_timer(id); });
+}
+
+void Reactor::set_timer_armed(int id, bool armed){
+    post([this, id, armed]{ arm_timer(id, armed); });
+}
+
+void Reactor::post(Task fn){
+    {
+        std::lock_guard<std::mutex> lock(_post_mtx);
+        _posted.push_back(std::move(fn));
+    }
+#if defined(__linux__)
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(_evfd, &one, sizeof(one));
+#else
+    _post_cv.notify_one();
+#endif
+}
+
+void Reactor::run_posted(){
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(_post_mtx);
+        tasks.swap(_posted);
+    }
+    for(auto &t : tasks)
+        t();
+}
+
+void Reactor::stop(){
+    _running.store(false);
+#if defined(__linux__)
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(_evfd, &one, sizeof(one));
+#else
+    { std::lock_guard<std::mutex> lock(_post_mtx); }
+    _post_cv.notify_one();
+#endif
+}
+
+void Reactor::publish_listing(){
+    std::vector<std::pair<int, std::string>> listing;
+    listing.reserve(_sources.size());
+    for(const auto &s : _sources)
+        listing.emplace_back(s.first, s.second.source->name());
+    std::lock_guard<std::mutex> lock(_listing_mtx);
+    _listing.swap(listing);
+}
+
+#if defined(__linux__)
+
+void Reactor::attach_source(int id, std::unique_ptr<IngestSource> source){
+    if(!source)
+        return;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = make_tag(TAG_SOURCE, id);
+    if(epoll_ctl(_epfd, EPOLL_CTL_ADD, source->fd(), &ev) != 0){
+        std::cout << "[!] Unable to watch source " << source->name() << std::endl;
+        return;
+    }
+    _sources[id].source = std::move(source);
+    publish_listing();
+}
+
+void Reactor::detach_source(int id){
+    auto it = _sources.find(id);
+    if(it == _sources.end())
+        return;
+    epoll_ctl(_epfd, EPOLL_CTL_DEL, it->second.source->fd(), nullptr);
+    _sources.erase(it);
+    publish_listing();
+}
+
+// an all-zero spec disarms the timerfd
+static void set_timerfd(int fd, uint64_t period_ns, bool armed){
+    itimerspec spec{};
+    if(armed){
+        spec.it_interval.tv_sec = period_ns / 1000000000ull;
+        spec.it_interval.tv_nsec = period_ns % 1000000000ull;
+        spec.it_value = spec.it_interval;
+        if(period_ns == 0)
+            spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(fd, 0, &spec, nullptr);
+}
+
+void Reactor::attach_timer(int id, uint64_t period_ns, Task fn){
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(fd < 0)
+        return;
+    set_timerfd(fd, period_ns, true);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = make_tag(TAG_TIMER, id);
+    epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev);
+
+    Timer &t = _timers[id];
+    t.period_ns = period_ns;
+    t.fn = std::move(fn);
+    t.fd = fd;
+}
+
+void Reactor::detach_timer(int id){
+    auto it = _timers.find(id);
+    if(it == _timers.end())
+        return;
+    epoll_ctl(_epfd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    ::close(it->second.fd);
+    _timers.erase(it);
+}
+
+void Reactor::arm_timer(int id, bool armed){
+    auto it = _timers.find(id);
+    if(it == _timers.end() || it->second.armed == armed)
+        return;
+    it->second.armed = armed;
+    set_timerfd(it->second.fd, it->second.period_ns, armed);
+}
+
+void Reactor::run(){
+    epoll_event events[64];
+    while(_running.load()){
+        int n = epoll_wait(_epfd, events, 64, -1);
+        if(n < 0){
+            if(errno == EINTR)
+                continue;
+            std::cout << "[!] epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for(int i = 0; i < n; ++i){
+            const uint64_t kind = events[i].data.u64 >> 32;
+            const int id = static_cast<int>(events[i].data.u64 & 0xFFFFFFFFu);
+            if(kind == TAG_CONTROL){
+                uint64_t v;
+                [[maybe_unused]] ssize_t r = ::read(_evfd, &v, sizeof(v));
+                run_posted();
+            } else if(kind == TAG_SOURCE){
+                // an earlier event in this batch may have dropped it already
+                auto it = _sources.find(id);
+                if(it == _sources.end())
+                    continue;
+                bool alive = it->second.source->on_readable();
+                if(!alive || (events[i].events & (EPOLLHUP | EPOLLERR)))
+                    detach_source(id);
+            } else if(kind == TAG_TIMER){
+                auto it = _timers.find(id);
+                if(it == _timers.end())
+                    continue;
+                uint64_t expirations;
+                [[maybe_unused]] ssize_t r = ::read(it->second.fd, &expirations, sizeof(expirations));
+                // disarmed earlier in this batch
+                if(!it->second.armed)
+                    continue;
+                it->second.fn();
+            }
+        }
+    }
+    // work posted just before stop() still runs, e.g. closing the sources
+    run_posted();
+}
+
+#else
+
+void Reactor::attach_source(int id, std::unique_ptr<IngestSource> source){
+    if(!source)
+        return;
+    SourceSlot &slot = _sources[id];
+    slot.alive = std::make_shared<std::atomic<bool>>(true);
+    IngestSource* src = source.get();
+    auto alive = slot.alive;
+    slot.source = std::move(source);
+    slot.reader = std::thread([this, id, src, alive]{
+        while(alive->load()){
+#ifndef _WIN32
+            // the fd is non-blocking, sleep until it has data and look at
+            // alive now and then so closing never waits on a quiet source
+            struct pollfd pfd = {src->fd(), POLLIN, 0};
+            int r = ::poll(&pfd, 1, 100);
+            if(r == 0 || (r < 0 && errno == EINTR))
+                continue;
+#endif
+            if(!src->on_readable())
+                break;
+        }
+        if(alive->load())
+            remove_source(id);
+    });
+    publish_listing();
+}
+
+void Reactor::detach_source(int id){
+    auto it = _sources.find(id);
+    if(it == _sources.end())
+        return;
+    it->second.alive->store(false);
+    if(it->second.reader.joinable())
+        it->second.reader.join();
+    _sources.erase(it);
+    publish_listing();
+}
+
+void Reactor::attach_timer(int id, uint64_t period_ns, Task fn){
+    Timer &t = _timers[id];
+    t.period_ns = period_ns;
+    t.fn = std::move(fn);
+    t.due_ns = now_ns() + period_ns;
+}
+
+void Reactor::detach_timer(int id){
+    _timers.erase(id);
+}
+
+void Reactor::arm_timer(int id, bool armed){
+    auto it = _timers.find(id);
+    if(it == _timers.end() || it->second.armed == armed)
+        return;
+    it->second.armed = armed;
+    if(armed)
+        it->second.due_ns = now_ns() + it->second.period_ns;
+}
+
+void Reactor::run(){
+    while(_running.load()){
+        {
+            std::unique_lock<std::mutex> lock(_post_mtx);
+            uint64_t next = UINT64_MAX;
+            for(const auto &t : _timers)
+                if(t.second.armed)
+                    next = std::min(next, t.second.due_ns);
+            auto ready = [&]{ return !_posted.empty() || !_running.load(); };
+            if(next == UINT64_MAX){
+                _post_cv.wait(lock, ready);
+            } else {
+                uint64_t now = now_ns();
+                if(next > now)
+                    _post_cv.wait_for(lock, std::chrono::nanoseconds(next - now), ready);
+            }
+        }
+        run_posted();
+
+        uint64_t now = now_ns();
+        std::vector<int> due;
+        for(const auto &t : _timers)
+            if(t.second.armed && t.second.due_ns <= now)
+                due.push_back(t.first);
+        for(int id : due){
+            auto it = _timers.find(id);
+            if(it == _timers.end() || !it->second.armed)
+                continue;
+            it->second.due_ns = now + (it->second.period_ns ? it->second.period_ns : UINT64_MAX - now);
+            it->second.fn();
+        }
+    }
+    run_posted();
+}
+
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Something the reactor can drain: a serial port, a socket, ...
+class IngestSource {
+    public:
+        explicit IngestSource(std::string name) : _name(std::move(name)) {}
+        virtual ~IngestSource() = default;
+
+        IngestSource(const IngestSource&) = delete;
+        IngestSource& operator=(const IngestSource&) = delete;
+
+#ifndef _WIN32
+        // fd polled for readability, the source puts it in non-blocking mode
+        virtual int fd() const = 0;
+#endif
+        // consume what is readable right now, false once the source is finished
+        virtual bool on_readable() = 0;
+
+        const std::string& name() const { return _name; }
+
+    private:
+        std::string _name;
+};
+
+// Single threaded I/O loop. On linux every source, timer and control event is
+// an fd on one epoll set; elsewhere each source gets a blocking reader thread
+// and the loop only runs timers and posted work.
+// add/remove/post are safe from any thread, the work itself always runs on
+// the thread inside run().
+class Reactor {
+    public:
+        using Task = std::function<void()>;
+
+        Reactor();
+        ~Reactor();
+
+        Reactor(const Reactor&) = delete;
+        Reactor& operator=(const Reactor&) = delete;
+
+        int add_source(std::unique_ptr<IngestSource> source);
+        void remove_source(int id);
+        void remove_all_sources();
+        std::vector<std::pair<int, std::string>> sources() const;
+
+        int add_timer(uint64_t period_ns, Task fn);
+        void remove_timer(int id);
+        // a disarmed timer stays registered but never fires, so it costs no
+        // wakeups; arming it again starts a fresh period from now
+        void set_timer_armed(int id, bool armed);
+
+        void post(Task fn);
+
+        void run();
+        void stop();
+
+    private:
+        struct Timer {
+            uint64_t period_ns = 0;
+            Task fn;
+            bool armed = true;
+#if defined(__linux__)
+            int fd = -1;
+#else
+            uint64_t due_ns = 0;
+#endif
+        };
+
+        struct SourceSlot {
+            std::unique_ptr<IngestSource> source;
+#if !defined(__linux__)
+            std::shared_ptr<std::atomic<bool>> alive;
+            std::thread reader;
+#endif
+        };
+
+        void run_posted();
+        void attach_source(int id, std::unique_ptr<IngestSource> source);
+        void detach_source(int id);
+        void attach_timer(int id, uint64_t period_ns, Task fn);
+        void detach_timer(int id);
+        void arm_timer(int id, bool armed);
+        void publish_listing();
+
+        std::atomic<bool> _running{true};
+        std::atomic<int> _next_id{1};
+
+        std::mutex _post_mtx;
+        std::vector<Task> _posted;
+#if defined(__linux__)
+        int _epfd = -1;
+        int _evfd = -1;
+#else
+        std::condition_variable _post_cv;
+#endif
+
+        // owned by the reactor thread
+        std::unordered_map<int, SourceSlot> _sources;
+        std::unordered_map<int, Timer> _timers;
+
+        mutable std::mutex _listing_mtx;
+        std::vector<std::pair<int, std::string>> _listing;
+};
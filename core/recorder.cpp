@@ -0,0 +1,215 @@
+#include "recorder.hpp"
+#include "candb.hpp"
+#include "clock.hpp"
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+static std::string default_session_dir(){
+    std::time_t now = std::time(nullptr);
+    std::tm tm_now{};
+#ifdef _WIN32
+    localtime_s(&tm_now, &now);
+#else
+    localtime_r(&now, &tm_now);
+#endif
+    char name[32];
+    std::strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &tm_now);
+    return std::string("sessions/") + name;
+}
+
+SessionRecorder::~SessionRecorder(){
+    stop();
+}
+
+std::string SessionRecorder::directory() const{
+    std::lock_guard<std::mutex> lock(_dir_mtx);
+    return _dir;
+}
+
+void SessionRecorder::set_bus_name(uint8_t bus, const std::string& name){
+    std::lock_guard<std::mutex> lock(_bus_mtx);
+    if(_bus_names.size() <= bus)
+        _bus_names.resize(bus + 1u);
+    _bus_names[bus] = name;
+    if(_log)
+        _log->set_bus_name(bus, name);
+}
+
+void SessionRecorder::start(const std::string& dir,
+                            const DbcMessageList* mdf_messages){
+    if(_active.load(std::memory_order_acquire))
+        return;
+    // the writer gave up on an error (disk full, directory gone) and left
+    // its thread to be joined
+    stop();
+    std::string path = dir.empty() ? default_session_dir() : dir;
+    {
+        std::lock_guard<std::mutex> lock(_bus_mtx);
+        _log.reset(new CanLogWriter(path));
+        for(size_t i = 0; i < _bus_names.size(); ++i)
+            _log->set_bus_name(static_cast<uint8_t>(i), _bus_names[i]);
+    }
+    _mdf.reset();
+    if(mdf_messages){
+        // frames are stamped host monotonic, the file wants wall clock
+        const int64_t realtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        _mdf.reset(new Mdf4Writer(path + "/session.mf4", *mdf_messages,
+                                  realtime - static_cast<int64_t>(monotonic_ns())));
+    }
+    {
+        std::lock_guard<std::mutex> lock(_dir_mtx);
+        _dir = path;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _free.clear();
+        _full.clear();
+        for(size_t i = 1; i < BUFFERS; ++i)
+            _free.push_back(CanLogWriter::aligned_block(BUFFER_BYTES));
+        _open = CanLogWriter::aligned_block(BUFFER_BYTES);
+        _fill = 0;
+        _stopping = false;
+    }
+    _frames.store(0, std::memory_order_relaxed);
+    _dropped.store(0, std::memory_order_relaxed);
+    _bytes_written.store(0, std::memory_order_relaxed);
+
+    _active.store(true, std::memory_order_release);
+    _thread = std::thread([this]{ writer(); });
+    std::cout << "[+] Recording to " << path << std::endl;
+}
+
+void SessionRecorder::stop(){
+    if(!_thread.joinable())
+        return;
+    _active.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stopping = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+    {
+        std::lock_guard<std::mutex> lock(_bus_mtx);
+        _log.reset();
+    }
+    _mdf.reset();
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    _open.reset();
+    _free.clear();
+    _full.clear();
+    _fill = 0;
+    std::cout << "[+] Recording stopped, " << frames() << " frames, "
+              << dropped() << " dropped" << std::endl;
+}
+
+// _mtx held. pad: flush a partly filled buffer, rounded up to the block
+// size; the zeros after the last record read as padding.
+void SessionRecorder::hand_off(bool pad){
+    if(!_open || !_fill)
+        return;
+    size_t len = pad ? canlog_align_up(_fill) : BUFFER_BYTES;
+    std::memset(_open.get() + _fill, 0, len - _fill);
+    _full.push_back(Filled{std::move(_open), len});
+    _fill = 0;
+    if(!_free.empty()){
+        _open = std::move(_free.back());
+        _free.pop_back();
+    }
+    _cv.notify_one();
+}
+
+void SessionRecorder::record(uint8_t bus, uint32_t id, uint8_t len, const uint8_t* payload,
+                             uint64_t timestamp_ns, bool brs){
+    if(!_active.load(std::memory_order_relaxed))
+        return;
+    if(len > CAN_FD_MAX_LEN)
+        len = CAN_FD_MAX_LEN;
+    const size_t need = canlog_record_size(len);
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    if(_open && _fill + need > BUFFER_BYTES)
+        hand_off(false);
+    if(!_open){
+        // every buffer is queued for the disk
+        _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    if(!_fill)
+        _opened_ns = monotonic_ns();
+    const uint8_t flags = (len > CAN_CLASSIC_MAX_LEN ? CANLOG_FLAG_FD : 0) | (brs ? CANLOG_FLAG_BRS : 0);
+    canlog_put_record(_open.get() + _fill, timestamp_ns, id, bus, len, flags, payload);
+    _fill += need;
+    _frames.store(_frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// writer thread: the records of one buffer, padding skipped as the reader does
+void SessionRecorder::write_mdf(const uint8_t* data, size_t len){
+    for(size_t off = 0; off + CANLOG_RECORD_HEADER <= len;){
+        CanLogRecord rec;
+        std::memcpy(&rec, data + off, sizeof(rec));
+        if(rec.timestamp_ns == 0){
+            off = (off / CANLOG_ALIGN + 1) * CANLOG_ALIGN;
+            continue;
+        }
+        _mdf->append(rec.bus, rec.id, rec.len, data + off + CANLOG_RECORD_HEADER, rec.timestamp_ns, rec.flags);
+        off += canlog_record_size(rec.len);
+    }
+}
+
+void SessionRecorder::writer(){
+    try{
+        for(;;){
+            Filled f;
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _cv.wait_for(lock, std::chrono::milliseconds(250), [this]{
+                    return !_full.empty() || _stopping;
+                });
+                if(_full.empty() && _fill && (_stopping || monotonic_ns() - _opened_ns >= FLUSH_INTERVAL_NS))
+                    hand_off(true);
+                if(_full.empty()){
+                    if(_stopping)
+                        break;
+                    continue;
+                }
+                f = std::move(_full.front());
+                _full.pop_front();
+            }
+
+            const size_t written = _log->bytes_written();
+            _log->write_block(f.data.get(), f.len);
+            _bytes_written.fetch_add(_log->bytes_written() - written, std::memory_order_relaxed);
+            if(_mdf)
+                write_mdf(f.data.get(), f.len);
+
+            std::lock_guard<std::mutex> lock(_mtx);
+            if(!_open){
+                _open = std::move(f.data);
+                _fill = 0;
+            } else {
+                _free.push_back(std::move(f.data));
+            }
+        }
+        _log->close();
+        if(_mdf){
+            {
+                std::lock_guard<std::mutex> lock(_bus_mtx);
+                for(size_t i = 0; i < _bus_names.size(); ++i)
+                    _mdf->set_bus_name(static_cast<uint8_t>(i), _bus_names[i]);
+            }
+            _mdf->close();
+            std::cout << "[+] Wrote " << _mdf->path() << ", "
+                      << _mdf->bytes_written() / 1000000 << " MB" << std::endl;
+        }
+    } catch(const std::exception& e){
+        _active.store(false, std::memory_order_release);
+        std::cout << "[!] Recording stopped: " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "canlog_writer.hpp"
+#include "mdf4.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Writes every raw frame to a segmented session log (canlog.hpp).
+//
+// record() runs on the ingest threads and only copies the frame into the
+// open buffer under a short lock. Full buffers (or one that has sat for
+// FLUSH_INTERVAL_NS) go to a dedicated writer thread, which hands them to a
+// CanLogWriter (O_DIRECT where the filesystem allows it, index built as it
+// goes, segments rolled). If the disk falls behind by
+// all BUFFERS the newest frames are dropped and counted; the parser is
+// never made to wait. The same thread can also feed every written buffer to
+// an Mdf4Writer, for a session.mf4 next to the segments.
+class SessionRecorder {
+    public:
+        static constexpr size_t BUFFER_BYTES = 1u << 20;
+        static constexpr size_t BUFFERS = 32;
+        static constexpr uint64_t FLUSH_INTERVAL_NS = 1000000000ull;
+
+        SessionRecorder() = default;
+        ~SessionRecorder();
+
+        SessionRecorder(const SessionRecorder&) = delete;
+        SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+        // empty dir: sessions/<local time>. With mdf_messages the session
+        // also gets session.mf4, raw frames plus a decoded group per message
+        // (copied, later DBC changes don't reach it). Throws
+        // std::system_error / std::runtime_error. After the writer failed
+        // (active() went false on its own) this starts a new session.
+        void start(const std::string& dir = {},
+                   const DbcMessageList* mdf_messages = nullptr);
+        // flushes, closes the last segment with its index, joins the writer
+        void stop();
+        bool active() const { return _active.load(std::memory_order_acquire); }
+        std::string directory() const;
+
+        void set_bus_name(uint8_t bus, const std::string& name);
+
+        void record(uint8_t bus, uint32_t id, uint8_t len, const uint8_t* payload,
+                    uint64_t timestamp_ns, bool brs = false);
+
+        uint64_t frames() const { return _frames.load(std::memory_order_relaxed); }
+        uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+        uint64_t bytes_written() const { return _bytes_written.load(std::memory_order_relaxed); }
+
+    private:
+        using Buffer = CanLogWriter::Block;
+
+        struct Filled {
+            Buffer data;
+            size_t len;
+        };
+
+        void hand_off(bool pad);
+        void write_mdf(const uint8_t* data, size_t len);
+        void writer();
+
+        std::atomic<bool> _active{false};
+        std::string _dir;
+        mutable std::mutex _dir_mtx;
+
+        // -- ingest side, under _mtx --
+        std::mutex _mtx;
+        std::condition_variable _cv;
+        Buffer _open;
+        size_t _fill = 0;
+        uint64_t _opened_ns = 0;
+        std::vector<Buffer> _free;
+        std::deque<Filled> _full;
+        bool _stopping = false;
+
+        // -- writer thread --
+        std::thread _thread;
+        std::unique_ptr<CanLogWriter> _log;
+        std::unique_ptr<Mdf4Writer> _mdf;
+
+        // kept across sessions, each new log starts with all of them
+        std::mutex _bus_mtx;
+        std::vector<std::string> _bus_names;
+
+        std::atomic<uint64_t> _frames{0};
+        std::atomic<uint64_t> _dropped{0};
+        std::atomic<uint64_t> _bytes_written{0};
+};
@@ -0,0 +1,154 @@
+#include "replay.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+ReplayEngine::ReplayEngine(const std::string& path, HandlerFactory make_handler)
+    : _log(open_frame_log(path)), _make_handler(std::move(make_handler)) {
+    _cursor = _log->begin();
+    _position = _log->first_ns();
+    _rate_start_ns = monotonic_ns();
+    reanchor();
+    publish(_rate_start_ns);
+}
+
+// playback continues from the pending frame as of now
+void ReplayEngine::reanchor(){
+    if(!_have)
+        _have = _log->next(_cursor, _rec, _payload);
+    const uint64_t now = monotonic_ns();
+    _anchor_host = now;
+    _anchor_log = _have ? _rec.timestamp_ns : _position;
+    const uint64_t out = std::max(now, _last_out + 1);
+    _shift = static_cast<int64_t>(out - _anchor_log);
+    _run_frames = _frames;
+}
+
+void ReplayEngine::send(const CanLogRecord& rec, const uint8_t* payload){
+    if(_handlers.size() <= rec.bus)
+        _handlers.resize(rec.bus + 1u);
+    FrameHandler &h = _handlers[rec.bus];
+    if(!h){
+        const auto &names = _log->bus_names();
+        std::string name = rec.bus < names.size() && !names[rec.bus].empty()
+                         ? names[rec.bus] : "bus " + std::to_string(rec.bus);
+        h = _make_handler(name);
+    }
+    uint64_t out = static_cast<uint64_t>(static_cast<int64_t>(rec.timestamp_ns) + _shift);
+    // recorded stamps from different buses may interleave slightly
+    out = std::max(out, _last_out);
+    _last_out = out;
+    _position = rec.timestamp_ns;
+    ++_frames;
+    h(rec.id, rec.len, payload, out);
+}
+
+void ReplayEngine::tick(){
+    const uint64_t now = monotonic_ns();
+    if(!_paused && !_finished){
+        if(_speed <= 0.0){
+            uint64_t sent = 0;
+            while(_have){
+                send(_rec, _payload);
+                _have = _log->next(_cursor, _rec, _payload);
+                // the clock is only worth reading now and then
+                if(++sent % 256 == 0 && monotonic_ns() - now >= FAST_BUDGET_NS)
+                    break;
+            }
+        } else {
+            const double elapsed = static_cast<double>(now - _anchor_host) * _speed;
+            const uint64_t due_log = _anchor_log + static_cast<uint64_t>(elapsed);
+            uint64_t sent = 0;
+            while(_have && _rec.timestamp_ns <= due_log){
+                send(_rec, _payload);
+                _have = _log->next(_cursor, _rec, _payload);
+                // far behind (a slow machine at high speed): catch up over
+                // several ticks rather than stall the reactor
+                if(++sent % 256 == 0 && monotonic_ns() - now >= FAST_BUDGET_NS)
+                    break;
+            }
+        }
+        if(!_have){
+            _finished = true;
+            const uint64_t run = _frames - _run_frames;
+            const double seconds = static_cast<double>(now - _anchor_host) * 1e-9;
+            std::cout << "[+] Replay of " << _log->path() << " finished, "
+                      << run << " frames";
+            if(_speed <= 0.0 && seconds > 0.0)
+                std::cout << " at " << static_cast<uint64_t>(run / seconds) << " frames/s";
+            std::cout << std::endl;
+        }
+    }
+    publish(now);
+}
+
+void ReplayEngine::seek(uint64_t log_ns){
+    _cursor = _log->seek(log_ns);
+    _have = _log->next(_cursor, _rec, _payload);
+    _finished = !_have;
+    _position = _have ? _rec.timestamp_ns : _log->last_ns();
+    reanchor();
+    publish(monotonic_ns());
+}
+
+void ReplayEngine::set_speed(double speed){
+    _speed = speed < 0.0 ? 0.0 : speed;
+    reanchor();
+    publish(monotonic_ns());
+}
+
+void ReplayEngine::set_paused(bool paused){
+    if(paused == _paused)
+        return;
+    _paused = paused;
+    if(!paused)
+        reanchor();
+    publish(monotonic_ns());
+}
+
+void ReplayEngine::step(){
+    _paused = true;
+    if(!_have)
+        _have = _log->next(_cursor, _rec, _payload);
+    if(!_have){
+        _finished = true;
+        publish(monotonic_ns());
+        return;
+    }
+    send(_rec, _payload);
+    _have = _log->next(_cursor, _rec, _payload);
+    _finished = !_have;
+    publish(monotonic_ns());
+}
+
+void ReplayEngine::publish(uint64_t now_ns){
+    // no ticks come while idle to bring the rate down, so it drops here
+    if(idle()){
+        _rate_hz = 0.0;
+        _rate_start_ns = now_ns;
+        _rate_start_frames = _frames;
+    } else if(now_ns - _rate_start_ns >= 1000000000ull){
+        _rate_hz = static_cast<double>(_frames - _rate_start_frames) * 1e9 /
+                   static_cast<double>(now_ns - _rate_start_ns);
+        _rate_start_ns = now_ns;
+        _rate_start_frames = _frames;
+    }
+    std::lock_guard<std::mutex> lock(_status_mtx);
+    _status.open = true;
+    _status.paused = _paused;
+    _status.finished = _finished;
+    _status.speed = _speed;
+    _status.first_ns = _log->first_ns();
+    _status.last_ns = _log->last_ns();
+    _status.position_ns = _position;
+    _status.frames = _frames;
+    _status.rate_hz = _rate_hz;
+    if(_status.directory.empty())
+        _status.directory = _log->path();
+}
+
+ReplayStatus ReplayEngine::status() const{
+    std::lock_guard<std::mutex> lock(_status_mtx);
+    return _status;
+}
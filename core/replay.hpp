@@ -0,0 +1,94 @@
+#pragma once
+
+#include "framelog.hpp"
+#include "candb.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// what the GUI shows of a replay
+struct ReplayStatus {
+    bool open = false;
+    bool paused = false;
+    bool finished = false;
+    double speed = 1.0;            // 0 = as fast as possible
+    uint64_t first_ns = 0;         // log time
+    uint64_t last_ns = 0;
+    uint64_t position_ns = 0;      // log time of the newest frame sent
+    uint64_t frames = 0;           // sent since opening
+    double rate_hz = 0.0;          // frames per second over the last second
+    std::string directory;
+};
+
+// Plays a session log or an MDF4 file (open_frame_log) back through the same
+// frame handlers a live source uses. Driven by tick() from a reactor timer
+// while it is not idle(); every other call also comes from the reactor
+// thread and publishes its change itself, only status() is read elsewhere.
+//
+// Frames keep their recorded spacing: each is stamped with its log time plus
+// an offset chosen whenever playback (re)starts, so at 1x the stamps are the
+// host clock and at other speeds only the pacing changes. The offset never
+// lets a stamp go backwards, even after seeking back. As fast as possible
+// sends for most of every tick, which makes it a throughput test of the
+// whole parser -> store -> decode path.
+class ReplayEngine {
+    public:
+        static constexpr uint64_t TICK_NS = 1000000;
+        // share of a tick spent sending when not paced
+        static constexpr uint64_t FAST_BUDGET_NS = 800000;
+
+        using HandlerFactory = std::function<FrameHandler(const std::string& bus)>;
+
+        // path: a session directory or an .mf4 file. make_handler is called
+        // once per recorded bus, with its name. Throws like open_frame_log.
+        ReplayEngine(const std::string& path, HandlerFactory make_handler);
+
+        void tick();
+        // positions at the first frame at or after log time t
+        void seek(uint64_t log_ns);
+        void set_speed(double speed);
+        void set_paused(bool paused);
+        // sends the next frame, pauses first if playing
+        void step();
+
+        ReplayStatus status() const;
+        // paused or played to the end: tick() has nothing to do until the
+        // next seek() or set_paused(false), its timer can be disarmed
+        bool idle() const { return _paused || _finished; }
+
+    private:
+        void reanchor();
+        void send(const CanLogRecord& rec, const uint8_t* payload);
+        void publish(uint64_t now_ns);
+
+        std::unique_ptr<FrameLog> _log;
+        HandlerFactory _make_handler;
+        std::vector<FrameHandler> _handlers; // by bus number, made on first use
+
+        FrameLog::Cursor _cursor;
+        // pending record, read ahead so the next due time is known
+        bool _have = false;
+        CanLogRecord _rec{};
+        const uint8_t* _payload = nullptr;
+
+        double _speed = 1.0;
+        bool _paused = false;
+        bool _finished = false;
+        uint64_t _anchor_host = 0;  // host time playback (re)started
+        uint64_t _anchor_log = 0;   // log time at that moment
+        int64_t _shift = 0;         // added to log stamps on the way out
+        uint64_t _last_out = 0;
+        uint64_t _position = 0;
+        uint64_t _frames = 0;
+        uint64_t _run_frames = 0;   // _frames at the anchor
+        uint64_t _rate_start_ns = 0;
+        uint64_t _rate_start_frames = 0;
+        double _rate_hz = 0.0;
+
+        // copy for other threads, refreshed every tick
+        mutable std::mutex _status_mtx;
+        ReplayStatus _status;
+};
@@ -1,4 +1,6 @@
 #include "ringbuffer.hpp"
+#include <algorithm>
+#include <climits>
 #include <cstddef>
 #include <cstring>
 #include <mutex>
@@ -6,52 +8,200 @@
 #include <termios.h>
 #include <unistd.h>
 #endif
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
 
-RingBuffer::RingBuffer() : head(0), tail(0), count(0) {}
+static constexpr uint32_t RING_MASK = BUFFERSIZE - 1;
+static constexpr int SPIN_LIMIT = 4096;
 
-void RingBuffer::write(const uint8_t *data, size_t len){
-    size_t written = 0;
-    std::unique_lock<std::mutex> lock(mtx);
-    while (written < len){
-        not_full.wait(lock, [&]{ return count < BUFFERSIZE; });
-        size_t space = BUFFERSIZE - count;
-        size_t to_write = std::min(len - written, space);
+static inline void cpu_relax(){
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
 
-        size_t end_space = BUFFERSIZE - tail;
-        size_t n1 = std::min(end_space, to_write);
-        std::memcpy(buf + tail, data + written, n1);
-        tail = (tail + n1) % BUFFERSIZE;
+#if defined(__linux__)
+static void futex_wait(const std::atomic<uint32_t>& word, uint32_t seen){
+    syscall(SYS_futex, reinterpret_cast<const uint32_t*>(&word), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+}
 
-        if (n1 < to_write) {
-            size_t n2 = to_write - n1;
-            std::memcpy(buf + tail, data + written + n1, n2);
-            tail = (tail + n2) % BUFFERSIZE;
-        }
+static void futex_wake(std::atomic<uint32_t>& word){
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+#endif
 
-        count+= to_write;
-        written += to_write;
-        not_empty.notify_one();
+RingBuffer::RingBuffer(WaitStrategy strategy)
+    : _strategy(strategy),
+      _tail(0), _head_cache(0),
+      _head(0), _tail_cache(0),
+      _producer_waiting(0), _consumer_waiting(0) {
+    _mirrored = map_mirrored();
+    if(!_mirrored)
+        buf = new uint8_t[BUFFERSIZE];
+}
+
+RingBuffer::~RingBuffer(){
+#if defined(__linux__)
+    if(_mirrored){
+        munmap(buf, 2 * BUFFERSIZE);
+        return;
     }
+#endif
+    delete[] buf;
 }
 
-size_t RingBuffer::read(uint8_t *out, size_t maxlen){
+// map one memfd twice, back to back, so buf[i] and buf[i + BUFFERSIZE] alias
+bool RingBuffer::map_mirrored(){
+#if defined(__linux__)
+    int fd = memfd_create("photon-ring", MFD_CLOEXEC);
+    if(fd < 0)
+        return false;
+    if(ftruncate(fd, BUFFERSIZE) != 0){
+        ::close(fd);
+        return false;
+    }
+    void* base = mmap(nullptr, 2 * BUFFERSIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED){
+        ::close(fd);
+        return false;
+    }
+    uint8_t* lo = static_cast<uint8_t*>(base);
+    void* a = mmap(lo, BUFFERSIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    void* b = mmap(lo + BUFFERSIZE, BUFFERSIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    ::close(fd);
+    if(a != lo || b != lo + BUFFERSIZE){
+        munmap(base, 2 * BUFFERSIZE);
+        return false;
+    }
+    buf = lo;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// block until word moves away from seen
+void RingBuffer::wait_for(const std::atomic<uint32_t>& word, uint32_t seen, std::atomic<uint32_t>& waiting){
+    if(_strategy != WaitStrategy::Blocking){
+        for(int i = 0; _strategy == WaitStrategy::Spin || i < SPIN_LIMIT; ++i){
+            if(word.load(std::memory_order_acquire) != seen)
+                return;
+            cpu_relax();
+        }
+    }
+
+#if defined(__linux__)
+    if(_strategy == WaitStrategy::SpinFutex){
+        while(word.load(std::memory_order_acquire) == seen){
+            waiting.store(1, std::memory_order_seq_cst);
+            if(word.load(std::memory_order_seq_cst) == seen)
+                futex_wait(word, seen);
+            waiting.store(0, std::memory_order_relaxed);
+        }
+        return;
+    }
+#endif
+
     std::unique_lock<std::mutex> lock(mtx);
-    not_empty.wait(lock, [&]{return count > 0;});
-    
-    size_t to_read = std::min(count, maxlen);
-    size_t end_space = BUFFERSIZE - head;
-    size_t n1 = std::min(end_space, to_read);
+    waiting.store(1, std::memory_order_seq_cst);
+    cv.wait(lock, [&]{ return word.load(std::memory_order_seq_cst) != seen; });
+    waiting.store(0, std::memory_order_relaxed);
+}
+
+// called after publishing a new index, only pays for a syscall if the other side sleeps
+void RingBuffer::wake(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting){
+    if(_strategy == WaitStrategy::Spin)
+        return;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!waiting.load(std::memory_order_relaxed))
+        return;
+#if defined(__linux__)
+    if(_strategy == WaitStrategy::SpinFutex){
+        futex_wake(word);
+        return;
+    }
+#else
+    (void)word;
+#endif
+    { std::lock_guard<std::mutex> lock(mtx); }
+    cv.notify_all();
+}
+
+uint8_t* RingBuffer::reserve(size_t& len){
+    const uint32_t tail = _tail.load(std::memory_order_relaxed);
+    size_t space = BUFFERSIZE - (tail - _head_cache);
+    if(space < READ_CHUNK){
+        _head_cache = _head.load(std::memory_order_acquire);
+        space = BUFFERSIZE - (tail - _head_cache);
+        while(space == 0){
+            wait_for(_head, _head_cache, _producer_waiting);
+            _head_cache = _head.load(std::memory_order_acquire);
+            space = BUFFERSIZE - (tail - _head_cache);
+        }
+    }
+    const size_t off = tail & RING_MASK;
+    len = _mirrored ? space : std::min(space, BUFFERSIZE - off);
+    return buf + off;
+}
+
+void RingBuffer::commit(size_t len){
+    _tail.store(_tail.load(std::memory_order_relaxed) + static_cast<uint32_t>(len), std::memory_order_release);
+    wake(_tail, _consumer_waiting);
+}
 
-    std::memcpy(out, buf + head, n1);
-    head = (head + n1) % BUFFERSIZE;
+const uint8_t* RingBuffer::peek(size_t& len){
+    const uint32_t head = _head.load(std::memory_order_relaxed);
+    size_t avail = _tail_cache - head;
+    if(avail == 0){
+        _tail_cache = _tail.load(std::memory_order_acquire);
+        avail = _tail_cache - head;
+        while(avail == 0){
+            wait_for(_tail, _tail_cache, _consumer_waiting);
+            _tail_cache = _tail.load(std::memory_order_acquire);
+            avail = _tail_cache - head;
+        }
+    }
+    const size_t off = head & RING_MASK;
+    len = _mirrored ? avail : std::min(avail, BUFFERSIZE - off);
+    return buf + off;
+}
 
-    if (n1 < to_read){
-        size_t n2 = to_read - n1;
-        std::memcpy(out + n1, buf + head, n2);
-        head = (head + n2) % BUFFERSIZE;
+void RingBuffer::consume(size_t len){
+    _head.store(_head.load(std::memory_order_relaxed) + static_cast<uint32_t>(len), std::memory_order_release);
+    wake(_head, _producer_waiting);
+}
+
+void RingBuffer::write(const uint8_t *data, size_t len){
+    size_t written = 0;
+    while (written < len){
+        size_t space = 0;
+        uint8_t* dst = reserve(space);
+        size_t to_write = std::min(len - written, space);
+        std::memcpy(dst, data + written, to_write);
+        commit(to_write);
+        written += to_write;
     }
+}
 
-    count -= to_read;
-    not_full.notify_one();
+size_t RingBuffer::read(uint8_t *out, size_t maxlen){
+    size_t avail = 0;
+    const uint8_t* src = peek(avail);
+    size_t to_read = std::min(avail, maxlen);
+    std::memcpy(out, src, to_read);
+    consume(to_read);
     return to_read;
 }
+
+size_t RingBuffer::size() const{
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+}
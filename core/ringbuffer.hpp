@@ -7,19 +7,82 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include <vector>
 #include <iostream>
 
 constexpr size_t BUFFERSIZE = 64 * 1024;
 constexpr size_t READ_CHUNK = 4096;
+constexpr size_t CACHE_LINE = 64;
+
+static_assert((BUFFERSIZE & (BUFFERSIZE - 1)) == 0, "BUFFERSIZE must be a power of two");
+
+// how a side of the ring waits when it has nothing to do
+enum class WaitStrategy : uint8_t {
+    Spin,       // busy poll, lowest latency, burns a core while idle
+    SpinFutex,  // spin for a while, then sleep on the index word (futex on linux)
+    Blocking    // sleep straight away on a condition variable
+};
+
+// Single producer / single consumer byte ring.
+// head is only written by the consumer and tail only by the producer, each on
+// its own cache line, so the hot path is a couple of atomic loads/stores and a
+// memcpy. The mutex/condvar (or futex) is only touched when a side actually has
+// to sleep.
+//
+// On linux the storage is mapped twice back to back (memfd + two mmaps), so
+// every free or filled region is contiguous and readers/parsers never see a
+// split at the wrap. Elsewhere reserve()/peek() just stop at the end of the
+// buffer.
 class RingBuffer {
     public:
-        RingBuffer();
+        explicit RingBuffer(WaitStrategy strategy = WaitStrategy::SpinFutex);
+        ~RingBuffer();
+
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+
+        // -- producer --
         void write(const uint8_t* data, size_t len);
+        // contiguous writable region, blocks until at least one byte is free
+        uint8_t* reserve(size_t& len);
+        void commit(size_t len);
+
+        // -- consumer --
         size_t read(uint8_t* out, size_t maxlen);
+        // contiguous readable region, blocks until at least one byte is available
+        const uint8_t* peek(size_t& len);
+        void consume(size_t len);
+
+        size_t size() const;
+        WaitStrategy strategy() const { return _strategy; }
+        bool mirrored() const { return _mirrored; }
+
     private:
-        uint8_t buf[BUFFERSIZE];
-        size_t head, tail, count;
+        void wait_for(const std::atomic<uint32_t>& word, uint32_t seen, std::atomic<uint32_t>& waiting);
+        void wake(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting);
+
+        bool map_mirrored();
+
+        uint8_t* buf = nullptr;
+        bool _mirrored = false;
+        WaitStrategy _strategy;
+
+        // producer line
+        std::atomic<uint32_t> _tail;
+        uint32_t _head_cache;
+        char _pad0[CACHE_LINE - sizeof(std::atomic<uint32_t>) - sizeof(uint32_t)];
+
+        // consumer line
+        std::atomic<uint32_t> _head;
+        uint32_t _tail_cache;
+        char _pad1[CACHE_LINE - sizeof(std::atomic<uint32_t>) - sizeof(uint32_t)];
+
+        // sleeper flags, only looked at by the opposite side after a publish
+        std::atomic<uint32_t> _producer_waiting;
+        std::atomic<uint32_t> _consumer_waiting;
+        char _pad2[CACHE_LINE - 2 * sizeof(std::atomic<uint32_t>)];
+
         std::mutex mtx;
-        std::condition_variable not_empty, not_full;
+        std::condition_variable cv;
 };
@@ -91,12 +91,12 @@ SerialPort::~SerialPort() {
     }
 }
 
-std::size_t SerialPort::read(uint8_t* buf, std::size_t maxlen) {
+ssize_t SerialPort::read(uint8_t* buf, std::size_t maxlen) {
   DWORD got = 0;
   if (!ReadFile(_handle, buf, static_cast<DWORD>(maxlen), &got, nullptr)) {
     throw std::system_error(GetLastError(), std::system_category(), "ReadFile failed");
   }
-  return static_cast<std::size_t>(got);
+  return static_cast<ssize_t>(got);
 }
 
 void SerialPort::write(const uint8_t* buf, std::size_t len) {
@@ -152,13 +152,21 @@ SerialPort::~SerialPort(){
     if (_fd >= 0) ::close(_fd);
 }
 
-std::size_t SerialPort::read(uint8_t* buf, std::size_t maxlen) {
-  ssize_t n = ::read(_fd, buf, maxlen);
-  return static_cast<std::size_t>(n);
+ssize_t SerialPort::read(uint8_t* buf, std::size_t maxlen) {
+  return ::read(_fd, buf, maxlen);
 }
 
 void SerialPort::write(const uint8_t* buf, std::size_t len) {
   [[maybe_unused]] ssize_t n = ::write(_fd, buf, len);
 }
 
+void SerialPort::set_nonblocking(bool enable) {
+  int flags = fcntl(_fd, F_GETFL, 0);
+  if (flags < 0)
+    throw std::system_error(errno, std::system_category(), "fcntl failed");
+  flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  if (fcntl(_fd, F_SETFL, flags) != 0)
+    throw std::system_error(errno, std::system_category(), "fcntl failed");
+}
+
 #endif
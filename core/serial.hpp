@@ -12,6 +12,8 @@
 
 #ifdef _WIN32
     #include <windows.h>
+    #include <BaseTsd.h>
+    typedef SSIZE_T ssize_t;
 #else
     #include <termios.h>
     #include <fcntl.h>
@@ -25,8 +27,15 @@ class SerialPort {
 
         SerialPort(const SerialPort&) = delete;
         SerialPort& operator=(const SerialPort&) = delete;
-        std::size_t read(uint8_t* buf, std::size_t maxlen);
+        // bytes read; 0 at end of stream (a hung up tty), -1 with errno set
+        // on error, EAGAIN / EINTR when there is just nothing to read.
+        // On windows 0 only means nothing arrived and errors throw.
+        ssize_t read(uint8_t* buf, std::size_t maxlen);
         void write(const uint8_t* buf, std::size_t len);
+#ifndef _WIN32
+        int native_handle() const { return _fd; }
+        void set_nonblocking(bool enable);
+#endif
 
 private:
 #ifdef _WIN32
@@ -0,0 +1,268 @@
+#include "signal_history.hpp"
+#include <algorithm>
+#include <new>
+
+SignalView SignalView::tail(int n) const{
+    if(n >= count || n < 0)
+        return *this;
+    SignalView out;
+    out.t = t + (count - n);
+    out.v = v + (count - n);
+    out.count = n;
+    return out;
+}
+
+std::string signal_key(const std::string& dbc, uint32_t id, const std::string& name){
+    return dbc + ":" + std::to_string(id) + ":" + name;
+}
+
+// (re)allocate with a ring of the given size, keeping the newest samples
+void SignalHistory::Signal::allocate(std::size_t ring){
+    Column nt(static_cast<double*>(std::calloc(2 * ring, sizeof(double))));
+    Column nv(static_cast<double*>(std::calloc(2 * ring, sizeof(double))));
+    if(!nt || !nv)
+        throw std::bad_alloc();
+    const std::size_t keep = std::min(size, ring);
+    if(keep){
+        const double* ot = t.get() + head + capacity - keep;
+        const double* ov = v.get() + head + capacity - keep;
+        std::copy(ot, ot + keep, nt.get());
+        std::copy(ov, ov + keep, nv.get());
+        std::copy(ot, ot + keep, nt.get() + ring);
+        std::copy(ov, ov + keep, nv.get() + ring);
+    }
+    t = std::move(nt);
+    v = std::move(nv);
+    capacity = ring;
+    size = keep;
+    head = keep & (ring - 1);
+}
+
+SignalHistory::Bucket& SignalHistory::Signal::open(std::size_t level, uint64_t index, bool fresh){
+    Level &l = levels[level];
+    if(!l.buckets){
+        l.buckets.reset(static_cast<Bucket*>(std::calloc(LOD_BUCKETS, sizeof(Bucket))));
+        if(!l.buckets)
+            throw std::bad_alloc();
+    }
+    if(fresh)
+        l.count = index + 1;
+    return l.at(index);
+}
+
+void SignalHistory::Bucket::merge(const Bucket& b){
+    t1 = b.t1;
+    last = b.last;
+    lo = std::min(lo, b.lo);
+    hi = std::max(hi, b.hi);
+}
+
+// sample n goes into level 0 bucket n / 4; a bucket that completes is
+// folded into the level above, and so on while those complete too
+void SignalHistory::Signal::add_lod(double t, double v){
+    const uint64_t n = total++;
+    const float f = static_cast<float>(v);
+    uint64_t b = n >> 2;
+    if((n & 3) == 0)
+        open(0, b, true) = Bucket{t, t, f, f, f, f};
+    else
+        open(0, b, false).merge(Bucket{t, t, f, f, f, f});
+    if((n & 3) != 3)
+        return;
+    for(std::size_t k = 1; k < LOD_LEVELS; ++k){
+        const Bucket done = levels[k - 1].at(b);
+        const uint64_t up = b >> 2;
+        if((b & 3) == 0)
+            open(k, up, true) = done;
+        else
+            open(k, up, false).merge(done);
+        if((b & 3) != 3)
+            return;
+        b = up;
+    }
+}
+
+SignalHandle SignalHistory::handle(const std::string& key){
+    auto it = _keys.find(key);
+    if(it != _keys.end())
+        return it->second;
+    SignalHandle h = static_cast<SignalHandle>(_signals.size());
+    _signals.emplace_back();
+    _keys.emplace(key, h);
+    return h;
+}
+
+SignalHandle SignalHistory::find(const std::string& key) const{
+    auto it = _keys.find(key);
+    return it == _keys.end() ? INVALID_SIGNAL : it->second;
+}
+
+void SignalHistory::set_capacity(SignalHandle h, std::size_t samples){
+    if(h < 0 || static_cast<std::size_t>(h) >= _signals.size())
+        return;
+    std::size_t cap = 1;
+    while(cap < samples && cap < MAX_CAPACITY)
+        cap <<= 1;
+    Signal &s = _signals[h];
+    if(cap == s.capacity)
+        return;
+    if(s.t)
+        s.allocate(cap);
+    else
+        s.capacity = cap;
+}
+
+void SignalHistory::append(SignalHandle h, double t, double v){
+    if(h < 0 || static_cast<std::size_t>(h) >= _signals.size())
+        return;
+    Signal &s = _signals[h];
+    if(!s.t)
+        s.allocate(s.capacity);
+    s.t[s.head] = s.t[s.head + s.capacity] = t;
+    s.v[s.head] = s.v[s.head + s.capacity] = v;
+    s.head = (s.head + 1) & (s.capacity - 1);
+    if(s.size < s.capacity)
+        ++s.size;
+    s.add_lod(t, v);
+}
+
+SignalView SignalHistory::view(SignalHandle h) const{
+    SignalView out;
+    if(h < 0 || static_cast<std::size_t>(h) >= _signals.size())
+        return out;
+    const Signal &s = _signals[h];
+    if(!s.size)
+        return out;
+    const std::size_t start = s.head + s.capacity - s.size;
+    out.t = s.t.get() + start;
+    out.v = s.v.get() + start;
+    out.count = static_cast<int>(s.size);
+    return out;
+}
+
+void SignalHistory::clear(SignalHandle h){
+    if(h < 0 || static_cast<std::size_t>(h) >= _signals.size())
+        return;
+    Signal &s = _signals[h];
+    s.t.reset();
+    s.v.reset();
+    s.head = s.size = 0;
+    s.total = 0;
+    for(auto &l : s.levels){
+        l.buckets.reset();
+        l.count = 0;
+    }
+}
+
+bool SignalHistory::span(SignalHandle h, double& t_first, double& t_last) const{
+    SignalView raw = view(h);
+    if(raw.empty())
+        return false;
+    const Signal &s = _signals[h];
+    t_first = raw.t[0];
+    t_last = raw.t[raw.count - 1];
+    for(const auto &l : s.levels)
+        if(l.count)
+            t_first = std::min(t_first, l.at(l.oldest()).t0);
+    return true;
+}
+
+// first/min/max/last of a bucket, min and max at its middle
+static void emit(LodBuffer& out, double t0, double t1, double first, double last, double lo, double hi){
+    const double mid = 0.5 * (t0 + t1);
+    out.t.push_back(t0);
+    out.v.push_back(first);
+    if(t1 > t0){
+        out.t.push_back(mid);
+        out.v.push_back(lo);
+        out.t.push_back(mid);
+        out.v.push_back(hi);
+        out.t.push_back(t1);
+        out.v.push_back(last);
+    }
+}
+
+SignalView SignalHistory::range(SignalHandle h, double t_min, double t_max, int pixels, LodBuffer& scratch) const{
+    SignalView raw = view(h);
+    if(raw.empty())
+        return raw;
+    const Signal &s = _signals[h];
+    const std::size_t budget = static_cast<std::size_t>(std::max(pixels, 1));
+
+    // raw samples if the ring reaches back far enough and they are few
+    if(raw.t[0] <= t_min || s.total == static_cast<uint64_t>(raw.count)){
+        const double* end = raw.t + raw.count;
+        std::size_t i0 = std::lower_bound(raw.t, end, t_min) - raw.t;
+        std::size_t i1 = std::upper_bound(raw.t, end, t_max) - raw.t;
+        if(i0 > 0) --i0;
+        if(i1 < static_cast<std::size_t>(raw.count)) ++i1;
+        if(i1 - i0 <= 4 * budget){
+            SignalView out;
+            out.t = raw.t + i0;
+            out.v = raw.v + i0;
+            out.count = static_cast<int>(i1 - i0);
+            return out;
+        }
+    }
+
+    // finest level that reaches back to t_min with at most budget buckets,
+    // or failing that the coarsest there is
+    std::size_t top = 0;
+    while(top < LOD_LEVELS && s.levels[top].count)
+        ++top;
+    if(!top)
+        return raw;
+    std::size_t k = 0;
+    uint64_t j0 = 0, j1 = 0;
+    for(; k < top; ++k){
+        const Level &l = s.levels[k];
+        const uint64_t first = l.oldest();
+        if(first && l.at(first).t0 > t_min && k + 1 < top)
+            continue;
+        // buckets are in time order, search by logical index
+        uint64_t lo = first, hi = l.count;
+        while(lo < hi){
+            uint64_t mid = lo + (hi - lo) / 2;
+            if(l.at(mid).t1 < t_min) lo = mid + 1; else hi = mid;
+        }
+        j0 = lo;
+        hi = l.count;
+        while(lo < hi){
+            uint64_t mid = lo + (hi - lo) / 2;
+            if(l.at(mid).t0 <= t_max) lo = mid + 1; else hi = mid;
+        }
+        j1 = lo;
+        if(j1 - j0 <= budget || k + 1 == top)
+            break;
+    }
+
+    const Level &l = s.levels[k];
+    if(j0 > l.oldest()) --j0;
+    if(j1 < l.count) ++j1;
+    scratch.t.clear();
+    scratch.v.clear();
+    for(uint64_t j = j0; j < j1; ++j){
+        const Bucket &b = l.at(j);
+        emit(scratch, b.t0, b.t1, b.first, b.last, b.lo, b.hi);
+    }
+    // the newest bucket of a coarse level lags the raw ring by whatever
+    // has not completed below it yet. That is the newest, still partial,
+    // bucket of each finer level, which close the gap oldest first without
+    // touching the ring.
+    if(j1 == l.count){
+        for(std::size_t m = k; m-- > 0;){
+            const Level &fine = s.levels[m];
+            // a complete bucket of 4^(m+1) samples is already folded above
+            if(s.total >= fine.count << (2 * (m + 1)))
+                continue;
+            const Bucket &b = fine.at(fine.count - 1);
+            emit(scratch, b.t0, b.t1, b.first, b.last, b.lo, b.hi);
+        }
+    }
+
+    SignalView out;
+    out.t = scratch.t.data();
+    out.v = scratch.v.data();
+    out.count = static_cast<int>(scratch.t.size());
+    return out;
+}
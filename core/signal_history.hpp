@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Decoded signal samples for plotting, one pair of columns (time, value) per
+// signal. Signals are registered once by key and then addressed by an
+// integer handle, so the per-sample path never builds or hashes a string.
+//
+// Each column is a mirrored ring: every sample is written at i and at
+// i + capacity, so the newest size() samples always sit contiguously at
+// data() and any suffix of them can be handed to ImPlot as a plain array.
+// Appends are O(1) (two stores per column) and never move data: a column is
+// allocated once at its full capacity with calloc, which leaves the pages
+// for the OS to commit as they are first written, so idle or young signals
+// cost little and no frame ever pays for a copy.
+//
+// Next to the raw ring each signal keeps a min/max pyramid for plotting long
+// spans: level k holds buckets of 4^(k+1) samples with their time span and
+// first/last/min/max value, LOD_BUCKETS per level. A bucket is folded into
+// the level above when it completes, so appends stay O(1) amortised, and
+// the coarse levels reach far further back than the raw ring. range() picks
+// the finest data that fits the visible time span in about one bucket per
+// pixel, so drawing costs the same for a minute or for a whole day.
+//
+// Only touched from the GUI thread.
+
+using SignalHandle = int32_t;
+constexpr SignalHandle INVALID_SIGNAL = -1;
+
+// contiguous view of a signal's newest samples, oldest first
+struct SignalView {
+    const double* t = nullptr;
+    const double* v = nullptr;
+    int count = 0;
+
+    bool empty() const { return count == 0; }
+    // the newest n samples
+    SignalView tail(int n) const;
+};
+
+// where range() puts decimated points, reused across calls
+struct LodBuffer {
+    std::vector<double> t;
+    std::vector<double> v;
+};
+
+class SignalHistory {
+    public:
+        static constexpr std::size_t DEFAULT_CAPACITY = 1u << 16;
+        static constexpr std::size_t MAX_CAPACITY = 1u << 20;
+        static constexpr std::size_t LOD_LEVELS = 8;
+        static constexpr std::size_t LOD_BUCKETS = 4096;
+
+        // existing handle for the key, or a new empty signal
+        SignalHandle handle(const std::string& key);
+        SignalHandle find(const std::string& key) const;
+        std::size_t signals() const { return _signals.size(); }
+
+        // rounded up to a power of two and clamped, keeps the newest samples
+        void set_capacity(SignalHandle h, std::size_t samples);
+
+        void append(SignalHandle h, double t, double v);
+        SignalView view(SignalHandle h) const;
+        SignalView view(const std::string& key) const { return view(find(key)); }
+        void clear(SignalHandle h);
+
+        // points covering [t_min, t_max] for a plot about pixels wide: raw
+        // samples when there are few enough (a view into the ring), else
+        // first/min/max/last of each bucket of the finest level that fits,
+        // written to scratch. One point past each end keeps lines running
+        // off the edges.
+        SignalView range(SignalHandle h, double t_min, double t_max, int pixels, LodBuffer& scratch) const;
+        // oldest time any level still holds and the newest sample
+        bool span(SignalHandle h, double& t_first, double& t_last) const;
+
+    private:
+        struct FreeDeleter {
+            void operator()(void* p) const { std::free(p); }
+        };
+        using Column = std::unique_ptr<double[], FreeDeleter>;
+
+        // values as float, plenty for drawing and half the footprint
+        struct Bucket {
+            double t0, t1;
+            float first, last, lo, hi;
+
+            void merge(const Bucket& b);
+        };
+
+        // ring of LOD_BUCKETS, bucket i lives at i % LOD_BUCKETS
+        struct Level {
+            std::unique_ptr<Bucket[], FreeDeleter> buckets;
+            uint64_t count = 0; // buckets started, the newest may be partial
+
+            uint64_t oldest() const { return count > LOD_BUCKETS ? count - LOD_BUCKETS : 0; }
+            Bucket& at(uint64_t i) const { return buckets[i & (LOD_BUCKETS - 1)]; }
+        };
+
+        struct Signal {
+            std::size_t capacity = DEFAULT_CAPACITY; // a power of two
+            std::size_t head = 0;                    // next write, < capacity
+            std::size_t size = 0;
+            Column t;                                // 2 * capacity each, once allocated
+            Column v;
+
+            uint64_t total = 0;                      // samples ever appended
+            Level levels[LOD_LEVELS];
+
+            void allocate(std::size_t ring);
+            void add_lod(double t, double v);
+            Bucket& open(std::size_t level, uint64_t index, bool fresh);
+        };
+
+        std::vector<Signal> _signals;
+        std::unordered_map<std::string, SignalHandle> _keys;
+};
+
+// key used for a DBC signal, "dbc:id:name"
+std::string signal_key(const std::string& dbc, uint32_t id, const std::string& name);
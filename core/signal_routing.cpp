@@ -4,26 +4,72 @@
 #include <string>
 #include <cmath>
 #include <algorithm>
+#include <limits>
 
 DbcPlotRegistry g_plot_registry;
 PlotDrawerRegistry g_plot_drawers;
 
+struct TimeAxis {
+    bool follow = true;
+    bool fit_all = false;
+    double width = DEFAULT_PLOT_WINDOW_S;
+};
+static std::unordered_map<std::string, TimeAxis> time_axes;
+
+void plot_time_series(const std::string& name, const char* y_label,
+                      const std::vector<PlotSignal>& signals, const SignalHistory& history,
+                      bool digital){
+    double first = std::numeric_limits<double>::max();
+    double last = std::numeric_limits<double>::lowest();
+    for(const auto &sig : signals){
+        double f, l;
+        if(history.span(sig.first, f, l)){
+            first = std::min(first, f);
+            last = std::max(last, l);
+        }
+    }
+    const bool have = first <= last;
+
+    if(ImPlot::BeginPlot(name.c_str())){
+        TimeAxis &ax = time_axes[name];
+        ImPlot::SetupAxes("Time", y_label, ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_RangeFit);
+        if(have && ax.follow){
+            if(ax.fit_all){
+                ax.width = std::max(last - first, 1e-3);
+                ax.fit_all = false;
+            }
+            ImPlot::SetupAxisLimits(ImAxis_X1, last - ax.width, last, ImPlotCond_Always);
+        }
+        ImPlotRect lim = ImPlot::GetPlotLimits();
+        ax.width = lim.X.Size();
+        if(ImPlot::IsPlotHovered()){
+            if(ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+                ax.follow = ax.fit_all = true;
+            else if(ImGui::IsMouseDragging(ImGuiMouseButton_Left))
+                ax.follow = false;
+        }
+
+        // plotted right away, so one scratch buffer serves every signal
+        static LodBuffer scratch;
+        const int pixels = static_cast<int>(ImPlot::GetPlotSize().x);
+        for(const auto &sig : signals){
+            SignalView v = history.range(sig.first, lim.X.Min, lim.X.Max, pixels, scratch);
+            if(v.empty())
+                continue;
+            if(digital)
+                ImPlot::PlotDigital(sig.second.c_str(), v.t, v.v, v.count);
+            else
+                ImPlot::PlotLine(sig.second.c_str(), v.t, v.v, v.count);
+        }
+        ImPlot::EndPlot();
+    }
+}
+
 PlotDrawerRegistry::PlotDrawerRegistry() {
     default_drawer = [](const std::string& name,
                         const std::vector<PlotSignal>& signals,
-                        const SignalDataMap& times,
-                        const SignalDataMap& values){
-        if(ImPlot::BeginPlot(name.c_str())){
-            ImPlot::SetupAxes("Time", "Value", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
-            for(const auto &sig : signals){
-                auto itx = times.find(sig.first);
-                auto ity = values.find(sig.first);
-                if(itx == times.end() || ity == values.end())
-                    continue;
-                ImPlot::PlotLine(sig.second.c_str(), itx->second.data(), ity->second.data(), ity->second.size());
-            }
-            ImPlot::EndPlot();
-        }
+                        const SignalHistory& history){
+        plot_time_series(name, "Value", signals, history);
     };
 }
 
@@ -41,53 +87,30 @@ PlotDrawFn PlotDrawerRegistry::get_drawer(const std::string& name) const {
 static PlotDrawFn make_line_drawer(const char* y_label) {
     return [y_label](const std::string& name,
                      const std::vector<PlotSignal>& signals,
-                     const SignalDataMap& times,
-                     const SignalDataMap& values){
-        if(ImPlot::BeginPlot(name.c_str())){
-            ImPlot::SetupAxes("Time", y_label, ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
-            for(const auto &sig : signals){
-                auto itx = times.find(sig.first);
-                auto ity = values.find(sig.first);
-                if(itx == times.end() || ity == values.end())
-                    continue;
-                ImPlot::PlotLine(sig.second.c_str(), itx->second.data(), ity->second.data(), ity->second.size());
-            }
-            ImPlot::EndPlot();
-        }
+                     const SignalHistory& history){
+        plot_time_series(name, y_label, signals, history);
     };
 }
 
 static PlotDrawFn make_digital_drawer(const char* y_label) {
     return [y_label](const std::string& name,
                      const std::vector<PlotSignal>& signals,
-                     const SignalDataMap& times,
-                     const SignalDataMap& values){
-        if(ImPlot::BeginPlot(name.c_str())){
-            ImPlot::SetupAxes("Time", y_label, ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
-            for(const auto &sig : signals){
-                auto itx = times.find(sig.first);
-                auto ity = values.find(sig.first);
-                if(itx == times.end() || ity == values.end())
-                    continue;
-                ImPlot::PlotDigital(sig.second.c_str(), itx->second.data(), ity->second.data(), ity->second.size());
-            }
-            ImPlot::EndPlot();
-        }
+                     const SignalHistory& history){
+        plot_time_series(name, y_label, signals, history, true);
     };
 }
 
 static PlotDrawFn make_histogram_drawer(const char* x_label) {
     return [x_label](const std::string& name,
                      const std::vector<PlotSignal>& signals,
-                     const SignalDataMap& times,
-                     const SignalDataMap& values){
+                     const SignalHistory& history){
         if(ImPlot::BeginPlot(name.c_str())){
             ImPlot::SetupAxes(x_label, "Count", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
             for(const auto &sig : signals){
-                auto ity = values.find(sig.first);
-                if(ity == values.end())
+                SignalView v = history.view(sig.first);
+                if(v.empty())
                     continue;
-                ImPlot::PlotHistogram(sig.second.c_str(), ity->second.data(), ity->second.size(), 50);
+                ImPlot::PlotHistogram(sig.second.c_str(), v.v, v.count, 50);
             }
             ImPlot::EndPlot();
         }
@@ -97,20 +120,19 @@ static PlotDrawFn make_histogram_drawer(const char* x_label) {
 static PlotDrawFn make_histogram2d_drawer(const char* label) {
     return [label](const std::string& name,
                    const std::vector<PlotSignal>& signals,
-                   const SignalDataMap& times,
-                   const SignalDataMap& values){
+                   const SignalHistory& history){
         if(signals.size() < 2)
             return;
-        auto itx = values.find(signals[0].first);
-        auto ity = values.find(signals[1].first);
-        if(itx == values.end() || ity == values.end())
-            return;
-        if(itx->second.empty() || ity->second.empty())
+        SignalView x = history.view(signals[0].first);
+        SignalView y = history.view(signals[1].first);
+        if(x.empty() || y.empty())
             return;
+        int count = std::min(x.count, y.count);
+        x = x.tail(count);
+        y = y.tail(count);
         if(ImPlot::BeginPlot(name.c_str())){
             ImPlot::SetupAxes(signals[0].second.c_str(), signals[1].second.c_str(), ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
-            ImPlot::PlotHistogram2D(label,
-                                   itx->second.data(), ity->second.data(), itx->second.size(), 50);
+            ImPlot::PlotHistogram2D(label, x.v, y.v, count, 50);
             ImPlot::EndPlot();
         }
     };
@@ -119,20 +141,18 @@ static PlotDrawFn make_histogram2d_drawer(const char* label) {
 static PlotDrawFn make_heatmap_drawer(const char* label) {
     return [label](const std::string& name,
                    const std::vector<PlotSignal>& signals,
-                   const SignalDataMap& times,
-                   const SignalDataMap& values){
+                   const SignalHistory& history){
         if(signals.empty())
             return;
-        auto it = values.find(signals[0].first);
-        if(it == values.end() || it->second.empty())
+        SignalView data = history.view(signals[0].first);
+        if(data.empty())
             return;
-        const auto &data = it->second;
-        int n = static_cast<int>(sqrt(data.size()));
-        if(n*n != (int)data.size())
+        int n = static_cast<int>(sqrt(data.count));
+        if(n*n != data.count)
             return;
         if(ImPlot::BeginPlot(name.c_str())){
             ImPlot::SetupAxes("X", "Y", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
-            ImPlot::PlotHeatmap(label, data.data(), n, n, 0, 0, nullptr);
+            ImPlot::PlotHeatmap(label, data.v, n, n, 0, 0, nullptr);
             ImPlot::EndPlot();
         }
     };
@@ -141,16 +161,15 @@ static PlotDrawFn make_heatmap_drawer(const char* label) {
 static PlotDrawFn make_bar_drawer(const char* y_label) {
     return [y_label](const std::string& name,
                      const std::vector<PlotSignal>& signals,
-                     const SignalDataMap& times,
-                     const SignalDataMap& values){
+                     const SignalHistory& history){
         if(ImPlot::BeginPlot(name.c_str())){
             ImPlot::SetupAxes("Index", y_label, ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
             int idx = 0;
             for(const auto &sig : signals){
-                auto it = values.find(sig.first);
-                if(it == values.end())
+                SignalView v = history.view(sig.first).tail(PLOT_POINTS);
+                if(v.empty())
                     continue;
-                ImPlot::PlotBars(sig.second.c_str(), it->second.data(), it->second.size(), 0.67, idx++);
+                ImPlot::PlotBars(sig.second.c_str(), v.v, v.count, 0.67, idx++);
             }
             ImPlot::EndPlot();
         }
@@ -161,23 +180,23 @@ static PlotDrawFn make_bar_drawer(const char* y_label) {
 static PlotDrawFn make_bar_groups_drawer(const char* y_label) {
     return [y_label](const std::string& name,
                      const std::vector<PlotSignal>& signals,
-                     const SignalDataMap& times,
-                     const SignalDataMap& values){
+                     const SignalHistory& history){
         if(signals.empty())
             return;
-        std::vector<const double*> data;
+        std::vector<SignalView> views;
         int count = -1;
         for(const auto &sig : signals){
-            auto it = values.find(sig.first);
-            if(it == values.end())
+            SignalView v = history.view(sig.first);
+            if(v.empty())
                 return;
-            if(count == -1)
-                count = it->second.size();
-            count = std::min(count, (int)it->second.size());
-            data.push_back(it->second.data());
+            count = count == -1 ? v.count : std::min(count, v.count);
+            views.push_back(v);
         }
         if(count <= 0)
             return;
+        std::vector<const double*> data;
+        for(const auto &v : views)
+            data.push_back(v.tail(count).v);
         if(ImPlot::BeginPlot(name.c_str())){
             ImPlot::SetupAxes("Index", y_label, ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
             ImPlot::PlotBarGroups(nullptr, data.data(), signals.size(), count, 0.67, 0);
@@ -191,23 +210,23 @@ static PlotDrawFn make_bar_groups_drawer(const char* y_label) {
 static PlotDrawFn make_bar_stack_drawer(const char* y_label) {
     return [y_label](const std::string& name,
                      const std::vector<PlotSignal>& signals,
-                     const SignalDataMap& times,
-                     const SignalDataMap& values){
+                     const SignalHistory& history){
         if(signals.empty())
             return;
-        std::vector<const double*> data;
+        std::vector<SignalView> views;
         int count = -1;
         for(const auto &sig : signals){
-            auto it = values.find(sig.first);
-            if(it == values.end())
+            SignalView v = history.view(sig.first);
+            if(v.empty())
                 return;
-            if(count == -1)
-                count = it->second.size();
-            count = std::min(count, (int)it->second.size());
-            data.push_back(it->second.data());
+            count = count == -1 ? v.count : std::min(count, v.count);
+            views.push_back(v);
         }
         if(count <= 0)
             return;
+        std::vector<const double*> data;
+        for(const auto &v : views)
+            data.push_back(v.tail(count).v);
         if(ImPlot::BeginPlot(name.c_str())){
             ImPlot::SetupAxes("Index", y_label, ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
             ImPlot::PlotBarStacked(nullptr, data.data(), signals.size(), count, 0.67);
@@ -220,25 +239,25 @@ static PlotDrawFn make_bar_stack_drawer(const char* y_label) {
 static PlotDrawFn make_surface_drawer(const char* z_label) {
     return [z_label](const std::string& name,
                      const std::vector<PlotSignal>& signals,
-                     const SignalDataMap& times,
-                     const SignalDataMap& values){
+                     const SignalHistory& history){
         if(signals.size() < 3)
             return;
-        auto itx = values.find(signals[0].first);
-        auto ity = values.find(signals[1].first);
-        auto itz = values.find(signals[2].first);
-        if(itx == values.end() || ity == values.end() || itz == values.end())
-            return;
-        int count = std::min({itx->second.size(), ity->second.size(), itz->second.size()});
+        SignalView x = history.view(signals[0].first);
+        SignalView y = history.view(signals[1].first);
+        SignalView z = history.view(signals[2].first);
+        int count = std::min({x.count, y.count, z.count});
         if(count <= 0)
             return;
+        x = x.tail(count);
+        y = y.tail(count);
+        z = z.tail(count);
         int N = static_cast<int>(sqrt(count));
         if(N*N != count)
             return;
         if(ImPlot3D::BeginPlot(name.c_str())){
             ImPlot3D::SetupAxes(signals[0].second.c_str(), signals[1].second.c_str(), z_label);
             ImPlot3D::SetupAxesLimits(-1,1,-1,1,-1,1);
-            ImPlot3D::PlotSurface(name.c_str(), itx->second.data(), ity->second.data(), itz->second.data(), N, N);
+            ImPlot3D::PlotSurface(name.c_str(), x.v, y.v, z.v, N, N);
             ImPlot3D::EndPlot();
         }
     };
@@ -247,22 +266,22 @@ static PlotDrawFn make_surface_drawer(const char* z_label) {
 static PlotDrawFn make_line3d_drawer(const char* z_label) {
     return [z_label](const std::string& name,
                      const std::vector<PlotSignal>& signals,
-                     const SignalDataMap& times,
-                     const SignalDataMap& values){
+                     const SignalHistory& history){
         if(signals.size() < 3)
             return;
-        auto itx = values.find(signals[0].first);
-        auto ity = values.find(signals[1].first);
-        auto itz = values.find(signals[2].first);
-        if(itx == values.end() || ity == values.end() || itz == values.end())
-            return;
-        int count = std::min({itx->second.size(), ity->second.size(), itz->second.size()});
+        SignalView x = history.view(signals[0].first);
+        SignalView y = history.view(signals[1].first);
+        SignalView z = history.view(signals[2].first);
+        int count = std::min({x.count, y.count, z.count});
         if(count <= 0)
             return;
+        x = x.tail(count);
+        y = y.tail(count);
+        z = z.tail(count);
         if(ImPlot3D::BeginPlot(name.c_str())){
             ImPlot3D::SetupAxes(signals[0].second.c_str(), signals[1].second.c_str(), z_label);
             ImPlot3D::SetupAxesLimits(-1,1,-1,1,-1,1);
-            ImPlot3D::PlotLine(name.c_str(), itx->second.data(), ity->second.data(), itz->second.data(), count);
+            ImPlot3D::PlotLine(name.c_str(), x.v, y.v, z.v, count);
             ImPlot3D::EndPlot();
         }
     };
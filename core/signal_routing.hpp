@@ -5,6 +5,7 @@
 #include <vector>
 #include <functional>
 #include <cstdint>
+#include "signal_history.hpp"
 
 struct SignalKeyHash {
     size_t operator()(const std::pair<uint32_t, std::string>& k) const noexcept {
@@ -36,9 +37,22 @@ struct DbcPlotRegistry {
 extern DbcPlotRegistry g_plot_registry;
 void init_default_plot_registry();
 
-using PlotSignal = std::pair<std::string, std::string>;
-using SignalDataMap = std::unordered_map<std::string, std::vector<double>>;
-using PlotDrawFn = std::function<void(const std::string&, const std::vector<PlotSignal>&, const SignalDataMap&, const SignalDataMap&)>;
+// handle into the signal history and the legend label
+using PlotSignal = std::pair<SignalHandle, std::string>;
+using PlotDrawFn = std::function<void(const std::string&, const std::vector<PlotSignal>&, const SignalHistory&)>;
+
+// newest samples the index-based drawers (bars) plot
+constexpr int PLOT_POINTS = 2000;
+// seconds a live time plot shows until it is zoomed
+constexpr double DEFAULT_PLOT_WINDOW_S = 60.0;
+
+// Time series plot of the signals from the history's LOD pyramid. The plot
+// follows the newest sample at its current zoom; dragging it lets go so old
+// data can be scrubbed, a double click fits the whole session and follows
+// again. Y fits the points drawn, i.e. the extrema of the visible buckets.
+void plot_time_series(const std::string& name, const char* y_label,
+                      const std::vector<PlotSignal>& signals, const SignalHistory& history,
+                      bool digital = false);
 
 struct PlotDrawerRegistry {
     std::unordered_map<std::string, PlotDrawFn> drawers;
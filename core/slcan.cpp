@@ -0,0 +1,369 @@
+#include "slcan.hpp"
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SLCAN_SSE2 1
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32)
+#define SLCAN_AVX2 1
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SLCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+static constexpr uint16_t STAMP_WRAP_MS = 60000;
+
+static inline uint8_t hex_value(uint8_t c){
+    static const std::array<int8_t, 256> table = []{
+        std::array<int8_t, 256> t{};
+        t.fill(-1);
+        for(uint8_t i = 0; i < 10; ++i)
+            t['0' + i] = i;
+        for(uint8_t i = 0; i < 6; ++i){
+            t['A' + i] = 10 + i;
+            t['a' + i] = 10 + i;
+        }
+        return t;
+    }();
+    return table[c];
+}
+
+// -- record boundary search --
+
+static const uint8_t* find_cr_scalar(const uint8_t* p, const uint8_t* end){
+    const void* hit = std::memchr(p, '\r', end - p);
+    return static_cast<const uint8_t*>(hit);
+}
+
+#if defined(SLCAN_AVX2)
+__attribute__((target("avx2")))
+static const uint8_t* find_cr_avx2(const uint8_t* p, const uint8_t* end){
+    const __m256i cr = _mm256_set1_epi8('\r');
+    for(; p + 32 <= end; p += 32){
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, cr)));
+        if(mask)
+            return p + __builtin_ctz(mask);
+    }
+    return find_cr_scalar(p, end);
+}
+#endif
+
+#if defined(SLCAN_SSE2)
+static const uint8_t* find_cr_sse2(const uint8_t* p, const uint8_t* end){
+    const __m128i cr = _mm_set1_epi8('\r');
+    for(; p + 16 <= end; p += 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, cr)));
+        if(mask){
+#if defined(_MSC_VER)
+            unsigned long idx;
+            _BitScanForward(&idx, mask);
+            return p + idx;
+#else
+            return p + __builtin_ctz(mask);
+#endif
+        }
+    }
+    return find_cr_scalar(p, end);
+}
+#endif
+
+#if defined(SLCAN_NEON)
+static const uint8_t* find_cr_neon(const uint8_t* p, const uint8_t* end){
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    for(; p + 16 <= end; p += 16){
+        uint8x16_t eq = vceqq_u8(vld1q_u8(p), cr);
+        // narrow each byte to a nibble so the hit position fits in 64 bits
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if(bits)
+            return p + (__builtin_ctzll(bits) >> 2);
+    }
+    return find_cr_scalar(p, end);
+}
+#endif
+
+using FindCrFn = const uint8_t* (*)(const uint8_t*, const uint8_t*);
+
+static FindCrFn pick_find_cr(){
+#if defined(SLCAN_AVX2)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return find_cr_avx2;
+#endif
+#if defined(SLCAN_SSE2)
+    return find_cr_sse2;
+#elif defined(SLCAN_NEON)
+    return find_cr_neon;
+#else
+    return find_cr_scalar;
+#endif
+}
+
+static const FindCrFn find_cr = pick_find_cr();
+
+// -- hex decoding --
+
+// decode 2*n hex chars from src into n bytes, false on any non hex char.
+// SIMD loads may read past src + 2*n but never past limit.
+static bool decode_hex_scalar(const uint8_t* src, size_t n, uint8_t* out){
+    for(size_t i = 0; i < n; ++i){
+        uint8_t hi = hex_value(src[2 * i]);
+        uint8_t lo = hex_value(src[2 * i + 1]);
+        if((hi | lo) > 15)
+            return false;
+        out[i] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    return true;
+}
+
+#if defined(SLCAN_SSE2)
+// 16 hex chars -> 8 bytes, returns the bitmask of lanes that were valid hex
+static inline unsigned hex16_sse2(const uint8_t* src, uint8_t* out){
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+
+    const __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                           _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    const __m128i is_alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                           _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+    const __m128i digit = _mm_and_si128(is_digit, _mm_sub_epi8(v, _mm_set1_epi8('0')));
+    const __m128i alpha = _mm_and_si128(is_alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+    const __m128i nib = _mm_or_si128(digit, alpha);
+
+    // each 16-bit lane holds (lo nibble << 8) | hi nibble
+    const __m128i hi = _mm_slli_epi16(_mm_and_si128(nib, _mm_set1_epi16(0x00FF)), 4);
+    const __m128i lo = _mm_srli_epi16(nib, 8);
+    const __m128i bytes = _mm_packus_epi16(_mm_or_si128(hi, lo), _mm_setzero_si128());
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)));
+}
+#endif
+
+#if defined(SLCAN_NEON)
+static inline unsigned hex16_neon(const uint8_t* src, uint8_t* out){
+    const uint8x16_t v = vld1q_u8(src);
+    const uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+
+    const uint8x16_t is_digit = vandq_u8(vcgeq_u8(v, vdupq_n_u8('0')), vcleq_u8(v, vdupq_n_u8('9')));
+    const uint8x16_t is_alpha = vandq_u8(vcgeq_u8(lower, vdupq_n_u8('a')), vcleq_u8(lower, vdupq_n_u8('f')));
+
+    const uint8x16_t digit = vandq_u8(is_digit, vsubq_u8(v, vdupq_n_u8('0')));
+    const uint8x16_t alpha = vandq_u8(is_alpha, vsubq_u8(lower, vdupq_n_u8('a' - 10)));
+    const uint8x16_t nib = vorrq_u8(digit, alpha);
+
+    // even lanes are high nibbles, odd lanes low nibbles
+    uint8x8x2_t split = vuzp_u8(vget_low_u8(nib), vget_high_u8(nib));
+    uint8x8_t bytes = vorr_u8(vshl_n_u8(split.val[0], 4), split.val[1]);
+    vst1_u8(out, bytes);
+
+    const uint8x16_t valid = vorrq_u8(is_digit, is_alpha);
+    const uint8_t bit_weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t bits = vandq_u8(valid, vld1q_u8(bit_weights));
+    unsigned lo_mask = vaddv_u8(vget_low_u8(bits));
+    unsigned hi_mask = vaddv_u8(vget_high_u8(bits));
+    return lo_mask | (hi_mask << 8);
+}
+#endif
+
+static bool decode_hex(const uint8_t* src, size_t n, uint8_t* out, const uint8_t* limit){
+#if defined(SLCAN_SSE2) || defined(SLCAN_NEON)
+    while(n > 0){
+        if(src + 16 > limit)
+            return decode_hex_scalar(src, n, out);
+        uint8_t tmp[8];
+#if defined(SLCAN_SSE2)
+        unsigned valid = hex16_sse2(src, tmp);
+#else
+        unsigned valid = hex16_neon(src, tmp);
+#endif
+        size_t take = n < 8 ? n : 8;
+        unsigned need = (take == 8) ? 0xFFFFu : ((1u << (2 * take)) - 1);
+        if((valid & need) != need)
+            return false;
+        std::memcpy(out, tmp, take);
+        src += 2 * take;
+        out += take;
+        n -= take;
+    }
+    return true;
+#else
+    (void)limit;
+    return decode_hex_scalar(src, n, out);
+#endif
+}
+
+// -- parser --
+
+SlcanParser::SlcanParser(FrameHandler handler) : _handler(std::move(handler)) {}
+
+void SlcanParser::reset(){
+    _carry_len = 0;
+    _discard = false;
+    _have_stamp = false;
+    _anchor.reset();
+    _last_stamp_ms = 0;
+    _sender_ns = 0;
+}
+
+uint64_t SlcanParser::unwrap_stamp(uint16_t ms){
+    if(!_have_stamp){
+        _have_stamp = true;
+        _sender_ns = static_cast<uint64_t>(ms) * 1000000ull;
+    } else {
+        uint16_t delta = (ms >= _last_stamp_ms) ? (ms - _last_stamp_ms)
+                                                : (ms + STAMP_WRAP_MS - _last_stamp_ms);
+        _sender_ns += static_cast<uint64_t>(delta) * 1000000ull;
+    }
+    _last_stamp_ms = ms;
+    return _sender_ns;
+}
+
+// rec[0..n) is one record without its '\r', hex loads may read up to limit
+void SlcanParser::decode_record(const uint8_t* rec, size_t n, const uint8_t* limit){
+    if(n == 0)
+        return; // bare '\r' is a command ack
+
+    // a '\a' (error) or other stray control bytes can sit in front of the
+    // frame, the first letter or digit decides what the record is
+    size_t start = 0;
+    while(start < n && !std::isalnum(rec[start]))
+        ++start;
+    if(start == n)
+        return;
+    rec += start;
+    n -= start;
+
+    const uint8_t type = rec[0];
+    bool ext, rtr = false, fd = false;
+    switch(type){
+        case 't': ext = false; break;
+        case 'T': ext = true;  break;
+        case 'r': ext = false; rtr = true; break;
+        case 'R': ext = true;  rtr = true; break;
+        case 'd': case 'b': ext = false; fd = true; break;
+        case 'D': case 'B': ext = true;  fd = true; break;
+        default:
+            return; // command response (z, Z, V, N, F ...)
+    }
+    const size_t id_chars = ext ? 8 : 3;
+    if(n < 1 + id_chars + 1){
+        ++_errors;
+        return;
+    }
+
+    uint32_t id = 0;
+    for(size_t i = 0; i < id_chars; ++i){
+        uint8_t v = hex_value(rec[1 + i]);
+        if(v > 15){
+            ++_errors;
+            return;
+        }
+        id = (id << 4) | v;
+    }
+    if(ext){
+        if(id > CAN_ID_EXT_MASK){
+            ++_errors;
+            return;
+        }
+        id |= CAN_ID_EXT_FLAG;
+    } else if(id > CAN_ID_STD_MASK){
+        ++_errors;
+        return;
+    }
+    if(rtr)
+        id |= CAN_ID_RTR_FLAG;
+
+    const uint8_t dlc = hex_value(rec[1 + id_chars]);
+    if(dlc > 15 || (!fd && dlc > 8)){
+        ++_errors;
+        return;
+    }
+    const uint8_t len = can_dlc_to_len(dlc);
+
+    const size_t data_at = 1 + id_chars + 1;
+    const size_t data_chars = rtr ? 0 : 2 * static_cast<size_t>(len);
+    const size_t rest = n - data_at;
+    if(rest != data_chars && rest != data_chars + 4){
+        ++_errors;
+        return;
+    }
+
+    uint8_t payload[CAN_FD_MAX_LEN] = {};
+    if(data_chars && !decode_hex(rec + data_at, len, payload, limit)){
+        ++_errors;
+        return;
+    }
+
+    uint64_t stamp = _read_ns;
+    if(rest == data_chars + 4){
+        uint8_t raw[2];
+        if(!decode_hex_scalar(rec + data_at + data_chars, 2, raw)){
+            ++_errors;
+            return;
+        }
+        uint16_t ms = static_cast<uint16_t>((raw[0] << 8) | raw[1]);
+        if(ms >= STAMP_WRAP_MS){
+            ++_errors;
+            return;
+        }
+        stamp = _anchor.map(unwrap_stamp(ms), _read_ns);
+    }
+
+    ++_frames;
+    if(_handler)
+        _handler(id, len, payload, stamp);
+}
+
+void SlcanParser::parse(const uint8_t* data, size_t len, uint64_t read_ns){
+    _read_ns = read_ns;
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+
+    // finish a record that was split by the previous call
+    if(_carry_len || _discard){
+        const uint8_t* cr = find_cr(p, end);
+        size_t chunk = (cr ? cr : end) - p;
+        if(!_discard && _carry_len + chunk <= MAX_RECORD){
+            std::memcpy(_carry + _carry_len, p, chunk);
+            _carry_len += chunk;
+        } else {
+            _discard = true;
+        }
+        if(!cr)
+            return;
+        if(!_discard)
+            decode_record(_carry, _carry_len, _carry + _carry_len);
+        else
+            ++_errors;
+        _carry_len = 0;
+        _discard = false;
+        p = cr + 1;
+    }
+
+    while(p < end){
+        const uint8_t* cr = find_cr(p, end);
+        if(!cr)
+            break;
+        decode_record(p, cr - p, end);
+        p = cr + 1;
+    }
+
+    // keep the unterminated tail for next time
+    size_t tail = end - p;
+    if(tail == 0)
+        return;
+    if(tail <= MAX_RECORD){
+        std::memcpy(_carry, p, tail);
+        _carry_len = tail;
+    } else {
+        _discard = true;
+    }
+}
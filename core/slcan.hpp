@@ -0,0 +1,53 @@
+#pragma once
+
+#include "candb.hpp"
+#include "clock.hpp"
+#include <cstdint>
+#include <cstddef>
+
+// SLCAN (lawicel) stream parser.
+//   tiiil<data>[zzzz]\r        11-bit data frame
+//   Tiiiiiiiil<data>[zzzz]\r   29-bit data frame
+//   riiil[zzzz]\r / Riiiiiiiil[zzzz]\r   remote frames
+//   diiil<data>[zzzz]\r / Diiiiiiiil<data>[zzzz]\r   CAN FD, b/B with bit rate switch
+// l is the DLC code, 9..F map to 12..64 payload bytes on FD frames.
+// zzzz is the optional 'Z1' timestamp suffix, milliseconds 0..59999 on the
+// sender's clock. It is unwrapped across the 60s wrap and anchored to the
+// host monotonic clock; frames without one are stamped with the read time.
+//
+// The fast path works on whole records: '\r' boundaries are found and hex is
+// decoded 16/32 bytes at a time (SSE2/AVX2/NEON, scalar otherwise). A record
+// split across two parse() calls is carried over in a small buffer. All state
+// lives in the object so every source can own its own.
+class SlcanParser {
+    public:
+        static constexpr size_t MAX_RECORD = 160;
+
+        explicit SlcanParser(FrameHandler handler);
+
+        // read_ns: monotonic time the bytes came off the port
+        void parse(const uint8_t* data, size_t len, uint64_t read_ns);
+        void reset();
+
+        uint64_t frames() const { return _frames; }
+        uint64_t errors() const { return _errors; }
+
+    private:
+        void decode_record(const uint8_t* rec, size_t n, const uint8_t* limit);
+        uint64_t unwrap_stamp(uint16_t ms);
+
+        FrameHandler _handler;
+
+        uint8_t _carry[MAX_RECORD];
+        size_t _carry_len = 0;
+        bool _discard = false;
+
+        uint64_t _read_ns = 0;
+        ClockAnchor _anchor;
+        bool _have_stamp = false;
+        uint16_t _last_stamp_ms = 0;
+        uint64_t _sender_ns = 0;
+
+        uint64_t _frames = 0;
+        uint64_t _errors = 0;
+};
@@ -0,0 +1,156 @@
+#include "socketcan.hpp"
+#include "clock.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+
+SocketCanIngest::SocketCanIngest(const std::string& ifname, FrameHandler handler)
+    : IngestSource("SocketCAN " + ifname), _handler(std::move(handler)) {
+    if(ifname.empty() || ifname.size() >= IFNAMSIZ)
+        throw std::invalid_argument("Invalid CAN interface name");
+
+    _fd = ::socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if(_fd < 0)
+        throw std::system_error(errno, std::system_category(), "CAN socket creation failed");
+
+    struct ifreq ifr = {};
+    std::strncpy(ifr.ifr_name, ifname.c_str(), IFNAMSIZ - 1);
+    if(ioctl(_fd, SIOCGIFINDEX, &ifr) < 0){
+        int err = errno;
+        ::close(_fd);
+        throw std::system_error(err, std::system_category(), "no such CAN interface");
+    }
+
+    // ask for FD frames too, older kernels without FD just refuse
+    int fd_frames = 1;
+    setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &fd_frames, sizeof(fd_frames));
+
+    // kernel receive timestamps, hardware ones too when the controller has them
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    if(setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) != 0){
+        int on = 1;
+        setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    }
+
+    struct sockaddr_can addr = {};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if(bind(_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0){
+        int err = errno;
+        ::close(_fd);
+        throw std::system_error(err, std::system_category(), "CAN bind failed");
+    }
+
+    for(unsigned i = 0; i < BATCH; ++i){
+        _iov[i].iov_base = &_frames[i];
+        _iov[i].iov_len = sizeof(_frames[i]);
+        std::memset(&_msgs[i], 0, sizeof(_msgs[i]));
+        _msgs[i].msg_hdr.msg_iov = &_iov[i];
+        _msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+SocketCanIngest::~SocketCanIngest(){
+    if(_fd >= 0) ::close(_fd);
+}
+
+static uint64_t to_ns(const struct timespec& ts){
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// software (CLOCK_REALTIME) and raw hardware receive stamps, 0 when absent
+static void rx_timestamps(struct msghdr& hdr, uint64_t& sw_ns, uint64_t& hw_ns){
+    sw_ns = hw_ns = 0;
+    for(struct cmsghdr* c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(&hdr, c)){
+        if(c->cmsg_level != SOL_SOCKET)
+            continue;
+        if(c->cmsg_type == SO_TIMESTAMPING){
+            struct scm_timestamping ts;
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            sw_ns = to_ns(ts.ts[0]);
+            hw_ns = to_ns(ts.ts[2]);
+        } else if(c->cmsg_type == SO_TIMESTAMPNS){
+            struct timespec ts;
+            std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            sw_ns = to_ns(ts);
+        }
+    }
+}
+
+// monotonic time of the receive. The controller clock keeps the finest
+// spacing but runs on its own epoch, so it is anchored to the kernel
+// software stamp (or our read time).
+uint64_t SocketCanIngest::rx_time(struct msghdr& hdr, uint64_t read_ns){
+    uint64_t sw_ns, hw_ns;
+    rx_timestamps(hdr, sw_ns, hw_ns);
+    uint64_t host_ns = sw_ns ? realtime_to_monotonic(sw_ns) : read_ns;
+    if(hw_ns)
+        return _hw_anchor.map(hw_ns, host_ns);
+    return host_ns;
+}
+
+bool SocketCanIngest::on_readable(){
+    // bounded so one busy bus can't starve the other sources
+    for(int round = 0; round < 4; ++round){
+        for(unsigned i = 0; i < BATCH; ++i){
+            _msgs[i].msg_hdr.msg_control = _control[i];
+            _msgs[i].msg_hdr.msg_controllen = sizeof(_control[i]);
+            _msgs[i].msg_hdr.msg_flags = 0;
+        }
+        int n = recvmmsg(_fd, _msgs, BATCH, MSG_DONTWAIT, nullptr);
+        const uint64_t read_ns = monotonic_ns();
+        if(n < 0){
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return true;
+            return false;
+        }
+        for(int i = 0; i < n; ++i){
+            const struct canfd_frame& f = _frames[i];
+            const bool is_fd = _msgs[i].msg_len == CANFD_MTU;
+            if(!is_fd && _msgs[i].msg_len != CAN_MTU)
+                continue;
+            if(f.can_id & CAN_ERR_FLAG)
+                continue;
+            uint32_t id = (f.can_id & CAN_EFF_FLAG) ? (CAN_ID_EXT_FLAG | (f.can_id & CAN_EFF_MASK))
+                                                    : (f.can_id & CAN_SFF_MASK);
+            if(f.can_id & CAN_RTR_FLAG)
+                id |= CAN_ID_RTR_FLAG;
+            const uint8_t max_len = is_fd ? CAN_FD_MAX_LEN : CAN_CLASSIC_MAX_LEN;
+            uint8_t len = f.len > max_len ? max_len : f.len;
+            _handler(id, len, f.data, rx_time(_msgs[i].msg_hdr, read_ns));
+        }
+        if(n < static_cast<int>(BATCH))
+            return true;
+    }
+    return true;
+}
+
+#else
+
+SocketCanIngest::SocketCanIngest(const std::string& ifname, FrameHandler handler)
+    : IngestSource("SocketCAN " + ifname), _handler(std::move(handler)) {
+    throw std::runtime_error("SocketCAN is only available on linux");
+}
+
+SocketCanIngest::~SocketCanIngest() {}
+
+bool SocketCanIngest::on_readable(){
+    return false;
+}
+
+#endif
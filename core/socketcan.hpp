@@ -0,0 +1,45 @@
+#pragma once
+
+#include "reactor.hpp"
+#include "candb.hpp"
+#include "clock.hpp"
+#include <cstdint>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/can.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+// Native linux SocketCAN interface (can0, vcan0, ...). Frames are pulled in
+// batches with recvmmsg and stamped by the kernel on receive, so there is no
+// SLCAN text round trip. CAN FD frames are taken when the interface has FD
+// enabled. Throws on platforms without SocketCAN.
+class SocketCanIngest : public IngestSource {
+    public:
+        static constexpr unsigned BATCH = 64;
+
+        SocketCanIngest(const std::string& ifname, FrameHandler handler);
+        ~SocketCanIngest() override;
+
+#ifndef _WIN32
+        int fd() const override { return _fd; }
+#endif
+        bool on_readable() override;
+
+    private:
+        FrameHandler _handler;
+        int _fd = -1;
+#if defined(__linux__)
+        uint64_t rx_time(struct msghdr& hdr, uint64_t read_ns);
+
+        ClockAnchor _hw_anchor;
+
+        // classic frames land here too, can_frame is a prefix of canfd_frame
+        struct canfd_frame _frames[BATCH];
+        struct iovec _iov[BATCH];
+        struct mmsghdr _msgs[BATCH];
+        alignas(8) unsigned char _control[BATCH][128];
+#endif
+};
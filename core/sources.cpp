@@ -0,0 +1,96 @@
+#include "sources.hpp"
+#include "clock.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <utility>
+
+SlcanStreamSource::SlcanStreamSource(std::string name, FrameHandler handler)
+    : IngestSource(std::move(name)),
+      _ring(WaitStrategy::Blocking),
+      _parser(std::move(handler)) {}
+
+bool SlcanStreamSource::on_readable(){
+    size_t space = 0;
+    uint8_t* dst = _ring.reserve(space);
+    ssize_t n = read_some(dst, std::min(space, READ_CHUNK));
+    const uint64_t read_ns = monotonic_ns();
+    if(n < 0 || _eof)
+        return false;
+    if(n == 0)
+        return true;
+    _ring.commit(static_cast<size_t>(n));
+
+    // same thread on both ends, so this never waits
+    size_t avail = 0;
+    const uint8_t* data = _ring.peek(avail);
+    feed(data, avail, read_ns);
+    _ring.consume(avail);
+    return true;
+}
+
+void SlcanStreamSource::feed(const uint8_t* data, size_t len, uint64_t read_ns){
+    _parser.parse(data, len, read_ns);
+}
+
+SerialIngest::SerialIngest(const std::string& port, unsigned baud, FrameHandler handler)
+    : SlcanStreamSource("Serial " + port + " @ " + std::to_string(baud), std::move(handler)),
+      _port(port, baud) {
+#ifndef _WIN32
+    _port.set_nonblocking(true);
+#endif
+}
+
+ssize_t SerialIngest::read_some(uint8_t* dst, size_t maxlen){
+    ssize_t n = _port.read(dst, maxlen);
+#ifndef _WIN32
+    // an unplugged adapter may report EOF without a hangup, and the fd
+    // stays readable, so end the source instead of polling it forever
+    if(n == 0){
+        _eof = true;
+        return 0;
+    }
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+#endif
+    return n;
+}
+
+TcpIngest::TcpIngest(const std::string& ip, unsigned port, FrameHandler handler,
+                     std::function<bool()> keep_trying)
+    : SlcanStreamSource("TCP " + (ip.empty() ? std::string("*") : ip) + ":" + std::to_string(port), handler),
+      _socket(ip, port, std::move(keep_trying)),
+      _decoder(std::move(handler)) {
+    // text-only senders never read, so the offer costs them nothing
+    std::vector<uint8_t> hello = TelemetryEncoder::hello();
+    if(_socket.write(hello.data(), hello.size()) != static_cast<ssize_t>(hello.size()))
+        std::cout << "[!] " << name() << ": could not offer binary telemetry" << std::endl;
+#ifndef _WIN32
+    _socket.set_nonblocking(true);
+#endif
+}
+
+ssize_t TcpIngest::read_some(uint8_t* dst, size_t maxlen){
+    ssize_t n = _socket.read(dst, maxlen);
+    if(n == 0){
+        _eof = true;
+        return 0;
+    }
+#ifndef _WIN32
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+#endif
+    return n;
+}
+
+void TcpIngest::feed(const uint8_t* data, size_t len, uint64_t read_ns){
+    if(_mode == Mode::Unknown){
+        // SLCAN text can never start with the sync byte
+        _mode = data[0] == TELEMETRY_SYNC ? Mode::Binary : Mode::Slcan;
+        std::cout << "[+] " << name() << (_mode == Mode::Binary ? ": binary telemetry" : ": SLCAN text") << std::endl;
+    }
+    if(_mode == Mode::Binary)
+        _decoder.parse(data, len, read_ns);
+    else
+        SlcanStreamSource::feed(data, len, read_ns);
+}
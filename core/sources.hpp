@@ -0,0 +1,66 @@
+#pragma once
+
+#include "reactor.hpp"
+#include "ringbuffer.hpp"
+#include "serial.hpp"
+#include "slcan.hpp"
+#include "tcp.hpp"
+#include "telemetry.hpp"
+#include <memory>
+#include <string>
+
+// Byte stream carrying SLCAN text. Reads land directly in the ring and the
+// parser runs in place on the contiguous view, one parser per source.
+class SlcanStreamSource : public IngestSource {
+    public:
+        SlcanStreamSource(std::string name, FrameHandler handler);
+
+        bool on_readable() override;
+
+    protected:
+        // < 0 error, 0 nothing right now, > 0 bytes read; sets _eof on end of stream
+        virtual ssize_t read_some(uint8_t* dst, size_t maxlen) = 0;
+        // bytes fresh out of the ring, SLCAN text unless a subclass knows better
+        virtual void feed(const uint8_t* data, size_t len, uint64_t read_ns);
+        bool _eof = false;
+
+    private:
+        RingBuffer _ring;
+        SlcanParser _parser;
+};
+
+class SerialIngest : public SlcanStreamSource {
+    public:
+        SerialIngest(const std::string& port, unsigned baud, FrameHandler handler);
+#ifndef _WIN32
+        int fd() const override { return _port.native_handle(); }
+#endif
+
+    protected:
+        ssize_t read_some(uint8_t* dst, size_t maxlen) override;
+
+    private:
+        SerialPort _port;
+};
+
+// Offers the binary telemetry protocol on connect and follows whatever the
+// peer answers with: binary packets, or SLCAN text from senders that predate it.
+class TcpIngest : public SlcanStreamSource {
+    public:
+        TcpIngest(const std::string& ip, unsigned port, FrameHandler handler,
+                  std::function<bool()> keep_trying = nullptr);
+#ifndef _WIN32
+        int fd() const override { return _socket.native_handle(); }
+#endif
+
+    protected:
+        ssize_t read_some(uint8_t* dst, size_t maxlen) override;
+        void feed(const uint8_t* data, size_t len, uint64_t read_ns) override;
+
+    private:
+        enum class Mode { Unknown, Slcan, Binary };
+
+        TcpSocket _socket;
+        TelemetryDecoder _decoder;
+        Mode _mode = Mode::Unknown;
+};
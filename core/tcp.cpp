@@ -1,5 +1,6 @@
 #include "tcp.hpp"
 #include <cstdint>
+#include <stdexcept>
 #include <system_error>
 #include <iostream>
 #include <thread>
@@ -9,11 +10,13 @@
 #include <winsock2.h>
 #include <Ws2tcpip.h>
 #else
+#include <sys/select.h>
 #include <sys/socket.h>
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 
-TcpSocket::TcpSocket(const std::string& serverIP, unsigned port){
+TcpSocket::TcpSocket(const std::string& serverIP, unsigned port, std::function<bool()> keep_trying){
 #ifdef _WIN32
     static bool wsa_started = false;
     if(!wsa_started){
@@ -59,6 +62,14 @@ TcpSocket::TcpSocket(const std::string& serverIP, unsigned port){
               < 0
 #endif
         ){
+            if(keep_trying && !keep_trying()){
+#ifdef _WIN32
+                closesocket(_fd);
+#else
+                ::close(_fd);
+#endif
+                throw std::runtime_error("connection attempt cancelled");
+            }
             std::cout << "[!] Unable to connect to server!" << std::endl;
             std::this_thread::sleep_for(std::chrono::seconds(1));
         }
@@ -114,9 +125,22 @@ TcpSocket::TcpSocket(const std::string& serverIP, unsigned port){
             _fd < 0
 #endif
         ){
+            if(keep_trying && !keep_trying()){
+#ifdef _WIN32
+                closesocket(_listen);
+#else
+                ::close(_listen);
+#endif
+                throw std::runtime_error("waiting for a connection cancelled");
+            }
             std::cout << "[!] Searching for connection on: " << _listen << std::endl;
-            _fd = accept(_listen, nullptr, nullptr);
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            // wait at most a second so keep_trying gets asked again
+            fd_set ready;
+            FD_ZERO(&ready);
+            FD_SET(_listen, &ready);
+            timeval timeout = {1, 0};
+            if(select(static_cast<int>(_listen) + 1, &ready, nullptr, nullptr, &timeout) > 0)
+                _fd = accept(_listen, nullptr, nullptr);
         }
         std::cout << "[+] Initialized connection on: " << _listen << std::endl;
     }
@@ -125,8 +149,10 @@ TcpSocket::TcpSocket(const std::string& serverIP, unsigned port){
 TcpSocket::~TcpSocket(){
 #ifdef _WIN32
     if(_fd != INVALID_SOCKET) closesocket(_fd);
+    if(_listen != INVALID_SOCKET) closesocket(_listen);
 #else
     if(_fd >= 0) ::close(_fd);
+    if(_listen >= 0) ::close(_listen);
 #endif
 }
 
@@ -183,3 +209,14 @@ void TcpSocket::reconnect(){
     std::cout << "[+] reconnect on: " << _listen << std::endl;
 #endif
 }
+
+#ifndef _WIN32
+void TcpSocket::set_nonblocking(bool enable){
+    int flags = fcntl(_fd, F_GETFL, 0);
+    if(flags < 0)
+        throw std::system_error(errno, std::system_category(), "fcntl failed");
+    flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if(fcntl(_fd, F_SETFL, flags) != 0)
+        throw std::system_error(errno, std::system_category(), "fcntl failed");
+}
+#endif
@@ -3,6 +3,7 @@
 #include <string>
 #include <cstdint>
 #include <cstddef>
+#include <functional>
 #include <sys/types.h>
 
 #ifdef _WIN32
@@ -21,7 +22,9 @@ typedef SSIZE_T ssize_t;
 
 class TcpSocket {
     public:
-        TcpSocket(const std::string& serverIP, unsigned port);
+        // connect/accept retry until they succeed or keep_trying says stop,
+        // which throws
+        TcpSocket(const std::string& serverIP, unsigned port, std::function<bool()> keep_trying = nullptr);
         ~TcpSocket();
 
         TcpSocket(const TcpSocket&) = delete;
@@ -29,6 +32,10 @@ class TcpSocket {
         ssize_t read(uint8_t* buf, std::size_t maxlen);
         ssize_t write(const uint8_t* buf, std::size_t len);
         void reconnect();
+#ifndef _WIN32
+        int native_handle() const { return _fd; }
+        void set_nonblocking(bool enable);
+#endif
 
     private:
 #ifdef _WIN32
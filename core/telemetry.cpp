@@ -0,0 +1,332 @@
+#include "telemetry.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32)
+#define TELEMETRY_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+// -- CRC-32C (Castagnoli) --
+
+static uint32_t crc32c_table(const uint8_t* data, size_t len, uint32_t crc){
+    static const std::array<uint32_t, 256> table = []{
+        std::array<uint32_t, 256> t{};
+        for(uint32_t i = 0; i < 256; ++i){
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k)
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : (c >> 1);
+            t[i] = c;
+        }
+        return t;
+    }();
+    for(size_t i = 0; i < len; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(TELEMETRY_SSE42)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(const uint8_t* data, size_t len, uint32_t crc){
+#if defined(__x86_64__)
+    uint64_t c = crc;
+    for(; len >= 8; len -= 8, data += 8){
+        uint64_t v;
+        std::memcpy(&v, data, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = static_cast<uint32_t>(c);
+#endif
+    for(; len > 0; --len)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+#endif
+
+using Crc32cFn = uint32_t (*)(const uint8_t*, size_t, uint32_t);
+
+static Crc32cFn pick_crc32c(){
+#if defined(TELEMETRY_SSE42)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2"))
+        return crc32c_sse42;
+#endif
+    return crc32c_table;
+}
+
+static const Crc32cFn crc32c_impl = pick_crc32c();
+
+uint32_t crc32c(const uint8_t* data, size_t len, uint32_t crc){
+    return ~crc32c_impl(data, len, ~crc);
+}
+
+// -- little endian helpers --
+
+static inline void put_le(std::vector<uint8_t>& out, uint64_t v, size_t bytes){
+    for(size_t i = 0; i < bytes; ++i)
+        out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+static inline void set_le(uint8_t* dst, uint64_t v, size_t bytes){
+    for(size_t i = 0; i < bytes; ++i)
+        dst[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static inline uint64_t get_le(const uint8_t* src, size_t bytes){
+    uint64_t v = 0;
+    for(size_t i = 0; i < bytes; ++i)
+        v |= static_cast<uint64_t>(src[i]) << (8 * i);
+    return v;
+}
+
+// -- encoder --
+
+TelemetryEncoder::TelemetryEncoder(){
+    _packet.reserve(TELEMETRY_MAX_PACKET);
+    open();
+}
+
+std::vector<uint8_t> TelemetryEncoder::hello(uint8_t type, uint8_t version){
+    std::vector<uint8_t> p;
+    p.push_back(TELEMETRY_SYNC);
+    p.push_back(type);
+    put_le(p, 4, 2);
+    put_le(p, 0, 4);
+    put_le(p, 0, 8);
+    p.push_back(version);
+    put_le(p, 0, 3);
+    put_le(p, crc32c(p.data(), p.size()), 4);
+    return p;
+}
+
+void TelemetryEncoder::open(){
+    _packet.assign(TELEMETRY_HEADER_SIZE, 0);
+    _packet[0] = TELEMETRY_SYNC;
+    _packet[1] = TELEMETRY_FRAMES;
+    set_le(&_packet[4], _sequence, 4);
+    _count = 0;
+    _sealed = false;
+}
+
+bool TelemetryEncoder::add(uint8_t bus, uint32_t id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns, bool brs){
+    const bool ext = (id & CAN_ID_EXT_FLAG) != 0;
+    const bool rtr = (id & CAN_ID_RTR_FLAG) != 0;
+    const bool fd = len > CAN_CLASSIC_MAX_LEN || brs;
+    if(len > CAN_FD_MAX_LEN || (rtr && fd))
+        return false;
+    const uint8_t dlc = can_len_to_dlc(len);
+    const uint8_t wire_len = rtr ? 0 : can_dlc_to_len(dlc);
+
+    if(_sealed)
+        open();
+    if(_count == 0){
+        _last_ns = timestamp_ns;
+        set_le(&_packet[8], timestamp_ns, 8);
+    }
+    uint64_t delta_us = timestamp_ns > _last_ns ? (timestamp_ns - _last_ns) / 1000 : 0;
+
+    uint8_t varint[10];
+    size_t varint_len = 0;
+    uint64_t v = delta_us;
+    do {
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        varint[varint_len++] = v ? (b | 0x80) : b;
+    } while(v);
+
+    const size_t record = 2 + varint_len + (ext ? 4 : 2) + wire_len;
+    if(_packet.size() - TELEMETRY_HEADER_SIZE + record > TELEMETRY_MAX_BODY)
+        return false;
+
+    uint8_t flags = (ext ? TELEMETRY_FLAG_EXT : 0) | (rtr ? TELEMETRY_FLAG_RTR : 0) |
+                    (fd ? TELEMETRY_FLAG_FD : 0) | (brs ? TELEMETRY_FLAG_BRS : 0);
+    _packet.push_back(static_cast<uint8_t>(flags << 4 | dlc));
+    _packet.push_back(bus);
+    _packet.insert(_packet.end(), varint, varint + varint_len);
+    put_le(_packet, id & (ext ? CAN_ID_EXT_MASK : CAN_ID_STD_MASK), ext ? 4 : 2);
+    // DLC codes round up, pad the payload to the coded length
+    for(uint8_t i = 0; i < wire_len; ++i)
+        _packet.push_back(i < len && payload ? payload[i] : 0);
+
+    // track the time the decoder will reconstruct so rounding never drifts
+    _last_ns += delta_us * 1000;
+    ++_count;
+    return true;
+}
+
+const std::vector<uint8_t>& TelemetryEncoder::finish(){
+    set_le(&_packet[2], _packet.size() - TELEMETRY_HEADER_SIZE, 2);
+    put_le(_packet, crc32c(_packet.data(), _packet.size()), 4);
+    ++_sequence;
+    _count = 0;
+    // stays valid until the next add() reopens the batch
+    _sealed = true;
+    return _packet;
+}
+
+// -- decoder --
+
+TelemetryDecoder::TelemetryDecoder(FrameHandler handler)
+    : _handler(std::move(handler)), _carry(TELEMETRY_MAX_PACKET) {}
+
+void TelemetryDecoder::reset(){
+    _carry_len = 0;
+    _anchor.reset();
+    _version = 0;
+    _have_sequence = false;
+    _sequence = 0;
+}
+
+// full packet size from a header, 0 if the header can't be one
+static size_t packet_size(const uint8_t* hdr){
+    if(hdr[0] != TELEMETRY_SYNC)
+        return 0;
+    if(hdr[1] != TELEMETRY_HELLO && hdr[1] != TELEMETRY_HELLO_ACK && hdr[1] != TELEMETRY_FRAMES)
+        return 0;
+    size_t body = static_cast<size_t>(get_le(hdr + 2, 2));
+    if(body > TELEMETRY_MAX_BODY)
+        return 0;
+    return TELEMETRY_HEADER_SIZE + body + TELEMETRY_CRC_SIZE;
+}
+
+void TelemetryDecoder::decode_frames(const uint8_t* p, size_t len, uint64_t base_ns){
+    const uint8_t* end = p + len;
+    uint64_t t_ns = base_ns;
+    while(p < end){
+        if(end - p < 2)
+            break;
+        const uint8_t flags = p[0] >> 4;
+        const uint8_t dlc = p[0] & 0x0F;
+        p += 2; // bus is not told apart by the store yet
+
+        uint64_t delta_us = 0;
+        unsigned shift = 0;
+        bool done = false;
+        while(p < end && shift < 64){
+            uint8_t b = *p++;
+            delta_us |= static_cast<uint64_t>(b & 0x7F) << shift;
+            shift += 7;
+            if(!(b & 0x80)){
+                done = true;
+                break;
+            }
+        }
+        if(!done)
+            break;
+
+        const bool ext = (flags & TELEMETRY_FLAG_EXT) != 0;
+        const bool rtr = (flags & TELEMETRY_FLAG_RTR) != 0;
+        const bool fd = (flags & TELEMETRY_FLAG_FD) != 0;
+        if((!fd && dlc > 8) || (fd && rtr))
+            break;
+        const size_t id_bytes = ext ? 4 : 2;
+        const uint8_t data_len = rtr ? 0 : can_dlc_to_len(dlc);
+        if(static_cast<size_t>(end - p) < id_bytes + data_len)
+            break;
+
+        uint32_t id = static_cast<uint32_t>(get_le(p, id_bytes));
+        p += id_bytes;
+        if(ext ? id > CAN_ID_EXT_MASK : id > CAN_ID_STD_MASK)
+            break;
+        if(ext)
+            id |= CAN_ID_EXT_FLAG;
+        if(rtr)
+            id |= CAN_ID_RTR_FLAG;
+
+        t_ns += delta_us * 1000;
+        ++_frames;
+        static const uint8_t no_payload[CAN_FD_MAX_LEN] = {};
+        if(_handler)
+            _handler(id, rtr ? can_dlc_to_len(dlc) : data_len, rtr ? no_payload : p,
+                     base_ns ? _anchor.map(t_ns, _read_ns) : _read_ns);
+        p += data_len;
+    }
+    if(p != end)
+        ++_errors;
+}
+
+// consumes every complete packet and any garbage, leaves a trailing partial
+// packet for the caller
+size_t TelemetryDecoder::decode_packets(const uint8_t* p, size_t n){
+    size_t off = 0;
+    while(off < n){
+        if(p[off] != TELEMETRY_SYNC){
+            const void* sync = std::memchr(p + off, TELEMETRY_SYNC, n - off);
+            ++_errors;
+            if(!sync)
+                return n;
+            off = static_cast<const uint8_t*>(sync) - p;
+        }
+        if(n - off < TELEMETRY_HEADER_SIZE)
+            break;
+        const uint8_t* hdr = p + off;
+        size_t size = packet_size(hdr);
+        if(size == 0){
+            ++_errors;
+            ++off;
+            continue;
+        }
+        if(n - off < size)
+            break;
+
+        const size_t body_len = size - TELEMETRY_HEADER_SIZE - TELEMETRY_CRC_SIZE;
+        uint32_t crc = static_cast<uint32_t>(get_le(hdr + size - TELEMETRY_CRC_SIZE, 4));
+        if(crc32c(hdr, size - TELEMETRY_CRC_SIZE) != crc){
+            // the length may be what got corrupted, resync from the next byte
+            ++_crc_errors;
+            ++off;
+            continue;
+        }
+
+        const uint8_t* body = hdr + TELEMETRY_HEADER_SIZE;
+        switch(hdr[1]){
+            case TELEMETRY_HELLO_ACK:
+                if(body_len >= 1)
+                    _version = body[0];
+                break;
+            case TELEMETRY_FRAMES: {
+                uint32_t seq = static_cast<uint32_t>(get_le(hdr + 4, 4));
+                if(_have_sequence && seq != _sequence + 1)
+                    _lost_packets += static_cast<uint32_t>(seq - _sequence - 1);
+                _have_sequence = true;
+                _sequence = seq;
+                decode_frames(body, body_len, get_le(hdr + 8, 8));
+                break;
+            }
+            default:
+                break; // a HELLO echoed back, nothing to do
+        }
+        off += size;
+    }
+    return off;
+}
+
+void TelemetryDecoder::parse(const uint8_t* data, size_t len, uint64_t read_ns){
+    _read_ns = read_ns;
+    // finish a packet split by the previous call, only topping the carry up
+    // to what that packet needs
+    while(_carry_len && len){
+        size_t want = TELEMETRY_HEADER_SIZE;
+        if(_carry_len >= TELEMETRY_HEADER_SIZE){
+            size_t size = packet_size(_carry.data());
+            want = size ? size : _carry_len;
+        }
+        size_t take = std::min(want - _carry_len, len);
+        std::memcpy(_carry.data() + _carry_len, data, take);
+        _carry_len += take;
+        data += take;
+        len -= take;
+
+        size_t used = decode_packets(_carry.data(), _carry_len);
+        std::memmove(_carry.data(), _carry.data() + used, _carry_len - used);
+        _carry_len -= used;
+    }
+    if(_carry_len)
+        return;
+
+    size_t used = decode_packets(data, len);
+    std::memcpy(_carry.data(), data + used, len - used);
+    _carry_len = len - used;
+}
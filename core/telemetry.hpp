@@ -0,0 +1,116 @@
+#pragma once
+
+#include "candb.hpp"
+#include "clock.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Binary framed telemetry link, the compact alternative to SLCAN text over TCP.
+// All integers are little endian. Every packet is
+//
+//   0   u8   sync 0xA5
+//   1   u8   type (TELEMETRY_HELLO, TELEMETRY_HELLO_ACK, TELEMETRY_FRAMES)
+//   2   u16  body length
+//   4   u32  sequence number, +1 per frames packet
+//   8   u64  base timestamp, sender clock ns (0 if it has none)
+//   16  ...  body
+//   end u32  CRC-32C over header and body
+//
+// A frames body is a run of records:
+//
+//   u8      flags << 4 | dlc code   (flags: 1 ext, 2 rtr, 4 fd, 8 brs)
+//   u8      bus
+//   varint  us since the previous record, the first one counts from base
+//   u16/u32 id, 4 bytes when ext
+//   ...     can_dlc_to_len(dlc) payload bytes, none for rtr
+//
+// which is 14 bytes for an 8-byte classic frame against 26 as SLCAN text.
+//
+// Handshake: the host sends HELLO (body: u8 version, 3 reserved) as soon as
+// the connection is up. A sender that speaks the protocol answers HELLO_ACK
+// with the version it will use and then only sends packets. A sender that
+// does not hear a HELLO within a second should fall back to SLCAN text, and
+// the host treats a stream whose first byte is not the sync as SLCAN, so old
+// text senders keep working unchanged.
+
+constexpr uint8_t TELEMETRY_SYNC = 0xA5;
+constexpr uint8_t TELEMETRY_VERSION = 1;
+constexpr uint8_t TELEMETRY_HELLO = 0x01;
+constexpr uint8_t TELEMETRY_HELLO_ACK = 0x02;
+constexpr uint8_t TELEMETRY_FRAMES = 0x10;
+
+constexpr uint8_t TELEMETRY_FLAG_EXT = 0x1;
+constexpr uint8_t TELEMETRY_FLAG_RTR = 0x2;
+constexpr uint8_t TELEMETRY_FLAG_FD  = 0x4;
+constexpr uint8_t TELEMETRY_FLAG_BRS = 0x8;
+
+constexpr size_t TELEMETRY_HEADER_SIZE = 16;
+constexpr size_t TELEMETRY_CRC_SIZE = 4;
+constexpr size_t TELEMETRY_MAX_BODY = 8192;
+constexpr size_t TELEMETRY_MAX_PACKET = TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_BODY + TELEMETRY_CRC_SIZE;
+
+uint32_t crc32c(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+// Builds packets. Frames are appended to the open batch until it is full,
+// finish() seals it with the CRC and starts counting the next sequence.
+class TelemetryEncoder {
+    public:
+        TelemetryEncoder();
+
+        static std::vector<uint8_t> hello(uint8_t type = TELEMETRY_HELLO, uint8_t version = TELEMETRY_VERSION);
+
+        // false if the record does not fit, finish() and retry
+        bool add(uint8_t bus, uint32_t id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns, bool brs = false);
+        bool empty() const { return _count == 0; }
+        const std::vector<uint8_t>& finish();
+
+    private:
+        void open();
+
+        std::vector<uint8_t> _packet;
+        uint32_t _sequence = 0;
+        uint64_t _last_ns = 0;
+        size_t _count = 0;
+        bool _sealed = false;
+};
+
+// Stream decoder, fed the same way as SlcanParser. A packet split across
+// parse() calls is carried over; a bad header or CRC drops one byte and
+// hunts for the next sync. Frames from every bus go to the one handler,
+// sender times anchored to the host monotonic clock (read time if none).
+class TelemetryDecoder {
+    public:
+        explicit TelemetryDecoder(FrameHandler handler);
+
+        void parse(const uint8_t* data, size_t len, uint64_t read_ns);
+        void reset();
+
+        // version from the sender's HELLO_ACK, 0 until one arrived
+        uint8_t version() const { return _version; }
+
+        uint64_t frames() const { return _frames; }
+        uint64_t errors() const { return _errors; }
+        uint64_t crc_errors() const { return _crc_errors; }
+        uint64_t lost_packets() const { return _lost_packets; }
+
+    private:
+        size_t decode_packets(const uint8_t* p, size_t n);
+        void decode_frames(const uint8_t* body, size_t len, uint64_t base_ns);
+
+        FrameHandler _handler;
+
+        std::vector<uint8_t> _carry;
+        size_t _carry_len = 0;
+        uint64_t _read_ns = 0;
+        ClockAnchor _anchor;
+
+        uint8_t _version = 0;
+        bool _have_sequence = false;
+        uint32_t _sequence = 0;
+
+        uint64_t _frames = 0;
+        uint64_t _errors = 0;
+        uint64_t _crc_errors = 0;
+        uint64_t _lost_packets = 0;
+};
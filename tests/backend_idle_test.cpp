@@ -0,0 +1,59 @@
+// backend() with its reactor and nothing connected must sleep: a few
+// seconds idle cost next to no CPU, and backend_shutdown() makes it return
+// promptly with every thread joined.
+
+#include "check.hpp"
+#include "backend.hpp"
+#include <chrono>
+#include <future>
+#include <thread>
+
+#if defined(__linux__)
+#include <cstdlib>
+#include <sys/resource.h>
+
+namespace {
+
+// user + system time of the whole process
+double cpu_seconds(){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6
+         + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+} // namespace
+
+int main(){
+    constexpr double IDLE_SECONDS = 3.0;
+    // 1% of one core; a polling loop or a stray 1 ms timer costs far more
+    constexpr double MAX_CPU_SECONDS = IDLE_SECONDS * 0.01;
+
+    char name[] = "backend_idle_test";
+    char* argv[] = {name, nullptr};
+    auto done = std::async(std::launch::async, [&argv]{ return backend(1, argv); });
+
+    // let the startup work (builtin DBCs, thread creation) settle first
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    const double before = cpu_seconds();
+    std::this_thread::sleep_for(std::chrono::duration<double>(IDLE_SECONDS));
+    const double used = cpu_seconds() - before;
+    std::cout << "[+] idle for " << IDLE_SECONDS << " s used " << used * 1e3 << " ms of CPU" << std::endl;
+    CHECK(used < MAX_CPU_SECONDS);
+
+    backend_shutdown();
+    if(done.wait_for(std::chrono::seconds(5)) != std::future_status::ready){
+        std::cout << "[!] backend() did not return after backend_shutdown()" << std::endl;
+        std::_Exit(1);
+    }
+    CHECK(done.get() == 0);
+    return test_result();
+}
+
+#else
+
+int main(){
+    SKIP("getrusage is not available here");
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal assertions for the ctest executables: a failed CHECK reports
+// itself and makes main() return 1, SKIP ends the test as skipped (ctest
+// SKIP_RETURN_CODE) when the environment can't run it.
+
+constexpr int TEST_SKIPPED = 77;
+
+inline int& test_failures(){
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)){ \
+            std::cout << "[!] " << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+            ++test_failures(); \
+        } \
+    } while(0)
+
+#define SKIP(why) \
+    do { \
+        std::cout << "[+] skipped: " << why << std::endl; \
+        return TEST_SKIPPED; \
+    } while(0)
+
+inline int test_result(){
+    if(test_failures())
+        std::cout << "[!] " << test_failures() << " check(s) failed" << std::endl;
+    return test_failures() ? 1 : 0;
+}
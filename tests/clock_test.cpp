@@ -0,0 +1,54 @@
+// ClockAnchor keeps mapped sender stamps on the host clock when the two
+// clocks drift apart, at realistic frame spacing.
+
+#include "check.hpp"
+#include "clock.hpp"
+#include <cstdint>
+
+namespace {
+
+// Frames every period_ns for seconds from a sender whose clock runs ppm off
+// (negative: slow), each read a fixed link delay after it was sent. With no
+// jitter the true offset is the latest host - sender difference, so a
+// mapped stamp should land on the read time; returns the worst lag behind it.
+uint64_t track(int64_t ppm, uint64_t period_ns, uint64_t seconds){
+    ClockAnchor anchor;
+    const uint64_t host0 = 1000000000000ull + 200000;
+    uint64_t worst = 0;
+    for(uint64_t t = 0; t < seconds * 1000000000ull; t += period_ns){
+        const uint64_t sender = 5000000000ull + t + static_cast<uint64_t>(static_cast<int64_t>(t) / 1000000 * ppm);
+        const uint64_t host = host0 + t;
+        const uint64_t mapped = anchor.map(sender, host);
+        CHECK(mapped <= host);
+        if(host - mapped > worst)
+            worst = host - mapped;
+    }
+    return worst;
+}
+
+} // namespace
+
+int main(){
+    // a 200 ppm slow sender loses 12 ms over a minute, the anchor must creep
+    // after it even though every call is only 100 us after the last
+    const uint64_t slow = track(-200, 100000, 60);
+    std::cout << "[+] slow sender, 100 us frames: worst lag " << slow / 1000 << " us" << std::endl;
+    CHECK(slow < 50000);
+
+    // the same at 1 us spacing, where each step is well under a nanosecond
+    const uint64_t slow_dense = track(-200, 1000, 5);
+    std::cout << "[+] slow sender, 1 us frames: worst lag " << slow_dense / 1000 << " us" << std::endl;
+    CHECK(slow_dense < 50000);
+
+    // a fast sender only ever lowers the minimum, no creep needed
+    const uint64_t fast = track(200, 100000, 60);
+    std::cout << "[+] fast sender, 100 us frames: worst lag " << fast / 1000 << " us" << std::endl;
+    CHECK(fast < 50000);
+
+    // and frames spaced wider than a millisecond still work
+    const uint64_t sparse = track(-200, 10000000, 60);
+    std::cout << "[+] slow sender, 10 ms frames: worst lag " << sparse / 1000 << " us" << std::endl;
+    CHECK(sparse < 50000);
+
+    return test_result();
+}
@@ -0,0 +1,197 @@
+// DbcParser over a small inline DBC: comments spanning lines with escaped
+// quotes, simple and extended multiplexing, SIG_VALTYPE_, cycle times from
+// BA_ and BA_DEF_DEF_, value tables that stay in their own file, and
+// malformed statements skipped without losing what follows them.
+
+#include "check.hpp"
+#include "dbc.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const char MAIN_DBC[] = R"(VERSION "1.0"
+
+NS_ :
+	NS_DESC_
+	CM_
+	BA_DEF_
+	VAL_TABLE_
+
+BS_:
+
+BU_: ECU HOST
+
+VAL_TABLE_ Mode 0 "Off" 1 "On" 2 "Fault" ;
+VAL_TABLE_ GearTable 0 "Park" 1 "Drive" ;
+
+BO_ 256 Speed: 8 ECU
+ SG_ Wheel : 0|16@1+ (0.01,0) [0|655.35] "km/h" HOST
+ SG_ Mode : 16|2@1+ (1,0) [0|3] "" HOST
+ SG_ Broken : 24|x@1+ (1,0) [0|1] "" HOST
+ SG_ Temp : 39|16@0- (0.5,-40) [-100|100] "degC" HOST,ECU
+
+BO_ 512 Mux: 8 ECU
+ SG_ Page M : 0|8@1+ (1,0) [0|255] "" HOST
+ SG_ PageA m0 : 8|16@1+ (1,0) [0|65535] "" HOST
+ SG_ PageB m1 : 8|16@1- (1,0) [-32768|32767] "" HOST
+ SG_ Sub m1M : 24|4@1+ (1,0) [0|15] "" HOST
+ SG_ Deep m3 : 28|4@1+ (1,0) [0|15] "" HOST
+
+BO_ 12x Garbage: 8 ECU
+ SG_ Orphan : 0|8@1+ (1,0) [0|255] "" HOST
+
+BO_ 2147484416 Floats: 8 ECU
+ SG_ F32 : 0|32@1- (1,0) [0|0] "" HOST
+ SG_ Gear : 32|8@1+ (1,0) [0|3] "" HOST
+ SG_ Mode : 40|2@1+ (1,0) [0|3] "" HOST
+
+this line is nothing a DBC knows
+
+CM_ "the file itself";
+CM_ BU_ ECU "the sender";
+CM_ BO_ 256 "Speed from the
+wheel sensor";
+CM_ SG_ 256 Wheel "reads \"fast\"; or slow
+and \\ a backslash";
+CM_ SG_ 256 Nothing "no such signal";
+BA_DEF_ BO_ "GenMsgCycleTime" INT 0 10000;
+BA_DEF_ SG_ "SigKind" ENUM "Raw","Scaled";
+BA_DEF_DEF_ "GenMsgCycleTime" 100;
+BA_DEF_DEF_ "SigKind" "Raw";
+BA_ "GenMsgCycleTime" BO_ 256 20;
+BA_ "GenMsgCycleTime" BO_ 999 5;
+BA_ "GenMsgCycleTime" BO_ oops 50;
+BA_ "SigKind" SG_ 256 Wheel 1;
+VAL_ 256 Mode 0 "Idle" 1 "Run" ;
+SIG_VALTYPE_ 2147484416 F32 : 1;
+SIG_VALTYPE_ 2147484416 Gear : 7;
+SG_MUL_VAL_ 512 Deep Sub 3-3, 5-7;
+CM_ SG_ 512 Page "never closed;
+)";
+
+// no tables and no BA_DEF_DEF_ of its own
+const char OTHER_DBC[] = R"(BO_ 1024 Other: 8 HOST
+ SG_ Mode : 0|2@1+ (1,0) [0|3] "" ECU
+ SG_ Gear : 8|8@1+ (1,0) [0|3] "" ECU
+)";
+
+const DbcSignal* find(const DbcParser& dbc, uint32_t id, const std::string& name){
+    auto it = dbc.messages().find(id);
+    if(it == dbc.messages().end())
+        return nullptr;
+    for(const auto &sig : it->second.signals)
+        if(sig.name == name)
+            return &sig;
+    return nullptr;
+}
+
+std::vector<std::string> names(const DbcParser& dbc, uint32_t id){
+    std::vector<std::string> out;
+    for(const auto &sig : dbc.messages().at(id).signals)
+        out.push_back(sig.name);
+    return out;
+}
+
+} // namespace
+
+int main(){
+    DbcParser dbc;
+    CHECK(dbc.loadFromMemory(MAIN_DBC, sizeof(MAIN_DBC) - 1, "main.dbc"));
+    const uint32_t FLOATS = 2147484416u;
+    const bool all = dbc.messages().size() == 3 && dbc.messages().count(256) && dbc.messages().count(512)
+                  && dbc.messages().count(FLOATS);
+    CHECK(all);
+    if(!all)
+        return test_result();
+    CHECK((dbc.nodes() == std::vector<std::string>{"ECU", "HOST"}));
+
+    // a malformed SG_ costs that signal, a malformed BO_ that message and
+    // its signals; the lines after either parse as usual
+    CHECK((names(dbc, 256) == std::vector<std::string>{"Wheel", "Mode", "Temp"}));
+    CHECK((names(dbc, FLOATS) == std::vector<std::string>{"F32", "Gear", "Mode"}));
+    for(const auto &mp : dbc.messages())
+        CHECK(!find(dbc, mp.first, "Orphan"));
+
+    const DbcMessage &speed = dbc.messages().at(256);
+    CHECK(speed.name == "Speed" && speed.dlc == 8 && speed.transmitter == "ECU" && speed.dbc_name == "main.dbc");
+    const DbcSignal* temp = find(dbc, 256, "Temp");
+    CHECK(temp && temp->start_bit == 39 && temp->size == 16 && !temp->little_endian && temp->is_signed
+          && temp->factor == 0.5 && temp->offset == -40 && temp->minimum == -100 && temp->maximum == 100
+          && temp->unit == "degC" && (temp->receivers == std::vector<std::string>{"HOST", "ECU"}));
+
+    // comments run across lines and keep escaped quotes and backslashes; a
+    // ';' inside one doesn't end it
+    CHECK(speed.comment == "Speed from the\nwheel sensor");
+    const DbcSignal* wheel = find(dbc, 256, "Wheel");
+    CHECK(wheel && wheel->comment == "reads \"fast\"; or slow\nand \\ a backslash");
+    CHECK(wheel && wheel->unit == "km/h" && wheel->factor == 0.01);
+    // one left open at the end of the file is dropped
+    const DbcSignal* page = find(dbc, 512, "Page");
+    CHECK(page && page->comment.empty());
+
+    // M, m<n> and m<n>M
+    const DbcSignal* page_a = find(dbc, 512, "PageA");
+    const DbcSignal* page_b = find(dbc, 512, "PageB");
+    const DbcSignal* sub = find(dbc, 512, "Sub");
+    const DbcSignal* deep = find(dbc, 512, "Deep");
+    CHECK(page && page->multiplexor && page->mux_value == -1);
+    CHECK(page_a && !page_a->multiplexor && page_a->mux_value == 0);
+    CHECK(page_b && !page_b->multiplexor && page_b->mux_value == 1 && page_b->is_signed);
+    CHECK(sub && sub->multiplexor && sub->mux_value == 1);
+    CHECK(deep && !deep->multiplexor && deep->mux_value == 3);
+    CHECK(!find(dbc, 256, "Wheel")->multiplexor && find(dbc, 256, "Wheel")->mux_value == -1);
+
+    // SG_MUL_VAL_: Deep is present while Sub reads 3 or 5 to 7
+    CHECK(deep && deep->mux_switch == "Sub"
+          && (deep->mux_ranges == std::vector<std::pair<uint64_t, uint64_t>>{{3, 3}, {5, 7}}));
+
+    // SIG_VALTYPE_ 1 reads the bits as an IEEE float; 7 is no type at all
+    const DbcSignal* f32 = find(dbc, FLOATS, "F32");
+    const DbcSignal* gear = find(dbc, FLOATS, "Gear");
+    CHECK(f32 && f32->value_type == DbcValueType::Float);
+    CHECK(gear && gear->value_type == DbcValueType::Integer);
+    CanFrame frame{};
+    frame.len = 8;
+    const float f = -1.75f;
+    std::memcpy(frame.data.data(), &f, sizeof(f));
+    frame.data[4] = 2;
+    std::vector<double> values;
+    CHECK(dbc.decode_values(FLOATS, frame, values));
+    CHECK(values.size() == 3 && values[0] == -1.75 && values[1] == 2);
+
+    // BA_ sets a message's cycle time, BA_DEF_DEF_ the rest of the file's;
+    // BA_ for an unknown message or with a bad id is ignored
+    CHECK(speed.cycle_time_ms == 20);
+    CHECK(dbc.messages().at(512).cycle_time_ms == 100);
+    CHECK(dbc.messages().at(FLOATS).cycle_time_ms == 100);
+    CHECK(dbc.attribute_defs().count("GenMsgCycleTime")
+          && dbc.attribute_defs().at("GenMsgCycleTime").default_value == "100");
+    CHECK(dbc.attribute_defs().count("SigKind")
+          && (dbc.attribute_defs().at("SigKind").enum_values == std::vector<std::string>{"Raw", "Scaled"}));
+    CHECK(wheel && wheel->attributes.count("SigKind") && wheel->attributes.at("SigKind") == "1");
+
+    // a VAL_ beats the table of the same name, which the other Mode gets;
+    // a table named after no signal is attached to nothing
+    const DbcSignal* mode = find(dbc, 256, "Mode");
+    const DbcSignal* float_mode = find(dbc, FLOATS, "Mode");
+    CHECK(mode && (mode->value_map == std::unordered_map<int64_t, std::string>{{0, "Idle"}, {1, "Run"}}));
+    CHECK(float_mode && (float_mode->value_map
+                         == std::unordered_map<int64_t, std::string>{{0, "Off"}, {1, "On"}, {2, "Fault"}}));
+    CHECK(gear && gear->value_map.empty());
+
+    // a second DBC into the same parser: its Mode gets no table from the
+    // first file, its messages no default cycle time, and the first
+    // file's messages keep theirs
+    CHECK(dbc.loadFromMemory(OTHER_DBC, sizeof(OTHER_DBC) - 1, "other.dbc"));
+    CHECK(dbc.messages().size() == 4);
+    const DbcSignal* other_mode = find(dbc, 1024, "Mode");
+    CHECK(other_mode && other_mode->value_map.empty());
+    CHECK(dbc.messages().at(1024).cycle_time_ms == 0 && dbc.messages().at(1024).dbc_name == "other.dbc");
+    CHECK(dbc.messages().at(512).cycle_time_ms == 100 && find(dbc, FLOATS, "Mode")->value_map.size() == 3);
+
+    return test_result();
+}
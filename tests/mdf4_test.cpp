@@ -0,0 +1,174 @@
+// Mdf4Writer / Mdf4Reader: frames written to an .mf4 with decoded groups
+// next to the raw one come back from the reader unchanged, in order and
+// through seek(), and a file that was never closed is refused.
+
+#include "check.hpp"
+#include "mdf4.hpp"
+#include "candb.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+
+namespace {
+
+struct Frame {
+    uint8_t bus;
+    uint32_t id;
+    uint8_t len;
+    uint8_t flags;
+    uint8_t data[CAN_FD_MAX_LEN];
+    uint64_t timestamp_ns;
+};
+
+// two messages with signals, so the file also carries decoded groups
+const char DBC[] =
+    "BO_ 256 Speed: 8 ECU\n"
+    " SG_ Wheel : 0|16@1+ (0.01,0) [0|655.35] \"km/h\" HOST\n"
+    " SG_ Gear : 16|4@1+ (1,0) [0|15] \"\" HOST\n"
+    "BO_ 2566848768 Battery: 8 BMS\n"
+    " SG_ Voltage : 7|16@0- (0.1,0) [-3276.8|3276.7] \"V\" HOST\n";
+
+// classic and FD, standard and extended ids on three buses, stamped at
+// strictly increasing times. No RTR frames: the flag has no MDF channel.
+std::vector<Frame> make_frames(size_t n, std::mt19937& rng){
+    static const uint8_t fd_lens[] = {12, 16, 20, 24, 32, 48, 64};
+    std::vector<Frame> out;
+    uint64_t t = 1700000000000000000ull;
+    for(size_t i = 0; i < n; ++i){
+        Frame f{};
+        f.bus = static_cast<uint8_t>(rng() % 3);
+        switch(rng() % 5){
+            case 0: f.id = 0x100; break;
+            case 1: f.id = CAN_ID_EXT_FLAG | 0x18FF5000; break;
+            case 2: f.id = CAN_ID_EXT_FLAG | (rng() & CAN_ID_EXT_MASK); break;
+            default: f.id = rng() & CAN_ID_STD_MASK; break;
+        }
+        if(rng() % 4 == 0){
+            f.len = fd_lens[rng() % sizeof(fd_lens)];
+            f.flags = CANLOG_FLAG_FD | (rng() % 2 ? CANLOG_FLAG_BRS : 0);
+        } else {
+            f.len = static_cast<uint8_t>(rng() % 9);
+        }
+        for(uint8_t b = 0; b < f.len; ++b)
+            f.data[b] = static_cast<uint8_t>(rng());
+        t += 1000 + rng() % 2000000;
+        f.timestamp_ns = t;
+        out.push_back(f);
+    }
+    return out;
+}
+
+bool same(const Frame& f, const CanLogRecord& rec, const uint8_t* payload){
+    return rec.timestamp_ns == f.timestamp_ns && rec.id == f.id && rec.bus == f.bus && rec.len == f.len
+        && rec.flags == f.flags && std::memcmp(payload, f.data, f.len) == 0;
+}
+
+} // namespace
+
+int main(){
+    char tmpl[] = "/tmp/photon_mdf4_XXXXXX";
+    if(!mkdtemp(tmpl))
+        SKIP("no temporary directory");
+    const std::string dir = tmpl;
+    const std::string path = dir + "/session.mf4";
+
+    DbcParser dbc;
+    CHECK(dbc.loadFromMemory(DBC, sizeof(DBC) - 1, "test.dbc"));
+    DbcMessageList messages;
+    for(const auto &mp : dbc.messages())
+        messages.emplace_back(mp.first, &mp.second);
+    CHECK(messages.size() == 2);
+
+    // enough frames for several raw DT blocks
+    std::mt19937 rng(20);
+    const std::vector<Frame> frames = make_frames(100000, rng);
+    {
+        Mdf4Writer writer(path, messages);
+        writer.set_bus_name(0, "can0");
+        writer.set_bus_name(2, "TCP 10.0.0.2:5000 <&>");
+        for(const auto &f : frames)
+            writer.append(f.bus, f.id, f.len, f.data, f.timestamp_ns, f.flags);
+
+        bool refused = false;
+        try{
+            Mdf4Reader early(path);
+        } catch (const std::exception &){
+            refused = true;
+        }
+        CHECK(refused);
+        writer.close();
+        CHECK(writer.frames() == frames.size());
+    }
+
+    Mdf4Reader reader(path);
+    CHECK(reader.records() == frames.size());
+    CHECK(reader.first_ns() == frames.front().timestamp_ns);
+    CHECK(reader.last_ns() == frames.back().timestamp_ns);
+    CHECK(reader.bus_names().size() == 3);
+    if(reader.bus_names().size() == 3)
+        CHECK(reader.bus_names()[0] == "can0" && reader.bus_names()[1].empty()
+              && reader.bus_names()[2] == "TCP 10.0.0.2:5000 <&>");
+
+    // front to back
+    size_t read = 0, bad = 0;
+    CanLogRecord rec;
+    const uint8_t* payload;
+    for(FrameLog::Cursor c = reader.begin(); reader.next(c, rec, payload); ++read)
+        if(read >= frames.size() || !same(frames[read], rec, payload))
+            ++bad;
+    CHECK(read == frames.size());
+    CHECK(bad == 0);
+
+    // seek lands on the first frame at or after the target: before the
+    // start, exactly on frames, between them and past the end
+    std::vector<uint64_t> stamps;
+    for(const auto &f : frames)
+        stamps.push_back(f.timestamp_ns);
+    std::vector<uint64_t> targets{0, stamps.front(), stamps.back(), stamps.back() + 1};
+    for(int i = 0; i < 2000; ++i){
+        const uint64_t t = stamps[rng() % stamps.size()];
+        targets.push_back(t);
+        targets.push_back(t - 1);
+        targets.push_back(t + 1);
+    }
+    size_t seek_bad = 0;
+    for(uint64_t t : targets){
+        const size_t want = std::lower_bound(stamps.begin(), stamps.end(), t) - stamps.begin();
+        FrameLog::Cursor c = reader.seek(t);
+        if(want == frames.size()){
+            if(reader.next(c, rec, payload))
+                ++seek_bad;
+            continue;
+        }
+        if(!reader.next(c, rec, payload) || !same(frames[want], rec, payload)){
+            ++seek_bad;
+            continue;
+        }
+        // and reading on from there carries on in order
+        if(want + 1 < frames.size() && (!reader.next(c, rec, payload) || !same(frames[want + 1], rec, payload)))
+            ++seek_bad;
+    }
+    std::cout << "[+] " << read << " frames read back, " << targets.size() << " seeks" << std::endl;
+    CHECK(seek_bad == 0);
+
+    // replay and export open it by extension
+    CHECK(open_frame_log(path)->records() == frames.size());
+
+    CHECK(std::system(("rm -rf '" + dir + "'").c_str()) == 0);
+    return test_result();
+}
+
+#else
+
+int main(){
+    SKIP("posix only");
+}
+
+#endif
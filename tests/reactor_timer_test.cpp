@@ -0,0 +1,55 @@
+// Reactor timers: a disarmed timer stops firing (the replay disarms its
+// 1 ms tick while paused or finished) and fires again once re-armed.
+
+#include "check.hpp"
+#include "reactor.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+void sleep_ms(int ms){
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+} // namespace
+
+int main(){
+    Reactor reactor;
+    std::thread loop([&reactor]{ reactor.run(); });
+
+    std::atomic<uint64_t> fired{0};
+    const int id = reactor.add_timer(1000000, [&fired]{ ++fired; });
+    sleep_ms(100);
+    CHECK(fired.load() > 10);
+
+    reactor.set_timer_armed(id, false);
+    sleep_ms(20);
+    const uint64_t disarmed = fired.load();
+    sleep_ms(200);
+    std::cout << "[+] fired " << fired.load() - disarmed << " times while disarmed" << std::endl;
+    CHECK(fired.load() == disarmed);
+
+    // disarming twice is harmless, arming again resumes
+    reactor.set_timer_armed(id, false);
+    reactor.set_timer_armed(id, true);
+    sleep_ms(100);
+    CHECK(fired.load() > disarmed + 10);
+
+    // a timer can disarm itself from its own callback
+    std::atomic<uint64_t> once{0};
+    std::atomic<int> self{-1};
+    self = reactor.add_timer(1000000, [&]{
+        ++once;
+        reactor.set_timer_armed(self.load(), false);
+    });
+    sleep_ms(100);
+    CHECK(once.load() >= 1 && once.load() <= 3);
+
+    reactor.remove_timer(id);
+    reactor.remove_timer(self.load());
+    reactor.stop();
+    loop.join();
+    return test_result();
+}
@@ -0,0 +1,73 @@
+// A SessionRecorder whose writer thread died on an I/O error can be started
+// again: start() reaps the finished thread instead of returning early.
+
+#include "check.hpp"
+#include "canlog.hpp"
+#include "recorder.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+bool exists(const std::string& path){
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+// up to 5 s for the writer to notice, it flushes at least once a second
+bool wait_inactive(const SessionRecorder& rec){
+    for(int i = 0; i < 500 && rec.active(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return !rec.active();
+}
+
+void record_some(SessionRecorder& rec, int frames){
+    const uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    for(int i = 0; i < frames; ++i)
+        rec.record(0, 0x123, 8, payload, 1000 + i);
+}
+
+} // namespace
+
+int main(){
+    char tmpl[] = "/tmp/photon_recorder_XXXXXX";
+    if(!mkdtemp(tmpl))
+        SKIP("no temporary directory");
+    const std::string root = tmpl;
+    const std::string first = root + "/first";
+    const std::string second = root + "/second";
+
+    SessionRecorder rec;
+    rec.start(first);
+    CHECK(rec.active());
+    // the first segment is only opened on the first flush, so with the
+    // directory gone that flush fails and the writer thread ends
+    CHECK(std::system(("rm -rf '" + first + "'").c_str()) == 0);
+    record_some(rec, 10);
+    CHECK(wait_inactive(rec));
+
+    rec.start(second);
+    CHECK(rec.active());
+    record_some(rec, 10);
+    rec.stop();
+    CHECK(!rec.active());
+    CHECK(rec.frames() == 10);
+    CHECK(exists(canlog_segment_path(second, 0, "canlog")));
+
+    CHECK(std::system(("rm -rf '" + root + "'").c_str()) == 0);
+    return test_result();
+}
+
+#else
+
+int main(){
+    SKIP("posix only");
+}
+
+#endif
@@ -0,0 +1,171 @@
+// SignalHistory::range over eight hours of samples: points come out in time
+// order, no window ever loses its minimum or maximum, short recent spans are
+// raw samples and everything else the LOD pyramid, and a span running up to
+// the newest sample reaches it whatever the pyramid has not completed yet.
+
+#include "check.hpp"
+#include "signal_history.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int PIXELS = 1000;
+
+// min/max over any index range of the reference samples, from per block
+// extrema and the partial blocks at either end
+class Extrema {
+    public:
+        static constexpr std::size_t BLOCK = 1024;
+
+        void add(double v){
+            if(_v.size() % BLOCK == 0){
+                _lo.push_back(v);
+                _hi.push_back(v);
+            }
+            _lo.back() = std::min(_lo.back(), v);
+            _hi.back() = std::max(_hi.back(), v);
+            _v.push_back(v);
+        }
+
+        // over [i0, i1), which must not be empty
+        void get(std::size_t i0, std::size_t i1, double& lo, double& hi) const{
+            lo = hi = _v[i0];
+            while(i0 < i1){
+                if(i0 % BLOCK == 0 && i0 + BLOCK <= i1){
+                    lo = std::min(lo, _lo[i0 / BLOCK]);
+                    hi = std::max(hi, _hi[i0 / BLOCK]);
+                    i0 += BLOCK;
+                } else {
+                    lo = std::min(lo, _v[i0]);
+                    hi = std::max(hi, _v[i0]);
+                    ++i0;
+                }
+            }
+        }
+
+    private:
+        std::vector<double> _v, _lo, _hi;
+};
+
+struct Reference {
+    std::vector<double> t;
+    Extrema extrema;
+};
+
+void append(SignalHistory& history, SignalHandle h, Reference& ref, double t, double v){
+    history.append(h, t, v);
+    ref.t.push_back(t);
+    ref.extrema.add(v);
+}
+
+// pyramid buckets hold floats
+bool covers(double got, double want, bool above){
+    const double slack = 1e-6 * std::max(1.0, std::fabs(want));
+    return above ? got >= want - slack : got <= want + slack;
+}
+
+struct Result {
+    bool ordered = true;
+    bool extrema = true;
+    bool raw = false;
+    bool bounded = true;
+};
+
+Result check_window(const SignalHistory& history, SignalHandle h, const Reference& ref,
+                    double t_min, double t_max, LodBuffer& scratch){
+    Result r;
+    const SignalView raw = history.view(h);
+    const SignalView out = history.range(h, t_min, t_max, PIXELS, scratch);
+    r.raw = out.t >= raw.t && out.t < raw.t + raw.count;
+    for(int i = 1; i < out.count; ++i)
+        if(out.t[i] < out.t[i - 1])
+            r.ordered = false;
+    // a bucket per pixel, each up to 4 points, plus one past either end and
+    // the partial buckets closing the gap to the newest sample
+    r.bounded = out.count <= 4 * (PIXELS + 2 + static_cast<int>(SignalHistory::LOD_LEVELS));
+
+    const std::size_t i0 = std::lower_bound(ref.t.begin(), ref.t.end(), t_min) - ref.t.begin();
+    const std::size_t i1 = std::upper_bound(ref.t.begin(), ref.t.end(), t_max) - ref.t.begin();
+    if(i0 >= i1 || !out.count)
+        return r;
+    double lo, hi;
+    ref.extrema.get(i0, i1, lo, hi);
+    const double got_lo = *std::min_element(out.v, out.v + out.count);
+    const double got_hi = *std::max_element(out.v, out.v + out.count);
+    r.extrema = covers(got_lo, lo, false) && covers(got_hi, hi, true);
+    return r;
+}
+
+} // namespace
+
+int main(){
+    std::mt19937 rng(15);
+    std::normal_distribution<double> step(0.0, 1.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    // eight hours at 50 Hz with jittered stamps: a random walk with the odd
+    // single sample spike, the kind a decimating plot would drop first
+    SignalHistory history;
+    const SignalHandle h = history.handle(signal_key("TEST", 0x100, "walk"));
+    Reference ref;
+    constexpr double HOURS = 8.0, RATE = 50.0;
+    double v = 0.0;
+    for(std::size_t n = 0; n < static_cast<std::size_t>(HOURS * 3600 * RATE); ++n){
+        v += step(rng);
+        const bool spike = rng() % 5000 == 0;
+        append(history, h, ref, (n + 0.5 * unit(rng)) / RATE, spike ? v + (rng() % 2 ? 500.0 : -500.0) : v);
+    }
+    const double first = ref.t.front(), last = ref.t.back();
+    const double ring_first = history.view(h).t[0];
+    std::cout << "[+] " << ref.t.size() << " samples over " << last / 3600 << " h, the raw ring holds the last "
+              << (last - ring_first) / 60 << " min" << std::endl;
+
+    // random windows from a few samples to the whole day
+    LodBuffer scratch;
+    size_t unordered = 0, missed = 0, unbounded = 0, raw = 0;
+    constexpr int WINDOWS = 20000;
+    for(int w = 0; w < WINDOWS; ++w){
+        const double span = std::pow(10.0, -1.0 + unit(rng) * (std::log10(last - first) + 1.0));
+        const double t_min = first - 10.0 + unit(rng) * (last - first + 20.0 - span);
+        const Result r = check_window(history, h, ref, t_min, t_min + span, scratch);
+        unordered += !r.ordered;
+        missed += !r.extrema;
+        unbounded += !r.bounded;
+        raw += r.raw;
+    }
+    std::cout << "[+] " << WINDOWS << " windows, " << raw << " from the raw ring" << std::endl;
+    CHECK(unordered == 0);
+    CHECK(missed == 0);
+    CHECK(unbounded == 0);
+
+    // raw while the ring covers the span in few enough samples, the pyramid
+    // when there are too many or they are older than the ring
+    CHECK(check_window(history, h, ref, last - 10.0, last, scratch).raw);
+    CHECK(check_window(history, h, ref, last - 4 * PIXELS / RATE + 1.0, last, scratch).raw);
+    CHECK(!check_window(history, h, ref, last - 4 * PIXELS / RATE - 1.0, last, scratch).raw);
+    CHECK(!check_window(history, h, ref, ring_first - 10.0, ring_first - 5.0, scratch).raw);
+    CHECK(!check_window(history, h, ref, first, last, scratch).raw);
+
+    // following the newest sample: after every odd number of appends some
+    // pyramid levels sit on a partial bucket, and the whole day must still
+    // end on the newest sample with a fresh extreme in it
+    size_t gap_bad = 0;
+    for(std::size_t extra : {1u, 2u, 3u, 5u, 15u, 63u, 255u, 1021u, 4093u, 16385u, 65533u}){
+        for(std::size_t i = 0; i + 1 < extra; ++i){
+            v += step(rng);
+            append(history, h, ref, ref.t.back() + 1.0 / RATE, v);
+        }
+        append(history, h, ref, ref.t.back() + 1.0 / RATE, v + 1000.0 * extra);
+        const SignalView out = history.range(h, first, ref.t.back(), PIXELS, scratch);
+        const bool newest = out.count && out.t[out.count - 1] == ref.t.back();
+        const Result r = check_window(history, h, ref, first, ref.t.back(), scratch);
+        if(!newest || !r.ordered || !r.extrema || r.raw)
+            ++gap_bad;
+    }
+    CHECK(gap_bad == 0);
+
+    return test_result();
+}
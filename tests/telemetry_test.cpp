@@ -0,0 +1,257 @@
+// Telemetry link: what TelemetryEncoder packs comes back out of
+// TelemetryDecoder frame for frame, however the stream is split across
+// reads, and a corrupted or dropped packet costs only its own frames.
+
+#include "check.hpp"
+#include "telemetry.hpp"
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Sent {
+    uint32_t id;
+    uint8_t len;
+    uint8_t data[CAN_FD_MAX_LEN];
+    uint64_t timestamp_ns;
+};
+
+// bit at a time, what both crc32c paths must agree with
+uint32_t crc32c_bitwise(const uint8_t* data, size_t len, uint32_t crc = 0){
+    crc = ~crc;
+    for(size_t i = 0; i < len; ++i){
+        crc ^= data[i];
+        for(int k = 0; k < 8; ++k)
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : (crc >> 1);
+    }
+    return ~crc;
+}
+
+// The host clock stands still for the whole test: the anchor neither
+// creeps nor moves once it has seen the latest sender time first, so every
+// frame maps to its sender time plus one fixed offset.
+constexpr uint64_t READ_NS = 200000000000000000ull;
+constexpr uint64_t LATEST_NS = 100000000000000000ull;
+
+// frames of every shape, microsecond stamps with gaps from 0 to hours so
+// the deltas take 1 to 6 varint bytes
+std::vector<Sent> make_frames(size_t n, std::mt19937& rng){
+    static const uint8_t fd_lens[] = {12, 16, 20, 24, 32, 48, 64};
+    static const uint64_t gaps_us[] = {0, 1, 127, 128, 16383, 16384, 1u << 21, 1u << 28, 1ull << 35};
+    std::vector<Sent> out;
+    uint64_t t = 1000000000;
+    for(size_t i = 0; i < n; ++i){
+        Sent f{};
+        const unsigned kind = rng() % 4;
+        f.id = kind == 1 ? (CAN_ID_EXT_FLAG | (rng() & CAN_ID_EXT_MASK)) : (rng() & CAN_ID_STD_MASK);
+        if(kind == 2){
+            f.id |= CAN_ID_RTR_FLAG;
+            f.len = static_cast<uint8_t>(rng() % 9);
+        } else {
+            f.len = kind == 3 ? fd_lens[rng() % sizeof(fd_lens)] : static_cast<uint8_t>(rng() % 9);
+            for(uint8_t b = 0; b < f.len; ++b)
+                f.data[b] = static_cast<uint8_t>(rng());
+        }
+        t += 1000 * (rng() % 8 ? rng() % 2000 : gaps_us[rng() % (sizeof(gaps_us) / sizeof(gaps_us[0]))]);
+        f.timestamp_ns = t;
+        out.push_back(f);
+    }
+    return out;
+}
+
+// one packet per batch of up to batch frames (fewer when the body fills)
+std::vector<std::vector<uint8_t>> encode(TelemetryEncoder& enc, const std::vector<Sent>& frames, size_t batch,
+                                         std::vector<std::vector<size_t>>& members){
+    std::vector<std::vector<uint8_t>> packets;
+    std::vector<size_t> current;
+    auto seal = [&]{
+        packets.push_back(enc.finish());
+        members.push_back(current);
+        current.clear();
+    };
+    for(size_t i = 0; i < frames.size(); ++i){
+        const Sent &f = frames[i];
+        if(!enc.add(0, f.id, f.len, f.data, f.timestamp_ns)){
+            seal();
+            CHECK(enc.add(0, f.id, f.len, f.data, f.timestamp_ns));
+        }
+        current.push_back(i);
+        if(current.size() == batch)
+            seal();
+    }
+    if(!enc.empty())
+        seal();
+    return packets;
+}
+
+struct Received {
+    std::vector<Sent> frames;
+
+    FrameHandler handler(){
+        return [this](uint32_t id, uint8_t len, const uint8_t* payload, uint64_t timestamp_ns){
+            Sent f{};
+            f.id = id;
+            f.len = len;
+            std::memcpy(f.data, payload, len);
+            f.timestamp_ns = timestamp_ns;
+            frames.push_back(f);
+        };
+    }
+};
+
+bool same(const Sent& sent, const Sent& got){
+    const bool rtr = (sent.id & CAN_ID_RTR_FLAG) != 0;
+    return sent.id == got.id && sent.len == got.len
+        && (rtr || std::memcmp(sent.data, got.data, sent.len) == 0)
+        && sent.timestamp_ns + (READ_NS - LATEST_NS) == got.timestamp_ns;
+}
+
+// the anchor packet, then the HELLO_ACK
+TelemetryEncoder start(TelemetryDecoder& dec){
+    TelemetryEncoder enc;
+    enc.add(0, 0x7FF, 0, nullptr, LATEST_NS);
+    std::vector<uint8_t> stream = enc.finish();
+    const std::vector<uint8_t> ack = TelemetryEncoder::hello(TELEMETRY_HELLO_ACK);
+    stream.insert(stream.end(), ack.begin(), ack.end());
+    dec.parse(stream.data(), stream.size(), READ_NS);
+    return enc;
+}
+
+std::vector<uint8_t> join(const std::vector<std::vector<uint8_t>>& packets){
+    std::vector<uint8_t> out;
+    for(const auto &p : packets)
+        out.insert(out.end(), p.begin(), p.end());
+    return out;
+}
+
+// frames the decoder should have given back, the anchor's first
+size_t check_frames(const Received& got, const std::vector<Sent>& sent, const std::vector<size_t>& expected){
+    size_t bad = 0;
+    if(got.frames.size() != expected.size() + 1)
+        return expected.size() + 1;
+    for(size_t i = 0; i < expected.size(); ++i)
+        if(!same(sent[expected[i]], got.frames[i + 1]))
+            ++bad;
+    return bad;
+}
+
+} // namespace
+
+int main(){
+    std::mt19937 rng(8);
+
+    // CRC-32C check value, and whichever implementation runs against the
+    // bitwise one at every length, alignment and split
+    const char* check = "123456789";
+    CHECK(crc32c(reinterpret_cast<const uint8_t*>(check), 9) == 0xE3069283u);
+    std::vector<uint8_t> buf(300);
+    for(auto &b : buf)
+        b = static_cast<uint8_t>(rng());
+    size_t crc_bad = 0;
+    for(size_t off = 0; off < 8; ++off)
+        for(size_t len = 0; off + len <= buf.size(); ++len){
+            const uint8_t* p = buf.data() + off;
+            const uint32_t want = crc32c_bitwise(p, len);
+            if(crc32c(p, len) != want || crc32c(p + len / 2, len - len / 2, crc32c(p, len / 2)) != want)
+                ++crc_bad;
+        }
+    CHECK(crc_bad == 0);
+
+    const std::vector<Sent> frames = make_frames(3000, rng);
+    std::vector<size_t> all(frames.size());
+    for(size_t i = 0; i < all.size(); ++i)
+        all[i] = i;
+
+    // byte by byte, then in reads of random size
+    for(int split = 0; split < 2; ++split){
+        Received got;
+        TelemetryDecoder dec(got.handler());
+        TelemetryEncoder enc = start(dec);
+        std::vector<std::vector<size_t>> members;
+        const std::vector<uint8_t> stream = join(encode(enc, frames, 1000, members));
+        CHECK(members.size() > 3); // some packets filled their body
+        for(size_t off = 0; off < stream.size();){
+            const size_t n = split ? std::min<size_t>(1 + rng() % 3000, stream.size() - off) : 1;
+            dec.parse(stream.data() + off, n, READ_NS);
+            off += n;
+        }
+        CHECK(check_frames(got, frames, all) == 0);
+        CHECK(dec.version() == TELEMETRY_VERSION);
+        CHECK(dec.frames() == frames.size() + 1);
+        CHECK(dec.errors() == 0 && dec.crc_errors() == 0 && dec.lost_packets() == 0);
+    }
+
+    // a sender without a clock stamps 0, its frames take the read time
+    {
+        Received got;
+        TelemetryDecoder dec(got.handler());
+        TelemetryEncoder enc;
+        const uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        enc.add(0, 0x123, 8, payload, 0);
+        enc.add(0, 0x124, 8, payload, 0);
+        const std::vector<uint8_t> p = enc.finish();
+        dec.parse(p.data(), p.size(), READ_NS);
+        CHECK(got.frames.size() == 2);
+        for(const auto &f : got.frames)
+            CHECK(f.timestamp_ns == READ_NS);
+    }
+
+    // packets of 10 frames; corrupt some, drop some, put garbage
+    // between others, and every untouched packet still comes through
+    {
+        Received got;
+        TelemetryDecoder dec(got.handler());
+        TelemetryEncoder enc = start(dec);
+        std::vector<std::vector<size_t>> members;
+        std::vector<std::vector<uint8_t>> packets = encode(enc, frames, 10, members);
+        std::vector<size_t> expected;
+        std::vector<uint8_t> stream;
+        uint64_t dropped = 0, corrupted = 0, gaps = 0, missing = 0;
+        for(size_t k = 0; k < packets.size(); ++k){
+            std::vector<uint8_t> &p = packets[k];
+            switch(k % 7){
+                case 1: // a flipped body bit
+                    p[TELEMETRY_HEADER_SIZE + rng() % (p.size() - TELEMETRY_HEADER_SIZE - TELEMETRY_CRC_SIZE)] ^= 0x10;
+                    ++corrupted;
+                    break;
+                case 3: // a length that reaches into the next packet
+                    p[2] ^= 0x01;
+                    ++corrupted;
+                    break;
+                case 4: // lost on the link
+                    ++dropped;
+                    ++missing;
+                    continue;
+                case 5: // line noise, sync bytes included
+                    for(int i = 0; i < 40; ++i)
+                        stream.push_back(i % 5 ? static_cast<uint8_t>(rng()) : TELEMETRY_SYNC);
+                    break;
+            }
+            if(k % 7 == 1 || k % 7 == 3){
+                ++missing;
+            } else {
+                expected.insert(expected.end(), members[k].begin(), members[k].end());
+                // a gap only shows once the next packet arrives
+                gaps += missing;
+                missing = 0;
+            }
+            stream.insert(stream.end(), p.begin(), p.end());
+        }
+        for(size_t off = 0; off < stream.size();){
+            const size_t n = std::min<size_t>(1 + rng() % 700, stream.size() - off);
+            dec.parse(stream.data() + off, n, READ_NS);
+            off += n;
+        }
+        std::cout << "[+] " << packets.size() << " packets, " << corrupted << " corrupted, " << dropped
+                  << " dropped: " << got.frames.size() - 1 << " frames back, " << dec.crc_errors()
+                  << " CRC errors, " << dec.errors() << " errors, " << dec.lost_packets() << " lost" << std::endl;
+        CHECK(check_frames(got, frames, expected) == 0);
+        CHECK(dec.crc_errors() >= corrupted);
+        CHECK(dec.errors() > 0);
+        // every corrupted or dropped packet is one sequence number missing
+        CHECK(dec.lost_packets() == gaps && gaps + missing == corrupted + dropped);
+    }
+
+    return test_result();
+}